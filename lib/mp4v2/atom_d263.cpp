@@ -81,6 +81,7 @@ void MP4D263Atom::Write()
 
 		if(!maxBitrate && !avgBitrate) {
 			DeleteChildAtom(bitrAtom);
+			delete bitrAtom;
 		}
 	}
 
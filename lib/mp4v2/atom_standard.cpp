@@ -74,6 +74,8 @@ MP4StandardAtom::MP4StandardAtom (const char *type) : MP4Atom(type)
     
     MP4TableProperty* pTable = new MP4TableProperty("entries", pCount);
     AddProperty(pTable);
+    pTable->SetBulkRead();
+    pTable->SetLazyRead();
     
     pTable->AddProperty(
 			new MP4Integer64Property("chunkOffset"));
@@ -103,6 +105,8 @@ MP4StandardAtom::MP4StandardAtom (const char *type) : MP4Atom(type)
     
     MP4TableProperty* pTable = new MP4TableProperty("entries", pCount);
     AddProperty(pTable);
+    pTable->SetBulkRead();
+    pTable->SetLazyRead();
     
     pTable->AddProperty(new MP4Integer32Property("sampleCount"));
     pTable->AddProperty(new MP4Integer32Property("sampleOffset"));
@@ -333,6 +337,8 @@ MP4StandardAtom::MP4StandardAtom (const char *type) : MP4Atom(type)
 
     MP4TableProperty* pTable = new MP4TableProperty("entries", pCount);
     AddProperty(pTable);
+    pTable->SetBulkRead();
+    pTable->SetLazyRead();
 
     pTable->AddProperty(new MP4Integer32Property("chunkOffset"));
 
@@ -356,6 +362,8 @@ MP4StandardAtom::MP4StandardAtom (const char *type) : MP4Atom(type)
 
     MP4TableProperty* pTable = new MP4TableProperty("entries", pCount);
     AddProperty(pTable);
+    pTable->SetBulkRead();
+    pTable->SetLazyRead();
 
     pTable->AddProperty(new MP4Integer32Property("sampleNumber"));
 
@@ -366,6 +374,8 @@ MP4StandardAtom::MP4StandardAtom (const char *type) : MP4Atom(type)
 
     MP4TableProperty* pTable = new MP4TableProperty("entries", pCount);
     AddProperty(pTable);
+    pTable->SetBulkRead();
+    pTable->SetLazyRead();
 
     pTable->AddProperty(new MP4Integer32Property("sampleCount"));
     pTable->AddProperty(new MP4Integer32Property("sampleDelta"));
@@ -32,6 +32,7 @@ MP4StscAtom::MP4StscAtom()
 
 	MP4TableProperty* pTable = new MP4TableProperty("entries", pCount);
 	AddProperty(pTable);
+	pTable->SetBulkRead();
 
 	pTable->AddProperty(
 		new MP4Integer32Property("firstChunk"));
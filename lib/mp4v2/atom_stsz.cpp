@@ -35,6 +35,8 @@ MP4StszAtom::MP4StszAtom()
 
 	MP4TableProperty* pTable = new MP4TableProperty("entries", pCount);
 	AddProperty(pTable); /* 4 */
+	pTable->SetBulkRead();
+	pTable->SetLazyRead();
 
 	pTable->AddProperty( /* 4/0 */
 		new MP4Integer32Property("entrySize"));
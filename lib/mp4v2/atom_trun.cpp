@@ -45,6 +45,7 @@ void MP4TrunAtom::AddProperties(u_int32_t flags)
 	  new MP4TableProperty("samples", 
 			       (MP4Integer32Property *)m_pProperties[2]);
 	AddProperty(pTable);
+	pTable->SetBulkRead();
 
 	if (flags & 0x100) {
 		pTable->AddProperty(
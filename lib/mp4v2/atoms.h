@@ -362,7 +362,6 @@ class MP4TfhdAtom : public MP4Atom {
 public:
 	MP4TfhdAtom();
 	void Read();
-protected:
 	void AddProperties(u_int32_t flags);
 };
 
@@ -378,7 +377,6 @@ class MP4TrunAtom : public MP4Atom {
 public:
 	MP4TrunAtom();
 	void Read();
-protected:
 	void AddProperties(u_int32_t flags);
 };
 
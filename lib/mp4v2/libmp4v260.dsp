@@ -318,6 +318,10 @@ SOURCE=.\mp4property.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\mp4reader.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\mp4track.cpp
 # End Source File
 # Begin Source File
@@ -386,6 +390,10 @@ SOURCE=.\mp4property.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\mp4reader.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\mp4track.h
 # End Source File
 # Begin Source File
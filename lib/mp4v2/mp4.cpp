@@ -41,6 +41,10 @@
 #define PRINT_ERROR(e) \
 	VERBOSE_ERROR(((MP4File*)hFile)->GetVerbosity(), e->Print());
 
+#define PRINT_STATUS(status, where) \
+	VERBOSE_ERROR(((MP4File*)hFile)->GetVerbosity(), \
+		MP4PrintStatus(status, where));
+
 /* file operations */
 // benski>
  extern "C" MP4FileHandle MP4ReadEx (const char* fileName,
@@ -78,6 +82,46 @@ extern "C" MP4FileHandle MP4Read(const char* fileName, u_int32_t verbosity)
 	}
 }
 
+extern "C" MP4FileHandle MP4ReadMapped(const char* fileName, 
+				       u_int32_t verbosity)
+{
+	MP4File* pFile = NULL;
+	try {
+		pFile = new MP4File(verbosity);
+		pFile->ReadMapped(fileName);
+		return (MP4FileHandle)pFile;
+	}
+	catch (MP4Error* e) {
+		VERBOSE_ERROR(verbosity, e->Print());
+		delete e;
+		delete pFile;
+		return MP4_INVALID_FILE_HANDLE;
+	}
+}
+
+extern "C" MP4FileHandle MP4ReadLazy(const char* fileName, 
+				     u_int32_t verbosity,
+				     bool mapped)
+{
+	MP4File* pFile = NULL;
+	try {
+		pFile = new MP4File(verbosity);
+		pFile->SetLazyLoad(true);
+		if (mapped) {
+			pFile->ReadMapped(fileName);
+		} else {
+			pFile->Read(fileName);
+		}
+		return (MP4FileHandle)pFile;
+	}
+	catch (MP4Error* e) {
+		VERBOSE_ERROR(verbosity, e->Print());
+		delete e;
+		delete pFile;
+		return MP4_INVALID_FILE_HANDLE;
+	}
+}
+
 extern "C" MP4FileHandle MP4Create (const char* fileName,
 				    u_int32_t verbosity, 
 				    u_int32_t  flags)
@@ -112,6 +156,45 @@ extern "C" MP4FileHandle MP4CreateEx (const char* fileName,
 	}
 }
 
+extern "C" MP4FileHandle MP4CreateFragmented (const char* fileName,
+					      u_int32_t verbosity, 
+					      u_int32_t flags,
+					      u_int32_t fragmentDuration)
+{
+	MP4File* pFile = NULL;
+	try {
+		pFile = new MP4File(verbosity);
+		pFile->SetFragmentDuration(fragmentDuration);
+		pFile->Create(fileName, flags);
+		return (MP4FileHandle)pFile;
+	}
+	catch (MP4Error* e) {
+		VERBOSE_ERROR(verbosity, e->Print());
+		delete e;
+		delete pFile;
+		return MP4_INVALID_FILE_HANDLE;
+	}
+}
+
+extern "C" bool MP4MakeStreamable(const char* existingFileName, 
+	const char* newFileName, 
+	u_int32_t verbosity)
+{
+	MP4File* pFile = NULL;
+	try {
+		pFile = new MP4File(verbosity);
+		pFile->MakeStreamable(existingFileName, newFileName);
+		delete pFile;
+		return true;
+	}
+	catch (MP4Error* e) {
+		VERBOSE_ERROR(verbosity, e->Print());
+		delete e;
+	}
+	delete pFile;
+	return false;
+}
+
 extern "C" MP4FileHandle MP4Modify(const char* fileName, 
 	u_int32_t verbosity, u_int32_t flags)
 {
@@ -134,10 +217,20 @@ extern "C" MP4FileHandle MP4Modify(const char* fileName,
 extern "C" bool MP4Optimize(const char* existingFileName, 
 	const char* newFileName, 
 	u_int32_t verbosity)
+{
+	return MP4OptimizeEx(existingFileName, newFileName, verbosity);
+}
+
+extern "C" bool MP4OptimizeEx(const char* existingFileName, 
+	const char* newFileName, 
+	u_int32_t verbosity,
+	MP4OptimizeProgressFunc progressFunc,
+	void* userData)
 {
 	try {
 		MP4File* pFile = new MP4File(verbosity);
-		pFile->Optimize(existingFileName, newFileName);
+		pFile->Optimize(existingFileName, newFileName, 
+			progressFunc, userData);
 		delete pFile;
 		return true;
 	}
@@ -214,6 +307,22 @@ extern "C" void MP4SetVerbosity(MP4FileHandle hFile, u_int32_t verbosity)
 	return;
 }
 
+extern "C" bool MP4SetSampleIndexLimit(MP4FileHandle hFile, 
+				      u_int32_t maxEntries)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
+		try {
+			((MP4File*)hFile)->SetSampleIndexLimit(maxEntries);
+			return true;
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	return false;
+}
+
 extern "C" MP4Duration MP4GetDuration(MP4FileHandle hFile)
 {
 	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
@@ -2293,6 +2402,168 @@ extern "C" bool MP4SetTrackBytesProperty(
 	return false;
 }
 
+extern "C" MP4PropertyHandle MP4GetPropertyHandle(
+	MP4FileHandle hFile, const char* propName)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
+		try {
+			return (MP4PropertyHandle)
+				((MP4File*)hFile)->GetPropertyRef(propName);
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	return MP4_INVALID_PROPERTY_HANDLE;
+}
+
+extern "C" MP4PropertyHandle MP4GetTrackPropertyHandle(
+	MP4FileHandle hFile, MP4TrackId trackId, const char* propName)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
+		try {
+			return (MP4PropertyHandle)
+				((MP4File*)hFile)->GetTrackPropertyRef(trackId, propName);
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	return MP4_INVALID_PROPERTY_HANDLE;
+}
+
+extern "C" void MP4FreePropertyHandle(
+	MP4FileHandle hFile, MP4PropertyHandle hProperty)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile) 
+	  && MP4_IS_VALID_PROPERTY_HANDLE(hProperty)) {
+		try {
+			((MP4File*)hFile)->FreePropertyRef(
+				(MP4PropertyRef*)hProperty);
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+}
+
+extern "C" bool MP4GetHandleIntegerProperty(
+	MP4FileHandle hFile, MP4PropertyHandle hProperty,
+	u_int64_t *retvalue)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile) 
+	  && MP4_IS_VALID_PROPERTY_HANDLE(hProperty)) {
+		try {
+			*retvalue = ((MP4File*)hFile)->GetIntegerProperty(
+				(MP4PropertyRef*)hProperty);
+			return true;
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	return false;
+}
+
+extern "C" bool MP4GetHandleFloatProperty(
+	MP4FileHandle hFile, MP4PropertyHandle hProperty,
+	float *retvalue)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile) 
+	  && MP4_IS_VALID_PROPERTY_HANDLE(hProperty)) {
+		try {
+			*retvalue = ((MP4File*)hFile)->GetFloatProperty(
+				(MP4PropertyRef*)hProperty);
+			return true;
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	return false;
+}
+
+extern "C" bool MP4GetHandleStringProperty(
+	MP4FileHandle hFile, MP4PropertyHandle hProperty,
+	const char **retvalue)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile) 
+	  && MP4_IS_VALID_PROPERTY_HANDLE(hProperty)) {
+		try {
+			*retvalue = ((MP4File*)hFile)->GetStringProperty(
+				(MP4PropertyRef*)hProperty);
+			return true;
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	return false;
+}
+
+extern "C" bool MP4SetHandleIntegerProperty(
+	MP4FileHandle hFile, MP4PropertyHandle hProperty,
+	int64_t value)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile) 
+	  && MP4_IS_VALID_PROPERTY_HANDLE(hProperty)) {
+		try {
+			((MP4File*)hFile)->SetIntegerProperty(
+				(MP4PropertyRef*)hProperty, value);
+			return true;
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	return false;
+}
+
+extern "C" bool MP4SetHandleFloatProperty(
+	MP4FileHandle hFile, MP4PropertyHandle hProperty,
+	float value)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile) 
+	  && MP4_IS_VALID_PROPERTY_HANDLE(hProperty)) {
+		try {
+			((MP4File*)hFile)->SetFloatProperty(
+				(MP4PropertyRef*)hProperty, value);
+			return true;
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	return false;
+}
+
+extern "C" bool MP4SetHandleStringProperty(
+	MP4FileHandle hFile, MP4PropertyHandle hProperty,
+	const char* value)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile) 
+	  && MP4_IS_VALID_PROPERTY_HANDLE(hProperty)) {
+		try {
+			((MP4File*)hFile)->SetStringProperty(
+				(MP4PropertyRef*)hProperty, value);
+			return true;
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	return false;
+}
+
 /* sample operations */
 
 extern "C" bool MP4ReadSample(
@@ -2310,7 +2581,45 @@ extern "C" bool MP4ReadSample(
 {
 	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
 		try {
-			((MP4File*)hFile)->ReadSample(
+			MP4Status status = ((MP4File*)hFile)->TryReadSample(
+				trackId, 
+				sampleId, 
+				ppBytes, 
+				pNumBytes, 
+				pStartTime, 
+				pDuration, 
+				pRenderingOffset, 
+				pIsSyncSample);
+			if (status == MP4_STATUS_OK) {
+				return true;
+			}
+			PRINT_STATUS(status, "MP4ReadSample");
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	*pNumBytes = 0;
+	return false;
+}
+
+extern "C" bool MP4ReadSampleView(
+	/* input parameters */
+	MP4FileHandle hFile,
+	MP4TrackId trackId, 
+	MP4SampleId sampleId,
+	/* output parameters */
+	const u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes, 
+	MP4Timestamp* pStartTime, 
+	MP4Duration* pDuration,
+	MP4Duration* pRenderingOffset, 
+	bool* pIsSyncSample)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
+		try {
+			((MP4File*)hFile)->ReadSampleView(
 				trackId, 
 				sampleId, 
 				ppBytes, 
@@ -2326,6 +2635,69 @@ extern "C" bool MP4ReadSample(
 			delete e;
 		}
 	}
+	*ppBytes = NULL;
+	*pNumBytes = 0;
+	return false;
+}
+
+extern "C" MP4ReaderHandle MP4CreateReader(
+	MP4FileHandle hFile)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
+		try {
+			return (MP4ReaderHandle)new MP4Reader((MP4File*)hFile);
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	return MP4_INVALID_READER_HANDLE;
+}
+
+extern "C" void MP4CloseReader(
+	MP4ReaderHandle hReader)
+{
+	if (MP4_IS_VALID_READER_HANDLE(hReader)) {
+		delete (MP4Reader*)hReader;
+	}
+}
+
+extern "C" bool MP4ReaderReadSample(
+	/* input parameters */
+	MP4ReaderHandle hReader,
+	MP4TrackId trackId, 
+	MP4SampleId sampleId,
+	/* output parameters */
+	u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes, 
+	MP4Timestamp* pStartTime, 
+	MP4Duration* pDuration,
+	MP4Duration* pRenderingOffset, 
+	bool* pIsSyncSample)
+{
+	if (MP4_IS_VALID_READER_HANDLE(hReader)) {
+		MP4FileHandle hFile = ((MP4Reader*)hReader)->GetFile();
+		try {
+			MP4Status status = ((MP4Reader*)hReader)->TryReadSample(
+				trackId, 
+				sampleId, 
+				ppBytes, 
+				pNumBytes, 
+				pStartTime, 
+				pDuration, 
+				pRenderingOffset, 
+				pIsSyncSample);
+			if (status == MP4_STATUS_OK) {
+				return true;
+			}
+			PRINT_STATUS(status, "MP4ReaderReadSample");
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
 	*pNumBytes = 0;
 	return false;
 }
@@ -2552,8 +2924,13 @@ extern "C" u_int32_t MP4GetSampleSize(
 {
 	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
 		try {
-			return ((MP4File*)hFile)->GetSampleSize(
-				trackId, sampleId);
+			u_int32_t sampleSize;
+			MP4Status status = ((MP4File*)hFile)->TryGetSampleSize(
+				trackId, sampleId, &sampleSize);
+			if (status == MP4_STATUS_OK) {
+				return sampleSize;
+			}
+			PRINT_STATUS(status, "MP4GetSampleSize");
 		}
 		catch (MP4Error* e) {
 			PRINT_ERROR(e);
@@ -2605,8 +2982,13 @@ extern "C" MP4Timestamp MP4GetSampleTime(
 {
 	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
 		try {
-			return ((MP4File*)hFile)->GetSampleTime(
-				trackId, sampleId);
+			MP4Timestamp timestamp;
+			MP4Status status = ((MP4File*)hFile)->TryGetSampleTimes(
+				trackId, sampleId, &timestamp, NULL);
+			if (status == MP4_STATUS_OK) {
+				return timestamp;
+			}
+			PRINT_STATUS(status, "MP4GetSampleTime");
 		}
 		catch (MP4Error* e) {
 			PRINT_ERROR(e);
@@ -2623,8 +3005,13 @@ extern "C" MP4Duration MP4GetSampleDuration(
 {
 	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
 		try {
-			return ((MP4File*)hFile)->GetSampleDuration(
-				trackId, sampleId);
+			MP4Duration duration;
+			MP4Status status = ((MP4File*)hFile)->TryGetSampleTimes(
+				trackId, sampleId, NULL, &duration);
+			if (status == MP4_STATUS_OK) {
+				return duration;
+			}
+			PRINT_STATUS(status, "MP4GetSampleDuration");
 		}
 		catch (MP4Error* e) {
 			PRINT_ERROR(e);
@@ -2634,6 +3021,30 @@ extern "C" MP4Duration MP4GetSampleDuration(
 	return MP4_INVALID_DURATION;
 }
 
+extern "C" bool MP4GetSampleTimes(
+	MP4FileHandle hFile,
+	MP4TrackId trackId, 
+	MP4SampleId startSampleId,
+	u_int32_t numSamples,
+	MP4Timestamp* pStartTimes,
+	MP4Duration* pDurations,
+	MP4Duration* pRenderingOffsets)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
+		try {
+			((MP4File*)hFile)->GetSampleTimes(
+				trackId, startSampleId, numSamples,
+				pStartTimes, pDurations, pRenderingOffsets);
+			return true;
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	return false;
+}
+
 extern "C" MP4Duration MP4GetSampleRenderingOffset(
 	MP4FileHandle hFile,
 	MP4TrackId trackId, 
@@ -3035,17 +3446,52 @@ extern "C" bool MP4ReadRtpPacket(
 {
 	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
 		try {
-			((MP4File*)hFile)->ReadRtpPacket(
+			MP4Status status = ((MP4File*)hFile)->TryReadRtpPacket(
 				hintTrackId, packetIndex, 
 				ppBytes, pNumBytes, 
 				ssrc, includeHeader, includePayload);
-			return true;
+			if (status == MP4_STATUS_OK) {
+				return true;
+			}
+			PRINT_STATUS(status, "MP4ReadRtpPacket");
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	return false;
+}
+
+extern "C" bool MP4ReadRtpPacketIov(
+	MP4FileHandle hFile,
+	MP4TrackId hintTrackId,
+	u_int16_t packetIndex,
+	u_int8_t* pBuffer,
+	u_int32_t bufferSize,
+	struct iovec* pIov,
+	u_int32_t* pIovCount,
+	u_int32_t ssrc,
+	bool includeHeader,
+	bool includePayload)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
+		try {
+			MP4Status status = ((MP4File*)hFile)->TryReadRtpPacketIov(
+				hintTrackId, packetIndex, 
+				pBuffer, bufferSize, pIov, pIovCount, 
+				ssrc, includeHeader, includePayload);
+			if (status == MP4_STATUS_OK) {
+				return true;
+			}
+			PRINT_STATUS(status, "MP4ReadRtpPacketIov");
 		}
 		catch (MP4Error* e) {
 			PRINT_ERROR(e);
 			delete e;
 		}
 	}
+	*pIovCount = 0;
 	return false;
 }
 
@@ -49,6 +49,8 @@
 
 /* MP4 API types */
 typedef void*		MP4FileHandle;
+typedef void*		MP4ReaderHandle;
+typedef void*		MP4PropertyHandle;
 typedef u_int32_t	MP4TrackId;
 typedef u_int32_t	MP4SampleId;
 typedef u_int64_t	MP4Timestamp;
@@ -63,6 +65,11 @@ typedef size_t (*VIRTUALIO_WRITE)(void *user, void *buffer, size_t size); // ret
 typedef int (*VIRTUALIO_ENDOFFILE)(void *user); // return 1 if file hit EOF
 typedef int (*VIRTUALIO_CLOSE)(void *user); // return 0 on success
 
+/* progress of MP4OptimizeEx, bytes of media data copied so far */
+typedef void (*MP4OptimizeProgressFunc)(void *userData, 
+					u_int64_t bytesCopied, 
+					u_int64_t bytesTotal);
+
 typedef struct Virtual_IO
 {
 	VIRTUALIO_GETFILELENGTH	GetFileLength;
@@ -77,6 +84,8 @@ typedef struct Virtual_IO
 
 /* Invalid values for API types */
 #define MP4_INVALID_FILE_HANDLE	((MP4FileHandle)NULL)
+#define MP4_INVALID_READER_HANDLE	((MP4ReaderHandle)NULL)
+#define MP4_INVALID_PROPERTY_HANDLE	((MP4PropertyHandle)NULL)
 #define MP4_INVALID_TRACK_ID	((MP4TrackId)0)
 #define MP4_INVALID_SAMPLE_ID	((MP4SampleId)0)
 #define MP4_INVALID_TIMESTAMP	((MP4Timestamp)-1)
@@ -85,6 +94,8 @@ typedef struct Virtual_IO
 
 /* Macros to test for API type validity */
 #define MP4_IS_VALID_FILE_HANDLE(x)	((x) != MP4_INVALID_FILE_HANDLE) 
+#define MP4_IS_VALID_READER_HANDLE(x)	((x) != MP4_INVALID_READER_HANDLE) 
+#define MP4_IS_VALID_PROPERTY_HANDLE(x)	((x) != MP4_INVALID_PROPERTY_HANDLE) 
 #define MP4_IS_VALID_TRACK_ID(x)	((x) != MP4_INVALID_TRACK_ID) 
 #define MP4_IS_VALID_SAMPLE_ID(x)	((x) != MP4_INVALID_SAMPLE_ID) 
 #define MP4_IS_VALID_TIMESTAMP(x)	((x) != MP4_INVALID_TIMESTAMP) 
@@ -331,6 +342,17 @@ MP4FileHandle MP4CreateEx(
 	char** supportedBrands DEFAULT(0),
 	u_int32_t supportedBrandsCount DEFAULT(0));
 
+/*
+ * MP4CreateFragmented writes the samples as a series of movie 
+ * fragments of about fragmentDuration milliseconds each, so the 
+ * memory used while recording does not grow with the file length
+ */
+MP4FileHandle MP4CreateFragmented(
+	const char* fileName,
+	u_int32_t verbosity DEFAULT(0),
+	u_int32_t flags DEFAULT(0),
+	u_int32_t fragmentDuration DEFAULT(1000));
+
 MP4FileHandle MP4Modify(
 	const char* fileName, 
 	u_int32_t verbosity DEFAULT(0),
@@ -340,6 +362,23 @@ MP4FileHandle MP4Read(
 	const char* fileName, 
 	u_int32_t verbosity DEFAULT(0));
 
+/* 
+ * same as MP4Read, but memory maps the file where supported
+ * falls back to regular reads if the file can't be mapped
+ */
+MP4FileHandle MP4ReadMapped(
+	const char* fileName, 
+	u_int32_t verbosity DEFAULT(0));
+
+/*
+ * same as MP4Read (or MP4ReadMapped), but the large sample tables
+ * of each track are only read when the track's samples are first used
+ */
+MP4FileHandle MP4ReadLazy(
+	const char* fileName, 
+	u_int32_t verbosity DEFAULT(0),
+	bool mapped DEFAULT(false));
+
 // benski>
 MP4FileHandle MP4ReadEx(const char* fileName,
 			void *user, 
@@ -354,6 +393,22 @@ bool MP4Optimize(
 	const char* newFileName DEFAULT(NULL), 
 	u_int32_t verbosity DEFAULT(0));
 
+bool MP4OptimizeEx(
+	const char* existingFileName, 
+	const char* newFileName DEFAULT(NULL), 
+	u_int32_t verbosity DEFAULT(0),
+	MP4OptimizeProgressFunc progressFunc DEFAULT(NULL),
+	void* userData DEFAULT(NULL));
+
+/*
+ * MP4MakeStreamable moves the moov atom ahead of the media data 
+ * without reordering the chunks, unlike MP4Optimize
+ */
+bool MP4MakeStreamable(
+	const char* existingFileName, 
+	const char* newFileName DEFAULT(NULL), 
+	u_int32_t verbosity DEFAULT(0));
+
 bool MP4Dump(
 	MP4FileHandle hFile, 
 	FILE* pDumpFile DEFAULT(NULL), 
@@ -375,6 +430,13 @@ u_int32_t MP4GetVerbosity(MP4FileHandle hFile);
 
 void MP4SetVerbosity(MP4FileHandle hFile, u_int32_t verbosity);
 
+/* 
+ * limit the number of entries in each track's sample offset index
+ * 0 (the default) indexes every sample, otherwise every Nth sample
+ * is indexed, trading a bounded amount of summing for memory
+ */
+bool MP4SetSampleIndexLimit(MP4FileHandle hFile, u_int32_t maxEntries);
+
 MP4Duration MP4GetDuration(MP4FileHandle hFile);
 
 u_int32_t MP4GetTimeScale(MP4FileHandle hFile);
@@ -812,6 +874,57 @@ bool MP4SetTrackBytesProperty(
 	const u_int8_t* pValue, 
 	u_int32_t valueSize);
 
+/* 
+ * property handles, the property is looked up by name once and 
+ * can then be got or set without looking it up again.
+ * Handles are freed by MP4FreePropertyHandle or MP4Close.  If the
+ * property is deleted first, with its atom or track, getting or
+ * setting it through the handle fails, but the handle must still be
+ * freed
+ */
+MP4PropertyHandle MP4GetPropertyHandle(
+	MP4FileHandle hFile, 
+	const char* propName);
+
+MP4PropertyHandle MP4GetTrackPropertyHandle(
+	MP4FileHandle hFile, 
+	MP4TrackId trackId, 
+	const char* propName);
+
+void MP4FreePropertyHandle(
+	MP4FileHandle hFile, 
+	MP4PropertyHandle hProperty);
+
+bool MP4GetHandleIntegerProperty(
+	MP4FileHandle hFile, 
+	MP4PropertyHandle hProperty,
+	u_int64_t *retvalue);
+
+bool MP4GetHandleFloatProperty(
+	MP4FileHandle hFile, 
+	MP4PropertyHandle hProperty,
+	float *retvalue);
+
+bool MP4GetHandleStringProperty(
+	MP4FileHandle hFile, 
+	MP4PropertyHandle hProperty,
+	const char **retvalue);
+
+bool MP4SetHandleIntegerProperty(
+	MP4FileHandle hFile, 
+	MP4PropertyHandle hProperty,
+	int64_t value);
+
+bool MP4SetHandleFloatProperty(
+	MP4FileHandle hFile, 
+	MP4PropertyHandle hProperty,
+	float value);
+
+bool MP4SetHandleStringProperty(
+	MP4FileHandle hFile, 
+	MP4PropertyHandle hProperty,
+	const char* value);
+
 /* sample operations */
 
 bool MP4ReadSample(
@@ -828,6 +941,61 @@ bool MP4ReadSample(
 	MP4Duration* pRenderingOffset DEFAULT(NULL), 
 	bool* pIsSyncSample DEFAULT(NULL));
 
+/* 
+ * returns a pointer to the sample data instead of copying it
+ * when the file was opened with MP4ReadMapped the pointer is into the
+ * file mapping, otherwise into a per track buffer.  
+ * The data is valid until the next MP4ReadSampleView call on the
+ * track, or MP4Close, and must not be freed.
+ * The per track buffer is shared with MP4ReadSampleFragment and with
+ * MP4ReadRtpPacket of hint tracks that refer to the track, so either
+ * of those calls on another sample also invalidates the data
+ */
+bool MP4ReadSampleView(
+	/* input parameters */
+	MP4FileHandle hFile,
+	MP4TrackId trackId, 
+	MP4SampleId sampleId,
+	/* output parameters */
+	const u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes, 
+	MP4Timestamp* pStartTime DEFAULT(NULL), 
+	MP4Duration* pDuration DEFAULT(NULL),
+	MP4Duration* pRenderingOffset DEFAULT(NULL), 
+	bool* pIsSyncSample DEFAULT(NULL));
+
+/*
+ * a reader reads samples with its own file handle and lookup state,
+ * so threads (or RTP sessions) that each have their own reader can read 
+ * the same file at once without locking.  hFile must have been opened
+ * for reading; create the readers before reading from other threads 
+ * and close them before MP4Close.  Other calls on hFile itself still 
+ * need to be serialized by the caller.
+ * A Virtual_IO can't open another handle, so the readers of a file
+ * opened by MP4ReadEx read through its Virtual_IO, and their reads
+ * must be serialized with each other and with the other calls on hFile.
+ */
+MP4ReaderHandle MP4CreateReader(
+	MP4FileHandle hFile);
+
+void MP4CloseReader(
+	MP4ReaderHandle hReader);
+
+/* same as MP4ReadSample, via a reader */
+bool MP4ReaderReadSample(
+	/* input parameters */
+	MP4ReaderHandle hReader,
+	MP4TrackId trackId, 
+	MP4SampleId sampleId,
+	/* input/output parameters */
+	u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes, 
+	/* output parameters */
+	MP4Timestamp* pStartTime DEFAULT(NULL), 
+	MP4Duration* pDuration DEFAULT(NULL),
+	MP4Duration* pRenderingOffset DEFAULT(NULL), 
+	bool* pIsSyncSample DEFAULT(NULL));
+
 /* uses (unedited) time to specify sample instead of sample id */
 bool MP4ReadSampleFromTime(
 	/* input parameters */
@@ -904,6 +1072,20 @@ MP4Duration MP4GetSampleDuration(
 	MP4TrackId trackId, 
 	MP4SampleId sampleId);
 
+/* 
+ * fill in the start times, durations and/or rendering offsets
+ * for numSamples samples beginning with startSampleId
+ * any of the arrays may be NULL
+ */
+bool MP4GetSampleTimes(
+	MP4FileHandle hFile,
+	MP4TrackId trackId, 
+	MP4SampleId startSampleId,
+	u_int32_t numSamples,
+	MP4Timestamp* pStartTimes,
+	MP4Duration* pDurations DEFAULT(NULL),
+	MP4Duration* pRenderingOffsets DEFAULT(NULL));
+
 MP4Duration MP4GetSampleRenderingOffset(
 	MP4FileHandle hFile,
 	MP4TrackId trackId, 
@@ -1001,6 +1183,28 @@ bool MP4ReadRtpPacket(
 	bool includeHeader DEFAULT(true),
 	bool includePayload DEFAULT(true));
 
+/*
+ * like MP4ReadRtpPacket, but the packet is returned as iovec entries
+ * for sendmsg()/writev() instead of being copied into one buffer.
+ * The entries point into the memory mapped file or the referenced 
+ * track's cached sample where they can, and into pBuffer for the RTP 
+ * header and anything that has to be copied, so pBuffer should be able
+ * to hold a whole packet. They stay valid until the next read from hFile.
+ * On input *pIovCount is the number of entries in pIov, on output 
+ * the number used.
+ */
+bool MP4ReadRtpPacketIov(
+	MP4FileHandle hFile,
+	MP4TrackId hintTrackId,
+	u_int16_t packetIndex,
+	u_int8_t* pBuffer,
+	u_int32_t bufferSize,
+	struct iovec* pIov,
+	u_int32_t* pIovCount,
+	u_int32_t ssrc DEFAULT(0),
+	bool includeHeader DEFAULT(true),
+	bool includePayload DEFAULT(true));
+
 MP4Timestamp MP4GetRtpTimestampStart(
 	MP4FileHandle hFile,
 	MP4TrackId hintTrackId);
@@ -33,6 +33,7 @@
 #include "mp4array.h"
 #include "mp4track.h"
 #include "mp4file.h"
+#include "mp4reader.h"
 #include "mp4property.h"
 #include "mp4container.h"
 #include "mp4descriptor.h"
@@ -42,8 +42,16 @@ MP4File::MP4File(u_int32_t verbosity)
 	m_fileSize = 0;
 	m_pRootAtom = NULL;
 	m_odTrackId = MP4_INVALID_TRACK_ID;
+	m_pPropertyRefs = NULL;
 
 	m_verbosity = verbosity;
+	m_sampleIndexLimit = 0;
+	m_lazyLoad = false;
+	m_fragmentDuration = 0;
+	m_fragmentSequence = 0;
+	m_fragmentMoovWritten = false;
+	m_fragmentMoovStart = 0;
+	m_fragmentMoovEnd = 0;
 	m_mode = 0;
 	m_createFlags = 0;
 	m_useIsma = false;
@@ -78,6 +86,12 @@ MP4File::~MP4File()
 	  m_virtual_IO->Close(m_pFile);
 	  m_pFile = NULL;
 	}
+	// before the atoms, so their properties don't look for them
+	while (m_pPropertyRefs != NULL) {
+		MP4PropertyRef* pNext = m_pPropertyRefs->pNext;
+		MP4Free(m_pPropertyRefs);
+		m_pPropertyRefs = pNext;
+	}
 	delete m_pRootAtom;
 	for (u_int32_t i = 0; i < m_pTracks.Size(); i++) {
 		delete m_pTracks[i];
@@ -132,6 +146,26 @@ void MP4File::ReadEx(const char *fileName, void *user, Virtual_IO *virtual_IO)
 	CacheProperties();
 }
 
+void MP4File::ReadMapped(const char* fileName)
+{
+	m_fileName = MP4Stralloc(fileName);
+	m_mode = 'r';
+
+	m_pFile = MMAP_Open(fileName);
+	if (m_pFile != NULL) {
+		m_virtual_IO = &MMAP_virtual_IO;
+		m_orgFileSize = m_fileSize = m_virtual_IO->GetFileLength(m_pFile);
+	} else {
+		// can't map it, use regular reads
+		VERBOSE_READ(m_verbosity, 
+			printf("ReadMapped: can't map %s, using stdio\n", fileName));
+		Open("rb");
+	}
+
+	ReadFromFile();
+
+	CacheProperties();
+}
 
 void MP4File::Create(const char* fileName, u_int32_t flags, 
 		     int add_ftyp, int add_iods, 
@@ -156,12 +190,21 @@ void MP4File::Create(const char* fileName, u_int32_t flags,
 
 	CacheProperties();
 
-	// create mdat, and insert it after ftyp, and before moov
-	(void)InsertChildAtom(m_pRootAtom, "mdat", 
-			      add_ftyp != 0 ? 1 : 0);
+	if (m_fragmentDuration) {
+		// fragmented files have no mdat of their own, the moov
+		// is written ahead of the first fragment by WriteFragment()
+		MP4Atom* pFtypAtom = m_pRootAtom->FindAtom("ftyp");
+		if (pFtypAtom) {
+			pFtypAtom->Write();
+		}
+	} else {
+		// create mdat, and insert it after ftyp, and before moov
+		(void)InsertChildAtom(m_pRootAtom, "mdat", 
+				      add_ftyp != 0 ? 1 : 0);
 
-	// start writing
-	m_pRootAtom->BeginWrite();
+		// start writing
+		m_pRootAtom->BeginWrite();
+	}
 	if (add_iods != 0) {
 	  (void)AddChildAtom("moov", "iods");
 	}
@@ -289,13 +332,22 @@ bool MP4File::Modify(const char* fileName)
 	return true;
 }
 
-void MP4File::Optimize(const char* orgFileName, const char* newFileName)
+void MP4File::Optimize(const char* orgFileName, const char* newFileName,
+	MP4OptimizeProgressFunc progressFunc, void* userData)
 {
 	m_fileName = MP4Stralloc(orgFileName);
 	m_mode = 'r';
 
 	// first load meta-info into memory
-	Open("rb");
+	// the original is mapped when possible so chunks can be 
+	// copied without an intermediate read
+	m_pFile = MMAP_Open(orgFileName);
+	if (m_pFile != NULL) {
+		m_virtual_IO = &MMAP_virtual_IO;
+		m_orgFileSize = m_fileSize = m_virtual_IO->GetFileLength(m_pFile);
+	} else {
+		Open("rb");
+	}
 	ReadFromFile();
 
 	CacheProperties();	// of moov atom
@@ -327,7 +379,8 @@ void MP4File::Optimize(const char* orgFileName, const char* newFileName)
 	((MP4RootAtom*)m_pRootAtom)->BeginOptimalWrite();
 
 	// write data in optimal order
-	RewriteMdat(pReadFile, m_pFile, pReadIO, m_virtual_IO);
+	RewriteMdat(pReadFile, m_pFile, pReadIO, m_virtual_IO, 
+		progressFunc, userData);
 
 	// finish writing
 	((MP4RootAtom*)m_pRootAtom)->FinishOptimalWrite();
@@ -343,86 +396,410 @@ void MP4File::Optimize(const char* orgFileName, const char* newFileName)
 	}
 }
 
+// size of the per track read ahead when copying chunks
+#define OPTIMIZE_READ_AHEAD_SIZE	(1024 * 1024)
+// bytes copied between calls to the progress function
+#define OPTIMIZE_PROGRESS_INTERVAL	(4 * 1024 * 1024)
+
+// heap of tracks ordered by the time of their next chunk
+struct MP4ChunkHeapEntry {
+	MP4Timestamp	time;
+	u_int32_t	trackIndex;
+	bool		isHint;
+};
+
+static bool ChunkHeapLess(MP4ChunkHeapEntry* pA, MP4ChunkHeapEntry* pB)
+{
+	if (pA->time != pB->time) {
+		return pA->time < pB->time;
+	}
+	// prefer hint tracks to media tracks if times are equal
+	if (pA->isHint != pB->isHint) {
+		return pA->isHint;
+	}
+	return pA->trackIndex < pB->trackIndex;
+}
+
+static void ChunkHeapDown(MP4ChunkHeapEntry* pHeap, u_int32_t size,
+	u_int32_t index)
+{
+	while (true) {
+		u_int32_t smallest = index;
+		u_int32_t left = 2 * index + 1;
+		u_int32_t right = left + 1;
+
+		if (left < size && ChunkHeapLess(&pHeap[left], &pHeap[smallest])) {
+			smallest = left;
+		}
+		if (right < size && ChunkHeapLess(&pHeap[right], &pHeap[smallest])) {
+			smallest = right;
+		}
+		if (smallest == index) {
+			break;
+		}
+		MP4ChunkHeapEntry temp = pHeap[index];
+		pHeap[index] = pHeap[smallest];
+		pHeap[smallest] = temp;
+		index = smallest;
+	}
+}
+
 void MP4File::RewriteMdat(void* pReadFile, void* pWriteFile,
-			  Virtual_IO *readIO, Virtual_IO *writeIO)
+			  Virtual_IO *readIO, Virtual_IO *writeIO,
+			  MP4OptimizeProgressFunc progressFunc, void* userData)
 {
 	u_int32_t numTracks = m_pTracks.Size();
 
 	MP4ChunkId* chunkIds = new MP4ChunkId[numTracks];
 	MP4ChunkId* maxChunkIds = new MP4ChunkId[numTracks];
-	MP4Timestamp* nextChunkTimes = new MP4Timestamp[numTracks];
+	MP4ChunkHeapEntry* pHeap = new MP4ChunkHeapEntry[numTracks];
+	u_int32_t heapSize = 0;
 
-	for (u_int32_t i = 0; i < numTracks; i++) {
+	// read ahead window of the original file for each track
+	u_int8_t** pBuffers = new u_int8_t*[numTracks];
+	u_int32_t* bufferSizes = new u_int32_t[numTracks];
+	u_int64_t* windowStarts = new u_int64_t[numTracks];
+	u_int32_t* windowSizes = new u_int32_t[numTracks];
+
+	u_int64_t readFileSize = readIO->GetFileLength(pReadFile);
+	u_int64_t bytesCopied = 0;
+	u_int64_t bytesTotal = 0;
+	u_int64_t lastProgress = 0;
+
+	u_int32_t i;
+	for (i = 0; i < numTracks; i++) {
 		chunkIds[i] = 1;
 		maxChunkIds[i] = m_pTracks[i]->GetNumberOfChunks();
-		nextChunkTimes[i] = MP4_INVALID_TIMESTAMP;
+		pBuffers[i] = NULL;
+		bufferSizes[i] = 0;
+		windowStarts[i] = 0;
+		windowSizes[i] = 0;
+
+		if (progressFunc) {
+			bytesTotal += m_pTracks[i]->GetTotalOfSampleSizes();
+		}
+
+		if (maxChunkIds[i] == 0) {
+			continue;
+		}
+		pHeap[heapSize].time = MP4ConvertTime(
+			m_pTracks[i]->GetChunkTime(1),
+			m_pTracks[i]->GetTimeScale(), GetTimeScale());
+		pHeap[heapSize].trackIndex = i;
+		pHeap[heapSize].isHint = 
+			!strcmp(m_pTracks[i]->GetType(), MP4_HINT_TRACK_TYPE);
+		heapSize++;
 	}
 
-	while (true) {
-		u_int32_t nextTrackIndex = (u_int32_t)-1;
-		MP4Timestamp nextTime = MP4_INVALID_TIMESTAMP;
+	for (i = heapSize / 2; i > 0; i--) {
+		ChunkHeapDown(pHeap, heapSize, i - 1);
+	}
 
-		for (u_int32_t i = 0; i < numTracks; i++) {
-			if (chunkIds[i] > maxChunkIds[i]) {
-				continue;
+	try {
+		while (heapSize > 0) {
+			u_int32_t trackIndex = pHeap[0].trackIndex;
+			MP4Track* pTrack = m_pTracks[trackIndex];
+			MP4ChunkId chunkId = chunkIds[trackIndex];
+
+			// point into original mp4 file to find the chunk
+			m_pFile = pReadFile;
+			m_virtual_IO = readIO;
+			m_mode = 'r';
+
+			u_int64_t chunkOffset = pTrack->GetChunkOffset(chunkId);
+			u_int32_t chunkSize = pTrack->GetChunkSize(chunkId);
+
+			const u_int8_t* pChunk = 
+				GetMappedBytes(chunkOffset, chunkSize);
+
+			if (pChunk == NULL) {
+				if (chunkOffset < windowStarts[trackIndex]
+				  || chunkOffset + chunkSize > 
+				    windowStarts[trackIndex] + windowSizes[trackIndex]) {
+					// refill the read ahead window from this chunk on
+					u_int32_t readSize = 
+						MAX(chunkSize, OPTIMIZE_READ_AHEAD_SIZE);
+					if (readSize > bufferSizes[trackIndex]) {
+						pBuffers[trackIndex] = (u_int8_t*)MP4Realloc(
+							pBuffers[trackIndex], readSize);
+						bufferSizes[trackIndex] = readSize;
+					}
+					if (chunkOffset + readSize > readFileSize
+					  && chunkOffset + chunkSize <= readFileSize) {
+						readSize = readFileSize - chunkOffset;
+					}
+					windowSizes[trackIndex] = 0;
+					SetPosition(chunkOffset);
+					ReadBytes(pBuffers[trackIndex], readSize);
+					windowStarts[trackIndex] = chunkOffset;
+					windowSizes[trackIndex] = readSize;
+				}
+				pChunk = &pBuffers[trackIndex]
+					[chunkOffset - windowStarts[trackIndex]];
 			}
 
-			if (nextChunkTimes[i] == MP4_INVALID_TIMESTAMP) {
-				MP4Timestamp chunkTime =
-					m_pTracks[i]->GetChunkTime(chunkIds[i]);
+			// point back at the new mp4 file for write chunk
+			m_pFile = pWriteFile;
+			m_virtual_IO = writeIO;
+			m_mode = 'w';
+
+			pTrack->RewriteChunk(chunkId, (u_int8_t*)pChunk, chunkSize);
 
-				nextChunkTimes[i] = MP4ConvertTime(chunkTime,
-					m_pTracks[i]->GetTimeScale(), GetTimeScale());
+			bytesCopied += chunkSize;
+			if (progressFunc 
+			  && bytesCopied - lastProgress >= OPTIMIZE_PROGRESS_INTERVAL) {
+				(*progressFunc)(userData, bytesCopied, bytesTotal);
+				lastProgress = bytesCopied;
 			}
 
-			// time is not earliest so far
-			if (nextChunkTimes[i] > nextTime) {
-				continue;
+			// move on to the track's next chunk
+			chunkIds[trackIndex]++;
+			if (chunkIds[trackIndex] > maxChunkIds[trackIndex]) {
+				pHeap[0] = pHeap[--heapSize];
+			} else {
+				pHeap[0].time = MP4ConvertTime(
+					pTrack->GetChunkTime(chunkIds[trackIndex]),
+					pTrack->GetTimeScale(), GetTimeScale());
 			}
+			ChunkHeapDown(pHeap, heapSize, 0);
+		}
+	}
+	catch (MP4Error* e) {
+		m_pFile = pWriteFile;
+		m_virtual_IO = writeIO;
+		m_mode = 'w';
+
+		for (i = 0; i < numTracks; i++) {
+			MP4Free(pBuffers[i]);
+		}
+		delete [] pBuffers;
+		delete [] bufferSizes;
+		delete [] windowStarts;
+		delete [] windowSizes;
+		delete [] chunkIds;
+		delete [] maxChunkIds;
+		delete [] pHeap;
+		throw e;
+	}
+
+	if (progressFunc) {
+		(*progressFunc)(userData, bytesCopied, bytesTotal);
+	}
+
+	for (i = 0; i < numTracks; i++) {
+		MP4Free(pBuffers[i]);
+	}
+	delete [] pBuffers;
+	delete [] bufferSizes;
+	delete [] windowStarts;
+	delete [] windowSizes;
+	delete [] chunkIds;
+	delete [] maxChunkIds;
+	delete [] pHeap;
+}
+
+void MP4File::MakeStreamable(const char* orgFileName, 
+	const char* newFileName)
+{
+	m_fileName = MP4Stralloc(orgFileName);
+	m_mode = 'r';
+
+	Open("rb");
+	ReadFromFile();
 
-			// prefer hint tracks to media tracks if times are equal
-			if (nextChunkTimes[i] == nextTime 
-			  && strcmp(m_pTracks[i]->GetType(), MP4_HINT_TRACK_TYPE)) {
+	CacheProperties();	// of moov atom
+
+	MP4Atom* pMoovAtom = FindAtom("moov");
+	ASSERT(pMoovAtom);
+
+	// the moov goes ahead of the first mdat
+	u_int64_t newMoovStart = pMoovAtom->GetStart();
+	u_int32_t i;
+	for (i = 0; i < m_pRootAtom->GetNumberOfChildAtoms(); i++) {
+		MP4Atom* pAtom = m_pRootAtom->GetChildAtom(i);
+
+		if (ATOMID(pAtom->GetType()) == ATOMID("moof")) {
+			throw new MP4Error("can't relocate moov of a fragmented file",
+				"MakeStreamable");
+		}
+		if (ATOMID(pAtom->GetType()) == ATOMID("mdat")
+		  && pAtom->GetStart() < newMoovStart) {
+			newMoovStart = pAtom->GetStart();
+		}
+	}
+
+	u_int64_t moovStart = pMoovAtom->GetStart();
+	u_int64_t moovEnd = pMoovAtom->GetEnd();
+	u_int64_t fileSize = GetSize();
+
+	if (newMoovStart == moovStart && newFileName == NULL) {
+		VERBOSE_WRITE(GetVerbosity(), 
+			printf("MakeStreamable: %s already has moov first\n",
+				orgFileName));
+		m_virtual_IO->Close(m_pFile);
+		m_pFile = NULL;
+		return;
+	}
+
+	// the size of the moov doesn't depend on the chunk offset values, 
+	// only on whether a track has to use co64 for them
+	u_int8_t* pMoovBytes = NULL;
+	u_int64_t moovSize = 0;
+	bool changed;
+	do {
+		MP4Free(pMoovBytes);
+		WriteMoovToMemory(&pMoovBytes, &moovSize);
+
+		changed = false;
+		for (i = 0; i < m_pTracks.Size(); i++) {
+			MP4Track* pTrack = m_pTracks[i];
+			u_int32_t numChunks = pTrack->GetNumberOfChunks();
+
+			if (pTrack->HasChunkOffsets64()) {
 				continue;
 			}
-
-			// this is our current choice of tracks
-			nextTime = nextChunkTimes[i];
-			nextTrackIndex = i;
+			for (MP4ChunkId chunkId = 1; chunkId <= numChunks; chunkId++) {
+				u_int64_t chunkOffset = pTrack->GetChunkOffset(chunkId);
+				if (chunkOffset >= moovEnd) {
+					chunkOffset -= moovEnd - moovStart;
+				}
+				if (chunkOffset >= newMoovStart
+				  && chunkOffset + moovSize > 0xFFFFFFFF) {
+					pTrack->ConvertChunkOffsetsTo64();
+					changed = true;
+					break;
+				}
+			}
 		}
+	} while (changed);
 
-		if (nextTrackIndex == (u_int32_t)-1) {
-			break;
+	// now shift the chunks that follow the new moov position
+	for (i = 0; i < m_pTracks.Size(); i++) {
+		MP4Track* pTrack = m_pTracks[i];
+		u_int32_t numChunks = pTrack->GetNumberOfChunks();
+
+		for (MP4ChunkId chunkId = 1; chunkId <= numChunks; chunkId++) {
+			u_int64_t chunkOffset = pTrack->GetChunkOffset(chunkId);
+			if (chunkOffset < newMoovStart) {
+				continue;
+			}
+			if (chunkOffset >= moovEnd) {
+				chunkOffset -= moovEnd - moovStart;
+			}
+			pTrack->SetChunkOffset(chunkId, chunkOffset + moovSize);
 		}
+	}
 
-		// point into original mp4 file for read chunk call
-		m_pFile = pReadFile;
-		m_virtual_IO = readIO;
-		m_mode = 'r';
+	MP4Free(pMoovBytes);
+	WriteMoovToMemory(&pMoovBytes, &moovSize);
 
-		u_int8_t* pChunk;
-		u_int32_t chunkSize;
+	// now switch over to writing the new file
+	MP4Free(m_fileName);
+	#ifdef _WIN32
+	MP4Free(m_fileName_w);
+	#endif
 
-		m_pTracks[nextTrackIndex]->
-			ReadChunk(chunkIds[nextTrackIndex], &pChunk, &chunkSize);
+	// create a temporary file if necessary
+	if (newFileName == NULL) {
+		m_fileName = MP4Stralloc(TempFileName());
+	} else {
+		m_fileName = MP4Stralloc(newFileName);
+	}
 
-		// point back at the new mp4 file for write chunk
-		m_pFile = pWriteFile;
-		m_virtual_IO = writeIO;
-		m_mode = 'w';
+	void* pReadFile = m_pFile;
+	Virtual_IO *pReadIO = m_virtual_IO;
+	m_pFile = NULL;
+	m_mode = 'w';
+
+	try {
+		Open("wb");
+
+		// the media data is copied as is, in large sequential blocks
+		CopyBytes(pReadFile, pReadIO, 0, newMoovStart);
+		WriteBytes(pMoovBytes, moovSize);
+		CopyBytes(pReadFile, pReadIO, newMoovStart, moovStart);
+		CopyBytes(pReadFile, pReadIO, moovEnd, fileSize);
+	}
+	catch (MP4Error* e) {
+		MP4Free(pMoovBytes);
+		pReadIO->Close(pReadFile);
+		throw e;
+	}
+	MP4Free(pMoovBytes);
+
+	// cleanup
+	m_virtual_IO->Close(m_pFile);
+	m_pFile = NULL;
+	pReadIO->Close(pReadFile);
 
-		m_pTracks[nextTrackIndex]->
-			RewriteChunk(chunkIds[nextTrackIndex], pChunk, chunkSize);
+	// move temporary file into place
+	if (newFileName == NULL) {
+		Rename(m_fileName, orgFileName);
+	}
+}
+
+void MP4File::WriteMoovToMemory(u_int8_t** ppBytes, u_int64_t* pNumBytes)
+{
+	MP4Atom* pMoovAtom = FindAtom("moov");
+	ASSERT(pMoovAtom);
 
-		MP4Free(pChunk);
+	// the atom positions are restored, they still refer to the file
+	u_int64_t moovStart = pMoovAtom->GetStart();
+	u_int64_t moovEnd = pMoovAtom->GetEnd();
+	u_int64_t moovSize = pMoovAtom->GetSize();
 
-		chunkIds[nextTrackIndex]++;
-		nextChunkTimes[nextTrackIndex] = MP4_INVALID_TIMESTAMP;
+	EnableMemoryBuffer(NULL, moovEnd - moovStart);
+	try {
+		pMoovAtom->Write();
+	}
+	catch (MP4Error* e) {
+		DisableMemoryBuffer(ppBytes, pNumBytes);
+		MP4Free(*ppBytes);
+		*ppBytes = NULL;
+		throw e;
 	}
+	DisableMemoryBuffer(ppBytes, pNumBytes);
 
-	delete [] chunkIds;
-	delete [] maxChunkIds;
-	delete [] nextChunkTimes;
+	pMoovAtom->SetStart(moovStart);
+	pMoovAtom->SetEnd(moovEnd);
+	pMoovAtom->SetSize(moovSize);
+}
+
+// size of the blocks used when copying media data as is
+#define COPY_BUFFER_SIZE	(1024 * 1024)
+
+void MP4File::CopyBytes(void* pReadFile, Virtual_IO* readIO,
+	u_int64_t start, u_int64_t end)
+{
+	if (start >= end) {
+		return;
+	}
+
+	u_int8_t* pBuffer = (u_int8_t*)MP4Malloc(COPY_BUFFER_SIZE);
+
+	try {
+		if (readIO->SetPosition(pReadFile, start) != 0) {
+			throw new MP4Error("setting position via Virtual I/O", 
+				"CopyBytes");
+		}
+		while (start < end) {
+			u_int32_t numBytes = COPY_BUFFER_SIZE;
+			if (end - start < numBytes) {
+				numBytes = end - start;
+			}
+			if (readIO->Read(pReadFile, pBuffer, numBytes) != numBytes) {
+				throw new MP4Error("not enough bytes, reached end-of-file",
+					"CopyBytes");
+			}
+			WriteBytes(pBuffer, numBytes);
+			start += numBytes;
+		}
+	}
+	catch (MP4Error* e) {
+		MP4Free(pBuffer);
+		throw e;
+	}
+	MP4Free(pBuffer);
 }
 
 void MP4File::Open(const char* fmode)
@@ -536,6 +913,11 @@ void MP4File::ReadFromFile()
 
 	// create MP4Track's for any tracks in the file
 	GenerateTracks();
+
+	// add the samples of any movie fragments to their tracks
+	if (m_mode == 'r') {
+		GenerateFragments();
+	}
 }
 
 void MP4File::GenerateTracks()
@@ -602,6 +984,53 @@ void MP4File::GenerateTracks()
 	}
 }
 
+void MP4File::GenerateFragments()
+{
+	for (u_int32_t i = 0; i < m_pRootAtom->GetNumberOfChildAtoms(); i++) {
+		MP4Atom* pMoofAtom = m_pRootAtom->GetChildAtom(i);
+
+		if (ATOMID(pMoofAtom->GetType()) != ATOMID("moof")) {
+			continue;
+		}
+
+		// unless told otherwise, the data of the first track fragment
+		// starts at the moof, and each following one after the last
+		u_int64_t dataOffset = pMoofAtom->GetStart();
+
+		for (u_int32_t j = 0; j < pMoofAtom->GetNumberOfChildAtoms(); j++) {
+			MP4Atom* pTrafAtom = pMoofAtom->GetChildAtom(j);
+
+			if (ATOMID(pTrafAtom->GetType()) != ATOMID("traf")) {
+				continue;
+			}
+
+			MP4Integer32Property* pTrackIdProperty = NULL;
+			(void)pTrafAtom->FindProperty(
+				"traf.tfhd.trackId",
+				(MP4Property**)&pTrackIdProperty);
+
+			MP4Track* pTrack = NULL;
+			if (pTrackIdProperty) {
+				for (u_int32_t k = 0; k < m_pTracks.Size(); k++) {
+					if (m_pTracks[k]->GetId() == pTrackIdProperty->GetValue()) {
+						pTrack = m_pTracks[k];
+						break;
+					}
+				}
+			}
+
+			if (pTrack == NULL) {
+				VERBOSE_READ(GetVerbosity(),
+					printf("Warning: track fragment for unknown track\n"));
+				continue;
+			}
+
+			dataOffset = pTrack->AddFragment(
+				pTrafAtom, pMoofAtom->GetStart(), dataOffset);
+		}
+	}
+}
+
 void MP4File::CacheProperties()
 {
 	FindIntegerProperty("moov.mvhd.modificationTime", 
@@ -621,6 +1050,11 @@ void MP4File::BeginWrite()
 
 void MP4File::FinishWrite()
 {
+	if (m_fragmentDuration) {
+		FinishFragmentedWrite();
+		return;
+	}
+
 	// for all tracks, flush chunking buffers
 	for (u_int32_t i = 0; i < m_pTracks.Size(); i++) {
 		ASSERT(m_pTracks[i]);
@@ -644,6 +1078,181 @@ void MP4File::FinishWrite()
 	}
 }
 
+// room left after the moov of a fragmented file, so that
+// it can still be rewritten in place if it grows a little
+#define FRAGMENT_MOOV_PADDING	1024
+
+void MP4File::WriteFragmentMoov()
+{
+	// fragmented files need an mvex with a trex for each track
+	MP4Atom* pMvexAtom = AddChildAtom("moov", "mvex");
+
+	for (u_int32_t i = 0; i < m_pTracks.Size(); i++) {
+		MP4Atom* pTrexAtom = AddChildAtom(pMvexAtom, "trex");
+
+		MP4Integer32Property* pProperty = NULL;
+		(void)pTrexAtom->FindProperty("trex.trackId",
+			(MP4Property**)&pProperty);
+		ASSERT(pProperty);
+		pProperty->SetValue(m_pTracks[i]->GetId());
+
+		(void)pTrexAtom->FindProperty("trex.defaultSampleDesriptionIndex",
+			(MP4Property**)&pProperty);
+		ASSERT(pProperty);
+		pProperty->SetValue(1);
+	}
+
+	MP4Atom* pMoovAtom = FindAtom("moov");
+	ASSERT(pMoovAtom);
+
+	m_fragmentMoovStart = GetPosition();
+	pMoovAtom->Write();
+
+	MP4Atom* pFreeAtom = MP4Atom::CreateAtom("free");
+	ASSERT(pFreeAtom);
+	pFreeAtom->SetFile(this);
+	pFreeAtom->SetSize(FRAGMENT_MOOV_PADDING);
+	pFreeAtom->Write();
+	delete pFreeAtom;
+
+	m_fragmentMoovEnd = GetPosition();
+	m_fragmentMoovWritten = true;
+}
+
+void MP4File::WriteFragment()
+{
+	// the moov goes out just ahead of the first fragment
+	if (!m_fragmentMoovWritten) {
+		WriteFragmentMoov();
+	}
+
+	u_int32_t i;
+	bool haveSamples = false;
+	for (i = 0; i < m_pTracks.Size(); i++) {
+		if (m_pTracks[i]->HasFragmentSamples()) {
+			haveSamples = true;
+		}
+	}
+	if (!haveSamples) {
+		return;
+	}
+
+	MP4Atom* pMoofAtom = MP4Atom::CreateAtom("moof");
+	pMoofAtom->SetFile(this);
+	pMoofAtom->Generate();
+
+	MP4Integer32Property* pSequenceProperty = NULL;
+	(void)pMoofAtom->FindProperty("moof.mfhd.sequenceNumber",
+		(MP4Property**)&pSequenceProperty);
+	ASSERT(pSequenceProperty);
+	pSequenceProperty->SetValue(++m_fragmentSequence);
+
+	// data offsets are relative to the start of the moof
+	// first work out where each track's data is in the mdat
+	u_int64_t dataOffset = 0;
+	for (i = 0; i < m_pTracks.Size(); i++) {
+		if (m_pTracks[i]->HasFragmentSamples()) {
+			m_pTracks[i]->AddFragmentAtoms(pMoofAtom, dataOffset);
+			dataOffset += m_pTracks[i]->GetFragmentDataSize();
+		}
+	}
+
+	bool use64 = Use64Bits("mdat");
+	u_int64_t moofStart = GetPosition();
+
+	try {
+		// write it once to learn the moof size,
+		// then again with the offsets moved past the moof and mdat header
+		pMoofAtom->Write();
+
+		u_int32_t headerSize = (u_int32_t)(GetPosition() - moofStart) 
+			+ (use64 ? 16 : 8);
+
+		for (u_int32_t j = 0; j < pMoofAtom->GetNumberOfChildAtoms(); j++) {
+			MP4Integer32Property* pDataOffsetProperty = NULL;
+			if (pMoofAtom->GetChildAtom(j)->FindProperty(
+			  "traf.trun.dataOffset", 
+			  (MP4Property**)&pDataOffsetProperty)) {
+				pDataOffsetProperty->SetValue(
+					pDataOffsetProperty->GetValue() + headerSize);
+			}
+		}
+
+		SetPosition(moofStart);
+		pMoofAtom->Write();
+	}
+	catch (MP4Error* e) {
+		delete pMoofAtom;
+		throw e;
+	}
+	delete pMoofAtom;
+
+	MP4Atom* pMdatAtom = MP4Atom::CreateAtom("mdat");
+	pMdatAtom->SetFile(this);
+
+	try {
+		pMdatAtom->BeginWrite(use64);
+		for (i = 0; i < m_pTracks.Size(); i++) {
+			m_pTracks[i]->WriteFragmentData();
+		}
+		pMdatAtom->FinishWrite(use64);
+	}
+	catch (MP4Error* e) {
+		delete pMdatAtom;
+		throw e;
+	}
+	delete pMdatAtom;
+
+	VERBOSE_WRITE(GetVerbosity(),
+		printf("WriteFragment: sequence %u at "U64" data "U64" bytes\n",
+			m_fragmentSequence, moofStart, dataOffset));
+}
+
+void MP4File::FinishFragmentedWrite()
+{
+	WriteFragment();
+
+	// the tracks' buffers are empty now, but they still
+	// have to record their bitrates in the moov
+	for (u_int32_t i = 0; i < m_pTracks.Size(); i++) {
+		ASSERT(m_pTracks[i]);
+		m_pTracks[i]->FinishWrite();
+	}
+
+	// rewrite the moov with the final durations, if it still fits
+	MP4Atom* pMoovAtom = FindAtom("moov");
+	ASSERT(pMoovAtom);
+
+	u_int64_t available = m_fragmentMoovEnd - m_fragmentMoovStart;
+	u_int64_t endPosition = GetPosition();
+	u_int8_t* pMoov = NULL;
+	u_int64_t moovSize = 0;
+
+	EnableMemoryBuffer(NULL, 2 * available);
+	pMoovAtom->Write();
+	DisableMemoryBuffer(&pMoov, &moovSize);
+
+	if (moovSize == available || moovSize + 8 <= available) {
+		SetPosition(m_fragmentMoovStart);
+		WriteBytes(pMoov, moovSize);
+
+		if (moovSize < available) {
+			MP4Atom* pFreeAtom = MP4Atom::CreateAtom("free");
+			ASSERT(pFreeAtom);
+			pFreeAtom->SetFile(this);
+			pFreeAtom->SetSize(available - moovSize - 8);
+			pFreeAtom->Write();
+			delete pFreeAtom;
+		}
+		SetPosition(endPosition);
+	} else {
+		VERBOSE_WARNING(GetVerbosity(),
+			printf("Warning: moov grew too much to be rewritten, "
+				"durations are not updated\n"));
+	}
+	MP4Free(pMoov);
+}
+
 void MP4File::UpdateDuration(MP4Duration duration)
 {
 	MP4Duration currentDuration = GetDuration();
@@ -973,6 +1582,136 @@ void MP4File::SetBytesProperty(const char* name,
 	((MP4BytesProperty*)pProperty)->SetValue(pValue, valueSize, index);
 }
 
+MP4PropertyRef* MP4File::GetPropertyRef(const char* name)
+{
+	MP4Property* pProperty = NULL;
+	u_int32_t index = 0;
+
+	if (!FindProperty(name, &pProperty, &index)) {
+		throw new MP4Error("no such property - %s", "MP4File::GetPropertyRef", name);
+	}
+
+	return AddPropertyRef(pProperty, index);
+}
+
+MP4PropertyRef* MP4File::AddPropertyRef(MP4Property* pProperty, 
+	u_int32_t index)
+{
+	MP4PropertyRef* pRef = 
+		(MP4PropertyRef*)MP4Malloc(sizeof(MP4PropertyRef));
+	pRef->pProperty = pProperty;
+	pRef->index = index;
+	pRef->pNext = m_pPropertyRefs;
+	m_pPropertyRefs = pRef;
+
+	return pRef;
+}
+
+void MP4File::FreePropertyRef(MP4PropertyRef* pRef)
+{
+	MP4PropertyRef** ppRef = &m_pPropertyRefs;
+
+	while (*ppRef != pRef) {
+		if (*ppRef == NULL) {
+			throw new MP4Error("not a property handle of this file",
+				"MP4File::FreePropertyRef");
+		}
+		ppRef = &(*ppRef)->pNext;
+	}
+	*ppRef = pRef->pNext;
+	MP4Free(pRef);
+}
+
+void MP4File::InvalidatePropertyRefs(MP4Property* pProperty)
+{
+	for (MP4PropertyRef* pRef = m_pPropertyRefs; pRef; pRef = pRef->pNext) {
+		if (pRef->pProperty == pProperty) {
+			pRef->pProperty = NULL;
+		}
+	}
+}
+
+static void CheckPropertyRef(MP4PropertyRef* pRef, const char* where)
+{
+	if (pRef->pProperty == NULL) {
+		throw new MP4Error("property was deleted", where);
+	}
+}
+
+u_int64_t MP4File::GetIntegerProperty(MP4PropertyRef* pRef)
+{
+	CheckPropertyRef(pRef, "MP4File::GetIntegerProperty");
+
+	switch (pRef->pProperty->GetType()) {
+	case Integer8Property:
+	case Integer16Property:
+	case Integer24Property:
+	case Integer32Property:
+	case Integer64Property:
+		break;
+	default:
+		throw new MP4Error("type mismatch - property %s type %d", 
+			"MP4File::GetIntegerProperty", pRef->pProperty->GetName(),
+			pRef->pProperty->GetType());
+	}
+
+	return ((MP4IntegerProperty*)pRef->pProperty)->GetValue(pRef->index);
+}
+
+void MP4File::SetIntegerProperty(MP4PropertyRef* pRef, u_int64_t value)
+{
+	ProtectWriteOperation("SetIntegerProperty");
+
+	// check the type
+	(void)GetIntegerProperty(pRef);
+
+	((MP4IntegerProperty*)pRef->pProperty)->SetValue(value, pRef->index);
+}
+
+float MP4File::GetFloatProperty(MP4PropertyRef* pRef)
+{
+	CheckPropertyRef(pRef, "MP4File::GetFloatProperty");
+
+	if (pRef->pProperty->GetType() != Float32Property) {
+		throw new MP4Error("type mismatch - property %s type %d", 
+			"MP4File::GetFloatProperty", pRef->pProperty->GetName(),
+			pRef->pProperty->GetType());
+	}
+
+	return ((MP4Float32Property*)pRef->pProperty)->GetValue(pRef->index);
+}
+
+void MP4File::SetFloatProperty(MP4PropertyRef* pRef, float value)
+{
+	ProtectWriteOperation("SetFloatProperty");
+
+	(void)GetFloatProperty(pRef);
+
+	((MP4Float32Property*)pRef->pProperty)->SetValue(value, pRef->index);
+}
+
+const char* MP4File::GetStringProperty(MP4PropertyRef* pRef)
+{
+	CheckPropertyRef(pRef, "MP4File::GetStringProperty");
+
+	if (pRef->pProperty->GetType() != StringProperty) {
+		throw new MP4Error("type mismatch - property %s type %d", 
+			"MP4File::GetStringProperty", pRef->pProperty->GetName(),
+			pRef->pProperty->GetType());
+	}
+
+	return ((MP4StringProperty*)pRef->pProperty)->GetValue(pRef->index);
+}
+
+void MP4File::SetStringProperty(MP4PropertyRef* pRef, const char* value)
+{
+	ProtectWriteOperation("SetStringProperty");
+
+	(void)GetStringProperty(pRef);
+
+	((MP4StringProperty*)pRef->pProperty)->SetValue(value, pRef->index);
+}
+
 
 // track functions
 
@@ -980,6 +1719,11 @@ MP4TrackId MP4File::AddTrack(const char* type, u_int32_t timeScale)
 {
 	ProtectWriteOperation("AddTrack");
 
+	if (m_fragmentMoovWritten) {
+		throw new MP4Error("can't add a track after the first fragment",
+			"AddTrack");
+	}
+
 	// create and add new trak atom
 	MP4Atom* pTrakAtom = AddChildAtom("moov", "trak");
 
@@ -2195,6 +2939,7 @@ void MP4File::DeleteTrack(MP4TrackId trackId)
 
 	m_pTracks.Delete(trackIndex);
 
+	pTrack->FreePropertyRefs();
 	delete pTrack;
 	delete pTrakAtom;
 }
@@ -2212,11 +2957,11 @@ u_int32_t MP4File::GetNumberOfTracks(const char* type, u_int8_t subType)
 		if (!strcmp(normType, m_pTracks[i]->GetType())) {
 			if (subType) {
 				if (normType == MP4_AUDIO_TRACK_TYPE) {
-					if (subType != GetTrackEsdsObjectTypeId(m_pTracks[i]->GetId())) {
+					if (subType != m_pTracks[i]->GetEsdsObjectTypeId()) {
 						continue;
 					}
 				} else if (normType == MP4_VIDEO_TRACK_TYPE) {
-					if (subType != GetTrackEsdsObjectTypeId(m_pTracks[i]->GetId())) {
+					if (subType != m_pTracks[i]->GetEsdsObjectTypeId()) {
 						continue;
 					}
 				} 
@@ -2279,11 +3024,11 @@ MP4TrackId MP4File::FindTrackId(u_int16_t trackIndex,
     if (!strcmp(normType, m_pTracks[i]->GetType())) {
       if (subType) {
 	if (normType == MP4_AUDIO_TRACK_TYPE) {
-	  if (subType != GetTrackEsdsObjectTypeId(m_pTracks[i]->GetId())) {
+	  if (subType != m_pTracks[i]->GetEsdsObjectTypeId()) {
 	    continue;
 	  }
 	} else if (normType == MP4_VIDEO_TRACK_TYPE) {
-	  if (subType != GetTrackEsdsObjectTypeId(m_pTracks[i]->GetId())) {
+	  if (subType != m_pTracks[i]->GetEsdsObjectTypeId()) {
 	    continue;
 	  }
 	} 
@@ -2316,6 +3061,16 @@ u_int16_t MP4File::FindTrackIndex(MP4TrackId trackId)
 	return (u_int16_t)-1; // satisfy MS compiler
 }
 
+MP4Track* MP4File::FindTrack(MP4TrackId trackId)
+{
+	for (u_int32_t i = 0; i < m_pTracks.Size(); i++) {
+		if (m_pTracks[i]->GetId() == trackId) {
+			return m_pTracks[i];
+		}
+	}
+	return NULL;
+}
+
 u_int16_t MP4File::FindTrakAtomIndex(MP4TrackId trackId)
 {
 	if (trackId) {
@@ -2336,6 +3091,16 @@ u_int32_t MP4File::GetSampleSize(MP4TrackId trackId, MP4SampleId sampleId)
 	return m_pTracks[FindTrackIndex(trackId)]->GetSampleSize(sampleId);
 }
 
+MP4Status MP4File::TryGetSampleSize(
+	MP4TrackId trackId, MP4SampleId sampleId, u_int32_t* pSize)
+{
+	MP4Track* pTrack = FindTrack(trackId);
+	if (pTrack == NULL) {
+		return MP4_STATUS_INVALID_TRACK;
+	}
+	return pTrack->TryGetSampleSize(sampleId, pSize);
+}
+
 u_int32_t MP4File::GetTrackMaxSampleSize(MP4TrackId trackId)
 {
 	return m_pTracks[FindTrackIndex(trackId)]->GetMaxSampleSize();
@@ -2366,6 +3131,27 @@ MP4Duration MP4File::GetSampleDuration(
 	return duration; 
 }
 
+void MP4File::GetSampleTimes(
+	MP4TrackId trackId, MP4SampleId startSampleId,
+	u_int32_t numSamples, MP4Timestamp* pStartTimes,
+	MP4Duration* pDurations, MP4Duration* pRenderingOffsets)
+{
+	m_pTracks[FindTrackIndex(trackId)]->
+		GetSampleTimesArray(startSampleId, numSamples, 
+			pStartTimes, pDurations, pRenderingOffsets);
+}
+
+MP4Status MP4File::TryGetSampleTimes(
+	MP4TrackId trackId, MP4SampleId sampleId,
+	MP4Timestamp* pStartTime, MP4Duration* pDuration)
+{
+	MP4Track* pTrack = FindTrack(trackId);
+	if (pTrack == NULL) {
+		return MP4_STATUS_INVALID_TRACK;
+	}
+	return pTrack->TryGetSampleTimes(sampleId, pStartTime, pDuration);
+}
+
 MP4Duration MP4File::GetSampleRenderingOffset(
 	MP4TrackId trackId, MP4SampleId sampleId)
 {
@@ -2388,14 +3174,55 @@ void MP4File::ReadSample(MP4TrackId trackId, MP4SampleId sampleId,
 			pStartTime, pDuration, pRenderingOffset, pIsSyncSample);
 }
 
+MP4Status MP4File::TryReadSample(MP4TrackId trackId, MP4SampleId sampleId,
+		u_int8_t** ppBytes, u_int32_t* pNumBytes, 
+		MP4Timestamp* pStartTime, MP4Duration* pDuration,
+		MP4Duration* pRenderingOffset, bool* pIsSyncSample)
+{
+	MP4Track* pTrack = FindTrack(trackId);
+	if (pTrack == NULL) {
+		return MP4_STATUS_INVALID_TRACK;
+	}
+	return pTrack->TryReadSample(sampleId, ppBytes, pNumBytes, 
+		pStartTime, pDuration, pRenderingOffset, pIsSyncSample);
+}
+
+void MP4File::ReadSampleView(MP4TrackId trackId, MP4SampleId sampleId,
+		const u_int8_t** ppBytes, u_int32_t* pNumBytes, 
+		MP4Timestamp* pStartTime, MP4Duration* pDuration,
+		MP4Duration* pRenderingOffset, bool* pIsSyncSample)
+{
+	m_pTracks[FindTrackIndex(trackId)]->
+		ReadSampleView(sampleId, ppBytes, pNumBytes, 
+			pStartTime, pDuration, pRenderingOffset, pIsSyncSample);
+}
+
+void MP4File::PrepareForReaders()
+{
+	if (m_mode != 'r') {
+		throw new MP4Error("file must be opened for reading", 
+			"MP4CreateReader");
+	}
+
+	for (u_int32_t i = 0; i < m_pTracks.Size(); i++) {
+		m_pTracks[i]->PrepareForReaders();
+	}
+}
+
 void MP4File::WriteSample(MP4TrackId trackId,
 		const u_int8_t* pBytes, u_int32_t numBytes,
 		MP4Duration duration, MP4Duration renderingOffset, bool isSyncSample)
 {
 	ProtectWriteOperation("MP4WriteSample");
 
-	m_pTracks[FindTrackIndex(trackId)]->
-		WriteSample(pBytes, numBytes, duration, renderingOffset, isSyncSample);
+	MP4Track* pTrack = m_pTracks[FindTrackIndex(trackId)];
+
+	// start a new fragment when this track has enough samples buffered
+	if (m_fragmentDuration && pTrack->IsFragmentFull(isSyncSample)) {
+		WriteFragment();
+	}
+
+	pTrack->WriteSample(pBytes, numBytes, duration, renderingOffset, isSyncSample);
 
 	m_pModificationProperty->SetValue(MP4GetAbsTimestamp());
 }
@@ -2430,37 +3257,61 @@ MP4Atom *MP4File::FindTrackAtom (MP4TrackId trackId, const char *name)
   return FindAtom(MakeTrackName(trackId, name));
 }
 
+MP4PropertyRef* MP4File::GetTrackPropertyRef(MP4TrackId trackId, 
+	const char* name)
+{
+	return GetPropertyRef(MakeTrackName(trackId, name));
+}
+
+MP4PropertyRef* MP4File::FindTrackPropertyRef(MP4TrackId trackId, 
+	const char* name, const char* where)
+{
+	MP4PropertyRef* pRef = 
+		m_pTracks[FindTrackIndex(trackId)]->GetPropertyRef(name);
+
+	if (pRef == NULL) {
+		throw new MP4Error("no such property - %s", where, name);
+	}
+	return pRef;
+}
+
 u_int64_t MP4File::GetTrackIntegerProperty(MP4TrackId trackId, const char* name)
 {
-	return GetIntegerProperty(MakeTrackName(trackId, name));
+	return GetIntegerProperty(FindTrackPropertyRef(trackId, name, 
+		"MP4File::GetTrackIntegerProperty"));
 }
 
 void MP4File::SetTrackIntegerProperty(MP4TrackId trackId, const char* name, 
 	int64_t value)
 {
-	SetIntegerProperty(MakeTrackName(trackId, name), value);
+	SetIntegerProperty(FindTrackPropertyRef(trackId, name, 
+		"MP4File::SetTrackIntegerProperty"), value);
 }
 
 float MP4File::GetTrackFloatProperty(MP4TrackId trackId, const char* name)
 {
-	return GetFloatProperty(MakeTrackName(trackId, name));
+	return GetFloatProperty(FindTrackPropertyRef(trackId, name, 
+		"MP4File::GetTrackFloatProperty"));
 }
 
 void MP4File::SetTrackFloatProperty(MP4TrackId trackId, const char* name, 
 	float value)
 {
-	SetFloatProperty(MakeTrackName(trackId, name), value);
+	SetFloatProperty(FindTrackPropertyRef(trackId, name, 
+		"MP4File::SetTrackFloatProperty"), value);
 }
 
 const char* MP4File::GetTrackStringProperty(MP4TrackId trackId, const char* name)
 {
-	return GetStringProperty(MakeTrackName(trackId, name));
+	return GetStringProperty(FindTrackPropertyRef(trackId, name, 
+		"MP4File::GetTrackStringProperty"));
 }
 
 void MP4File::SetTrackStringProperty(MP4TrackId trackId, const char* name,
 	const char* value)
 {
-	SetStringProperty(MakeTrackName(trackId, name), value);
+	SetStringProperty(FindTrackPropertyRef(trackId, name, 
+		"MP4File::SetTrackStringProperty"), value);
 }
 
 void MP4File::GetTrackBytesProperty(MP4TrackId trackId, const char* name, 
@@ -2662,20 +3513,12 @@ void MP4File::SetTrackTimeScale(MP4TrackId trackId, u_int32_t value)
 
 MP4Duration MP4File::GetTrackDuration(MP4TrackId trackId)
 {
-	return GetTrackIntegerProperty(trackId, "mdia.mdhd.duration");
+	return m_pTracks[FindTrackIndex(trackId)]->GetDuration();
 }
 
 u_int8_t MP4File::GetTrackEsdsObjectTypeId(MP4TrackId trackId)
 {
-	// changed mp4a to * to handle enca case
-  try {
-	return GetTrackIntegerProperty(trackId, 
-		"mdia.minf.stbl.stsd.*.esds.decConfigDescr.objectTypeId");
-  } catch (MP4Error *e) {
-    delete e;
-    return GetTrackIntegerProperty(trackId, 
-		"mdia.minf.stbl.stsd.*.*.esds.decConfigDescr.objectTypeId");
-  }
+	return m_pTracks[FindTrackIndex(trackId)]->GetEsdsObjectTypeId();
 }
 
 u_int8_t MP4File::GetTrackAudioMpeg4Type(MP4TrackId trackId)
@@ -3116,6 +3959,50 @@ void MP4File::ReadRtpPacket(
 		ssrc, includeHeader, includePayload);
 }
 
+MP4Status MP4File::TryReadRtpPacket(
+	MP4TrackId hintTrackId,
+	u_int16_t packetIndex,
+	u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes,
+	u_int32_t ssrc,
+	bool includeHeader,
+	bool includePayload)
+{
+	MP4Track* pTrack = FindTrack(hintTrackId);
+	if (pTrack == NULL) {
+		return MP4_STATUS_INVALID_TRACK;
+	}
+	if (strcmp(pTrack->GetType(), MP4_HINT_TRACK_TYPE)) {
+		return MP4_STATUS_NOT_HINT_TRACK;
+	}
+	return ((MP4RtpHintTrack*)pTrack)->TryReadPacket(
+		packetIndex, ppBytes, pNumBytes,
+		ssrc, includeHeader, includePayload);
+}
+
+MP4Status MP4File::TryReadRtpPacketIov(
+	MP4TrackId hintTrackId,
+	u_int16_t packetIndex,
+	u_int8_t* pBuffer,
+	u_int32_t bufferSize,
+	struct iovec* pIov,
+	u_int32_t* pIovCount,
+	u_int32_t ssrc,
+	bool includeHeader,
+	bool includePayload)
+{
+	MP4Track* pTrack = FindTrack(hintTrackId);
+	if (pTrack == NULL) {
+		return MP4_STATUS_INVALID_TRACK;
+	}
+	if (strcmp(pTrack->GetType(), MP4_HINT_TRACK_TYPE)) {
+		return MP4_STATUS_NOT_HINT_TRACK;
+	}
+	return ((MP4RtpHintTrack*)pTrack)->TryReadPacketIov(
+		packetIndex, pBuffer, bufferSize, pIov, pIovCount,
+		ssrc, includeHeader, includePayload);
+}
+
 MP4Timestamp MP4File::GetRtpTimestampStart(
 	MP4TrackId hintTrackId)
 {
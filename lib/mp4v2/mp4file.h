@@ -40,6 +40,14 @@ class MP4Descriptor;
 class MP4DescriptorProperty;
 struct Virtual_IO;
 
+// a property found once by name, so it can be got and set 
+// many times without another lookup, see MP4GetPropertyHandle
+struct MP4PropertyRef {
+	MP4Property*	pProperty;	// NULL once the property is deleted
+	u_int32_t	index;
+	MP4PropertyRef*	pNext;		// the file's list, freed with the file
+};
+
 class MP4File {
 public: /* equivalent to MP4 library API */
 	MP4File(u_int32_t verbosity = 0);
@@ -51,6 +59,7 @@ public: /* equivalent to MP4 library API */
 	void Read(const wchar_t* fileName);
 	#endif
 	void ReadEx(const char *fileName, void *user, Virtual_IO *virtual_IO); //benski>
+	void ReadMapped(const char* fileName);
 	void Create(const char* fileName, u_int32_t flags, 
 		    int add_ftyp = 1, int add_iods = 1,
 		    char* majorBrand = NULL, 
@@ -58,6 +67,10 @@ public: /* equivalent to MP4 library API */
 		    u_int32_t supportedBrandsCount = 0);
 	bool Modify(const char* fileName);
 	void Optimize(const char* orgFileName, 
+		const char* newFileName = NULL,
+		MP4OptimizeProgressFunc progressFunc = NULL,
+		void* userData = NULL);
+	void MakeStreamable(const char* orgFileName, 
 		const char* newFileName = NULL);
 	void Dump(FILE* pDumpFile = NULL, bool dumpImplicits = false);
 	void Close();
@@ -71,6 +84,30 @@ public: /* equivalent to MP4 library API */
 		m_verbosity = verbosity;
 	}
 
+	u_int32_t GetSampleIndexLimit() {
+		return m_sampleIndexLimit;
+	}
+	void SetSampleIndexLimit(u_int32_t maxEntries) {
+		m_sampleIndexLimit = maxEntries;
+	}
+
+	// defer reading large sample tables until a track needs them
+	bool GetLazyLoad() {
+		return m_lazyLoad;
+	}
+	void SetLazyLoad(bool lazyLoad) {
+		m_lazyLoad = lazyLoad;
+	}
+
+	// when non-zero, Create() writes a fragmented file, flushing
+	// a moof and mdat about every fragmentDuration milliseconds
+	u_int32_t GetFragmentDuration() {
+		return m_fragmentDuration;
+	}
+	void SetFragmentDuration(u_int32_t fragmentDuration) {
+		m_fragmentDuration = fragmentDuration;
+	}
+
 	bool Use64Bits(const char *atomName);
 	void Check64BitStatus(const char *atomName);
 	/* file properties */
@@ -87,6 +124,23 @@ public: /* equivalent to MP4 library API */
 	void SetBytesProperty(const char* name, 
 		const u_int8_t* pValue, u_int32_t valueSize);
 
+	// properties by reference, valid until FreePropertyRef or the
+	// file is closed.  If the property is deleted first, with its atom
+	// or track, the reference just fails
+	MP4PropertyRef* GetPropertyRef(const char* name);
+	MP4PropertyRef* AddPropertyRef(MP4Property* pProperty, u_int32_t index);
+	void FreePropertyRef(MP4PropertyRef* pRef);
+	// as a property is deleted
+	void InvalidatePropertyRefs(MP4Property* pProperty);
+
+	u_int64_t GetIntegerProperty(MP4PropertyRef* pRef);
+	float GetFloatProperty(MP4PropertyRef* pRef);
+	const char* GetStringProperty(MP4PropertyRef* pRef);
+
+	void SetIntegerProperty(MP4PropertyRef* pRef, u_int64_t value);
+	void SetFloatProperty(MP4PropertyRef* pRef, float value);
+	void SetStringProperty(MP4PropertyRef* pRef, const char* value);
+
 	// file level convenience functions
 
 	MP4Duration GetDuration();
@@ -125,10 +179,15 @@ public: /* equivalent to MP4 library API */
 	MP4TrackId FindTrackId(u_int16_t trackIndex, 
 		const char* type = NULL, u_int8_t subType = 0);
 	u_int16_t FindTrackIndex(MP4TrackId trackId);
+	MP4Track* FindTrack(MP4TrackId trackId);	// NULL if there is none
 	u_int16_t FindTrakAtomIndex(MP4TrackId trackId);
 
 	/* track properties */
 	MP4Atom *FindTrackAtom(MP4TrackId trackId, const char *name);
+	MP4PropertyRef* GetTrackPropertyRef(MP4TrackId trackId, const char* name);
+	// the track's own reference, kept by the track
+	MP4PropertyRef* FindTrackPropertyRef(MP4TrackId trackId, 
+		const char* name, const char* where);
 	u_int64_t GetTrackIntegerProperty(
 		MP4TrackId trackId, const char* name);
 	float GetTrackFloatProperty(
@@ -152,6 +211,8 @@ public: /* equivalent to MP4 library API */
 	/* sample operations */
 
 	u_int32_t GetSampleSize(MP4TrackId trackId, MP4SampleId sampleId);
+	MP4Status TryGetSampleSize(
+		MP4TrackId trackId, MP4SampleId sampleId, u_int32_t* pSize);
 
 	u_int32_t GetTrackMaxSampleSize(MP4TrackId trackId);
 
@@ -164,6 +225,15 @@ public: /* equivalent to MP4 library API */
 	MP4Duration GetSampleDuration(
 		MP4TrackId trackId, MP4SampleId sampleId);
 
+	MP4Status TryGetSampleTimes(
+		MP4TrackId trackId, MP4SampleId sampleId,
+		MP4Timestamp* pStartTime, MP4Duration* pDuration);
+
+	void GetSampleTimes(
+		MP4TrackId trackId, MP4SampleId startSampleId,
+		u_int32_t numSamples, MP4Timestamp* pStartTimes,
+		MP4Duration* pDurations, MP4Duration* pRenderingOffsets);
+
 	MP4Duration GetSampleRenderingOffset(
 		MP4TrackId trackId, MP4SampleId sampleId);
 
@@ -182,6 +252,32 @@ public: /* equivalent to MP4 library API */
 		MP4Duration* pRenderingOffset = NULL, 
 		bool* pIsSyncSample = NULL);
 
+	// status returning variants of the above, used by the C API 
+	// so that routine failures don't allocate and throw an MP4Error
+	MP4Status TryReadSample(
+		// input parameters
+		MP4TrackId trackId, 
+		MP4SampleId sampleId,
+		// output parameters
+		u_int8_t** ppBytes, 
+		u_int32_t* pNumBytes, 
+		MP4Timestamp* pStartTime = NULL, 
+		MP4Duration* pDuration = NULL,
+		MP4Duration* pRenderingOffset = NULL, 
+		bool* pIsSyncSample = NULL);
+
+	void ReadSampleView(
+		// input parameters
+		MP4TrackId trackId, 
+		MP4SampleId sampleId,
+		// output parameters
+		const u_int8_t** ppBytes, 
+		u_int32_t* pNumBytes, 
+		MP4Timestamp* pStartTime = NULL, 
+		MP4Duration* pDuration = NULL,
+		MP4Duration* pRenderingOffset = NULL, 
+		bool* pIsSyncSample = NULL);
+
 	void WriteSample(
 		MP4TrackId trackId,
 		const u_int8_t* pBytes, 
@@ -453,6 +549,26 @@ public: /* equivalent to MP4 library API */
 		bool includeHeader = true,
 		bool includePayload = true);
 
+	MP4Status TryReadRtpPacket(
+		MP4TrackId hintTrackId,
+		u_int16_t packetIndex,
+		u_int8_t** ppBytes, 
+		u_int32_t* pNumBytes,
+		u_int32_t ssrc = 0,
+		bool includeHeader = true,
+		bool includePayload = true);
+
+	MP4Status TryReadRtpPacketIov(
+		MP4TrackId hintTrackId,
+		u_int16_t packetIndex,
+		u_int8_t* pBuffer,
+		u_int32_t bufferSize,
+		struct iovec* pIov,
+		u_int32_t* pIovCount,
+		u_int32_t ssrc = 0,
+		bool includeHeader = true,
+		bool includePayload = true);
+
 	MP4Timestamp GetRtpTimestampStart(
 		MP4TrackId hintTrackId);
 
@@ -604,8 +720,14 @@ public: /* equivalent to MP4 library API */
 
 	u_int64_t GetSize();
 
+	// pointer into the file when it is memory mapped, else NULL
+	const u_int8_t* GetMappedBytes(u_int64_t pos, u_int32_t numBytes);
+
 	void ReadBytes(
 		u_int8_t* pBytes, u_int32_t numBytes, FILE* pFile = NULL);
+	// positions and reads without throwing, for the sample read path
+	MP4Status TryReadBytes(u_int64_t pos, 
+		u_int8_t* pBytes, u_int32_t numBytes, FILE* pFile = NULL);
 	u_int64_t ReadUInt(u_int8_t size);
 	u_int8_t ReadUInt8();
 	u_int16_t ReadUInt16();
@@ -651,6 +773,19 @@ public: /* equivalent to MP4 library API */
 		return m_mode;
 	}
 
+	const char* GetFilename() {
+		return m_fileName;
+	}
+
+	// true if the file is mapped rather than read via a handle
+	bool IsMapped();
+	// true if the file is read via the Virtual_IO given to ReadEx,
+	// which has no way to open another handle
+	bool IsVirtualIO();
+
+	// see MP4Reader
+	void PrepareForReaders();
+
 	MP4Track* GetTrack(MP4TrackId trackId);
 
 	void UpdateDuration(MP4Duration duration);
@@ -690,11 +825,19 @@ protected:
 	#endif
 	void ReadFromFile();
 	void GenerateTracks();
+	void GenerateFragments();
 	void BeginWrite();
 	void FinishWrite();
+	void WriteFragmentMoov();
+	void WriteFragment();
+	void FinishFragmentedWrite();
 	void CacheProperties();
 	void RewriteMdat(void* pReadFile, void* pWriteFile,
-			 Virtual_IO *readIO, Virtual_IO *writeIO);
+			 Virtual_IO *readIO, Virtual_IO *writeIO,
+			 MP4OptimizeProgressFunc progressFunc, void* userData);
+	void WriteMoovToMemory(u_int8_t** ppBytes, u_int64_t* pNumBytes);
+	void CopyBytes(void* pReadFile, Virtual_IO* readIO,
+		u_int64_t start, u_int64_t end);
 	bool ShallHaveIods();
 
 	const char* TempFileName();
@@ -804,7 +947,17 @@ protected:
 	MP4Integer32Array m_trakIds;
 	MP4TrackArray	m_pTracks;
 	MP4TrackId		m_odTrackId;
+	MP4PropertyRef*	m_pPropertyRefs;
 	u_int32_t		m_verbosity;
+	u_int32_t		m_sampleIndexLimit;
+	bool			m_lazyLoad;
+
+	// fragmented writing
+	u_int32_t		m_fragmentDuration;
+	u_int32_t		m_fragmentSequence;
+	bool			m_fragmentMoovWritten;
+	u_int64_t		m_fragmentMoovStart;
+	u_int64_t		m_fragmentMoovEnd;
 	char			m_mode;
 	u_int32_t               m_createFlags;
 	bool			m_useIsma;
@@ -63,7 +63,7 @@ void MP4File::SetPosition(u_int64_t pos, FILE* pFile)
 			}
 		}
 	} else {
-		if (pos >= m_memoryBufferSize) {
+		if (pos > m_memoryBufferSize) {
 		  //		  abort();
 			throw new MP4Error("position out of range", "MP4SetPosition");
 		}
@@ -84,6 +84,26 @@ u_int64_t MP4File::GetSize()
 	return m_fileSize;
 }
 
+const u_int8_t* MP4File::GetMappedBytes(u_int64_t pos, u_int32_t numBytes)
+{
+	if (m_memoryBuffer != NULL || m_pFile == NULL 
+	  || m_virtual_IO != &MMAP_virtual_IO) {
+		return NULL;
+	}
+	return MMAP_GetBytes(m_pFile, pos, numBytes);
+}
+
+bool MP4File::IsMapped()
+{
+	return m_pFile != NULL && m_virtual_IO == &MMAP_virtual_IO;
+}
+
+bool MP4File::IsVirtualIO()
+{
+	return m_pFile != NULL && m_virtual_IO != &MMAP_virtual_IO
+	  && m_virtual_IO != &FILE_virtual_IO;
+}
+
 void MP4File::ReadBytes(u_int8_t* pBytes, u_int32_t numBytes, FILE* pFile)
 {
 	// handle degenerate cases
@@ -123,6 +143,45 @@ void MP4File::ReadBytes(u_int8_t* pBytes, u_int32_t numBytes, FILE* pFile)
 	return;
 }
 
+MP4Status MP4File::TryReadBytes(u_int64_t pos, 
+	u_int8_t* pBytes, u_int32_t numBytes, FILE* pFile)
+{
+	if (numBytes == 0) {
+		return MP4_STATUS_OK;
+	}
+
+	if (m_memoryBuffer != NULL) {
+		if (pos > m_memoryBufferSize 
+		  || numBytes > m_memoryBufferSize - pos) {
+			return MP4_STATUS_END_OF_FILE;
+		}
+		memcpy(pBytes, &m_memoryBuffer[pos], numBytes);
+		m_memoryBufferPosition = pos + numBytes;
+		return MP4_STATUS_OK;
+	}
+
+	if (pFile == NULL) {
+		if (m_pFile == NULL
+		  || m_virtual_IO->SetPosition(m_pFile, pos) != 0) {
+			return MP4_STATUS_READ_ERROR;
+		}
+		if (m_virtual_IO->Read(m_pFile, pBytes, numBytes) != numBytes) {
+			return MP4_STATUS_END_OF_FILE;
+		}
+		return MP4_STATUS_OK;
+	}
+
+	fpos_t fpos;
+	VAR_TO_FPOS(fpos, pos);
+	if (fsetpos(pFile, &fpos) < 0) {
+		return MP4_STATUS_READ_ERROR;
+	}
+	if (fread(pBytes, 1, numBytes, pFile) != numBytes) {
+		return feof(pFile) ? MP4_STATUS_END_OF_FILE : MP4_STATUS_READ_ERROR;
+	}
+	return MP4_STATUS_OK;
+}
+
 void MP4File::PeekBytes(u_int8_t* pBytes, u_int32_t numBytes, FILE* pFile)
 {
 	u_int64_t pos = GetPosition(pFile);
@@ -588,7 +588,7 @@ extern "C" char* MP4FileInfo(
 	MP4TrackId trackId)
 {
 	MP4FileHandle mp4File =
-		MP4Read(fileName);
+		MP4ReadLazy(fileName);
 
 	if (!mp4File) {
 		return NULL;
@@ -29,6 +29,14 @@ MP4Property::MP4Property(const char* name)
 	m_implicit = false;
 }
 
+MP4Property::~MP4Property()
+{
+	// property handles to this property now fail
+	if (m_pParentAtom && m_pParentAtom->GetFile()) {
+		m_pParentAtom->GetFile()->InvalidatePropertyRefs(this);
+	}
+}
+
 bool MP4Property::FindProperty(const char* name, 
 	MP4Property** ppProperty, u_int32_t* pIndex) 
 {
@@ -554,6 +562,10 @@ MP4TableProperty::MP4TableProperty(char* name, MP4IntegerProperty* pCountPropert
 {
 	m_pCountProperty = pCountProperty;
 	m_pCountProperty->SetReadOnly();
+	m_bulkRead = false;
+	m_lazyRead = false;
+	m_pLazyFile = NULL;
+	m_lazyPosition = 0;
 }
 
 MP4TableProperty::~MP4TableProperty()
@@ -593,6 +605,8 @@ bool MP4TableProperty::FindProperty(const char *name,
 		if (pIndex) {
 			*pIndex = index;
 		}
+		// caller wants a value, so the entries must be present
+		Load();
 	}
 
 	VERBOSE_FIND(m_pParentAtom->GetFile()->GetVerbosity(),
@@ -642,16 +656,204 @@ void MP4TableProperty::Read(MP4File* pFile, u_int32_t index)
 
 	u_int32_t numEntries = GetCount();
 
+	// if allowed, just note where the table is, and skip over it
+	// the entries are read later by Load()
+	if (m_lazyRead && pFile->GetLazyLoad()) {
+		u_int32_t entrySize = GetBulkEntrySize();
+		if (entrySize > 0) {
+			u_int64_t position = pFile->GetPosition();
+			u_int64_t tableSize = (u_int64_t)numEntries * entrySize;
+
+			if (position + tableSize > pFile->GetSize()) {
+				throw new MP4Error("not enough bytes, reached end-of-file",
+					"MP4TableProperty::Read");
+			}
+
+			VERBOSE_READ_TABLE(pFile->GetVerbosity(),
+				printf("Read: deferring \"%s\" %u entries at "U64"\n",
+					m_name, numEntries, position));
+
+			m_pLazyFile = pFile;
+			m_lazyPosition = position;
+			pFile->SetPosition(position + tableSize);
+			return;
+		}
+	}
+
 	/* for each property set size */
 	for (u_int32_t j = 0; j < numProperties; j++) {
 		m_pProperties[j]->SetCount(numEntries);
 	}
 
+	if (m_bulkRead && ReadBulk(pFile, numEntries)) {
+		return;
+	}
+
 	for (u_int32_t i = 0; i < numEntries; i++) {
 		ReadEntry(pFile, i);
 	}
 }
 
+// largest block read at once when the file isn't memory mapped
+#define TABLE_BULK_READ_SIZE (64 * 1024)
+
+// size of one table entry if all the columns are fixed size integers,
+// zero otherwise
+u_int32_t MP4TableProperty::GetBulkEntrySize()
+{
+	u_int32_t numProperties = m_pProperties.Size();
+	u_int32_t entrySize = 0;
+
+	for (u_int32_t j = 0; j < numProperties; j++) {
+		if (m_pProperties[j]->IsImplicit()) {
+			continue;
+		}
+		switch (m_pProperties[j]->GetType()) {
+		case Integer8Property:
+			entrySize += 1;
+			break;
+		case Integer16Property:
+			entrySize += 2;
+			break;
+		case Integer32Property:
+			entrySize += 4;
+			break;
+		case Integer64Property:
+			entrySize += 8;
+			break;
+		default:
+			return 0;
+		}
+	}
+	return entrySize;
+}
+
+void MP4TableProperty::Load()
+{
+	if (m_pLazyFile == NULL) {
+		return;
+	}
+
+	MP4File* pFile = m_pLazyFile;
+	u_int32_t numEntries = GetCount();
+	u_int64_t oldPosition = pFile->GetPosition();
+
+	VERBOSE_READ_TABLE(pFile->GetVerbosity(),
+		printf("Load: \"%s\" %u entries at "U64"\n",
+			m_name, numEntries, m_lazyPosition));
+
+	// clear first, a failed load isn't retried
+	m_pLazyFile = NULL;
+
+	for (u_int32_t j = 0; j < m_pProperties.Size(); j++) {
+		m_pProperties[j]->SetCount(numEntries);
+	}
+
+	pFile->SetPosition(m_lazyPosition);
+	if (!ReadBulk(pFile, numEntries)) {
+		for (u_int32_t i = 0; i < numEntries; i++) {
+			ReadEntry(pFile, i);
+		}
+	}
+	pFile->SetPosition(oldPosition);
+}
+
+bool MP4TableProperty::ReadBulk(MP4File* pFile, u_int32_t numEntries)
+{
+	u_int32_t numProperties = m_pProperties.Size();
+
+	// only fixed size integer columns can be read this way
+	u_int32_t entrySize = GetBulkEntrySize();
+
+	if (entrySize == 0 || numEntries == 0) {
+		return false;
+	}
+
+	u_int64_t tableSize = (u_int64_t)numEntries * entrySize;
+	u_int64_t position = pFile->GetPosition();
+
+	if (position + tableSize > pFile->GetSize()) {
+		throw new MP4Error("not enough bytes, reached end-of-file",
+			"MP4TableProperty::ReadBulk");
+	}
+
+	VERBOSE_READ_TABLE(pFile->GetVerbosity(),
+		printf("ReadBulk: \"%s\" %u entries of %u bytes\n",
+			m_name, numEntries, entrySize));
+
+	// use the whole table in place if the file is mapped
+	const u_int8_t* pMapped = NULL;
+	if (tableSize <= 0xFFFFFFFF) {
+		pMapped = pFile->GetMappedBytes(position, (u_int32_t)tableSize);
+	}
+
+	u_int32_t blockEntries = numEntries;
+	u_int8_t* pBlock = NULL;
+	if (pMapped == NULL) {
+		blockEntries = MAX(TABLE_BULK_READ_SIZE / entrySize, 1);
+		if (blockEntries > numEntries) {
+			blockEntries = numEntries;
+		}
+		pBlock = (u_int8_t*)MP4Malloc(blockEntries * entrySize);
+	}
+
+	try {
+		for (u_int32_t i = 0; i < numEntries; i += blockEntries) {
+			u_int32_t count = MIN(blockEntries, numEntries - i);
+			const u_int8_t* pBytes;
+
+			if (pMapped) {
+				pBytes = pMapped;
+			} else {
+				pFile->ReadBytes(pBlock, count * entrySize);
+				pBytes = pBlock;
+			}
+
+			// de-interleave each column into its property
+			for (u_int32_t j = 0; j < numProperties; j++) {
+				MP4Property* pProperty = m_pProperties[j];
+				if (pProperty->IsImplicit()) {
+					continue;
+				}
+				switch (pProperty->GetType()) {
+				case Integer8Property:
+					((MP4Integer8Property*)pProperty)->
+						ReadValues(pBytes, entrySize, i, count);
+					pBytes += 1;
+					break;
+				case Integer16Property:
+					((MP4Integer16Property*)pProperty)->
+						ReadValues(pBytes, entrySize, i, count);
+					pBytes += 2;
+					break;
+				case Integer32Property:
+					((MP4Integer32Property*)pProperty)->
+						ReadValues(pBytes, entrySize, i, count);
+					pBytes += 4;
+					break;
+				case Integer64Property:
+					((MP4Integer64Property*)pProperty)->
+						ReadValues(pBytes, entrySize, i, count);
+					pBytes += 8;
+					break;
+				default:
+					ASSERT(false);
+				}
+			}
+		}
+	}
+	catch (MP4Error* e) {
+		MP4Free(pBlock);
+		throw e;
+	}
+	MP4Free(pBlock);
+
+	if (pMapped) {
+		pFile->SetPosition(position + tableSize);
+	}
+	return true;
+}
+
 void MP4TableProperty::ReadEntry(MP4File* pFile, u_int32_t index)
 {
 	for (u_int32_t j = 0; j < m_pProperties.Size(); j++) {
@@ -674,6 +876,8 @@ void MP4TableProperty::Write(MP4File* pFile, u_int32_t index)
 		return;
 	}
 
+	Load();
+
 	u_int32_t numEntries = GetCount();
 
 	if (m_pProperties[0]->GetCount() != numEntries) {
@@ -714,6 +918,8 @@ void MP4TableProperty::Dump(FILE* pFile, u_int8_t indent,
 		return;
 	}
 
+	Load();
+
 	u_int32_t numEntries = GetCount();
 
 	for (u_int32_t i = 0; i < numEntries; i++) {
@@ -45,7 +45,7 @@ class MP4Property {
 public:
 	MP4Property(const char *name = NULL);
 
-	virtual ~MP4Property() { }
+	virtual ~MP4Property();
 
 	MP4Atom* GetParentAtom() {
 		return m_pParentAtom;
@@ -163,6 +163,19 @@ public:
 			} \
 			m_values[index] = pFile->ReadUInt##xsize(); \
 		} \
+		/* set count values from big endian bytes, stride bytes apart */ \
+		void ReadValues(const u_int8_t* pBytes, u_int32_t stride, \
+		  u_int32_t startIndex, u_int32_t count) { \
+			if (count == 0) { \
+				return; \
+			} \
+			(void)m_values[startIndex + count - 1]; /* range check */ \
+			u_int##isize##_t* pValues = &m_values[startIndex]; \
+			for (u_int32_t i = 0; i < count; i++) { \
+				pValues[i] = MP4BytesToUInt##xsize(pBytes); \
+				pBytes += stride; \
+			} \
+		} \
 		\
 		void Write(MP4File* pFile, u_int32_t index = 0) { \
 			if (m_implicit) { \
@@ -440,6 +453,22 @@ public:
 		return m_pProperties[index];
 	}
 
+	// tables of plain integers can be read in blocks
+	// rather than an entry at a time
+	void SetBulkRead(bool value = true) {
+		m_bulkRead = value;
+	}
+
+	// when the file is read lazily, such a table may be skipped
+	// over at first, and read on first use via Load()
+	void SetLazyRead(bool value = true) {
+		m_lazyRead = value;
+	}
+	bool IsLoaded() {
+		return m_pLazyFile == NULL;
+	}
+	void Load();
+
 	virtual u_int32_t GetCount() {
 	  return m_pCountProperty->GetValue();
 	}
@@ -459,12 +488,19 @@ protected:
 	virtual void ReadEntry(MP4File* pFile, u_int32_t index);
 	virtual void WriteEntry(MP4File* pFile, u_int32_t index);
 
+	u_int32_t GetBulkEntrySize();
+	bool ReadBulk(MP4File* pFile, u_int32_t numEntries);
+
 	bool FindContainedProperty(const char* name,
 		MP4Property** ppProperty, u_int32_t* pIndex);
 
 protected:
 	MP4IntegerProperty*	m_pCountProperty;
 	MP4PropertyArray	m_pProperties;
+	bool			m_bulkRead;
+	bool			m_lazyRead;
+	MP4File*		m_pLazyFile;
+	u_int64_t		m_lazyPosition;
 };
 
 class MP4DescriptorProperty : public MP4Property {
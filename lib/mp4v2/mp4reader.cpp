@@ -0,0 +1,114 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ * 
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ * 
+ * The Original Code is MPEG4IP.
+ * 
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2001 - 2005.  All Rights Reserved.
+ * 
+ * Contributor(s): 
+ *		Dave Mackie		dmackie@cisco.com
+ */
+
+#include "mp4common.h"
+
+MP4Reader::MP4Reader(MP4File* pFile)
+{
+	m_pFile = pFile;
+	m_pFileHandle = NULL;
+	m_pCursors = NULL;
+	m_numCursors = 0;
+
+	// build the track indexes now, so reads don't modify the tracks
+	m_pFile->PrepareForReaders();
+
+	// mapped files are read straight from the mapping, and files
+	// opened with a Virtual_IO through its one handle
+	if (!m_pFile->IsMapped() && !m_pFile->IsVirtualIO()) {
+		const char* fileName = m_pFile->GetFilename();
+		if (fileName) {
+			m_pFileHandle = fopen(fileName, "rb");
+		}
+		if (m_pFileHandle == NULL) {
+			throw new MP4Error("can't open file for reader", 
+				"MP4CreateReader");
+		}
+	}
+
+	m_numCursors = m_pFile->GetNumberOfTracks();
+	m_pCursors = (MP4TrackCursor*)
+		MP4Calloc(MAX(m_numCursors, 1) * sizeof(MP4TrackCursor));
+
+	for (u_int32_t i = 0; i < m_numCursors; i++) {
+		m_pCursors[i].pFile = m_pFileHandle;
+	}
+}
+
+MP4Reader::~MP4Reader()
+{
+	for (u_int32_t i = 0; i < m_numCursors; i++) {
+		FILE* pFile = m_pCursors[i].lastSampleFile;
+		if (pFile && pFile != (FILE*)-1) {
+			fclose(pFile);
+		}
+	}
+	MP4Free(m_pCursors);
+
+	if (m_pFileHandle) {
+		fclose(m_pFileHandle);
+	}
+}
+
+void MP4Reader::ReadSample(
+	MP4TrackId trackId,
+	MP4SampleId sampleId,
+	u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes, 
+	MP4Timestamp* pStartTime, 
+	MP4Duration* pDuration,
+	MP4Duration* pRenderingOffset, 
+	bool* pIsSyncSample)
+{
+	MP4Status status = TryReadSample(trackId, sampleId, ppBytes, pNumBytes,
+		pStartTime, pDuration, pRenderingOffset, pIsSyncSample);
+
+	if (status != MP4_STATUS_OK) {
+		throw new MP4Error(MP4StatusString(status), "MP4ReaderReadSample");
+	}
+}
+
+MP4Status MP4Reader::TryReadSample(
+	MP4TrackId trackId,
+	MP4SampleId sampleId,
+	u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes, 
+	MP4Timestamp* pStartTime, 
+	MP4Duration* pDuration,
+	MP4Duration* pRenderingOffset, 
+	bool* pIsSyncSample)
+{
+	MP4Track* pTrack = m_pFile->FindTrack(trackId);
+	if (pTrack == NULL) {
+		return MP4_STATUS_INVALID_TRACK;
+	}
+
+	u_int16_t trackIndex = m_pFile->FindTrackIndex(trackId);
+
+	if (trackIndex >= m_numCursors) {
+		throw new MP4Error("track added after the reader was created",
+			"MP4ReaderReadSample");
+	}
+
+	return pTrack->TryReadSample(
+		&m_pCursors[trackIndex], sampleId, ppBytes, pNumBytes,
+		pStartTime, pDuration, pRenderingOffset, pIsSyncSample);
+}
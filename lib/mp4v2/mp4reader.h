@@ -0,0 +1,74 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ * 
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ * 
+ * The Original Code is MPEG4IP.
+ * 
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2001 - 2005.  All Rights Reserved.
+ * 
+ * Contributor(s): 
+ *		Dave Mackie		dmackie@cisco.com
+ */
+
+#ifndef __MP4_READER_INCLUDED__
+#define __MP4_READER_INCLUDED__
+
+// a reader reads samples of an MP4File opened for reading
+// with its own file handle and lookup state, sharing the parsed moov.
+// Different readers can be used from different threads at once, 
+// each reader by one thread at a time, except that the readers of a 
+// file opened with a Virtual_IO all read through the file's handle
+class MP4Reader {
+public:
+	MP4Reader(MP4File* pFile);
+
+	~MP4Reader();
+
+	MP4File* GetFile() {
+		return m_pFile;
+	}
+
+	void ReadSample(
+		// input parameters
+		MP4TrackId trackId,
+		MP4SampleId sampleId,
+		// output parameters
+		u_int8_t** ppBytes, 
+		u_int32_t* pNumBytes, 
+		MP4Timestamp* pStartTime = NULL, 
+		MP4Duration* pDuration = NULL,
+		MP4Duration* pRenderingOffset = NULL, 
+		bool* pIsSyncSample = NULL);
+
+	// as above, but routine failures are returned rather than thrown
+	MP4Status TryReadSample(
+		// input parameters
+		MP4TrackId trackId,
+		MP4SampleId sampleId,
+		// output parameters
+		u_int8_t** ppBytes, 
+		u_int32_t* pNumBytes, 
+		MP4Timestamp* pStartTime = NULL, 
+		MP4Duration* pDuration = NULL,
+		MP4Duration* pRenderingOffset = NULL, 
+		bool* pIsSyncSample = NULL);
+
+protected:
+	MP4File*	m_pFile;
+	FILE*		m_pFileHandle;	// NULL when mapped or via a Virtual_IO
+
+	// one per track, in the file's track order
+	MP4TrackCursor*	m_pCursors;
+	u_int32_t	m_numCursors;
+};
+
+#endif /* __MP4_READER_INCLUDED__ */
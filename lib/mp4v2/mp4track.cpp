@@ -38,9 +38,19 @@ MP4Track::MP4Track(MP4File* pFile, MP4Atom* pTrakAtom)
 	m_pFile = pFile;
 	m_pTrakAtom = pTrakAtom;
 
+	m_pEsdsAtom = NULL;
+	m_pEsdsObjectTypeProperty = NULL;
+
+	m_numPropertyRefs = 0;
+	m_nextPropertyRef = 0;
+
 	m_lastStsdIndex = 0;
 	m_lastSampleFile = NULL;
 
+	m_pSampleOffsetIndex = NULL;
+	m_sampleOffsetIndexSamples = 0;
+	m_sampleOffsetIndexShift = 0;
+
 	m_cachedReadSampleId = MP4_INVALID_SAMPLE_ID;
 	m_pCachedReadSample = NULL;
 	m_cachedReadSampleSize = 0;
@@ -49,6 +59,7 @@ MP4Track::MP4Track(MP4File* pFile, MP4Atom* pTrakAtom)
 	m_fixedSampleDuration = 0;
 	m_pChunkBuffer = NULL;
 	m_chunkBufferSize = 0;
+	m_chunkBufferMaxSize = 0;
 	m_chunkSamples = 0;
 	m_chunkDuration = 0;
 
@@ -60,7 +71,25 @@ MP4Track::MP4Track(MP4File* pFile, MP4Atom* pTrakAtom)
 	m_isAmr = AMR_UNINITIALIZED;
 	m_curMode = 0;
 	
-	m_cachedSttsSid = MP4_INVALID_SAMPLE_ID;
+	m_pSttsFirstSampleIndex = NULL;
+	m_pSttsFirstTimeIndex = NULL;
+	m_sttsIndexCount = 0;
+	m_cachedSttsIndex = 0;
+
+	m_pCttsFirstSampleIndex = NULL;
+	m_cttsIndexCount = 0;
+
+	m_sampleTablesLoaded = !pFile->GetLazyLoad();
+
+	m_pFragmentSamples = NULL;
+	m_fragmentSampleCount = 0;
+	m_fragmentSampleMax = 0;
+
+	m_fragmentWriteBytes = 0;
+	m_fragmentWriteMaxSize = 0;
+	m_fragmentWriteThisSec = 0;
+	m_fragmentWriteBytesThisSec = 0;
+	m_fragmentWriteMaxBytesPerSec = 0;
 
 	bool success = true;
 
@@ -235,8 +264,489 @@ MP4Track::MP4Track(MP4File* pFile, MP4Atom* pTrakAtom)
 
 MP4Track::~MP4Track()
 {
+	FreeSampleOffsetIndex();
+	FreeSttsIndex();
+	FreeCttsIndex();
+	MP4Free(m_pFragmentSamples);
 	MP4Free(m_pCachedReadSample);
 	MP4Free(m_pChunkBuffer);
+	// the references themselves go with the file
+	for (u_int32_t i = 0; i < m_numPropertyRefs; i++) {
+		MP4Free(m_propertyRefs[i].name);
+	}
+}
+
+void MP4Track::LoadDeferredTables()
+{
+	m_sampleTablesLoaded = true;
+
+	MP4Atom* pStblAtom = m_pTrakAtom->FindAtom("trak.mdia.minf.stbl");
+	if (pStblAtom == NULL) {
+		return;
+	}
+
+	// read any tables that were skipped over when the file was opened
+	for (u_int32_t i = 0; i < pStblAtom->GetNumberOfChildAtoms(); i++) {
+		MP4Atom* pAtom = pStblAtom->GetChildAtom(i);
+
+		for (u_int32_t j = 0; j < pAtom->GetCount(); j++) {
+			MP4Property* pProperty = pAtom->GetProperty(j);
+			if (pProperty->GetType() == TableProperty) {
+				((MP4TableProperty*)pProperty)->Load();
+			}
+		}
+	}
+}
+
+// returns NULL for samples that are in the sample tables
+MP4FragmentSample* MP4Track::GetFragmentSample(MP4SampleId sampleId)
+{
+	if (m_fragmentSampleCount == 0) {
+		return NULL;
+	}
+
+	u_int32_t numStblSamples = m_pStszSampleCountProperty->GetValue();
+	if (sampleId <= numStblSamples) {
+		return NULL;
+	}
+	if (sampleId - numStblSamples > m_fragmentSampleCount) {
+		throw new MP4Error("sample id out of range", 
+			"MP4Track::GetFragmentSample");
+	}
+	return &m_pFragmentSamples[sampleId - numStblSamples - 1];
+}
+
+// tfhd and trun flags, see ISO/IEC 14496-12 8.8
+#define TFHD_BASE_DATA_OFFSET		0x000001
+#define TFHD_SAMPLE_DESCR_INDEX		0x000002
+#define TFHD_DEFAULT_DURATION		0x000008
+#define TFHD_DEFAULT_SIZE		0x000010
+#define TFHD_DEFAULT_FLAGS		0x000020
+#define TFHD_DEFAULT_BASE_IS_MOOF	0x020000
+
+#define TRUN_DATA_OFFSET		0x000001
+#define TRUN_FIRST_SAMPLE_FLAGS		0x000004
+#define TRUN_SAMPLE_DURATION		0x000100
+#define TRUN_SAMPLE_SIZE		0x000200
+#define TRUN_SAMPLE_FLAGS		0x000400
+#define TRUN_SAMPLE_CTS_OFFSET		0x000800
+
+// sample flags bit that marks a sample as not being a sync sample
+#define SAMPLE_IS_NON_SYNC		0x00010000
+
+static u_int32_t GetFragmentValue(MP4Atom* pAtom, const char* name,
+	u_int32_t defaultValue)
+{
+	MP4Integer32Property* pProperty = NULL;
+
+	if (pAtom->FindProperty(name, (MP4Property**)&pProperty)
+	  && pProperty != NULL) {
+		return pProperty->GetValue();
+	}
+	return defaultValue;
+}
+
+u_int64_t MP4Track::AddFragment(MP4Atom* pTrafAtom, 
+	u_int64_t moofStart, u_int64_t dataOffset)
+{
+	LoadSampleTables();
+
+	MP4Atom* pTfhdAtom = pTrafAtom->FindChildAtom("tfhd");
+	if (pTfhdAtom == NULL) {
+		throw new MP4Error("traf atom has no tfhd", "MP4Track::AddFragment");
+	}
+
+	// track wide defaults come from the trex atom in moov.mvex
+	u_int32_t sampleDescrIndex = 1;
+	u_int32_t defaultDuration = 0;
+	u_int32_t defaultSize = 0;
+	u_int32_t defaultFlags = 0;
+
+	MP4Atom* pMvexAtom = m_pFile->FindAtom("moov.mvex");
+	if (pMvexAtom) {
+		for (u_int32_t i = 0; i < pMvexAtom->GetNumberOfChildAtoms(); i++) {
+			MP4Atom* pTrexAtom = pMvexAtom->GetChildAtom(i);
+			if (ATOMID(pTrexAtom->GetType()) != ATOMID("trex")
+			  || GetFragmentValue(pTrexAtom, "trex.trackId", 0) != m_trackId) {
+				continue;
+			}
+			sampleDescrIndex = GetFragmentValue(pTrexAtom, 
+				"trex.defaultSampleDesriptionIndex", sampleDescrIndex);
+			defaultDuration = GetFragmentValue(pTrexAtom, 
+				"trex.defaultSampleDuration", defaultDuration);
+			defaultSize = GetFragmentValue(pTrexAtom, 
+				"trex.defaultSampleSize", defaultSize);
+			defaultFlags = GetFragmentValue(pTrexAtom, 
+				"trex.defaultSampleFlags", defaultFlags);
+			break;
+		}
+	}
+
+	// which the tfhd can override for this fragment
+	u_int32_t tfhdFlags = pTfhdAtom->GetFlags();
+
+	if (tfhdFlags & TFHD_BASE_DATA_OFFSET) {
+		MP4Integer64Property* pBaseProperty = NULL;
+		pTfhdAtom->FindProperty("tfhd.baseDataOffset", 
+			(MP4Property**)&pBaseProperty);
+		ASSERT(pBaseProperty);
+		dataOffset = pBaseProperty->GetValue();
+	} else if (tfhdFlags & TFHD_DEFAULT_BASE_IS_MOOF) {
+		dataOffset = moofStart;
+	}
+	u_int64_t baseDataOffset = dataOffset;
+
+	if (tfhdFlags & TFHD_SAMPLE_DESCR_INDEX) {
+		sampleDescrIndex = GetFragmentValue(pTfhdAtom, 
+			"tfhd.sampleDescriptionIndex", sampleDescrIndex);
+	}
+	if (tfhdFlags & TFHD_DEFAULT_DURATION) {
+		defaultDuration = GetFragmentValue(pTfhdAtom, 
+			"tfhd.defaultSampleDuration", defaultDuration);
+	}
+	if (tfhdFlags & TFHD_DEFAULT_SIZE) {
+		defaultSize = GetFragmentValue(pTfhdAtom, 
+			"tfhd.defaultSampleSize", defaultSize);
+	}
+	if (tfhdFlags & TFHD_DEFAULT_FLAGS) {
+		defaultFlags = GetFragmentValue(pTfhdAtom, 
+			"tfhd.defaultSampleFlags", defaultFlags);
+	}
+
+	// fragment samples follow on from the end of the sample tables
+	MP4Timestamp startTime;
+	if (m_fragmentSampleCount) {
+		MP4FragmentSample* pLastSample = 
+			&m_pFragmentSamples[m_fragmentSampleCount - 1];
+		startTime = pLastSample->startTime + pLastSample->duration;
+	} else {
+		if (m_pSttsFirstSampleIndex == NULL) {
+			BuildSttsIndex();
+		}
+		startTime = m_pSttsFirstTimeIndex[m_sttsIndexCount];
+	}
+
+	for (u_int32_t i = 0; i < pTrafAtom->GetNumberOfChildAtoms(); i++) {
+		MP4Atom* pTrunAtom = pTrafAtom->GetChildAtom(i);
+		if (ATOMID(pTrunAtom->GetType()) != ATOMID("trun")) {
+			continue;
+		}
+
+		u_int32_t trunFlags = pTrunAtom->GetFlags();
+		u_int32_t numSamples = 
+			GetFragmentValue(pTrunAtom, "trun.sampleCount", 0);
+
+		// without an explicit offset, runs follow each other
+		if (trunFlags & TRUN_DATA_OFFSET) {
+			dataOffset = baseDataOffset + (int32_t)
+				GetFragmentValue(pTrunAtom, "trun.dataOffset", 0);
+		}
+
+		u_int32_t firstSampleFlags = defaultFlags;
+		if (trunFlags & TRUN_FIRST_SAMPLE_FLAGS) {
+			firstSampleFlags = GetFragmentValue(pTrunAtom, 
+				"trun.firstSampleFlags", defaultFlags);
+		}
+
+		// per sample values, only present if flagged in the trun
+		MP4Integer32Property* pDurationProperty = NULL;
+		MP4Integer32Property* pSizeProperty = NULL;
+		MP4Integer32Property* pFlagsProperty = NULL;
+		MP4Integer32Property* pOffsetProperty = NULL;
+
+		(void)pTrunAtom->FindProperty("trun.samples.sampleDuration",
+			(MP4Property**)&pDurationProperty);
+		(void)pTrunAtom->FindProperty("trun.samples.sampleSize",
+			(MP4Property**)&pSizeProperty);
+		(void)pTrunAtom->FindProperty("trun.samples.sampleFlags",
+			(MP4Property**)&pFlagsProperty);
+		(void)pTrunAtom->FindProperty(
+			"trun.samples.sampleCompositionTimeOffset",
+			(MP4Property**)&pOffsetProperty);
+
+		if (m_fragmentSampleCount + numSamples > m_fragmentSampleMax) {
+			m_fragmentSampleMax = 
+				MAX(m_fragmentSampleMax * 2, m_fragmentSampleCount + numSamples);
+			m_pFragmentSamples = (MP4FragmentSample*)MP4Realloc(
+				m_pFragmentSamples, 
+				m_fragmentSampleMax * sizeof(MP4FragmentSample));
+		}
+
+		VERBOSE_READ(m_pFile->GetVerbosity(),
+			printf("AddFragment: track %u %u samples at "U64"\n",
+				m_trackId, numSamples, dataOffset));
+
+		for (u_int32_t j = 0; j < numSamples; j++) {
+			MP4FragmentSample* pSample = 
+				&m_pFragmentSamples[m_fragmentSampleCount + j];
+
+			u_int32_t sampleFlags = (j == 0 ? firstSampleFlags : defaultFlags);
+			if (pFlagsProperty) {
+				sampleFlags = pFlagsProperty->GetValue(j);
+			}
+
+			pSample->fileOffset = dataOffset;
+			pSample->startTime = startTime;
+			pSample->size = 
+				pSizeProperty ? pSizeProperty->GetValue(j) : defaultSize;
+			pSample->duration = 
+				pDurationProperty ? pDurationProperty->GetValue(j) : defaultDuration;
+			pSample->renderingOffset = 
+				pOffsetProperty ? pOffsetProperty->GetValue(j) : 0;
+			pSample->sampleDescrIndex = sampleDescrIndex;
+			pSample->isSyncSample = !(sampleFlags & SAMPLE_IS_NON_SYNC);
+
+			dataOffset += pSample->size;
+			startTime += pSample->duration;
+		}
+		m_fragmentSampleCount += numSamples;
+	}
+
+	return dataOffset;
+}
+
+void MP4Track::AddFragmentSample(
+	const u_int8_t* pBytes, 
+	u_int32_t numBytes,
+	MP4Duration duration, 
+	MP4Duration renderingOffset, 
+	bool isSyncSample)
+{
+	// append sample bytes to the fragment data
+	u_int32_t sampleOffset = m_chunkBufferSize;
+	AppendChunkBuffer(pBytes, numBytes);
+
+	if (m_fragmentSampleCount == m_fragmentSampleMax) {
+		m_fragmentSampleMax = MAX(m_fragmentSampleMax * 2, 64);
+		m_pFragmentSamples = (MP4FragmentSample*)MP4Realloc(
+			m_pFragmentSamples, 
+			m_fragmentSampleMax * sizeof(MP4FragmentSample));
+	}
+
+	MP4FragmentSample* pSample = &m_pFragmentSamples[m_fragmentSampleCount];
+	pSample->fileOffset = sampleOffset;
+	pSample->startTime = m_chunkDuration;
+	pSample->size = numBytes;
+	pSample->duration = duration;
+	pSample->renderingOffset = renderingOffset;
+	pSample->sampleDescrIndex = 1;
+	pSample->isSyncSample = isSyncSample;
+
+	m_fragmentSampleCount++;
+	m_chunkDuration += duration;
+
+	// keep the statistics FinishWrite() would get from the sample tables
+	m_fragmentWriteBytes += numBytes;
+	if (numBytes > m_fragmentWriteMaxSize) {
+		m_fragmentWriteMaxSize = numBytes;
+	}
+	MP4Timestamp startTime = GetDuration();
+	if (startTime < m_fragmentWriteThisSec + GetTimeScale()) {
+		m_fragmentWriteBytesThisSec += numBytes;
+	} else {
+		if (m_fragmentWriteBytesThisSec > m_fragmentWriteMaxBytesPerSec) {
+			m_fragmentWriteMaxBytesPerSec = m_fragmentWriteBytesThisSec;
+		}
+		m_fragmentWriteThisSec = startTime - (startTime % GetTimeScale());
+		m_fragmentWriteBytesThisSec = numBytes;
+	}
+
+	UpdateDurations(duration);
+
+	UpdateModificationTimes();
+
+	m_writeSampleId++;
+}
+
+bool MP4Track::IsFragmentFull(bool isSyncSample)
+{
+	MP4Duration fragmentDuration = MP4ConvertTime(
+		m_pFile->GetFragmentDuration(), MP4_MSECS_TIME_SCALE, 
+		GetTimeScale());
+
+	// prefer to start fragments on sync samples,
+	// but don't let them grow without bound waiting for one
+	if (isSyncSample) {
+		return m_chunkDuration >= fragmentDuration;
+	}
+	return m_chunkDuration >= 2 * fragmentDuration;
+}
+
+void MP4Track::AddFragmentAtoms(MP4Atom* pMoofAtom, u_int64_t dataOffset)
+{
+	MP4Atom* pTrafAtom = MP4Atom::CreateAtom("traf");
+	pMoofAtom->AddChildAtom(pTrafAtom);
+	pTrafAtom->Generate();
+
+	MP4Atom* pTfhdAtom = pTrafAtom->FindChildAtom("tfhd");
+	ASSERT(pTfhdAtom);
+	pTfhdAtom->SetFlags(TFHD_DEFAULT_BASE_IS_MOOF);
+
+	MP4Integer32Property* pTrackIdProperty = NULL;
+	(void)pTfhdAtom->FindProperty("tfhd.trackId",
+		(MP4Property**)&pTrackIdProperty);
+	ASSERT(pTrackIdProperty);
+	pTrackIdProperty->SetValue(m_trackId);
+
+	u_int32_t trunFlags = TRUN_DATA_OFFSET | TRUN_SAMPLE_DURATION 
+		| TRUN_SAMPLE_SIZE | TRUN_SAMPLE_FLAGS;
+
+	u_int32_t i;
+	for (i = 0; i < m_fragmentSampleCount; i++) {
+		if (m_pFragmentSamples[i].renderingOffset) {
+			trunFlags |= TRUN_SAMPLE_CTS_OFFSET;
+			break;
+		}
+	}
+
+	MP4TrunAtom* pTrunAtom = (MP4TrunAtom*)MP4Atom::CreateAtom("trun");
+	pTrafAtom->AddChildAtom(pTrunAtom);
+	pTrunAtom->Generate();
+	pTrunAtom->SetFlags(trunFlags);
+	pTrunAtom->AddProperties(trunFlags);
+
+	MP4Integer32Property* pCountProperty = NULL;
+	MP4Integer32Property* pDataOffsetProperty = NULL;
+	MP4Integer32Property* pDurationProperty = NULL;
+	MP4Integer32Property* pSizeProperty = NULL;
+	MP4Integer32Property* pFlagsProperty = NULL;
+	MP4Integer32Property* pOffsetProperty = NULL;
+
+	(void)pTrunAtom->FindProperty("trun.sampleCount",
+		(MP4Property**)&pCountProperty);
+	(void)pTrunAtom->FindProperty("trun.dataOffset",
+		(MP4Property**)&pDataOffsetProperty);
+	(void)pTrunAtom->FindProperty("trun.samples.sampleDuration",
+		(MP4Property**)&pDurationProperty);
+	(void)pTrunAtom->FindProperty("trun.samples.sampleSize",
+		(MP4Property**)&pSizeProperty);
+	(void)pTrunAtom->FindProperty("trun.samples.sampleFlags",
+		(MP4Property**)&pFlagsProperty);
+	(void)pTrunAtom->FindProperty(
+		"trun.samples.sampleCompositionTimeOffset",
+		(MP4Property**)&pOffsetProperty);
+
+	ASSERT(pCountProperty && pDataOffsetProperty && pDurationProperty
+		&& pSizeProperty && pFlagsProperty);
+
+	// count is read-only as the table size depends on it
+	pCountProperty->IncrementValue(m_fragmentSampleCount);
+	pDataOffsetProperty->SetValue(dataOffset);
+
+	for (i = 0; i < m_fragmentSampleCount; i++) {
+		MP4FragmentSample* pSample = &m_pFragmentSamples[i];
+
+		pDurationProperty->AddValue(pSample->duration);
+		pSizeProperty->AddValue(pSample->size);
+		pFlagsProperty->AddValue(
+			pSample->isSyncSample ? 0 : SAMPLE_IS_NON_SYNC);
+		if (pOffsetProperty) {
+			pOffsetProperty->AddValue(pSample->renderingOffset);
+		}
+	}
+}
+
+void MP4Track::WriteFragmentData()
+{
+	if (m_fragmentSampleCount == 0) {
+		return;
+	}
+
+	VERBOSE_WRITE_SAMPLE(m_pFile->GetVerbosity(),
+		printf("WriteFragmentData: track %u size %u numSamples %u\n",
+			m_trackId, m_chunkBufferSize, m_fragmentSampleCount));
+
+	m_pFile->WriteBytes(m_pChunkBuffer, m_chunkBufferSize);
+
+	// the buffers are kept for the next fragment
+	m_chunkBufferSize = 0;
+	m_chunkDuration = 0;
+	m_fragmentSampleCount = 0;
+}
+
+MP4Atom* MP4Track::GetEsdsAtom()
+{
+	if (m_pEsdsAtom == NULL) {
+		// * rather than mp4a or mp4v to handle the enca and encv cases
+		m_pEsdsAtom = 
+			m_pTrakAtom->FindAtom("trak.mdia.minf.stbl.stsd.*.esds");
+		if (m_pEsdsAtom == NULL) {
+			m_pEsdsAtom = 
+				m_pTrakAtom->FindAtom("trak.mdia.minf.stbl.stsd.*.*.esds");
+		}
+	}
+	return m_pEsdsAtom;
+}
+
+MP4PropertyRef* MP4Track::GetPropertyRef(const char* name)
+{
+	u_int32_t i;
+
+	for (i = 0; i < m_numPropertyRefs; i++) {
+		if (!strcmp(m_propertyRefs[i].name, name)) {
+			break;
+		}
+	}
+	if (i < m_numPropertyRefs 
+	  && m_propertyRefs[i].pRef->pProperty != NULL) {
+		return m_propertyRefs[i].pRef;
+	}
+
+	// not asked for before, or its atom was deleted since
+	MP4Property* pProperty = NULL;
+	u_int32_t index = 0;
+	char* trakName = (char*)MP4Malloc(strlen(name) + 6);
+	sprintf(trakName, "trak.%s", name);
+	bool found = m_pTrakAtom->FindProperty(trakName, &pProperty, &index);
+	MP4Free(trakName);
+	if (!found) {
+		return NULL;
+	}
+
+	if (i < m_numPropertyRefs) {
+		m_propertyRefs[i].pRef->pProperty = pProperty;
+		m_propertyRefs[i].pRef->index = index;
+		return m_propertyRefs[i].pRef;
+	}
+
+	if (m_numPropertyRefs < MP4_TRACK_PROPERTY_REFS) {
+		i = m_numPropertyRefs++;
+	} else {
+		i = m_nextPropertyRef;
+		m_nextPropertyRef = (i + 1) % MP4_TRACK_PROPERTY_REFS;
+		m_pFile->FreePropertyRef(m_propertyRefs[i].pRef);
+		MP4Free(m_propertyRefs[i].name);
+	}
+	m_propertyRefs[i].name = MP4Stralloc(name);
+	m_propertyRefs[i].pRef = m_pFile->AddPropertyRef(pProperty, index);
+	return m_propertyRefs[i].pRef;
+}
+
+void MP4Track::FreePropertyRefs()
+{
+	for (u_int32_t i = 0; i < m_numPropertyRefs; i++) {
+		m_pFile->FreePropertyRef(m_propertyRefs[i].pRef);
+		MP4Free(m_propertyRefs[i].name);
+	}
+	m_numPropertyRefs = 0;
+	m_nextPropertyRef = 0;
+}
+
+u_int8_t MP4Track::GetEsdsObjectTypeId()
+{
+	if (m_pEsdsObjectTypeProperty == NULL) {
+		MP4Atom* pEsdsAtom = GetEsdsAtom();
+
+		if (pEsdsAtom == NULL || !pEsdsAtom->FindProperty(
+		  "esds.decConfigDescr.objectTypeId",
+		  (MP4Property**)&m_pEsdsObjectTypeProperty)) {
+			m_pEsdsObjectTypeProperty = NULL;
+			throw new MP4Error("no such property - %s", 
+				"MP4Track::GetEsdsObjectTypeId",
+				"esds.decConfigDescr.objectTypeId");
+		}
+	}
+	return m_pEsdsObjectTypeProperty->GetValue();
 }
 
 const char* MP4Track::GetType()
@@ -259,30 +769,47 @@ void MP4Track::ReadSample(
 	MP4Duration* pRenderingOffset, 
 	bool* pIsSyncSample)
 {
-	if (sampleId == MP4_INVALID_SAMPLE_ID) {
-		throw new MP4Error("sample id can't be zero", 
-			"MP4Track::ReadSample");
+	MP4Status status = TryReadSample(sampleId, ppBytes, pNumBytes,
+		pStartTime, pDuration, pRenderingOffset, pIsSyncSample);
+
+	if (status != MP4_STATUS_OK) {
+		throw new MP4Error(MP4StatusString(status), "MP4Track::ReadSample");
+	}
+}
+
+MP4Status MP4Track::TryReadSample(
+	MP4SampleId sampleId,
+	u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes, 
+	MP4Timestamp* pStartTime, 
+	MP4Duration* pDuration,
+	MP4Duration* pRenderingOffset, 
+	bool* pIsSyncSample)
+{
+	LoadSampleTables();
+
+	if (sampleId == MP4_INVALID_SAMPLE_ID 
+	  || sampleId > GetNumberOfSamples()) {
+		return MP4_STATUS_INVALID_SAMPLE;
 	}
 
 	// handle unusual case of wanting to read a sample
 	// that is still sitting in the write chunk buffer
-	if (m_pChunkBuffer && sampleId >= m_writeSampleId - m_chunkSamples) {
+	if (m_chunkSamples && sampleId >= m_writeSampleId - m_chunkSamples) {
 		WriteChunkBuffer();
 	}
 
 	FILE* pFile = GetSampleFile(sampleId);
 
 	if (pFile == (FILE*)-1) {
-		throw new MP4Error("sample is located in an inaccessible file",
-			"MP4Track::ReadSample");
+		return MP4_STATUS_INACCESSIBLE_FILE;
 	}
 
 	u_int64_t fileOffset = GetSampleFileOffset(sampleId);
 
 	u_int32_t sampleSize = GetSampleSize(sampleId);
 	if (*ppBytes != NULL && *pNumBytes < sampleSize) {
-		throw new MP4Error("sample buffer is too small",
-			 "MP4Track::ReadSample");
+		return MP4_STATUS_BUFFER_TOO_SMALL;
 	}
 	*pNumBytes = sampleSize;
 
@@ -296,11 +823,30 @@ void MP4Track::ReadSample(
 		bufferMalloc = true;
 	}
 
-	u_int64_t oldPos = m_pFile->GetPosition(pFile); // only used in mode == 'w'
-	try { 
-		m_pFile->SetPosition(fileOffset, pFile);
-		m_pFile->ReadBytes(*ppBytes, *pNumBytes, pFile);
+	u_int64_t oldPos = 0; // only used in mode == 'w'
+	if (m_pFile->GetMode() == 'w') {
+		oldPos = m_pFile->GetPosition(pFile);
+	}
+
+	MP4Status status = 
+		m_pFile->TryReadBytes(fileOffset, *ppBytes, *pNumBytes, pFile);
 
+	if (m_pFile->GetMode() == 'w') {
+		m_pFile->SetPosition(oldPos, pFile);
+	}
+
+	if (status != MP4_STATUS_OK) {
+		if (bufferMalloc) {
+			// let's not leak memory
+			MP4Free(*ppBytes);
+			*ppBytes = NULL;
+		}
+		return status;
+	}
+
+	// the sample id is known to be valid, so these only throw 
+	// for a damaged file
+	try {
 		if (pStartTime || pDuration) {
 			GetSampleTimes(sampleId, pStartTime, pDuration);
 
@@ -327,32 +873,17 @@ void MP4Track::ReadSample(
 
 	catch (MP4Error* e) {
 		if (bufferMalloc) {
-			// let's not leak memory
 			MP4Free(*ppBytes);
 			*ppBytes = NULL;
 		}
-		if (m_pFile->GetMode() == 'w') {
-			m_pFile->SetPosition(oldPos, pFile);
-		}
 		throw e;
 	}
 
-	if (m_pFile->GetMode() == 'w') {
-		m_pFile->SetPosition(oldPos, pFile);
-	}
+	return MP4_STATUS_OK;
 }
 
-void MP4Track::ReadSampleFragment(
-	MP4SampleId sampleId,
-	u_int32_t sampleOffset,
-	u_int16_t sampleLength,
-	u_int8_t* pDest)
+void MP4Track::UpdateCachedReadSample(MP4SampleId sampleId)
 {
-	if (sampleId == MP4_INVALID_SAMPLE_ID) {
-		throw new MP4Error("invalid sample id", 
-			"MP4Track::ReadSampleFragment");
-	}
-
 	if (sampleId != m_cachedReadSampleId) {
 		MP4Free(m_pCachedReadSample);
 		m_pCachedReadSample = NULL;
@@ -366,6 +897,73 @@ void MP4Track::ReadSampleFragment(
 
 		m_cachedReadSampleId = sampleId;
 	}
+}
+
+void MP4Track::ReadSampleView(
+	MP4SampleId sampleId,
+	const u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes, 
+	MP4Timestamp* pStartTime, 
+	MP4Duration* pDuration,
+	MP4Duration* pRenderingOffset, 
+	bool* pIsSyncSample)
+{
+	LoadSampleTables();
+
+	if (sampleId == MP4_INVALID_SAMPLE_ID) {
+		throw new MP4Error("sample id can't be zero", 
+			"MP4Track::ReadSampleView");
+	}
+
+	const u_int8_t* pBytes = NULL;
+	u_int32_t sampleSize = 0;
+
+	// self-contained samples of a mapped file can be used in place
+	if (m_chunkSamples == 0 && GetSampleFile(sampleId) == NULL) {
+		sampleSize = GetSampleSize(sampleId);
+		pBytes = m_pFile->GetMappedBytes(
+			GetSampleFileOffset(sampleId), sampleSize);
+	}
+
+	// otherwise use the same cached copy as ReadSampleFragment
+	if (pBytes == NULL) {
+		UpdateCachedReadSample(sampleId);
+		pBytes = m_pCachedReadSample;
+		sampleSize = m_cachedReadSampleSize;
+	}
+
+	VERBOSE_READ_SAMPLE(m_pFile->GetVerbosity(),
+		printf("ReadSampleView: track %u id %u size %u (0x%x)\n",
+			m_trackId, sampleId, sampleSize, sampleSize));
+
+	if (pStartTime || pDuration) {
+		GetSampleTimes(sampleId, pStartTime, pDuration);
+	}
+	if (pRenderingOffset) {
+		*pRenderingOffset = GetSampleRenderingOffset(sampleId);
+	}
+	if (pIsSyncSample) {
+		*pIsSyncSample = IsSyncSample(sampleId);
+	}
+
+	*ppBytes = pBytes;
+	*pNumBytes = sampleSize;
+}
+
+void MP4Track::ReadSampleFragment(
+	MP4SampleId sampleId,
+	u_int32_t sampleOffset,
+	u_int16_t sampleLength,
+	u_int8_t* pDest)
+{
+	LoadSampleTables();
+
+	if (sampleId == MP4_INVALID_SAMPLE_ID) {
+		throw new MP4Error("invalid sample id", 
+			"MP4Track::ReadSampleFragment");
+	}
+
+	UpdateCachedReadSample(sampleId);
 
 	if (sampleOffset + sampleLength > m_cachedReadSampleSize) {
 		throw new MP4Error("offset and/or length are too large", 
@@ -375,6 +973,222 @@ void MP4Track::ReadSampleFragment(
 	memcpy(pDest, &m_pCachedReadSample[sampleOffset], sampleLength);
 }
 
+const u_int8_t* MP4Track::GetSampleFragmentView(
+	MP4SampleId sampleId,
+	u_int32_t sampleOffset,
+	u_int16_t sampleLength,
+	bool replaceCached)
+{
+	LoadSampleTables();
+
+	if (sampleId == MP4_INVALID_SAMPLE_ID) {
+		throw new MP4Error("invalid sample id", 
+			"MP4Track::GetSampleFragmentView");
+	}
+
+	if (sampleId != m_cachedReadSampleId) {
+		// self-contained samples of a mapped file can be used in place
+		if (m_pFile->IsMapped() && m_chunkSamples == 0 
+		  && GetSampleFile(sampleId) == NULL) {
+			if (sampleOffset + sampleLength > GetSampleSize(sampleId)) {
+				throw new MP4Error("offset and/or length are too large", 
+					"MP4Track::GetSampleFragmentView");
+			}
+			const u_int8_t* pBytes = m_pFile->GetMappedBytes(
+				GetSampleFileOffset(sampleId) + sampleOffset, sampleLength);
+			if (pBytes) {
+				return pBytes;
+			}
+		}
+		if (!replaceCached) {
+			return NULL;
+		}
+		UpdateCachedReadSample(sampleId);
+	}
+
+	if (sampleOffset + sampleLength > m_cachedReadSampleSize) {
+		throw new MP4Error("offset and/or length are too large", 
+			"MP4Track::GetSampleFragmentView");
+	}
+
+	return &m_pCachedReadSample[sampleOffset];
+}
+
+void MP4Track::ReadSampleFragmentUncached(
+	MP4SampleId sampleId,
+	u_int32_t sampleOffset,
+	u_int16_t sampleLength,
+	u_int8_t* pDest)
+{
+	LoadSampleTables();
+
+	if (sampleId == MP4_INVALID_SAMPLE_ID) {
+		throw new MP4Error("invalid sample id", 
+			"MP4Track::ReadSampleFragment");
+	}
+
+	if (m_chunkSamples && sampleId >= m_writeSampleId - m_chunkSamples) {
+		WriteChunkBuffer();
+	}
+
+	FILE* pFile = GetSampleFile(sampleId);
+
+	if (pFile == (FILE*)-1) {
+		throw new MP4Error("sample is located in an inaccessible file",
+			"MP4Track::ReadSampleFragment");
+	}
+	if (sampleOffset + sampleLength > GetSampleSize(sampleId)) {
+		throw new MP4Error("offset and/or length are too large", 
+			"MP4Track::ReadSampleFragment");
+	}
+
+	u_int64_t oldPos = 0; // only used in mode == 'w'
+	if (m_pFile->GetMode() == 'w') {
+		oldPos = m_pFile->GetPosition(pFile);
+	}
+
+	MP4Status status = m_pFile->TryReadBytes(
+		GetSampleFileOffset(sampleId) + sampleOffset, 
+		pDest, sampleLength, pFile);
+
+	if (m_pFile->GetMode() == 'w') {
+		m_pFile->SetPosition(oldPos, pFile);
+	}
+
+	if (status != MP4_STATUS_OK) {
+		throw new MP4Error(MP4StatusString(status), 
+			"MP4Track::ReadSampleFragment");
+	}
+}
+
+void MP4Track::PrepareForReaders()
+{
+	LoadSampleTables();
+
+	if (m_pSttsFirstSampleIndex == NULL) {
+		BuildSttsIndex();
+	}
+	if (m_pCttsCountProperty && m_pCttsFirstSampleIndex == NULL) {
+		BuildCttsIndex();
+	}
+
+	// fixed size samples don't use the sample offset index
+	if (m_pStszFixedSampleSizeProperty != NULL
+	  && m_pStszFixedSampleSizeProperty->GetValue() != 0) {
+		return;
+	}
+	if (m_pSampleOffsetIndex == NULL) {
+		BuildSampleOffsetIndex();
+	}
+}
+
+void MP4Track::ReadSample(
+	MP4TrackCursor* pCursor,
+	MP4SampleId sampleId,
+	u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes, 
+	MP4Timestamp* pStartTime, 
+	MP4Duration* pDuration,
+	MP4Duration* pRenderingOffset, 
+	bool* pIsSyncSample)
+{
+	MP4Status status = TryReadSample(pCursor, sampleId, ppBytes, pNumBytes,
+		pStartTime, pDuration, pRenderingOffset, pIsSyncSample);
+
+	if (status != MP4_STATUS_OK) {
+		throw new MP4Error(MP4StatusString(status), "MP4Track::ReadSample");
+	}
+}
+
+MP4Status MP4Track::TryReadSample(
+	MP4TrackCursor* pCursor,
+	MP4SampleId sampleId,
+	u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes, 
+	MP4Timestamp* pStartTime, 
+	MP4Duration* pDuration,
+	MP4Duration* pRenderingOffset, 
+	bool* pIsSyncSample)
+{
+	// an out of range sample id must not get as far as 
+	// the lazily built indexes
+	if (sampleId == MP4_INVALID_SAMPLE_ID 
+	  || sampleId > GetNumberOfSamples()) {
+		return MP4_STATUS_INVALID_SAMPLE;
+	}
+
+	FILE* pFile = GetSampleFile(sampleId, pCursor);
+
+	if (pFile == (FILE*)-1) {
+		return MP4_STATUS_INACCESSIBLE_FILE;
+	}
+
+	u_int64_t fileOffset = GetSampleFileOffset(sampleId);
+
+	u_int32_t sampleSize = GetSampleSize(sampleId);
+	if (*ppBytes != NULL && *pNumBytes < sampleSize) {
+		return MP4_STATUS_BUFFER_TOO_SMALL;
+	}
+	*pNumBytes = sampleSize;
+
+	VERBOSE_READ_SAMPLE(m_pFile->GetVerbosity(),
+		printf("ReadSample: track %u id %u offset 0x"X64" size %u (0x%x)\n",
+			m_trackId, sampleId, fileOffset, *pNumBytes, *pNumBytes));
+
+	bool bufferMalloc = false;
+	if (*ppBytes == NULL) {
+		*ppBytes = (u_int8_t*)MP4Malloc(*pNumBytes);
+		bufferMalloc = true;
+	}
+
+	// self-contained samples come from the mapping if there is one,
+	// otherwise from the reader's own handle, or the file's Virtual_IO
+	// if it can't have one
+	const u_int8_t* pMapped = NULL;
+	if (pFile == NULL) {
+		pMapped = m_pFile->GetMappedBytes(fileOffset, sampleSize);
+		pFile = pCursor->pFile;
+	}
+
+	MP4Status status = MP4_STATUS_OK;
+	if (pMapped) {
+		memcpy(*ppBytes, pMapped, sampleSize);
+	} else {
+		status = m_pFile->TryReadBytes(
+			fileOffset, *ppBytes, *pNumBytes, pFile);
+	}
+
+	if (status != MP4_STATUS_OK) {
+		if (bufferMalloc) {
+			MP4Free(*ppBytes);
+			*ppBytes = NULL;
+		}
+		return status;
+	}
+
+	try { 
+		if (pStartTime || pDuration) {
+			GetSampleTimes(sampleId, pStartTime, pDuration, pCursor);
+		}
+		if (pRenderingOffset) {
+			*pRenderingOffset = GetSampleRenderingOffset(sampleId);
+		}
+		if (pIsSyncSample) {
+			*pIsSyncSample = IsSyncSample(sampleId);
+		}
+	}
+
+	catch (MP4Error* e) {
+		if (bufferMalloc) {
+			MP4Free(*ppBytes);
+			*ppBytes = NULL;
+		}
+		throw e;
+	}
+
+	return MP4_STATUS_OK;
+}
+
 void MP4Track::WriteSample(
 	const u_int8_t* pBytes, 
 	u_int32_t numBytes,
@@ -414,21 +1228,28 @@ void MP4Track::WriteSample(
 	VERBOSE_WRITE_SAMPLE(m_pFile->GetVerbosity(),
 		printf("duration "U64"\n", duration));
 
+	if (m_pFile->GetFragmentDuration()) {
+		AddFragmentSample(pBytes, numBytes, duration, 
+			renderingOffset, isSyncSample);
+		return;
+	}
+
 	if ((m_isAmr == AMR_TRUE) &&
 		(m_curMode != curMode)) {
 		WriteChunkBuffer();
 		m_curMode = curMode;
 	}
 
-	// append sample bytes to chunk buffer
-	m_pChunkBuffer = (u_int8_t*)MP4Realloc(m_pChunkBuffer, 
-		m_chunkBufferSize + numBytes);
-	if (m_pChunkBuffer == NULL) return;
-	memcpy(&m_pChunkBuffer[m_chunkBufferSize], pBytes, numBytes);
-	m_chunkBufferSize += numBytes;
 	m_chunkSamples++;
 	m_chunkDuration += duration;
 
+	// a sample that fills the chunk is written from the caller's buffer
+	// right after the buffered ones, instead of being copied first
+	bool chunkFull = IsChunkFull(m_writeSampleId);
+	if (!chunkFull) {
+		AppendChunkBuffer(pBytes, numBytes);
+	}
+
 	UpdateSampleSizes(m_writeSampleId, numBytes);
 
 	UpdateSampleTimes(duration);
@@ -437,8 +1258,8 @@ void MP4Track::WriteSample(
 
 	UpdateSyncSamples(m_writeSampleId, isSyncSample);
 
-	if (IsChunkFull(m_writeSampleId)) {
-		WriteChunkBuffer();
+	if (chunkFull) {
+		WriteChunkBuffer(pBytes, numBytes);
 		m_curMode = curMode;
 	}
 
@@ -449,21 +1270,40 @@ void MP4Track::WriteSample(
 	m_writeSampleId++;
 }
 
-void MP4Track::WriteChunkBuffer()
+void MP4Track::AppendChunkBuffer(const u_int8_t* pBytes, u_int32_t numBytes)
+{
+	if (m_chunkBufferSize + numBytes > m_chunkBufferMaxSize) {
+		// grow geometrically, the buffer is reused for every chunk
+		// so it soon settles at the largest chunk size
+		u_int32_t newSize = MAX(2 * m_chunkBufferMaxSize, 4096);
+		newSize = MAX(newSize, m_chunkBufferSize + numBytes);
+
+		m_pChunkBuffer = (u_int8_t*)MP4Realloc(m_pChunkBuffer, newSize);
+		m_chunkBufferMaxSize = newSize;
+	}
+	memcpy(&m_pChunkBuffer[m_chunkBufferSize], pBytes, numBytes);
+	m_chunkBufferSize += numBytes;
+}
+
+void MP4Track::WriteChunkBuffer(const u_int8_t* pLastSample, 
+	u_int32_t lastSampleSize)
 {
-	if (m_chunkBufferSize == 0) {
+	u_int32_t chunkSize = m_chunkBufferSize + lastSampleSize;
+
+	if (chunkSize == 0) {
 		return;
 	}
 
 	u_int64_t chunkOffset = m_pFile->GetPosition();
 
-	// write chunk buffer
+	// write chunk buffer, followed by the sample that completed it
 	m_pFile->WriteBytes(m_pChunkBuffer, m_chunkBufferSize);
+	m_pFile->WriteBytes((u_int8_t*)pLastSample, lastSampleSize);
 
 	VERBOSE_WRITE_SAMPLE(m_pFile->GetVerbosity(),
 		printf("WriteChunk: track %u offset 0x"X64" size %u (0x%x) numSamples %u\n",
-			m_trackId, chunkOffset, m_chunkBufferSize, 
-			m_chunkBufferSize, m_chunkSamples));
+			m_trackId, chunkOffset, chunkSize, 
+			chunkSize, m_chunkSamples));
 
 	UpdateSampleToChunk(m_writeSampleId, 
 		m_pChunkCountProperty->GetValue() + 1, 
@@ -471,9 +1311,10 @@ void MP4Track::WriteChunkBuffer()
 
 	UpdateChunkOffsets(chunkOffset);
 
-	// clean up chunk buffer
-	MP4Free(m_pChunkBuffer);
-	m_pChunkBuffer = NULL;
+	// sample offset index no longer covers all the chunks
+	FreeSampleOffsetIndex();
+
+	// keep the chunk buffer for the next chunk
 	m_chunkBufferSize = 0;
 	m_chunkSamples = 0;
 	m_chunkDuration = 0;
@@ -484,6 +1325,10 @@ void MP4Track::FinishWrite()
 	// write out any remaining samples in chunk buffer
 	WriteChunkBuffer();
 
+	MP4Free(m_pChunkBuffer);
+	m_pChunkBuffer = NULL;
+	m_chunkBufferMaxSize = 0;
+
 	if (m_pStszFixedSampleSizeProperty == NULL &&
 	    m_stsz_sample_bits == 4) {
 	  if (m_have_stz2_4bit_sample) {
@@ -493,26 +1338,51 @@ void MP4Track::FinishWrite()
 	}
 
 	// record buffer size and bitrates
+	MP4Atom* pEsdsAtom = GetEsdsAtom();
+	if (pEsdsAtom == NULL) {
+		return;
+	}
+
+	u_int32_t maxSampleSize, maxBitrate, avgBitrate;
+
+	if (m_pFile->GetFragmentDuration()) {
+		// the samples went out in fragments, use the totals kept
+		// as they were written
+		maxSampleSize = m_fragmentWriteMaxSize;
+		maxBitrate = MAX(m_fragmentWriteMaxBytesPerSec, 
+			m_fragmentWriteBytesThisSec) * 8;
+		avgBitrate = 0;
+		if (GetDuration() != 0) {
+			avgBitrate = (u_int32_t)ceil(
+				UINT64_TO_DOUBLE(m_fragmentWriteBytes) * 8.0 
+				* GetTimeScale() / UINT64_TO_DOUBLE(GetDuration()));
+		}
+	} else {
+		maxSampleSize = GetMaxSampleSize();
+		maxBitrate = GetMaxBitrate();
+		avgBitrate = GetAvgBitrate();
+	}
+
 	MP4BitfieldProperty* pBufferSizeProperty;
 
-	if (m_pTrakAtom->FindProperty(
-	  "trak.mdia.minf.stbl.stsd.*.esds.decConfigDescr.bufferSizeDB",
+	if (pEsdsAtom->FindProperty(
+	  "esds.decConfigDescr.bufferSizeDB",
 	  (MP4Property**)&pBufferSizeProperty)) {
-		pBufferSizeProperty->SetValue(GetMaxSampleSize());
+		pBufferSizeProperty->SetValue(maxSampleSize);
 	}
 
 	MP4Integer32Property* pBitrateProperty;
 
-	if (m_pTrakAtom->FindProperty(
-	  "trak.mdia.minf.stbl.stsd.*.esds.decConfigDescr.maxBitrate",
+	if (pEsdsAtom->FindProperty(
+	  "esds.decConfigDescr.maxBitrate",
 	  (MP4Property**)&pBitrateProperty)) {
-		pBitrateProperty->SetValue(GetMaxBitrate());
+		pBitrateProperty->SetValue(maxBitrate);
 	}
 
-	if (m_pTrakAtom->FindProperty(
-	  "trak.mdia.minf.stbl.stsd.*.esds.decConfigDescr.avgBitrate",
+	if (pEsdsAtom->FindProperty(
+	  "esds.decConfigDescr.avgBitrate",
 	  (MP4Property**)&pBitrateProperty)) {
-		pBitrateProperty->SetValue(GetAvgBitrate());
+		pBitrateProperty->SetValue(avgBitrate);
 	}
 }
 
@@ -528,11 +1398,18 @@ bool MP4Track::IsChunkFull(MP4SampleId sampleId)
 
 u_int32_t MP4Track::GetNumberOfSamples()
 {
-	return m_pStszSampleCountProperty->GetValue();
+	return m_pStszSampleCountProperty->GetValue() + m_fragmentSampleCount;
 }
 
 u_int32_t MP4Track::GetSampleSize(MP4SampleId sampleId)
 {
+	LoadSampleTables();
+
+	MP4FragmentSample* pFragmentSample = GetFragmentSample(sampleId);
+	if (pFragmentSample) {
+		return pFragmentSample->size;
+	}
+
   if (m_pStszFixedSampleSizeProperty != NULL) {
 	u_int32_t fixedSampleSize = 
 		m_pStszFixedSampleSizeProperty->GetValue(); 
@@ -553,31 +1430,62 @@ u_int32_t MP4Track::GetSampleSize(MP4SampleId sampleId)
     m_pStszSampleSizeProperty->GetValue(sampleId - 1);
 }
 
+MP4Status MP4Track::TryGetSampleSize(
+	MP4SampleId sampleId, u_int32_t* pSize)
+{
+	LoadSampleTables();
+
+	if (sampleId == MP4_INVALID_SAMPLE_ID 
+	  || sampleId > GetNumberOfSamples()) {
+		return MP4_STATUS_INVALID_SAMPLE;
+	}
+	*pSize = GetSampleSize(sampleId);
+	return MP4_STATUS_OK;
+}
+
 u_int32_t MP4Track::GetMaxSampleSize()
 {
+	LoadSampleTables();
+
+	u_int32_t maxSampleSize = 0;
+	u_int32_t fixedSampleSize = 0;
+
   if (m_pStszFixedSampleSizeProperty != NULL) {
-	u_int32_t fixedSampleSize = 
-		m_pStszFixedSampleSizeProperty->GetValue(); 
+	fixedSampleSize = m_pStszFixedSampleSizeProperty->GetValue(); 
+  }
 
 	if (fixedSampleSize != 0) {
-		return fixedSampleSize * m_bytesPerSample;
+		maxSampleSize = fixedSampleSize * m_bytesPerSample;
+	} else {
+		u_int32_t numSamples = m_pStszSampleSizeProperty->GetCount();
+		for (MP4SampleId sid = 1; sid <= numSamples; sid++) {
+			u_int32_t sampleSize =
+				m_pStszSampleSizeProperty->GetValue(sid - 1);
+			if (sampleSize > maxSampleSize) {
+				maxSampleSize = sampleSize;
+			}
+		}
+		maxSampleSize *= m_bytesPerSample;
 	}
-  }
 
-	u_int32_t maxSampleSize = 0;
-	u_int32_t numSamples = m_pStszSampleSizeProperty->GetCount();
-	for (MP4SampleId sid = 1; sid <= numSamples; sid++) {
-		u_int32_t sampleSize =
-			m_pStszSampleSizeProperty->GetValue(sid - 1);
-		if (sampleSize > maxSampleSize) {
-			maxSampleSize = sampleSize;
+	for (u_int32_t i = 0; i < m_fragmentSampleCount; i++) {
+		if (m_pFragmentSamples[i].size > maxSampleSize) {
+			maxSampleSize = m_pFragmentSamples[i].size;
 		}
 	}
-	return maxSampleSize * m_bytesPerSample;
+	return maxSampleSize;
 }
 
 u_int64_t MP4Track::GetTotalOfSampleSizes()
 {
+	LoadSampleTables();
+
+	// samples from movie fragments carry their own sizes
+	u_int64_t fragmentSampleSizes = 0;
+	for (u_int32_t i = 0; i < m_fragmentSampleCount; i++) {
+		fragmentSampleSizes += m_pFragmentSamples[i].size;
+	}
+
   uint64_t retval;
   if (m_pStszFixedSampleSizeProperty != NULL) {
 	u_int32_t fixedSampleSize = 
@@ -587,8 +1495,8 @@ u_int64_t MP4Track::GetTotalOfSampleSizes()
 	if (fixedSampleSize != 0) {
 	  retval = m_bytesPerSample;
 	  retval *= fixedSampleSize;
-	  retval *= GetNumberOfSamples();
-	  return retval;
+	  retval *= m_pStszSampleCountProperty->GetValue();
+	  return retval + fragmentSampleSizes;
 	}
   }
 
@@ -600,7 +1508,7 @@ u_int64_t MP4Track::GetTotalOfSampleSizes()
 			m_pStszSampleSizeProperty->GetValue(sid - 1);
 		totalSampleSizes += sampleSize;
 	}
-	return totalSampleSizes * m_bytesPerSample;
+	return totalSampleSizes * m_bytesPerSample + fragmentSampleSizes;
 }
 
 void MP4Track::SampleSizePropertyAddValue (uint32_t size)
@@ -771,39 +1679,56 @@ u_int32_t MP4Track::GetMaxBitrate()
 
 u_int32_t MP4Track::GetSampleStscIndex(MP4SampleId sampleId)
 {
-	u_int32_t stscIndex;
 	u_int32_t numStscs = m_pStscCountProperty->GetValue();
 
 	if (numStscs == 0) {
 		throw new MP4Error("No data chunks exist", "GetSampleStscIndex");
 	}
 
-	for (stscIndex = 0; stscIndex < numStscs; stscIndex++) {
+	// binary search for the last entry with firstSample <= sampleId
+	u_int32_t stscLIndex = 0;
+	u_int32_t stscRIndex = numStscs;
+
+	while (stscRIndex - stscLIndex > 1) {
+		u_int32_t stscIndex = (stscLIndex + stscRIndex) >> 1;
+
 		if (sampleId < m_pStscFirstSampleProperty->GetValue(stscIndex)) {
-			ASSERT(stscIndex != 0);
-			stscIndex -= 1;
-			break;
+			stscRIndex = stscIndex;
+		} else {
+			stscLIndex = stscIndex;
 		}
 	}
-	if (stscIndex == numStscs) {
-		ASSERT(stscIndex != 0);
-		stscIndex -= 1;
-	}
 
-	return stscIndex;
+	return stscLIndex;
 }
 
-FILE* MP4Track::GetSampleFile(MP4SampleId sampleId)
+FILE* MP4Track::GetSampleFile(MP4SampleId sampleId, 
+	MP4TrackCursor* pCursor)
 {
-	u_int32_t stscIndex =
-		GetSampleStscIndex(sampleId);
+	u_int32_t stsdIndex;
+
+	// reads via an MP4Reader keep their own answer
+	u_int32_t* pLastStsdIndex = &m_lastStsdIndex;
+	FILE** ppLastSampleFile = &m_lastSampleFile;
+	if (pCursor) {
+		pLastStsdIndex = &pCursor->lastStsdIndex;
+		ppLastSampleFile = &pCursor->lastSampleFile;
+	}
 
-	u_int32_t stsdIndex = 
-		m_pStscSampleDescrIndexProperty->GetValue(stscIndex);
+	MP4FragmentSample* pFragmentSample = GetFragmentSample(sampleId);
+	if (pFragmentSample) {
+		stsdIndex = pFragmentSample->sampleDescrIndex;
+	} else {
+		u_int32_t stscIndex =
+			GetSampleStscIndex(sampleId);
+
+		stsdIndex = 
+			m_pStscSampleDescrIndexProperty->GetValue(stscIndex);
+	}
 
 	// check if the answer will be the same as last time
-	if (m_lastStsdIndex && stsdIndex == m_lastStsdIndex) {
-		return m_lastSampleFile;
+	if (*pLastStsdIndex && stsdIndex == *pLastStsdIndex) {
+		return *ppLastSampleFile;
 	}
 
 	MP4Atom* pStsdAtom = 
@@ -868,19 +1793,24 @@ FILE* MP4Track::GetSampleFile(MP4SampleId sampleId)
 		} 
 	}
 
-	if (m_lastSampleFile) {
-		fclose(m_lastSampleFile);
+	if (*ppLastSampleFile && *ppLastSampleFile != (FILE*)-1) {
+		fclose(*ppLastSampleFile);
 	}
 
 	// cache the answer
-	m_lastStsdIndex = stsdIndex;
-	m_lastSampleFile = pFile;
+	*pLastStsdIndex = stsdIndex;
+	*ppLastSampleFile = pFile;
 
 	return pFile;
 }
 
 u_int64_t MP4Track::GetSampleFileOffset(MP4SampleId sampleId)
 {
+	MP4FragmentSample* pFragmentSample = GetFragmentSample(sampleId);
+	if (pFragmentSample) {
+		return pFragmentSample->fileOffset;
+	}
+
 	u_int32_t stscIndex =
 		GetSampleStscIndex(sampleId);
 
@@ -907,8 +1837,36 @@ u_int64_t MP4Track::GetSampleFileOffset(MP4SampleId sampleId)
 	MP4SampleId firstSampleInChunk = 
 		sampleId - ((sampleId - firstSample) % samplesPerChunk);
 
+	// fixed size samples don't need any summing
+	if (m_pStszFixedSampleSizeProperty != NULL) {
+		u_int32_t fixedSampleSize =
+			m_pStszFixedSampleSizeProperty->GetValue();
+
+		if (fixedSampleSize != 0) {
+			return chunkOffset + ((u_int64_t)(sampleId - firstSampleInChunk)
+				* fixedSampleSize * m_bytesPerSample);
+		}
+	}
+
+	if (m_pSampleOffsetIndex == NULL) {
+		BuildSampleOffsetIndex();
+	}
+
 	// need cumulative samples sizes from firstSample to sampleId - 1
+	// start from the closest indexed sample in the same chunk, if any
 	u_int32_t sampleOffset = 0;
+
+	if (sampleId <= m_sampleOffsetIndexSamples) {
+		u_int32_t indexEntry = (sampleId - 1) >> m_sampleOffsetIndexShift;
+		MP4SampleId indexSampleId = 
+			(indexEntry << m_sampleOffsetIndexShift) + 1;
+
+		if (indexSampleId >= firstSampleInChunk) {
+			sampleOffset = m_pSampleOffsetIndex[indexEntry];
+			firstSampleInChunk = indexSampleId;
+		}
+	}
+
 	for (MP4SampleId i = firstSampleInChunk; i < sampleId; i++) {
 		sampleOffset += GetSampleSize(i);
 	}
@@ -916,6 +1874,89 @@ u_int64_t MP4Track::GetSampleFileOffset(MP4SampleId sampleId)
 	return chunkOffset + sampleOffset;
 }
 
+void MP4Track::BuildSampleOffsetIndex()
+{
+	FreeSampleOffsetIndex();
+
+	u_int32_t numStscs = m_pStscCountProperty->GetValue();
+	u_int32_t numChunks = m_pChunkCountProperty->GetValue();
+	u_int32_t numSamples = GetNumberOfSamples();
+
+	if (numStscs == 0 || numChunks == 0 || numSamples == 0) {
+		return;
+	}
+
+	// only samples that have been written out to chunks can be indexed
+	u_int32_t lastStsc = numStscs - 1;
+	u_int64_t chunkedSamples = 
+		m_pStscFirstSampleProperty->GetValue(lastStsc) - 1
+		+ (u_int64_t)(numChunks + 1
+			- m_pStscFirstChunkProperty->GetValue(lastStsc))
+		  * m_pStscSamplesPerChunkProperty->GetValue(lastStsc);
+	if (chunkedSamples < numSamples) {
+		numSamples = (u_int32_t)chunkedSamples;
+	}
+
+	// when a limit is set, keep only every Nth sample offset
+	// N being the smallest power of two that fits in the limit
+	u_int32_t maxEntries = m_pFile->GetSampleIndexLimit();
+	u_int8_t shift = 0;
+	if (maxEntries != 0) {
+		while (shift < 31 
+		  && ((numSamples - 1) >> shift) + 1 > maxEntries) {
+			shift++;
+		}
+	}
+
+	u_int32_t numEntries = ((numSamples - 1) >> shift) + 1;
+	m_pSampleOffsetIndex = 
+		(u_int32_t*)MP4Malloc(numEntries * sizeof(u_int32_t));
+
+	VERBOSE_READ_TABLE(m_pFile->GetVerbosity(),
+		printf("BuildSampleOffsetIndex: track %u samples %u entries %u\n",
+			m_trackId, numSamples, numEntries));
+
+	MP4SampleId sid = 1;
+	for (u_int32_t stscIndex = 0; stscIndex < numStscs; stscIndex++) {
+		u_int32_t samplesPerChunk = 
+			m_pStscSamplesPerChunkProperty->GetValue(stscIndex);
+		MP4ChunkId lastChunk = numChunks;
+		if (stscIndex < lastStsc) {
+			lastChunk = 
+				m_pStscFirstChunkProperty->GetValue(stscIndex + 1) - 1;
+		}
+
+		for (MP4ChunkId chunkId = 
+		       m_pStscFirstChunkProperty->GetValue(stscIndex);
+		     chunkId <= lastChunk; chunkId++) {
+			u_int32_t sampleOffset = 0;
+
+			for (u_int32_t i = 0; i < samplesPerChunk; i++, sid++) {
+				if (sid > numSamples) {
+					m_sampleOffsetIndexShift = shift;
+					m_sampleOffsetIndexSamples = numSamples;
+					return;
+				}
+				if (((sid - 1) & (((u_int32_t)1 << shift) - 1)) == 0) {
+					m_pSampleOffsetIndex[(sid - 1) >> shift] = sampleOffset;
+				}
+				sampleOffset += GetSampleSize(sid);
+			}
+		}
+	}
+
+	m_sampleOffsetIndexShift = shift;
+	m_sampleOffsetIndexSamples = sid - 1;
+}
+
+void MP4Track::FreeSampleOffsetIndex()
+{
+	MP4Free(m_pSampleOffsetIndex);
+	m_pSampleOffsetIndex = NULL;
+	m_sampleOffsetIndexSamples = 0;
+	m_sampleOffsetIndexShift = 0;
+}
+
 void MP4Track::UpdateSampleToChunk(MP4SampleId sampleId,
 	 MP4ChunkId chunkId, u_int32_t samplesPerChunk)
 {
@@ -950,6 +1991,8 @@ void MP4Track::UpdateChunkOffsets(u_int64_t chunkOffset)
 
 MP4Duration MP4Track::GetFixedSampleDuration()
 {
+	LoadSampleTables();
+
 	u_int32_t numStts = m_pSttsCountProperty->GetValue();
 
 	if (numStts == 0) {
@@ -963,6 +2006,8 @@ MP4Duration MP4Track::GetFixedSampleDuration()
 
 void MP4Track::SetFixedSampleDuration(MP4Duration duration)
 {
+	LoadSampleTables();
+
 	u_int32_t numStts = m_pSttsCountProperty->GetValue();
 
 	// setting this is only allowed before samples have been written
@@ -973,101 +2018,332 @@ void MP4Track::SetFixedSampleDuration(MP4Duration duration)
 	return;
 }
 
-void MP4Track::GetSampleTimes(MP4SampleId sampleId,
-	MP4Timestamp* pStartTime, MP4Duration* pDuration)
+void MP4Track::BuildSttsIndex()
 {
+	FreeSttsIndex();
+
 	u_int32_t numStts = m_pSttsCountProperty->GetValue();
-	MP4SampleId sid;
-	MP4Duration elapsed;
-	
-	
-	if (m_cachedSttsSid != MP4_INVALID_SAMPLE_ID && sampleId >= m_cachedSttsSid) {
-		sid	  = m_cachedSttsSid;
-		elapsed	  = m_cachedSttsElapsed;
-	} else {
-		m_cachedSttsIndex = 0;
-		sid	  = 1;
-		elapsed	  = 0;
-	}
 
-	for (u_int32_t sttsIndex = m_cachedSttsIndex; sttsIndex < numStts; sttsIndex++) {
+	m_pSttsFirstSampleIndex = 
+		(MP4SampleId*)MP4Malloc((numStts + 1) * sizeof(MP4SampleId));
+	m_pSttsFirstTimeIndex = 
+		(MP4Timestamp*)MP4Malloc((numStts + 1) * sizeof(MP4Timestamp));
+
+	MP4SampleId sid = 1;
+	MP4Timestamp elapsed = 0;
+
+	for (u_int32_t sttsIndex = 0; sttsIndex < numStts; sttsIndex++) {
 		u_int32_t sampleCount = 
 			m_pSttsSampleCountProperty->GetValue(sttsIndex);
 		u_int32_t sampleDelta = 
 			m_pSttsSampleDeltaProperty->GetValue(sttsIndex);
 
-		if (sampleId <= sid + sampleCount - 1) {
-			if (pStartTime) {
-			  *pStartTime = (sampleId - sid);
-			  *pStartTime *= sampleDelta;
-			  *pStartTime += elapsed;
-			}
-			if (pDuration) {
-				*pDuration = sampleDelta;
-			}
+		m_pSttsFirstSampleIndex[sttsIndex] = sid;
+		m_pSttsFirstTimeIndex[sttsIndex] = elapsed;
+
+		sid += sampleCount;
+		elapsed += (MP4Timestamp)sampleCount * sampleDelta;
+	}
+	m_pSttsFirstSampleIndex[numStts] = sid;
+	m_pSttsFirstTimeIndex[numStts] = elapsed;
+
+	m_sttsIndexCount = numStts;
+	m_cachedSttsIndex = 0;
+}
+
+void MP4Track::FreeSttsIndex()
+{
+	MP4Free(m_pSttsFirstSampleIndex);
+	m_pSttsFirstSampleIndex = NULL;
+	MP4Free(m_pSttsFirstTimeIndex);
+	m_pSttsFirstTimeIndex = NULL;
+	m_sttsIndexCount = 0;
+	m_cachedSttsIndex = 0;
+}
+
+u_int32_t MP4Track::GetSampleSttsIndex(MP4SampleId sampleId, 
+	u_int32_t* pCachedIndex)
+{
+	if (pCachedIndex == NULL) {
+		pCachedIndex = &m_cachedSttsIndex;
+	}
+
+	if (m_pSttsFirstSampleIndex == NULL) {
+		BuildSttsIndex();
+	}
+
+	u_int32_t numStts = m_sttsIndexCount;
 
-			m_cachedSttsIndex = sttsIndex;
-			m_cachedSttsSid = sid;
-			m_cachedSttsElapsed = elapsed;
+	if (sampleId == MP4_INVALID_SAMPLE_ID 
+	  || sampleId >= m_pSttsFirstSampleIndex[numStts]) {
+		throw new MP4Error("sample id out of range", 
+			"MP4Track::GetSampleSttsIndex");
+	}
+
+	// sequential access usually hits the same or the next entry
+	u_int32_t sttsIndex = *pCachedIndex;
+	if (sttsIndex < numStts 
+	  && sampleId >= m_pSttsFirstSampleIndex[sttsIndex]) {
+		if (sampleId < m_pSttsFirstSampleIndex[sttsIndex + 1]) {
+			return sttsIndex;
+		}
+		if (sttsIndex + 1 < numStts 
+		  && sampleId < m_pSttsFirstSampleIndex[sttsIndex + 2]) {
+			*pCachedIndex = sttsIndex + 1;
+			return sttsIndex + 1;
+		}
+	}
+
+	// binary search for the last entry with firstSample <= sampleId
+	u_int32_t sttsLIndex = 0;
+	u_int32_t sttsRIndex = numStts;
+
+	while (sttsRIndex - sttsLIndex > 1) {
+		sttsIndex = (sttsLIndex + sttsRIndex) >> 1;
+
+		if (sampleId < m_pSttsFirstSampleIndex[sttsIndex]) {
+			sttsRIndex = sttsIndex;
+		} else {
+			sttsLIndex = sttsIndex;
+		}
+	}
+
+	*pCachedIndex = sttsLIndex;
+	return sttsLIndex;
+}
+
+void MP4Track::GetSampleTimes(MP4SampleId sampleId,
+	MP4Timestamp* pStartTime, MP4Duration* pDuration,
+	MP4TrackCursor* pCursor)
+{
+	LoadSampleTables();
+
+	MP4FragmentSample* pFragmentSample = GetFragmentSample(sampleId);
+	if (pFragmentSample) {
+		if (pStartTime) {
+			*pStartTime = pFragmentSample->startTime;
+		}
+		if (pDuration) {
+			*pDuration = pFragmentSample->duration;
+		}
+		return;
+	}
+
+	u_int32_t sttsIndex = GetSampleSttsIndex(sampleId, 
+		pCursor ? &pCursor->sttsIndex : NULL);
+
+	u_int32_t sampleDelta = 
+		m_pSttsSampleDeltaProperty->GetValue(sttsIndex);
+
+	if (pStartTime) {
+		*pStartTime = 
+			(sampleId - m_pSttsFirstSampleIndex[sttsIndex]);
+		*pStartTime *= sampleDelta;
+		*pStartTime += m_pSttsFirstTimeIndex[sttsIndex];
+	}
+	if (pDuration) {
+		*pDuration = sampleDelta;
+	}
+}
+
+MP4Status MP4Track::TryGetSampleTimes(MP4SampleId sampleId,
+	MP4Timestamp* pStartTime, MP4Duration* pDuration)
+{
+	LoadSampleTables();
+
+	if (sampleId == MP4_INVALID_SAMPLE_ID 
+	  || sampleId > GetNumberOfSamples()) {
+		return MP4_STATUS_INVALID_SAMPLE;
+	}
+	GetSampleTimes(sampleId, pStartTime, pDuration);
+	return MP4_STATUS_OK;
+}
+
+void MP4Track::GetSampleTimesArray(MP4SampleId startSampleId,
+	u_int32_t numSamples,
+	MP4Timestamp* pStartTimes,
+	MP4Duration* pDurations,
+	MP4Duration* pRenderingOffsets)
+{
+	LoadSampleTables();
+
+	if (numSamples == 0) {
+		return;
+	}
 
+	// samples from movie fragments are filled in separately
+	u_int32_t numStblSamples = m_pStszSampleCountProperty->GetValue();
+	if (m_fragmentSampleCount 
+	  && startSampleId + numSamples - 1 > numStblSamples) {
+		u_int32_t numFromStbl = 0;
+		if (startSampleId <= numStblSamples) {
+			numFromStbl = numStblSamples - startSampleId + 1;
+		}
+		for (u_int32_t i = numFromStbl; i < numSamples; i++) {
+			MP4FragmentSample* pFragmentSample = 
+				GetFragmentSample(startSampleId + i);
+			if (pStartTimes) {
+				pStartTimes[i] = pFragmentSample->startTime;
+			}
+			if (pDurations) {
+				pDurations[i] = pFragmentSample->duration;
+			}
+			if (pRenderingOffsets) {
+				pRenderingOffsets[i] = pFragmentSample->renderingOffset;
+			}
+		}
+		numSamples = numFromStbl;
+		if (numSamples == 0) {
 			return;
 		}
-		sid += sampleCount;
-		elapsed += sampleCount * sampleDelta;
 	}
 
-	throw new MP4Error("sample id out of range", 
-		"MP4Track::GetSampleTimes");
+	// validate the whole range up front
+	u_int32_t sttsIndex = GetSampleSttsIndex(startSampleId);
+	(void)GetSampleSttsIndex(startSampleId + numSamples - 1);
+
+	u_int32_t cttsIndex = 0;
+	MP4SampleId nextCttsSid = 0;
+	bool haveCtts = pRenderingOffsets != NULL
+		&& m_pCttsCountProperty != NULL
+		&& m_pCttsCountProperty->GetValue() != 0;
+	if (haveCtts) {
+		MP4SampleId firstSampleId;
+		cttsIndex = GetSampleCttsIndex(startSampleId, &firstSampleId);
+		nextCttsSid = m_pCttsFirstSampleIndex[cttsIndex + 1];
+	}
+
+	MP4SampleId nextSttsSid = m_pSttsFirstSampleIndex[sttsIndex + 1];
+	u_int32_t sampleDelta = 
+		m_pSttsSampleDeltaProperty->GetValue(sttsIndex);
+	MP4Timestamp startTime = m_pSttsFirstTimeIndex[sttsIndex]
+		+ (MP4Timestamp)(startSampleId 
+			- m_pSttsFirstSampleIndex[sttsIndex]) * sampleDelta;
+
+	for (u_int32_t i = 0; i < numSamples; i++) {
+		MP4SampleId sid = startSampleId + i;
+
+		while (sid >= nextSttsSid) {
+			sttsIndex++;
+			nextSttsSid = m_pSttsFirstSampleIndex[sttsIndex + 1];
+			sampleDelta = m_pSttsSampleDeltaProperty->GetValue(sttsIndex);
+		}
+		if (pStartTimes) {
+			pStartTimes[i] = startTime;
+		}
+		if (pDurations) {
+			pDurations[i] = sampleDelta;
+		}
+		startTime += sampleDelta;
+
+		if (pRenderingOffsets) {
+			if (haveCtts) {
+				while (sid >= nextCttsSid && cttsIndex + 1 < m_cttsIndexCount) {
+					cttsIndex++;
+					nextCttsSid = m_pCttsFirstSampleIndex[cttsIndex + 1];
+				}
+				pRenderingOffsets[i] = 
+					m_pCttsSampleOffsetProperty->GetValue(cttsIndex);
+			} else {
+				pRenderingOffsets[i] = 0;
+			}
+		}
+	}
 }
 
 MP4SampleId MP4Track::GetSampleIdFromTime(
 	MP4Timestamp when, 
 	bool wantSyncSample) 
 {
-	u_int32_t numStts = m_pSttsCountProperty->GetValue();
-	MP4SampleId sid = 1;
-	MP4Duration elapsed = 0;
+	LoadSampleTables();
 
-	for (u_int32_t sttsIndex = 0; sttsIndex < numStts; sttsIndex++) {
-		u_int32_t sampleCount = 
-			m_pSttsSampleCountProperty->GetValue(sttsIndex);
-		u_int32_t sampleDelta = 
-			m_pSttsSampleDeltaProperty->GetValue(sttsIndex);
+	// times past the sample tables are in the movie fragments
+	if (m_fragmentSampleCount && when >= m_pFragmentSamples[0].startTime) {
+		MP4FragmentSample* pLastSample = 
+			&m_pFragmentSamples[m_fragmentSampleCount - 1];
 
-		if (sampleDelta == 0 && sttsIndex < numStts - 1) {
-			VERBOSE_READ(m_pFile->GetVerbosity(),
-				printf("Warning: Zero sample duration, stts entry %u\n",
-				sttsIndex));
+		if (when > pLastSample->startTime + pLastSample->duration) {
+			throw new MP4Error("time out of range", 
+				"MP4Track::GetSampleIdFromTime");
 		}
 
-		MP4Duration d = when - elapsed;
+		// binary search for the last sample starting at or before when
+		u_int32_t fragLIndex = 0;
+		u_int32_t fragRIndex = m_fragmentSampleCount;
 
-		if (d <= sampleCount * sampleDelta) {
-			MP4SampleId sampleId = sid;
-			if (sampleDelta) {
-				sampleId += (d / sampleDelta);
-			}
+		while (fragRIndex - fragLIndex > 1) {
+			u_int32_t fragIndex = (fragLIndex + fragRIndex) >> 1;
 
-			if (wantSyncSample) {
-				return GetNextSyncSample(sampleId);
+			if (when < m_pFragmentSamples[fragIndex].startTime) {
+				fragRIndex = fragIndex;
+			} else {
+				fragLIndex = fragIndex;
 			}
-			return sampleId;
 		}
 
-		sid += sampleCount;
-		elapsed += sampleCount * sampleDelta;
+		MP4SampleId sampleId = 
+			m_pStszSampleCountProperty->GetValue() + fragLIndex + 1;
+
+		if (wantSyncSample) {
+			return GetNextSyncSample(sampleId);
+		}
+		return sampleId;
+	}
+
+	if (m_pSttsFirstSampleIndex == NULL) {
+		BuildSttsIndex();
+	}
+
+	u_int32_t numStts = m_sttsIndexCount;
+
+	if (numStts == 0 || when > m_pSttsFirstTimeIndex[numStts]) {
+		throw new MP4Error("time out of range", 
+			"MP4Track::GetSampleIdFromTime");
+	}
+
+	// binary search for the first entry that ends at or after when
+	u_int32_t sttsLIndex = 0;
+	u_int32_t sttsRIndex = numStts - 1;
+
+	while (sttsLIndex < sttsRIndex) {
+		u_int32_t sttsIndex = (sttsLIndex + sttsRIndex) >> 1;
+
+		if (m_pSttsFirstTimeIndex[sttsIndex + 1] < when) {
+			sttsLIndex = sttsIndex + 1;
+		} else {
+			sttsRIndex = sttsIndex;
+		}
+	}
+
+	u_int32_t sampleDelta = 
+		m_pSttsSampleDeltaProperty->GetValue(sttsLIndex);
+
+	if (sampleDelta == 0 && sttsLIndex < numStts - 1) {
+		VERBOSE_READ(m_pFile->GetVerbosity(),
+			printf("Warning: Zero sample duration, stts entry %u\n",
+			sttsLIndex));
 	}
 
-	throw new MP4Error("time out of range", 
-		"MP4Track::GetSampleIdFromTime");
+	MP4SampleId sampleId = m_pSttsFirstSampleIndex[sttsLIndex];
+	if (sampleDelta) {
+		sampleId += 
+			(when - m_pSttsFirstTimeIndex[sttsLIndex]) / sampleDelta;
+	}
 
-	return 0; // satisfy MS compiler
+	if (wantSyncSample) {
+		return GetNextSyncSample(sampleId);
+	}
+	return sampleId;
 }
 
 void MP4Track::UpdateSampleTimes(MP4Duration duration)
 {
 	u_int32_t numStts = m_pSttsCountProperty->GetValue();
 
+	if (m_pSttsFirstSampleIndex) {
+		FreeSttsIndex();
+	}
+
 	// if duration == duration of last entry
 	if (numStts 
 	  && duration == m_pSttsSampleDeltaProperty->GetValue(numStts-1)) {
@@ -1082,33 +2358,76 @@ void MP4Track::UpdateSampleTimes(MP4Duration duration)
 	}
 }
 
-u_int32_t MP4Track::GetSampleCttsIndex(MP4SampleId sampleId, 
-	MP4SampleId* pFirstSampleId)
+void MP4Track::BuildCttsIndex()
 {
+	FreeCttsIndex();
+
 	u_int32_t numCtts = m_pCttsCountProperty->GetValue();
 
+	m_pCttsFirstSampleIndex = 
+		(MP4SampleId*)MP4Malloc((numCtts + 1) * sizeof(MP4SampleId));
+
 	MP4SampleId sid = 1;
-	
 	for (u_int32_t cttsIndex = 0; cttsIndex < numCtts; cttsIndex++) {
-		u_int32_t sampleCount = 
-			m_pCttsSampleCountProperty->GetValue(cttsIndex);
+		m_pCttsFirstSampleIndex[cttsIndex] = sid;
+		sid += m_pCttsSampleCountProperty->GetValue(cttsIndex);
+	}
+	m_pCttsFirstSampleIndex[numCtts] = sid;
 
-		if (sampleId <= sid + sampleCount - 1) {
-			if (pFirstSampleId) {
-				*pFirstSampleId = sid;
-			}
-			return cttsIndex;
+	m_cttsIndexCount = numCtts;
+}
+
+void MP4Track::FreeCttsIndex()
+{
+	MP4Free(m_pCttsFirstSampleIndex);
+	m_pCttsFirstSampleIndex = NULL;
+	m_cttsIndexCount = 0;
+}
+
+u_int32_t MP4Track::GetSampleCttsIndex(MP4SampleId sampleId, 
+	MP4SampleId* pFirstSampleId)
+{
+	if (m_pCttsFirstSampleIndex == NULL) {
+		BuildCttsIndex();
+	}
+
+	u_int32_t numCtts = m_cttsIndexCount;
+
+	if (numCtts == 0 || sampleId == MP4_INVALID_SAMPLE_ID
+	  || sampleId >= m_pCttsFirstSampleIndex[numCtts]) {
+		throw new MP4Error("sample id out of range", 
+			"MP4Track::GetSampleCttsIndex");
+	}
+
+	// binary search for the last entry with firstSample <= sampleId
+	u_int32_t cttsLIndex = 0;
+	u_int32_t cttsRIndex = numCtts;
+
+	while (cttsRIndex - cttsLIndex > 1) {
+		u_int32_t cttsIndex = (cttsLIndex + cttsRIndex) >> 1;
+
+		if (sampleId < m_pCttsFirstSampleIndex[cttsIndex]) {
+			cttsRIndex = cttsIndex;
+		} else {
+			cttsLIndex = cttsIndex;
 		}
-		sid += sampleCount;
 	}
 
-	throw new MP4Error("sample id out of range", 
-		"MP4Track::GetSampleCttsIndex");
-	return 0; // satisfy MS compiler
+	if (pFirstSampleId) {
+		*pFirstSampleId = m_pCttsFirstSampleIndex[cttsLIndex];
+	}
+	return cttsLIndex;
 }
 
 MP4Duration MP4Track::GetSampleRenderingOffset(MP4SampleId sampleId)
 {
+	LoadSampleTables();
+
+	MP4FragmentSample* pFragmentSample = GetFragmentSample(sampleId);
+	if (pFragmentSample) {
+		return pFragmentSample->renderingOffset;
+	}
+
 	if (m_pCttsCountProperty == NULL) {
 		return 0;
 	}
@@ -1160,6 +2479,10 @@ void MP4Track::UpdateRenderingOffsets(MP4SampleId sampleId,
 
 	// ctts atom exists (now)
 
+	if (m_pCttsFirstSampleIndex) {
+		FreeCttsIndex();
+	}
+
 	u_int32_t numCtts = m_pCttsCountProperty->GetValue();
 
 	// if renderingOffset == renderingOffset of last entry
@@ -1180,6 +2503,8 @@ void MP4Track::UpdateRenderingOffsets(MP4SampleId sampleId,
 void MP4Track::SetSampleRenderingOffset(MP4SampleId sampleId,
 	 MP4Duration renderingOffset)
 {
+	LoadSampleTables();
+
 	// check if any ctts entries exist
 	if (m_pCttsCountProperty == NULL
 	  || m_pCttsCountProperty->GetValue() == 0) {
@@ -1204,6 +2529,9 @@ void MP4Track::SetSampleRenderingOffset(MP4SampleId sampleId,
 	MP4SampleId firstSampleId;
 	u_int32_t cttsIndex = GetSampleCttsIndex(sampleId, &firstSampleId);
 
+	// the entries are about to change
+	FreeCttsIndex();
+
 	// do nothing in the degenerate case
 	if (renderingOffset == 
 	  m_pCttsSampleOffsetProperty->GetValue(cttsIndex)) {
@@ -1276,6 +2604,13 @@ void MP4Track::SetSampleRenderingOffset(MP4SampleId sampleId,
 
 bool MP4Track::IsSyncSample(MP4SampleId sampleId)
 {
+	LoadSampleTables();
+
+	MP4FragmentSample* pFragmentSample = GetFragmentSample(sampleId);
+	if (pFragmentSample) {
+		return pFragmentSample->isSyncSample;
+	}
+
 	if (m_pStssCountProperty == NULL) {
 		return true;
 	}
@@ -1306,20 +2641,46 @@ bool MP4Track::IsSyncSample(MP4SampleId sampleId)
 // N.B. "next" is inclusive of this sample id
 MP4SampleId MP4Track::GetNextSyncSample(MP4SampleId sampleId)
 {
+	u_int32_t numStblSamples = m_pStszSampleCountProperty->GetValue();
+
+	// movie fragment samples are scanned forward
+	if (m_fragmentSampleCount && sampleId > numStblSamples) {
+		for (u_int32_t i = sampleId - numStblSamples - 1; 
+		  i < m_fragmentSampleCount; i++) {
+			if (m_pFragmentSamples[i].isSyncSample) {
+				return numStblSamples + i + 1;
+			}
+		}
+		return MP4_INVALID_SAMPLE_ID;
+	}
+
 	if (m_pStssCountProperty == NULL) {
 		return sampleId;
 	}
 
 	u_int32_t numStss = m_pStssCountProperty->GetValue();
-	
-	for (u_int32_t stssIndex = 0; stssIndex < numStss; stssIndex++) {
-		MP4SampleId syncSampleId = 
-			m_pStssSampleProperty->GetValue(stssIndex);
 
-		if (sampleId > syncSampleId) {
-			continue;
+	// binary search for the first sync sample >= sampleId
+	u_int32_t stssLIndex = 0;
+	u_int32_t stssRIndex = numStss;
+
+	while (stssLIndex < stssRIndex) {
+		u_int32_t stssIndex = (stssLIndex + stssRIndex) >> 1;
+
+		if (m_pStssSampleProperty->GetValue(stssIndex) < sampleId) {
+			stssLIndex = stssIndex + 1;
+		} else {
+			stssRIndex = stssIndex;
 		}
-		return syncSampleId;
+	}
+
+	if (stssLIndex < numStss) {
+		return m_pStssSampleProperty->GetValue(stssLIndex);
+	}
+
+	// none left in the sample tables, try the movie fragments
+	if (m_fragmentSampleCount) {
+		return GetNextSyncSample(numStblSamples + 1);
 	}
 
 	// LATER check stsh for alternate sample
@@ -1376,7 +2737,20 @@ MP4Atom* MP4Track::AddAtom(char* parentName, char* childName)
 
 u_int64_t MP4Track::GetDuration()
 {
-	return m_pMediaDurationProperty->GetValue();
+	u_int64_t duration = m_pMediaDurationProperty->GetValue();
+
+	// the media header may not cover the movie fragments
+	if (m_fragmentSampleCount) {
+		MP4FragmentSample* pLastSample = 
+			&m_pFragmentSamples[m_fragmentSampleCount - 1];
+		u_int64_t fragmentEnd = 
+			pLastSample->startTime + pLastSample->duration;
+
+		if (fragmentEnd > duration) {
+			duration = fragmentEnd;
+		}
+	}
+	return duration;
 }
 
 u_int32_t MP4Track::GetTimeScale()
@@ -1413,6 +2787,8 @@ void MP4Track::UpdateModificationTimes()
 
 u_int32_t MP4Track::GetNumberOfChunks()
 {
+	LoadSampleTables();
+
 	return m_pChunkOffsetProperty->GetCount();
 }
 
@@ -1423,18 +2799,27 @@ u_int32_t MP4Track::GetChunkStscIndex(MP4ChunkId chunkId)
 
 	ASSERT(chunkId);
 	ASSERT(numStscs > 0);
+	ASSERT(chunkId >= m_pStscFirstChunkProperty->GetValue(0));
 
-	for (stscIndex = 0; stscIndex < numStscs; stscIndex++) {
+	// first chunks are ascending, find the last one <= chunkId
+	u_int32_t lIndex = 0;
+	u_int32_t rIndex = numStscs;
+
+	while (rIndex - lIndex > 1) {
+		stscIndex = lIndex + (rIndex - lIndex) / 2;
 		if (chunkId < m_pStscFirstChunkProperty->GetValue(stscIndex)) {
-			ASSERT(stscIndex != 0);
-			break;
+			rIndex = stscIndex;
+		} else {
+			lIndex = stscIndex;
 		}
 	}
-	return stscIndex - 1;
+	return lIndex;
 }
 
 MP4Timestamp MP4Track::GetChunkTime(MP4ChunkId chunkId)
 {
+	LoadSampleTables();
+
 	u_int32_t stscIndex = GetChunkStscIndex(chunkId);
 
 	MP4ChunkId firstChunkId = 
@@ -1456,8 +2841,83 @@ MP4Timestamp MP4Track::GetChunkTime(MP4ChunkId chunkId)
 	return chunkTime;
 }
 
+u_int64_t MP4Track::GetChunkOffset(MP4ChunkId chunkId)
+{
+	LoadSampleTables();
+
+	ASSERT(chunkId);
+	return m_pChunkOffsetProperty->GetValue(chunkId - 1);
+}
+
+void MP4Track::SetChunkOffset(MP4ChunkId chunkId, u_int64_t chunkOffset)
+{
+	LoadSampleTables();
+
+	ASSERT(chunkId);
+	if (m_pChunkOffsetProperty->GetType() == Integer32Property
+	  && chunkOffset > 0xFFFFFFFF) {
+		throw new MP4Error("chunk offset doesn't fit in stco", 
+			"SetChunkOffset");
+	}
+	m_pChunkOffsetProperty->SetValue(chunkOffset, chunkId - 1);
+}
+
+bool MP4Track::HasChunkOffsets64()
+{
+	return m_pChunkOffsetProperty->GetType() == Integer64Property;
+}
+
+void MP4Track::ConvertChunkOffsetsTo64()
+{
+	if (HasChunkOffsets64()) {
+		return;
+	}
+
+	LoadSampleTables();
+
+	MP4Atom* pStcoAtom = m_pTrakAtom->FindAtom("trak.mdia.minf.stbl.stco");
+	ASSERT(pStcoAtom);
+	MP4Atom* pStblAtom = pStcoAtom->GetParentAtom();
+
+	// put co64 where stco was
+	u_int32_t stcoIndex;
+	for (stcoIndex = 0; 
+	  stcoIndex < pStblAtom->GetNumberOfChildAtoms(); stcoIndex++) {
+		if (pStblAtom->GetChildAtom(stcoIndex) == pStcoAtom) {
+			break;
+		}
+	}
+
+	MP4Atom* pCo64Atom = MP4Atom::CreateAtom("co64");
+	pStblAtom->InsertChildAtom(pCo64Atom, stcoIndex);
+	pCo64Atom->Generate();
+
+	MP4Integer32Property* pCountProperty = NULL;
+	MP4Integer64Property* pOffsetProperty = NULL;
+
+	(void)pCo64Atom->FindProperty("co64.entryCount",
+		(MP4Property**)&pCountProperty);
+	(void)pCo64Atom->FindProperty("co64.entries.chunkOffset",
+		(MP4Property**)&pOffsetProperty);
+	ASSERT(pCountProperty && pOffsetProperty);
+
+	u_int32_t numChunks = m_pChunkOffsetProperty->GetCount();
+	for (u_int32_t i = 0; i < numChunks; i++) {
+		pOffsetProperty->AddValue(m_pChunkOffsetProperty->GetValue(i));
+	}
+	pCountProperty->IncrementValue(numChunks);
+
+	pStblAtom->DeleteChildAtom(pStcoAtom);
+	delete pStcoAtom;
+
+	m_pChunkCountProperty = pCountProperty;
+	m_pChunkOffsetProperty = pOffsetProperty;
+}
+
 u_int32_t MP4Track::GetChunkSize(MP4ChunkId chunkId)
 {
+	LoadSampleTables();
+
 	u_int32_t stscIndex = GetChunkStscIndex(chunkId);
 
 	MP4ChunkId firstChunkId = 
@@ -1484,6 +2944,8 @@ u_int32_t MP4Track::GetChunkSize(MP4ChunkId chunkId)
 void MP4Track::ReadChunk(MP4ChunkId chunkId, 
 	u_int8_t** ppChunk, u_int32_t* pChunkSize)
 {
+	LoadSampleTables();
+
 	ASSERT(chunkId);
 	ASSERT(ppChunk);
 	ASSERT(pChunkSize);
@@ -1522,6 +2984,8 @@ void MP4Track::ReadChunk(MP4ChunkId chunkId,
 void MP4Track::RewriteChunk(MP4ChunkId chunkId, 
 	u_int8_t* pChunk, u_int32_t chunkSize)
 {
+	LoadSampleTables();
+
 	u_int64_t chunkOffset = m_pFile->GetPosition();
 
 	m_pFile->WriteBytes(pChunk, chunkSize);
@@ -1624,8 +3088,11 @@ void MP4Track::DeleteEdit(MP4EditId editId)
 		m_pElstRateProperty = NULL;
 		m_pElstReservedProperty = NULL;
 
-		m_pTrakAtom->DeleteChildAtom(
-			m_pTrakAtom->FindAtom("trak.edts"));
+		// deleted, not just removed, so references to its
+		// properties fail rather than read the old ones
+		MP4Atom* pEdtsAtom = m_pTrakAtom->FindAtom("trak.edts");
+		m_pTrakAtom->DeleteChildAtom(pEdtsAtom);
+		delete pEdtsAtom;
 	}
 }
 
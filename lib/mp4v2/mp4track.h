@@ -33,6 +33,7 @@ typedef u_int32_t MP4ChunkId;
 
 // forward declarations
 class MP4File;
+struct MP4PropertyRef;
 class MP4Atom;
 class MP4Property;
 class MP4IntegerProperty;
@@ -41,6 +42,31 @@ class MP4Integer32Property;
 class MP4Integer64Property;
 class MP4StringProperty;
 
+// a sample found in a movie fragment (moof) rather than in the
+// sample tables, these are numbered after the sample table samples
+struct MP4FragmentSample {
+	u_int64_t	fileOffset;
+	MP4Timestamp	startTime;
+	u_int32_t	size;
+	u_int32_t	duration;
+	u_int32_t	renderingOffset;
+	u_int32_t	sampleDescrIndex;
+	bool		isSyncSample;
+};
+
+// the lookup state an MP4Reader keeps for each track it reads, 
+// so that several readers can read the same track at once
+struct MP4TrackCursor {
+	FILE*		pFile;		// the reader's own handle, or NULL for
+					// the file's Virtual_IO
+	u_int32_t	sttsIndex;
+	u_int32_t	lastStsdIndex;
+	FILE*		lastSampleFile;
+};
+
+// properties a track keeps references to, see MP4Track::GetPropertyRef
+#define MP4_TRACK_PROPERTY_REFS 16
+
 class MP4Track {
 public:
 	MP4Track(MP4File* pFile, MP4Atom* pTrakAtom);
@@ -63,8 +89,99 @@ public:
 		return m_pTrakAtom;
 	}
 
+	// the esds of the first sample description, NULL if there isn't one
+	MP4Atom* GetEsdsAtom();
+	u_int8_t GetEsdsObjectTypeId();
+
+	// a property by its name below trak, looked up on first use and
+	// kept for the next, NULL if the track has no such property
+	MP4PropertyRef* GetPropertyRef(const char* name);
+	// before the track is deleted, the file still has the references
+	void FreePropertyRefs();
+
+	// add the samples of a track fragment (traf) to the track
+	// returns the file offset just past the fragment's data
+	u_int64_t AddFragment(MP4Atom* pTrafAtom, 
+		u_int64_t moofStart, u_int64_t dataOffset);
+
+	// fragmented writing, samples are held until WriteFragmentData()
+	bool IsFragmentFull(bool isSyncSample);
+	bool HasFragmentSamples() {
+		return m_fragmentSampleCount != 0;
+	}
+	u_int32_t GetFragmentDataSize() {
+		return m_chunkBufferSize;
+	}
+	void AddFragmentAtoms(MP4Atom* pMoofAtom, u_int64_t dataOffset);
+	void WriteFragmentData();
+
+	// make sure sample tables deferred by a lazy read are present
+	void LoadSampleTables() {
+		if (!m_sampleTablesLoaded) {
+			LoadDeferredTables();
+		}
+	}
+
+	void ReadSample(
+		// input parameters
+		MP4SampleId sampleId,
+		// output parameters
+		u_int8_t** ppBytes, 
+		u_int32_t* pNumBytes, 
+		MP4Timestamp* pStartTime = NULL, 
+		MP4Duration* pDuration = NULL,
+		MP4Duration* pRenderingOffset = NULL, 
+		bool* pIsSyncSample = NULL);
+
+	// ReadSample without the exception, routine failures like a bad
+	// sample id, a short buffer or a short read come back as a status
+	MP4Status TryReadSample(
+		// input parameters
+		MP4SampleId sampleId,
+		// output parameters
+		u_int8_t** ppBytes, 
+		u_int32_t* pNumBytes, 
+		MP4Timestamp* pStartTime = NULL, 
+		MP4Duration* pDuration = NULL,
+		MP4Duration* pRenderingOffset = NULL, 
+		bool* pIsSyncSample = NULL);
+
+	// like ReadSample, but returns a pointer to the sample data
+	// rather than copying it, valid until the next call or MP4Close
+	// the copy of an unmapped sample is the ReadSampleFragment cache,
+	// so a fragment read of another sample, directly or from a hint
+	// track, replaces it too
+	void ReadSampleView(
+		// input parameters
+		MP4SampleId sampleId,
+		// output parameters
+		const u_int8_t** ppBytes, 
+		u_int32_t* pNumBytes, 
+		MP4Timestamp* pStartTime = NULL, 
+		MP4Duration* pDuration = NULL,
+		MP4Duration* pRenderingOffset = NULL, 
+		bool* pIsSyncSample = NULL);
+
+	// reading via an MP4Reader, PrepareForReaders() builds everything
+	// that is otherwise built on first use, after which reads with 
+	// different cursors don't modify the track
+	void PrepareForReaders();
+
 	void ReadSample(
 		// input parameters
+		MP4TrackCursor* pCursor,
+		MP4SampleId sampleId,
+		// output parameters
+		u_int8_t** ppBytes, 
+		u_int32_t* pNumBytes, 
+		MP4Timestamp* pStartTime = NULL, 
+		MP4Duration* pDuration = NULL,
+		MP4Duration* pRenderingOffset = NULL, 
+		bool* pIsSyncSample = NULL);
+
+	MP4Status TryReadSample(
+		// input parameters
+		MP4TrackCursor* pCursor,
 		MP4SampleId sampleId,
 		// output parameters
 		u_int8_t** ppBytes, 
@@ -87,6 +204,7 @@ public:
 	u_int32_t	GetTimeScale();
 	u_int32_t	GetNumberOfSamples();
 	u_int32_t	GetSampleSize(MP4SampleId sampleId);
+	MP4Status	TryGetSampleSize(MP4SampleId sampleId, u_int32_t* pSize);
 	u_int32_t	GetMaxSampleSize();
 	u_int64_t 	GetTotalOfSampleSizes();
 	u_int32_t	GetAvgBitrate();	// in bps
@@ -96,8 +214,18 @@ public:
 	void		SetFixedSampleDuration(MP4Duration duration);
 
 	void		GetSampleTimes(MP4SampleId sampleId,
+					MP4Timestamp* pStartTime, MP4Duration* pDuration,
+					MP4TrackCursor* pCursor = NULL);
+	MP4Status	TryGetSampleTimes(MP4SampleId sampleId,
 					MP4Timestamp* pStartTime, MP4Duration* pDuration);
 
+	// bulk version of GetSampleTimes/GetSampleRenderingOffset
+	void		GetSampleTimesArray(MP4SampleId startSampleId,
+					u_int32_t numSamples,
+					MP4Timestamp* pStartTimes,
+					MP4Duration* pDurations,
+					MP4Duration* pRenderingOffsets);
+
 	bool		IsSyncSample(MP4SampleId sampleId);
 
 	MP4SampleId GetSampleIdFromTime(
@@ -132,12 +260,38 @@ public:
 		u_int16_t sampleLength,
 		u_int8_t* pDest);
 
+	// in place version of ReadSampleFragment, points into the mapped
+	// file or the cached read sample, or returns NULL if that would
+	// mean replacing the cached sample and replaceCached is false
+	const u_int8_t* GetSampleFragmentView(
+		MP4SampleId sampleId,
+		u_int32_t sampleOffset,
+		u_int16_t sampleLength,
+		bool replaceCached = true);
+
+	// reads just the fragment from the file, the cached sample is kept
+	void ReadSampleFragmentUncached(
+		MP4SampleId sampleId,
+		u_int32_t sampleOffset,
+		u_int16_t sampleLength,
+		u_int8_t* pDest);
+
 	// special operations for use during optimization
 
 	u_int32_t GetNumberOfChunks();
 
 	MP4Timestamp GetChunkTime(MP4ChunkId chunkId);
 
+	u_int64_t GetChunkOffset(MP4ChunkId chunkId);
+
+	void SetChunkOffset(MP4ChunkId chunkId, u_int64_t chunkOffset);
+
+	// switch from stco to co64 so offsets beyond 4GB can be stored
+	bool HasChunkOffsets64();
+	void ConvertChunkOffsetsTo64();
+
+	u_int32_t GetChunkSize(MP4ChunkId chunkId);
+
 	void ReadChunk(MP4ChunkId chunkId, 
 		u_int8_t** ppChunk, u_int32_t* pChunkSize);
 
@@ -147,14 +301,28 @@ public:
 protected:
 	bool		InitEditListProperties();
 
-	FILE*		GetSampleFile(MP4SampleId sampleId);
+	FILE*		GetSampleFile(MP4SampleId sampleId, 
+					MP4TrackCursor* pCursor = NULL);
 	u_int64_t	GetSampleFileOffset(MP4SampleId sampleId);
 	u_int32_t	GetSampleStscIndex(MP4SampleId sampleId);
 	u_int32_t	GetChunkStscIndex(MP4ChunkId chunkId);
-	u_int32_t	GetChunkSize(MP4ChunkId chunkId);
+	void		LoadDeferredTables();
+	MP4FragmentSample* GetFragmentSample(MP4SampleId sampleId);
+	void		AddFragmentSample(const u_int8_t* pBytes, 
+				u_int32_t numBytes, MP4Duration duration, 
+				MP4Duration renderingOffset, bool isSyncSample);
+	void		UpdateCachedReadSample(MP4SampleId sampleId);
+	void		BuildSampleOffsetIndex();
+	void		FreeSampleOffsetIndex();
 	u_int32_t	GetSampleCttsIndex(MP4SampleId sampleId, 
 					MP4SampleId* pFirstSampleId = NULL);
 	MP4SampleId	GetNextSyncSample(MP4SampleId sampleId);
+	u_int32_t	GetSampleSttsIndex(MP4SampleId sampleId, 
+					u_int32_t* pCachedIndex = NULL);
+	void		BuildSttsIndex();
+	void		FreeSttsIndex();
+	void		BuildCttsIndex();
+	void		FreeCttsIndex();
 
 	void UpdateSampleSizes(MP4SampleId sampleId, 
 		u_int32_t numBytes);
@@ -175,7 +343,9 @@ protected:
 
 	void UpdateModificationTimes();
 
-	void WriteChunkBuffer();
+	void AppendChunkBuffer(const u_int8_t* pBytes, u_int32_t numBytes);
+	void WriteChunkBuffer(const u_int8_t* pLastSample = NULL, 
+		u_int32_t lastSampleSize = 0);
 
 	void CalculateBytesPerSample();
 protected:
@@ -184,9 +354,28 @@ protected:
 	MP4TrackId	m_trackId;			// moov.trak[].tkhd.trackId
 	MP4StringProperty* m_pTypeProperty;	// moov.trak[].mdia.hdlr.handlerType
 
+	// found on first use, as the esds is added after the track
+	MP4Atom*	m_pEsdsAtom;
+	MP4IntegerProperty* m_pEsdsObjectTypeProperty;
+
+	// properties asked for by name, MP4File::GetTrackIntegerProperty
+	// and the like, the oldest is replaced once they are all used
+	struct {
+		char*		name;
+		MP4PropertyRef*	pRef;
+	}		m_propertyRefs[MP4_TRACK_PROPERTY_REFS];
+	u_int32_t	m_numPropertyRefs;
+	u_int32_t	m_nextPropertyRef;
+
 	u_int32_t	m_lastStsdIndex;
 	FILE*	 	m_lastSampleFile;
 
+	// lazily built index of sample offsets within their chunk
+	// one entry per (1 << m_sampleOffsetIndexShift) samples
+	u_int32_t*	m_pSampleOffsetIndex;
+	u_int32_t	m_sampleOffsetIndexSamples;	// samples covered
+	u_int8_t	m_sampleOffsetIndexShift;
+
 	// for efficient construction of hint track packets
 	MP4SampleId	m_cachedReadSampleId;
 	u_int8_t* 	m_pCachedReadSample;
@@ -197,6 +386,7 @@ protected:
 	MP4Duration m_fixedSampleDuration;
 	u_int8_t* 	m_pChunkBuffer;
 	u_int32_t	m_chunkBufferSize;
+	u_int32_t	m_chunkBufferMaxSize;	// allocated, kept across chunks
 	u_int32_t	m_chunkSamples;
 	MP4Duration m_chunkDuration;
 
@@ -238,15 +428,37 @@ protected:
 	MP4Integer32Property* m_pSttsSampleCountProperty;
 	MP4Integer32Property* m_pSttsSampleDeltaProperty;
 
+	// first sample id and start time of each stts entry
+	// with an extra entry one past the end, built on first use
+	MP4SampleId*	m_pSttsFirstSampleIndex;
+	MP4Timestamp*	m_pSttsFirstTimeIndex;
+	u_int32_t	m_sttsIndexCount;
+
 	// for improve sequental timestamp index access
 	u_int32_t	m_cachedSttsIndex;
-	MP4SampleId	m_cachedSttsSid;
-	MP4Timestamp	m_cachedSttsElapsed;
 
 	MP4Integer32Property* m_pCttsCountProperty;
 	MP4Integer32Property* m_pCttsSampleCountProperty;
 	MP4Integer32Property* m_pCttsSampleOffsetProperty;
 
+	// first sample id of each ctts entry, plus one past the end
+	MP4SampleId*	m_pCttsFirstSampleIndex;
+	u_int32_t	m_cttsIndexCount;
+
+	bool		m_sampleTablesLoaded;
+
+	MP4FragmentSample* m_pFragmentSamples;
+	u_int32_t	m_fragmentSampleCount;
+	u_int32_t	m_fragmentSampleMax;
+
+	// totals of the samples written to fragments, which are gone
+	// from the track by the time FinishWrite() sets the esds bitrates
+	u_int64_t	m_fragmentWriteBytes;
+	u_int32_t	m_fragmentWriteMaxSize;
+	MP4Timestamp	m_fragmentWriteThisSec;
+	u_int32_t	m_fragmentWriteBytesThisSec;
+	u_int32_t	m_fragmentWriteMaxBytesPerSec;
+
 	MP4Integer32Property* m_pStssCountProperty;
 	MP4Integer32Property* m_pStssSampleProperty;
 
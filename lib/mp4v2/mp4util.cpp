@@ -56,6 +56,43 @@ void MP4Error::Print(FILE* pFile)
 	fprintf(pFile, "\n");
 }
 
+const char* MP4StatusString(MP4Status status)
+{
+	switch (status) {
+	case MP4_STATUS_OK:
+		return "no error";
+	case MP4_STATUS_INVALID_TRACK:
+		return "track id doesn't exist";
+	case MP4_STATUS_INVALID_SAMPLE:
+		return "sample id out of range";
+	case MP4_STATUS_BUFFER_TOO_SMALL:
+		return "sample buffer is too small";
+	case MP4_STATUS_INACCESSIBLE_FILE:
+		return "sample is located in an inaccessible file";
+	case MP4_STATUS_END_OF_FILE:
+		return "not enough bytes, reached end-of-file";
+	case MP4_STATUS_READ_ERROR:
+		return "error reading file";
+	case MP4_STATUS_NOT_HINT_TRACK:
+		return "track is not a hint track";
+	case MP4_STATUS_NO_HINT:
+		return "no hint has been read";
+	case MP4_STATUS_NO_DATA_REQUESTED:
+		return "no data requested";
+	case MP4_STATUS_INVALID_PACKET:
+		return "packet index out of range";
+	}
+	return "unknown status";
+}
+
+void MP4PrintStatus(MP4Status status, const char* where)
+{
+	MP4Error e;
+	e.m_errstring = MP4StatusString(status);
+	e.m_where = where;
+	e.Print();
+}
+
 void MP4HexDump(
 	u_int8_t* pBytes, u_int32_t numBytes,
 	FILE* pFile, u_int8_t indent)
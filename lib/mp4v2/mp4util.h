@@ -158,6 +158,27 @@ public:
 	const char* m_where;
 };
 
+// result of the read paths that report routine failures without
+// allocating and throwing an MP4Error, see MP4Track::TryReadSample
+typedef enum {
+	MP4_STATUS_OK = 0,
+	MP4_STATUS_INVALID_TRACK,
+	MP4_STATUS_INVALID_SAMPLE,
+	MP4_STATUS_BUFFER_TOO_SMALL,
+	MP4_STATUS_INACCESSIBLE_FILE,
+	MP4_STATUS_END_OF_FILE,
+	MP4_STATUS_READ_ERROR,
+	MP4_STATUS_NOT_HINT_TRACK,
+	MP4_STATUS_NO_HINT,
+	MP4_STATUS_NO_DATA_REQUESTED,
+	MP4_STATUS_INVALID_PACKET
+} MP4Status;
+
+const char* MP4StatusString(MP4Status status);
+
+// prints a status the same way MP4Error::Print() would
+void MP4PrintStatus(MP4Status status, const char* where);
+
 void MP4HexDump(
 	u_int8_t* pBytes, u_int32_t numBytes,
 	FILE* pFile = stdout, u_int8_t indent = 0);
@@ -211,6 +232,27 @@ inline void INT32TOSTR(u_int32_t i, char* s) {
   s[4] = 0;
 }
 
+// big endian byte sequences to host integers, for bulk table reads
+inline u_int8_t MP4BytesToUInt8(const u_int8_t* p) {
+	return p[0];
+}
+
+inline u_int16_t MP4BytesToUInt16(const u_int8_t* p) {
+	return (p[0] << 8) | p[1];
+}
+
+inline u_int32_t MP4BytesToUInt24(const u_int8_t* p) {
+	return (p[0] << 16) | (p[1] << 8) | p[2];
+}
+
+inline u_int32_t MP4BytesToUInt32(const u_int8_t* p) {
+	return ((u_int32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+inline u_int64_t MP4BytesToUInt64(const u_int8_t* p) {
+	return ((u_int64_t)MP4BytesToUInt32(p) << 32) | MP4BytesToUInt32(p + 4);
+}
+
 inline MP4Timestamp MP4GetAbsTimestamp() {
 	struct timeval tv;
 	gettimeofday(&tv, NULL);
@@ -187,14 +187,31 @@ void MP4RtpHintTrack::ReadPacket(
 	u_int32_t ssrc,
 	bool addHeader,
 	bool addPayload)
+{
+	MP4Status status = TryReadPacket(packetIndex, ppBytes, pNumBytes,
+		ssrc, addHeader, addPayload);
+
+	if (status != MP4_STATUS_OK) {
+		throw new MP4Error(MP4StatusString(status), "MP4ReadRtpPacket");
+	}
+}
+
+MP4Status MP4RtpHintTrack::TryReadPacket(
+	u_int16_t packetIndex,
+	u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes,
+	u_int32_t ssrc,
+	bool addHeader,
+	bool addPayload)
 {
 	if (m_pReadHint == NULL) {
-		throw new MP4Error("no hint has been read",
-			"MP4ReadRtpPacket");
+		return MP4_STATUS_NO_HINT;
 	}
 	if (!addHeader && !addPayload) {
-		throw new MP4Error("no data requested",
-			"MP4ReadRtpPacket");
+		return MP4_STATUS_NO_DATA_REQUESTED;
+	}
+	if (packetIndex >= m_pReadHint->GetNumberOfPackets()) {
+		return MP4_STATUS_INVALID_PACKET;
 	}
 
 	MP4RtpPacket* pPacket =
@@ -220,23 +237,8 @@ void MP4RtpHintTrack::ReadPacket(
 		u_int8_t* pDest = *ppBytes;
 
 		if (addHeader) {
-			*pDest++ =
-				0x80 | (pPacket->GetPBit() << 5) | (pPacket->GetXBit() << 4);
-
-			*pDest++ =
-				(pPacket->GetMBit() << 7) | pPacket->GetPayload();
-
-			*((u_int16_t*)pDest) = 
-				htons(m_rtpSequenceStart + pPacket->GetSequenceNumber());
-			pDest += 2; 
-
-			*((u_int32_t*)pDest) = 
-				htonl(m_rtpTimestampStart + (u_int32_t)m_readHintTimestamp);
-			pDest += 4; 
-
-			*((u_int32_t*)pDest) = 
-				htonl(ssrc);
-			pDest += 4;
+			WriteRtpHeader(pPacket, ssrc, pDest);
+			pDest += 12;
 		}
 
 		if (addPayload) {
@@ -254,6 +256,82 @@ void MP4RtpHintTrack::ReadPacket(
 	VERBOSE_READ_HINT(m_pFile->GetVerbosity(),
 		printf("ReadPacket: %u ", packetIndex);
 		MP4HexDump(*ppBytes, *pNumBytes););
+
+	return MP4_STATUS_OK;
+}
+
+MP4Status MP4RtpHintTrack::TryReadPacketIov(
+	u_int16_t packetIndex,
+	u_int8_t* pBuffer,
+	u_int32_t bufferSize,
+	struct iovec* pIov,
+	u_int32_t* pIovCount,
+	u_int32_t ssrc,
+	bool addHeader,
+	bool addPayload)
+{
+	if (m_pReadHint == NULL) {
+		return MP4_STATUS_NO_HINT;
+	}
+	if (!addHeader && !addPayload) {
+		return MP4_STATUS_NO_DATA_REQUESTED;
+	}
+	if (packetIndex >= m_pReadHint->GetNumberOfPackets()) {
+		return MP4_STATUS_INVALID_PACKET;
+	}
+
+	MP4RtpPacket* pPacket =
+		m_pReadHint->GetPacket(packetIndex);
+
+	u_int32_t maxIov = *pIovCount;
+	u_int32_t bufferUsed = 0;
+
+	*pIovCount = 0;
+	if (addHeader) {
+		if (bufferSize < 12 || maxIov == 0) {
+			return MP4_STATUS_BUFFER_TOO_SMALL;
+		}
+		WriteRtpHeader(pPacket, ssrc, pBuffer);
+		pIov[0].iov_base = pBuffer;
+		pIov[0].iov_len = 12;
+		bufferUsed = 12;
+		*pIovCount = 1;
+	}
+
+	if (addPayload) {
+		MP4Status status = pPacket->GetDataIov(pBuffer, bufferSize, 
+			&bufferUsed, pIov, maxIov, pIovCount);
+		if (status != MP4_STATUS_OK) {
+			return status;
+		}
+	}
+
+	VERBOSE_READ_HINT(m_pFile->GetVerbosity(),
+		printf("ReadPacketIov: %u %u entries, %u bytes copied\n", 
+			packetIndex, *pIovCount, bufferUsed));
+
+	return MP4_STATUS_OK;
+}
+
+void MP4RtpHintTrack::WriteRtpHeader(MP4RtpPacket* pPacket, 
+	u_int32_t ssrc, u_int8_t* pDest)
+{
+	*pDest++ =
+		0x80 | (pPacket->GetPBit() << 5) | (pPacket->GetXBit() << 4);
+
+	*pDest++ =
+		(pPacket->GetMBit() << 7) | pPacket->GetPayload();
+
+	*((u_int16_t*)pDest) = 
+		htons(m_rtpSequenceStart + pPacket->GetSequenceNumber());
+	pDest += 2; 
+
+	*((u_int32_t*)pDest) = 
+		htonl(m_rtpTimestampStart + (u_int32_t)m_readHintTimestamp);
+	pDest += 4; 
+
+	*((u_int32_t*)pDest) = 
+		htonl(ssrc);
 }
 
 MP4Timestamp MP4RtpHintTrack::GetRtpTimestampStart()
@@ -1042,6 +1120,46 @@ void MP4RtpPacket::GetData(u_int8_t* pDest)
 	}
 }
 
+MP4Status MP4RtpPacket::GetDataIov(
+	u_int8_t* pBuffer, u_int32_t bufferSize, u_int32_t* pBufferUsed,
+	struct iovec* pIov, u_int32_t maxIov, u_int32_t* pNumIov)
+{
+	// tracks whose cached read sample is pointed at by an earlier entry
+	MP4TrackArray cachedTracks;
+
+	for (u_int32_t i = 0; i < m_rtpData.Size(); i++) {
+		u_int16_t dataSize = m_rtpData[i]->GetDataSize();
+		if (dataSize == 0) {
+			continue;
+		}
+		if (*pBufferUsed + dataSize > bufferSize) {
+			return MP4_STATUS_BUFFER_TOO_SMALL;
+		}
+
+		u_int8_t* pDest = &pBuffer[*pBufferUsed];
+		const u_int8_t* pData = 
+			m_rtpData[i]->GetDataView(pDest, cachedTracks);
+		if (pData == pDest) {
+			*pBufferUsed += dataSize;
+		}
+
+		// extend the last entry if this data directly follows it
+		struct iovec* pLast = (*pNumIov > 0) ? &pIov[*pNumIov - 1] : NULL;
+		if (pLast && (u_int8_t*)pLast->iov_base + pLast->iov_len == pData) {
+			pLast->iov_len += dataSize;
+			continue;
+		}
+		if (*pNumIov == maxIov) {
+			return MP4_STATUS_BUFFER_TOO_SMALL;
+		}
+		pIov[*pNumIov].iov_base = (void*)pData;
+		pIov[*pNumIov].iov_len = dataSize;
+		(*pNumIov)++;
+	}
+
+	return MP4_STATUS_OK;
+}
+
 void MP4RtpPacket::Write(MP4File* pFile)
 {
 	MP4Container::Write(pFile);
@@ -1237,6 +1355,46 @@ void MP4RtpSampleData::GetData(u_int8_t* pDest)
 		pDest);
 }
 
+const u_int8_t* MP4RtpSampleData::GetDataView(
+	u_int8_t* pDest, MP4TrackArray& cachedTracks)
+{
+	u_int8_t trackRefIndex = 
+		((MP4Integer8Property*)m_pProperties[1])->GetValue();
+
+	MP4Track* pSampleTrack =
+		FindTrackFromRefIndex(trackRefIndex);
+
+	MP4SampleId sampleId = 
+		((MP4Integer32Property*)m_pProperties[3])->GetValue();
+	u_int32_t sampleOffset = 
+		((MP4Integer32Property*)m_pProperties[4])->GetValue();
+	u_int16_t sampleLength = 
+		((MP4Integer16Property*)m_pProperties[2])->GetValue();
+
+	// a track only caches one sample, so once an earlier entry points
+	// into it, data from other samples of that track has to be copied
+	bool replaceCached = true;
+	for (u_int32_t i = 0; i < cachedTracks.Size(); i++) {
+		if (cachedTracks[i] == pSampleTrack) {
+			replaceCached = false;
+			break;
+		}
+	}
+
+	const u_int8_t* pData = pSampleTrack->GetSampleFragmentView(
+		sampleId, sampleOffset, sampleLength, replaceCached);
+
+	if (pData == NULL) {
+		pSampleTrack->ReadSampleFragmentUncached(
+			sampleId, sampleOffset, sampleLength, pDest);
+		return pDest;
+	}
+	if (replaceCached) {
+		cachedTracks.Add(pSampleTrack);
+	}
+	return pData;
+}
+
 void MP4RtpSampleData::WriteEmbeddedData(MP4File* pFile, u_int64_t startPos)
 {
 	// if not using embedded data, nothing to do
@@ -38,6 +38,14 @@ public:
 	virtual u_int16_t GetDataSize() = 0;
 	virtual void GetData(u_int8_t* pDest) = 0;
 
+	// returns a pointer to the data where it already is in memory,
+	// or copies it to pDest and returns pDest, see GetDataIov()
+	virtual const u_int8_t* GetDataView(
+			u_int8_t* pDest, MP4TrackArray& cachedTracks) {
+		GetData(pDest);
+		return pDest;
+	}
+
 	MP4Track* FindTrackFromRefIndex(u_int8_t refIndex);
 
 	virtual void WriteEmbeddedData(MP4File* pFile, u_int64_t startPos) {
@@ -99,6 +107,9 @@ public:
 
 	void GetData(u_int8_t* pDest);
 
+	const u_int8_t* GetDataView(
+		u_int8_t* pDest, MP4TrackArray& cachedTracks);
+
 	void WriteEmbeddedData(MP4File* pFile, u_int64_t startPos);
 
 protected:
@@ -161,6 +172,13 @@ public:
 
 	void GetData(u_int8_t* pDest);
 
+	// describes the data with iovec entries that point into the 
+	// media samples where possible, anything that has to be copied
+	// goes into pBuffer after the first *pBufferUsed bytes
+	MP4Status GetDataIov(
+		u_int8_t* pBuffer, u_int32_t bufferSize, u_int32_t* pBufferUsed,
+		struct iovec* pIov, u_int32_t maxIov, u_int32_t* pNumIov);
+
 	void Read(MP4File* pFile);
 
 	void ReadExtra(MP4File* pFile);
@@ -285,6 +303,26 @@ public:
 		bool includeHeader = true,
 		bool includePayload = true);
 
+	// ReadPacket returning a status instead of throwing
+	MP4Status TryReadPacket(
+		u_int16_t packetIndex,
+		u_int8_t** ppBytes, 
+		u_int32_t* pNumBytes,
+		u_int32_t ssrc,
+		bool includeHeader = true,
+		bool includePayload = true);
+
+	// ReadPacket without copying the media data, see MP4ReadRtpPacketIov
+	MP4Status TryReadPacketIov(
+		u_int16_t packetIndex,
+		u_int8_t* pBuffer,
+		u_int32_t bufferSize,
+		struct iovec* pIov,
+		u_int32_t* pIovCount,
+		u_int32_t ssrc,
+		bool includeHeader = true,
+		bool includePayload = true);
+
 	MP4Timestamp GetRtpTimestampStart();
 
 	void SetRtpTimestampStart(MP4Timestamp start);
@@ -305,6 +343,10 @@ public:
 	void FinishWrite();
 
 protected:
+	// the fixed 12 byte RTP header of a packet of the read hint
+	void WriteRtpHeader(MP4RtpPacket* pPacket, u_int32_t ssrc,
+		u_int8_t* pDest);
+
 	MP4Track*	m_pRefTrack;
 
 	MP4StringProperty*		m_pRtpMapProperty;
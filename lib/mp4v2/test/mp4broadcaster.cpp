@@ -259,30 +259,37 @@ int main(int argc, char** argv)
 		u_int16_t packetIndex;
 
 		for (packetIndex = 0; packetIndex < numPackets; packetIndex++) {
-			u_int8_t* pPacket = NULL;
-			u_int32_t packetSize;
-
-			// get the packet from the library
-			MP4ReadRtpPacket(
-				mp4File, 
-				hintTrackIds[nextTrackIndex], 
-				packetIndex,
-				&pPacket,
-				&packetSize,
-				ssrc);
-
-			if (pPacket == NULL) {
+			static u_int8_t packetBuffer[0x10000];
+			struct iovec iov[64];
+			u_int32_t iovCount = NUM_ELEMENTS_IN_ARRAY(iov);
+
+			// get the packet from the library, the media data 
+			// isn't copied, the iovec entries point at it
+			if (!MP4ReadRtpPacketIov(
+			  mp4File, 
+			  hintTrackIds[nextTrackIndex], 
+			  packetIndex,
+			  packetBuffer,
+			  sizeof(packetBuffer),
+			  iov,
+			  &iovCount,
+			  ssrc)) {
 				// error, but forge on
 				continue;
 			}
 
 			// send it out via UDP
-			send(udpSockets[nextTrackIndex * 2], pPacket, packetSize, 0);
+			struct msghdr msg;
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_iov = iov;
+			msg.msg_iovlen = iovCount;
 
-			// free packet buffer
-			free(pPacket);
+			ssize_t packetSize = 
+				sendmsg(udpSockets[nextTrackIndex * 2], &msg, 0);
 
-			bytesSent[nextTrackIndex] += packetSize - 12;
+			if (packetSize > 12) {
+				bytesSent[nextTrackIndex] += packetSize - 12;
+			}
 		}
 
 		packetsSent[nextTrackIndex] += numPackets;
@@ -0,0 +1,102 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ * 
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ * 
+ * The Original Code is MPEG4IP.
+ * 
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2001.  All Rights Reserved.
+ * 
+ * Contributor(s): 
+ *		Dave Mackie		dmackie@cisco.com
+ */
+
+/*
+ * mp4propbench - time getting a track property by name 
+ * against getting it through a property handle
+ */
+
+#include "mp4.h"
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+int main(int argc, char** argv)
+{
+	const char* propName = "mdia.mdhd.timeScale";
+	u_int32_t iterations = 100000;
+
+	if (argc < 2) {
+		fprintf(stderr, 
+			"Usage: %s <file> [<iterations> [<track-property>]]\n", 
+			argv[0]);
+		exit(1);
+	}
+	if (argc > 2) {
+		iterations = strtoul(argv[2], NULL, 10);
+		if (iterations == 0) {
+			iterations = 1;
+		}
+	}
+	if (argc > 3) {
+		propName = argv[3];
+	}
+
+	MP4FileHandle mp4File = MP4Read(argv[1], 0);
+	if (mp4File == MP4_INVALID_FILE_HANDLE) {
+		fprintf(stderr, "%s: can't open %s\n", argv[0], argv[1]);
+		exit(1);
+	}
+
+	MP4TrackId trackId = MP4FindTrackId(mp4File, 0);
+	MP4PropertyHandle hProperty = 
+		MP4GetTrackPropertyHandle(mp4File, trackId, propName);
+	if (hProperty == MP4_INVALID_PROPERTY_HANDLE) {
+		fprintf(stderr, "%s: no %s in track %u\n", 
+			argv[0], propName, trackId);
+		exit(1);
+	}
+
+	u_int64_t value = 0;
+	u_int64_t sum = 0;
+
+	double start = now();
+	for (u_int32_t i = 0; i < iterations; i++) {
+		MP4GetTrackIntegerProperty(mp4File, trackId, propName, &value);
+		sum += value;
+	}
+	double byName = now() - start;
+
+	start = now();
+	for (u_int32_t i = 0; i < iterations; i++) {
+		MP4GetHandleIntegerProperty(mp4File, hProperty, &value);
+		sum -= value;
+	}
+	double byHandle = now() - start;
+
+	MP4FreePropertyHandle(mp4File, hProperty);
+	MP4Close(mp4File);
+
+	if (sum != 0) {
+		fprintf(stderr, "%s: handle and name values differ\n", argv[0]);
+		exit(1);
+	}
+
+	printf("%s: %s %u gets, by name %.1f ns, by handle %.1f ns\n",
+		argv[1], propName, iterations,
+		(byName / iterations) * 1.0e9, (byHandle / iterations) * 1.0e9);
+
+	exit(0);
+}
@@ -0,0 +1,89 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ * 
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ * 
+ * The Original Code is MPEG4IP.
+ * 
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2001.  All Rights Reserved.
+ * 
+ * Contributor(s): 
+ *		Dave Mackie		dmackie@cisco.com
+ */
+
+/*
+ * mp4readbench - time how long it takes to open an mp4 file
+ * and parse its sample tables, optionally via a memory mapping
+ */
+
+#include "mp4.h"
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+int main(int argc, char** argv)
+{
+	bool mapped = false;
+	u_int32_t iterations = 10;
+
+	if (argc > 1 && !strcmp(argv[1], "-m")) {
+		mapped = true;
+		argc--;
+		argv++;
+	}
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s [-m] <file> [<iterations>]\n", argv[0]);
+		exit(1);
+	}
+	if (argc > 2) {
+		iterations = strtoul(argv[2], NULL, 10);
+		if (iterations == 0) {
+			iterations = 1;
+		}
+	}
+
+	double total = 0.0;
+	double best = 0.0;
+	u_int32_t numTracks = 0;
+
+	for (u_int32_t i = 0; i < iterations; i++) {
+		double start = now();
+
+		MP4FileHandle mp4File;
+		if (mapped) {
+			mp4File = MP4ReadMapped(argv[1], 0);
+		} else {
+			mp4File = MP4Read(argv[1], 0);
+		}
+		if (mp4File == MP4_INVALID_FILE_HANDLE) {
+			fprintf(stderr, "%s: can't open %s\n", argv[0], argv[1]);
+			exit(1);
+		}
+		numTracks = MP4GetNumberOfTracks(mp4File);
+		MP4Close(mp4File);
+
+		double elapsed = now() - start;
+		total += elapsed;
+		if (i == 0 || elapsed < best) {
+			best = elapsed;
+		}
+	}
+
+	printf("%s: %u tracks, %u opens, average %.3f ms, best %.3f ms\n",
+		argv[1], numTracks, iterations,
+		(total / iterations) * 1000.0, best * 1000.0);
+
+	exit(0);
+}
@@ -0,0 +1,100 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ * 
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ * 
+ * The Original Code is MPEG4IP.
+ * 
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2001.  All Rights Reserved.
+ * 
+ * Contributor(s): 
+ *		Dave Mackie		dmackie@cisco.com
+ */
+
+/*
+ * mp4writebench - time writing samples to an mp4 file, 
+ * a video track and an audio track interleaved as a recorder would
+ */
+
+#include "mp4.h"
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+int main(int argc, char** argv)
+{
+	u_int32_t numSamples = 30000;
+	u_int32_t videoSampleSize = 8000;
+
+	if (argc < 2) {
+		fprintf(stderr, 
+			"Usage: %s <file> [<video-samples> [<video-sample-size>]]\n", 
+			argv[0]);
+		exit(1);
+	}
+	if (argc > 2) {
+		numSamples = strtoul(argv[2], NULL, 10);
+	}
+	if (argc > 3) {
+		videoSampleSize = strtoul(argv[3], NULL, 10);
+	}
+
+	u_int32_t audioSampleSize = 256;
+	u_int8_t* pVideoSample = (u_int8_t*)malloc(videoSampleSize);
+	u_int8_t* pAudioSample = (u_int8_t*)malloc(audioSampleSize);
+	memset(pVideoSample, 0x55, videoSampleSize);
+	memset(pAudioSample, 0xAA, audioSampleSize);
+
+	double start = now();
+
+	MP4FileHandle mp4File = MP4Create(argv[1], 0);
+	if (mp4File == MP4_INVALID_FILE_HANDLE) {
+		fprintf(stderr, "%s: can't create %s\n", argv[0], argv[1]);
+		exit(1);
+	}
+	MP4SetTimeScale(mp4File, 90000);
+
+	MP4TrackId videoTrackId = MP4AddVideoTrack(mp4File, 
+		90000, 3000, 320, 240, MP4_MPEG4_VIDEO_TYPE);
+	MP4TrackId audioTrackId = MP4AddAudioTrack(mp4File, 
+		48000, 1024, MP4_MPEG4_AUDIO_TYPE);
+
+	u_int64_t numBytes = 0;
+	for (u_int32_t i = 0; i < numSamples; i++) {
+		MP4WriteSample(mp4File, videoTrackId, 
+			pVideoSample, videoSampleSize, 
+			MP4_INVALID_DURATION, 0, (i % 30) == 0);
+		numBytes += videoSampleSize;
+
+		// about 47 audio frames a second against 30 video frames
+		if ((i * 47) / 30 != ((i + 1) * 47) / 30) {
+			MP4WriteSample(mp4File, audioTrackId, 
+				pAudioSample, audioSampleSize);
+			numBytes += audioSampleSize;
+		}
+	}
+
+	MP4Close(mp4File);
+
+	double elapsed = now() - start;
+
+	printf("%s: %u video samples, %.1f MB in %.3f s, %.1f MB/s\n",
+		argv[1], numSamples, numBytes / 1000000.0, elapsed, 
+		(numBytes / 1000000.0) / elapsed);
+
+	free(pVideoSample);
+	free(pAudioSample);
+	exit(0);
+}
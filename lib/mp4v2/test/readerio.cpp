@@ -0,0 +1,186 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ *
+ * The Original Code is MPEG4IP.
+ *
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2005.  All Rights Reserved.
+ *
+ * Contributor(s):
+ *		Dave Mackie		dmackie@cisco.com
+ */
+
+/*
+ * readerio - write a file, then read it back from memory through a
+ * Virtual_IO with MP4ReadEx, and check that a reader gets the same
+ * samples as MP4ReadSample.  The name given to MP4ReadEx isn't a
+ * file, so a reader that went around the Virtual_IO would fail
+ */
+
+#include "mp4.h"
+
+#define NUM_SAMPLES	50
+
+struct memory_file {
+	u_int8_t*	data;
+	u_int64_t	size;
+	u_int64_t	position;
+};
+
+static u_int64_t memory_length(void* user)
+{
+	return ((memory_file*)user)->size;
+}
+
+static int memory_set_position(void* user, u_int64_t position)
+{
+	memory_file* mf = (memory_file*)user;
+	if (position > mf->size) {
+		return -1;
+	}
+	mf->position = position;
+	return 0;
+}
+
+static int memory_get_position(void* user, u_int64_t* position)
+{
+	*position = ((memory_file*)user)->position;
+	return 0;
+}
+
+static size_t memory_read(void* user, void* buffer, size_t size)
+{
+	memory_file* mf = (memory_file*)user;
+	if (size > mf->size - mf->position) {
+		size = mf->size - mf->position;
+	}
+	memcpy(buffer, mf->data + mf->position, size);
+	mf->position += size;
+	return size;
+}
+
+static size_t memory_write(void* user, void* buffer, size_t size)
+{
+	return 0;
+}
+
+static int memory_eof(void* user)
+{
+	memory_file* mf = (memory_file*)user;
+	return mf->position >= mf->size;
+}
+
+static int memory_close(void* user)
+{
+	return 0;
+}
+
+static Virtual_IO_t memory_io = {
+	memory_length,
+	memory_set_position,
+	memory_get_position,
+	memory_read,
+	memory_write,
+	memory_eof,
+	memory_close,
+};
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <file>\n", argv[0]);
+		exit(1);
+	}
+
+	MP4FileHandle mp4File = MP4Create(argv[1], 0);
+	if (mp4File == MP4_INVALID_FILE_HANDLE) {
+		exit(1);
+	}
+	MP4SetTimeScale(mp4File, 90000);
+	MP4TrackId trackId = MP4AddVideoTrack(mp4File,
+		90000, 3000, 320, 240, MP4_MPEG4_VIDEO_TYPE);
+
+	u_int8_t sample[256];
+	for (u_int32_t i = 1; i <= NUM_SAMPLES; i++) {
+		memset(sample, i, sizeof(sample));
+		MP4WriteSample(mp4File, trackId, sample, 100 + i,
+			MP4_INVALID_DURATION, 0, (i % 10) == 1);
+	}
+	MP4Close(mp4File);
+
+	// read the whole file into memory
+	memory_file mf;
+	FILE* pFile = fopen(argv[1], "rb");
+	if (pFile == NULL) {
+		fprintf(stderr, "%s: can't open %s\n", argv[0], argv[1]);
+		exit(1);
+	}
+	fseek(pFile, 0, SEEK_END);
+	mf.size = ftell(pFile);
+	mf.position = 0;
+	mf.data = (u_int8_t*)malloc(mf.size);
+	fseek(pFile, 0, SEEK_SET);
+	if (fread(mf.data, 1, mf.size, pFile) != mf.size) {
+		fprintf(stderr, "%s: can't read %s\n", argv[0], argv[1]);
+		exit(1);
+	}
+	fclose(pFile);
+
+	mp4File = MP4ReadEx("memory:readerio", &mf, &memory_io);
+	if (mp4File == MP4_INVALID_FILE_HANDLE) {
+		fprintf(stderr, "%s: can't read from memory\n", argv[0]);
+		exit(1);
+	}
+	MP4ReaderHandle hReader = MP4CreateReader(mp4File);
+	if (hReader == MP4_INVALID_READER_HANDLE) {
+		fprintf(stderr, "%s: can't create a reader\n", argv[0]);
+		exit(1);
+	}
+
+	u_int32_t errors = 0;
+	for (u_int32_t i = 1; i <= NUM_SAMPLES; i++) {
+		u_int8_t* pBytes = NULL;
+		u_int32_t numBytes = 0;
+		u_int8_t* pReaderBytes = NULL;
+		u_int32_t readerNumBytes = 0;
+		MP4Duration duration = 0;
+		bool isSync = false;
+
+		if (!MP4ReadSample(mp4File, trackId, i, &pBytes, &numBytes)
+		  || !MP4ReaderReadSample(hReader, trackId, i,
+			&pReaderBytes, &readerNumBytes, NULL, &duration, NULL,
+			&isSync)) {
+			printf("sample %u: can't read\n", i);
+			errors++;
+		} else if (numBytes != 100 + i || readerNumBytes != numBytes
+		  || memcmp(pBytes, pReaderBytes, numBytes) != 0
+		  || pReaderBytes[0] != i) {
+			printf("sample %u: reader got %u bytes, should be %u\n",
+				i, readerNumBytes, numBytes);
+			errors++;
+		} else if (duration != 3000 || isSync != ((i % 10) == 1)) {
+			printf("sample %u: duration "D64" sync %d\n",
+				i, duration, isSync);
+			errors++;
+		}
+		free(pBytes);
+		free(pReaderBytes);
+	}
+
+	MP4CloseReader(hReader);
+	MP4Close(mp4File);
+	free(mf.data);
+
+	printf("%s: %u samples through a Virtual_IO reader, %u errors\n",
+		argv[0], NUM_SAMPLES, errors);
+	exit(errors == 0 ? 0 : 1);
+}
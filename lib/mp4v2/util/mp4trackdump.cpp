@@ -30,6 +30,8 @@
 char* ProgName;
 char* Mp4PathName;
 char* Mp4FileName;
+#define TIMES_BLOCK 1024
+
 static void DumpTrack (MP4FileHandle mp4file, MP4TrackId tid)
 {
   uint32_t numSamples;
@@ -37,6 +39,8 @@ static void DumpTrack (MP4FileHandle mp4file, MP4TrackId tid)
   MP4Duration time;
   uint32_t timescale;
   uint64_t msectime;
+  MP4Timestamp times[TIMES_BLOCK];
+  MP4Duration durations[TIMES_BLOCK];
 
   uint64_t sectime, mintime, hrtime;
 
@@ -46,7 +50,18 @@ static void DumpTrack (MP4FileHandle mp4file, MP4TrackId tid)
 	 Mp4FileName, tid, numSamples, timescale);
 
   for (sid = 1; sid <= numSamples; sid++) {
-    time = MP4GetSampleTime(mp4file, tid, sid);
+    uint32_t ix = (sid - 1) % TIMES_BLOCK;
+    if (ix == 0) {
+      // fetch the sample times a block at a time
+      uint32_t count = MIN(TIMES_BLOCK, numSamples - sid + 1);
+      if (MP4GetSampleTimes(mp4file, tid, sid, count, 
+			    times, durations) == false) {
+	fprintf(stderr, "%s: can't get sample times for track %u\n",
+		ProgName, tid);
+	return;
+      }
+    }
+    time = times[ix];
     msectime = time;
     msectime *= TO_U64(1000);
     msectime /= timescale;
@@ -63,7 +78,7 @@ static void DumpTrack (MP4FileHandle mp4file, MP4TrackId tid)
 
     printf("sampleId %6d, size %5u duration %8"U64F" time %8"U64F" %02"U64F":%02"U64F":%02"U64F".%03"U64F" %c\n",
 	  sid,  MP4GetSampleSize(mp4file, tid, sid), 
-	   MP4GetSampleDuration(mp4file, tid, sid),
+	   durations[ix],
 	   time, hrtime, mintime, sectime, msectime,
 	   MP4GetSampleSync(mp4file, tid, sid) == 1 ? 'S' : ' ');
   }
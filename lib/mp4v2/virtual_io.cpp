@@ -90,3 +90,150 @@ Virtual_IO FILE_virtual_IO =
 		FILE_EndOfFile,
 		FILE_Close,
 };
+
+/* --------- Virtual IO for read only memory mapped files --------- */
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+
+typedef struct MMAP_file_t {
+	int fd;
+	u_int8_t *base;
+	u_int64_t size;
+	u_int64_t position;
+} MMAP_file_t;
+
+// returns NULL if the file can't be mapped, the caller should
+// fall back to FILE_virtual_IO
+void *MMAP_Open(const char *fileName)
+{
+	int flags = O_RDONLY;
+#ifdef O_LARGEFILE
+	flags |= O_LARGEFILE;
+#endif
+	int fd = open(fileName, flags);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct stat s;
+	if (fstat(fd, &s) < 0 || s.st_size == 0 ||
+	    (u_int64_t)s.st_size != (u_int64_t)(size_t)s.st_size) {
+		close(fd);
+		return NULL;
+	}
+
+	void *base = mmap(NULL, s.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		close(fd);
+		return NULL;
+	}
+
+	MMAP_file_t *mf = MALLOC_STRUCTURE(MMAP_file_t);
+	mf->fd = fd;
+	mf->base = (u_int8_t *)base;
+	mf->size = s.st_size;
+	mf->position = 0;
+	return mf;
+}
+
+const u_int8_t *MMAP_GetBytes(void *user, u_int64_t position, 
+			      u_int32_t numBytes)
+{
+	MMAP_file_t *mf = (MMAP_file_t *)user;
+	if (position > mf->size || numBytes > mf->size - position) {
+		return NULL;
+	}
+	return mf->base + position;
+}
+
+u_int64_t MMAP_GetFileLength(void *user)
+{
+	MMAP_file_t *mf = (MMAP_file_t *)user;
+	return mf->size;
+}
+
+int MMAP_SetPosition(void *user, u_int64_t position)
+{
+	MMAP_file_t *mf = (MMAP_file_t *)user;
+	if (position > mf->size) {
+		return -1;
+	}
+	mf->position = position;
+	return 0;
+}
+
+int MMAP_GetPosition(void *user, u_int64_t *position)
+{
+	MMAP_file_t *mf = (MMAP_file_t *)user;
+	*position = mf->position;
+	return 0;
+}
+
+size_t MMAP_Read(void *user, void *buffer, size_t size)
+{
+	MMAP_file_t *mf = (MMAP_file_t *)user;
+	if (size > mf->size - mf->position) {
+		size = mf->size - mf->position;
+	}
+	memcpy(buffer, mf->base + mf->position, size);
+	mf->position += size;
+	return size;
+}
+
+size_t MMAP_Write(void *user, void *buffer, size_t size)
+{
+	return 0;
+}
+
+int MMAP_EndOfFile(void *user)
+{
+	MMAP_file_t *mf = (MMAP_file_t *)user;
+	return mf->position >= mf->size;
+}
+
+int MMAP_Close(void *user)
+{
+	MMAP_file_t *mf = (MMAP_file_t *)user;
+	munmap(mf->base, mf->size);
+	int ret = close(mf->fd);
+	free(mf);
+	return ret;
+}
+
+Virtual_IO MMAP_virtual_IO =
+{
+	MMAP_GetFileLength,
+		MMAP_SetPosition,
+		MMAP_GetPosition,
+		MMAP_Read,
+		MMAP_Write,
+		MMAP_EndOfFile,
+		MMAP_Close,
+};
+
+#else
+
+void *MMAP_Open(const char *fileName)
+{
+	return NULL;
+}
+
+const u_int8_t *MMAP_GetBytes(void *user, u_int64_t position, 
+			      u_int32_t numBytes)
+{
+	return NULL;
+}
+
+// never used, MMAP_Open always fails
+Virtual_IO MMAP_virtual_IO =
+{
+	FILE_GetFileLength,
+		FILE_SetPosition,
+		FILE_GetPosition,
+		FILE_Read,
+		FILE_Write,
+		FILE_EndOfFile,
+		FILE_Close,
+};
+#endif
@@ -28,4 +28,11 @@
 
 extern Virtual_IO FILE_virtual_IO;
 
+/* read only memory mapped files, see MMAP_Open */
+extern Virtual_IO MMAP_virtual_IO;
+
+void *MMAP_Open(const char *fileName);
+const u_int8_t *MMAP_GetBytes(void *user, u_int64_t position, 
+			      u_int32_t numBytes);
+
 #endif
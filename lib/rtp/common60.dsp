@@ -244,6 +244,10 @@ SOURCE=.\rtp.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\rtp_loop.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\util.c
 # End Source File
 # End Group
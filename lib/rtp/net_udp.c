@@ -39,6 +39,9 @@
 /* appropriate system header files should also be included   */
 /* by those files.                                           */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	/* for sendmmsg and recvmmsg */
+#endif
 #include "config_unix.h"
 #include "config_win32.h"
 #include "debug.h"
@@ -113,6 +116,9 @@ struct socket_udp_ {
 #ifdef HAVE_IPv6
 	struct in6_addr	 addr6;
 #endif /* HAVE_IPv6 */
+	/* datagrams waiting for udp_send_flush */
+	uint32_t	 queue_count;
+	struct iovec	 queue[UDP_SEND_QUEUE_MAX];
 };
 
 #ifdef _WIN32
@@ -280,6 +286,7 @@ static socket_udp *udp_init4 (const char *addr, const char *iface,
 
   socket_udp         	*s = (socket_udp *)malloc(sizeof(socket_udp));
   s->mode    = IPv4;
+  s->queue_count = 0;
   s->addr    = NULL;
   s->rx_port = rx_port;
   s->tx_port = tx_port;
@@ -564,6 +571,7 @@ static socket_udp *udp_init6(const char *addr, const char *iface, uint16_t rx_po
   struct sockaddr_in6 s_in;
   socket_udp         *s = (socket_udp *) malloc(sizeof(socket_udp));
   s->mode    = IPv6;
+  s->queue_count = 0;
   s->addr    = NULL;
   s->rx_port = rx_port;
   s->tx_port = tx_port;
@@ -963,6 +971,119 @@ int udp_sendto_iov(socket_udp *s, struct iovec *iov, int count,
 }
 #endif
 
+/**
+ * udp_send_queue:
+ * @s: UDP session.
+ * @buffer: pointer to buffer to be transmitted.
+ * @buflen: length of @buffer.
+ *
+ * Queues a UDP datagram, to be transmitted by the next udp_send_flush().
+ * @buffer is not copied, and must stay valid until then.  At most
+ * UDP_SEND_QUEUE_MAX datagrams can be queued.
+ *
+ * Return value: 0 on success, -1 if the queue is full.
+ **/
+int udp_send_queue(socket_udp *s, const uint8_t *buffer, uint32_t buflen)
+{
+	ASSERT(s != NULL);
+	ASSERT(buffer != NULL);
+	ASSERT(buflen > 0);
+
+	if (s->queue_count >= UDP_SEND_QUEUE_MAX) {
+		return -1;
+	}
+	s->queue[s->queue_count].iov_base = (void *)buffer;
+	s->queue[s->queue_count].iov_len = buflen;
+	s->queue_count++;
+	return 0;
+}
+
+/**
+ * udp_send_flush:
+ * @s: UDP session.
+ *
+ * Transmits the datagrams queued by udp_send_queue(), with a single
+ * sendmmsg() where the system has it.  A datagram that can't be sent
+ * is dropped, and the ones after it are still sent.  The queue is empty
+ * afterwards.
+ *
+ * Return value: the number of datagrams sent, -1 on failure.
+ **/
+int udp_send_flush(socket_udp *s)
+{
+	uint32_t sent = 0;
+#ifdef HAVE_SENDMMSG
+	struct sockaddr_storage to;
+	socklen_t tolen;
+	struct mmsghdr msgs[UDP_SEND_QUEUE_MAX];
+	uint32_t ix;
+	int ret;
+
+	memset(&to, 0, sizeof(to));
+	if (s->mode == IPv4) {
+		struct sockaddr_in *s_in = (struct sockaddr_in *)&to;
+		s_in->sin_family      = AF_INET;
+		s_in->sin_addr.s_addr = s->addr4.s_addr;
+		s_in->sin_port        = htons(s->tx_port);
+		tolen = sizeof(struct sockaddr_in);
+	} else {
+#ifdef HAVE_IPv6
+		struct sockaddr_in6 *s_in = (struct sockaddr_in6 *)&to;
+		s_in->sin6_family = AF_INET6;
+		s_in->sin6_addr   = s->addr6;
+		s_in->sin6_port   = htons(s->tx_port);
+#ifdef HAVE_SIN6_LEN
+		s_in->sin6_len    = sizeof(struct sockaddr_in6);
+#endif
+		tolen = sizeof(struct sockaddr_in6);
+#else
+		s->queue_count = 0;
+		return -1;
+#endif
+	}
+
+	memset(msgs, 0, s->queue_count * sizeof(struct mmsghdr));
+	for (ix = 0; ix < s->queue_count; ix++) {
+		msgs[ix].msg_hdr.msg_name    = &to;
+		msgs[ix].msg_hdr.msg_namelen = tolen;
+		msgs[ix].msg_hdr.msg_iov     = &s->queue[ix];
+		msgs[ix].msg_hdr.msg_iovlen  = 1;
+	}
+	/* sendmmsg can stop short, carry on from there.  It only fails
+	   when the first datagram can't be sent, so skip that one */
+	ix = 0;
+	while (ix < s->queue_count) {
+		ret = sendmmsg(s->fd, &msgs[ix], s->queue_count - ix, 0);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ret <= 0) {
+			rtp_message(LOG_ERR, "sendmmsg %d %s", 
+				    errno, strerror(errno));
+			ix++;
+		} else {
+			ix += ret;
+			sent += ret;
+		}
+	}
+#else
+	uint32_t ix;
+
+	for (ix = 0; ix < s->queue_count; ix++) {
+		if (udp_send(s, (uint8_t *)s->queue[ix].iov_base,
+			     s->queue[ix].iov_len) >= 0) {
+			sent++;
+		}
+	}
+#endif
+	if (sent == 0 && s->queue_count > 0) {
+		s->queue_count = 0;
+		return -1;
+	}
+	s->queue_count = 0;
+	return sent;
+}
+
 /**
  * udp_recv:
  * @s: UDP session.
@@ -1004,6 +1125,75 @@ uint32_t udp_recv(socket_udp *s, uint8_t *buffer, uint32_t buflen)
   return udp_recv_with_source(s, buffer, buflen, NULL, 0);
 }
 
+/**
+ * udp_recv_batch:
+ * @s: UDP session.
+ * @buffers: buffers to read datagrams into, one each.
+ * @buflen: length of each of @buffers.
+ * @lengths: filled with the length of each datagram read.
+ * @count: number of @buffers - no more than UDP_RECV_BATCH_MAX are
+ * read at once.
+ *
+ * Reads up to @count datagrams that are already waiting, with a single
+ * recvmmsg() where the system has it.  Call it once udp_select() says
+ * the socket is readable.
+ *
+ * Return value: number of datagrams read, 0 if none are waiting.
+ **/
+uint32_t udp_recv_batch(socket_udp *s, uint8_t *buffers[], uint32_t buflen,
+			uint32_t lengths[], uint32_t count)
+{
+	uint32_t ix;
+#ifdef HAVE_RECVMMSG
+	struct mmsghdr msgs[UDP_RECV_BATCH_MAX];
+	struct iovec iov[UDP_RECV_BATCH_MAX];
+	int ret;
+
+	if (count > UDP_RECV_BATCH_MAX) {
+		count = UDP_RECV_BATCH_MAX;
+	}
+	memset(msgs, 0, sizeof(msgs));
+	for (ix = 0; ix < count; ix++) {
+		iov[ix].iov_base = buffers[ix];
+		iov[ix].iov_len = buflen;
+		msgs[ix].msg_hdr.msg_iov = &iov[ix];
+		msgs[ix].msg_hdr.msg_iovlen = 1;
+	}
+	ret = recvmmsg(s->fd, msgs, count, MSG_DONTWAIT, NULL);
+	if (ret <= 0) {
+		if (ret < 0 && errno != EAGAIN && errno != ECONNREFUSED) {
+			socket_error("recvmmsg");
+		}
+		return 0;
+	}
+	for (ix = 0; ix < (uint32_t)ret; ix++) {
+		lengths[ix] = msgs[ix].msg_len;
+	}
+	return ret;
+#else
+	/* the first is there, by udp_select(); without MSG_DONTWAIT */
+	/* we can't find out if there are more without blocking       */
+	ix = 0;
+	if (count > 0) {
+		lengths[0] = udp_recv(s, buffers[0], buflen);
+		if (lengths[0] == 0) {
+			return 0;
+		}
+		ix = 1;
+	}
+#ifdef MSG_DONTWAIT
+	for (; ix < count; ix++) {
+		int len = recv(s->fd, buffers[ix], buflen, MSG_DONTWAIT);
+		if (len <= 0) {
+			break;
+		}
+		lengths[ix] = len;
+	}
+#endif
+	return ix;
+#endif
+}
+
 struct udp_set_ {
   fd_set	rfd;
   fd_t	max_fd;
@@ -61,8 +61,18 @@ int udp_sendto_iov(socket_udp *s, struct iovec *iov, int count,
 		   const struct sockaddr *to, const socklen_t tolen);
 #endif
 
+/* batched transmit - queue datagrams, then send them all at once */
+#define UDP_SEND_QUEUE_MAX 32
+int         udp_send_queue(socket_udp *s, const uint8_t *buffer, uint32_t buflen);
+int         udp_send_flush(socket_udp *s);
+
 uint32_t         udp_recv(socket_udp *s, uint8_t *buffer, uint32_t buflen);
 
+/* batched receive - read the datagrams that are waiting at once */
+#define UDP_RECV_BATCH_MAX 32
+uint32_t    udp_recv_batch(socket_udp *s, uint8_t *buffers[], uint32_t buflen,
+			   uint32_t lengths[], uint32_t count);
+
 uint32_t  udp_recv_with_source(socket_udp *s, uint8_t *buffer, uint32_t buflen, 
 			       struct sockaddr *source, socklen_t *source_len);
 
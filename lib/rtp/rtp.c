@@ -103,6 +103,14 @@ static int des_encrypt(void *ifptr, uint8_t *data,
 
 #define RTP_LOWER_LAYER_OVERHEAD 28	/* IPv4 + UDP */
 
+/* Size of the pooled buffers outgoing RTP packets are built in; a */
+/* bigger packet gets a buffer of its own.                         */
+#define RTP_SEND_BUFFER_SIZE 2048
+/* iov entries rtp_send_data_iov can send without a malloc */
+#define RTP_SEND_IOV_MAX 8
+/* received packets kept for reuse by rtp_free_packet() */
+#define RTP_RECV_POOL_MAX 256
+
 #define RTCP_SR   200
 #define RTCP_RR   201
 #define RTCP_SDES 202
@@ -153,12 +161,11 @@ typedef struct {
   } r;
 } rtcp_t;
 
+/* Reception reports are kept on the list of the source that sent them */
 typedef struct _rtcp_rr_wrapper {
   struct _rtcp_rr_wrapper	*next;
-  struct _rtcp_rr_wrapper	*prev;
-  uint32_t                 reporter_ssrc;
   rtcp_rr			*rr;
-  struct timeval		*ts;	/* Arrival time of this RR */
+  struct timeval		 ts;	/* Arrival time of this RR */
 } rtcp_rr_wrapper;
 
 /*
@@ -167,8 +174,6 @@ typedef struct _rtcp_rr_wrapper {
  */
 
 typedef struct _source {
-  struct _source	*next;
-  struct _source	*prev;
   uint32_t	 ssrc;
   char		*cname;
   char		*name;
@@ -194,19 +199,21 @@ typedef struct _source {
   int		 probation;
   uint32_t	 jitter;
   uint32_t	 transit;
+  rtcp_rr_wrapper *rr_list;		/* RRs this source sent, newest first */
+  int		 rr_reportee_count;	/* RRs on the lists of sources about this one */
   uint32_t	 magic;			/* For debugging... */
 } source;
 
-/* The size of the hash table used to hold the source database. */
-/* Should be large enough that we're unlikely to get collisions */
-/* when sources are added, but not too large that we waste too  */
-/* much memory. Sedgewick ("Algorithms", 2nd Ed, Addison-Wesley */
-/* 1988) suggests that this should be around 1/10th the number  */
-/* of entries that we expect to have in the database and should */
-/* be a prime number. Everything continues to work if this is   */
-/* too low, it just goes slower... for now we assume around 100 */
-/* participants is a sensible limit so we set this to 11.       */   
-#define RTP_DB_SIZE	11
+/* The source database is a hash table using open addressing with   */
+/* linear probing, so finding a source costs a probe or two however */
+/* many there are - a large multicast session can have thousands of */
+/* receivers sending RTCP.  The size is a power of two, and the     */
+/* table is grown when it is 3/4 full.  Deleted sources leave a     */
+/* RTP_DB_DELETED marker so that walking the table while deleting   */
+/* sources, as rtp_update() does, doesn't move anything.            */
+#define RTP_DB_INITIAL_SIZE	16
+static source	 db_deleted_slot;
+#define RTP_DB_DELETED	(&db_deleted_slot)
 
 /*
  *  Options for an RTP session are stored in the "options" struct.
@@ -216,6 +223,8 @@ typedef struct {
   int 	promiscuous_mode;
   int	wait_for_rtcp;
   int	filter_my_packets;
+  int	queue_sends;
+  int	check_database;
 } options;
 
 /*
@@ -233,8 +242,10 @@ struct rtp {
   int		 ttl;
   uint32_t	 my_ssrc;
   int		 last_advertised_csrc;
-  source		*db[RTP_DB_SIZE];
-  rtcp_rr_wrapper  rr[RTP_DB_SIZE][RTP_DB_SIZE]; 	/* Indexed by [hash(reporter)][hash(reportee)] */
+  source		**db;
+  uint32_t	 db_size;		/* slots in db, a power of two */
+  uint32_t	 db_count;		/* sources in db */
+  uint32_t	 db_used;		/* slots that aren't empty, deleted or not */
   options		*opt;
   void		*recv_userdata, *send_userdata;
   int		 invalid_rtp_count;
@@ -281,6 +292,18 @@ struct rtp {
   uint32_t	 magic;				/* For debugging...  */
   uint8_t *m_output_buffer; // to consolidate IOVs for encryption
   uint32_t m_output_buffer_size;
+  /* buffers for outgoing RTP packets; the first send_queue_count */
+  /* hold packets queued on rtp_socket, waiting for rtp_send_flush */
+  uint8_t *send_buffers[UDP_SEND_QUEUE_MAX];
+  uint32_t send_queue_count;
+  /* packets for rtp_recv_batch to read into; a slot is emptied when */
+  /* its packet is handed to the callback                            */
+  rtp_packet *recv_ring[UDP_RECV_BATCH_MAX];
+  /* packets handed back by rtp_free_packet, linked by rtp_next.     */
+  /* They are freed by the decode threads, so this has its own lock  */
+  rtp_packet *recv_pool;
+  uint32_t recv_pool_count;
+  mutex_t recv_pool_mutex;
 
   mutex_t mutex;
   int use_mutex;
@@ -350,29 +373,145 @@ static int tv_gt(struct timeval a, struct timeval b)
   return a.tv_usec > b.tv_usec;
 }
 
+static uint32_t ssrc_hash(uint32_t ssrc)
+{
+  /* Hash from an ssrc to a position in the source database.   */
+  /* ssrc values should be uniformly distributed, but probably */
+  /* aren't (Rosenberg has reported that many implementations  */
+  /* generate ssrc values which are not uniformly distributed  */
+  /* over the space, and the H.323 spec requires that they are */
+  /* non-uniformly distributed), so the bits are mixed before  */
+  /* the size of the table is masked off.                      */
+  ssrc ^= ssrc >> 16;
+  ssrc *= 0x85ebca6b;
+  ssrc ^= ssrc >> 13;
+  ssrc *= 0xc2b2ae35;
+  ssrc ^= ssrc >> 16;
+  return ssrc;
+}
+
+/* The db_ routines manipulate the source database, with the */
+/* session mutex held by the caller.                         */
+
+static source *db_find(struct rtp *session, uint32_t ssrc)
+{
+  uint32_t	 mask = session->db_size - 1;
+  uint32_t	 h;
+  source	*s;
+
+  /* There is always an empty slot, see db_insert() */
+  for (h = ssrc_hash(ssrc) & mask; (s = session->db[h]) != NULL; h = (h + 1) & mask) {
+    if (s != RTP_DB_DELETED && s->ssrc == ssrc) {
+      return s;
+    }
+  }
+  return NULL;
+}
+
+static void db_resize(struct rtp *session, uint32_t size)
+{
+  source	**old_db   = session->db;
+  uint32_t	  old_size = session->db_size;
+  uint32_t	  i, h;
+
+  session->db = (source **) xmalloc(size * sizeof(source *));
+  memset(session->db, 0, size * sizeof(source *));
+  session->db_size = size;
+  session->db_used = session->db_count;
+  for (i = 0; i < old_size; i++) {
+    if (old_db[i] != NULL && old_db[i] != RTP_DB_DELETED) {
+      h = ssrc_hash(old_db[i]->ssrc) & (size - 1);
+      while (session->db[h] != NULL) {
+	h = (h + 1) & (size - 1);
+      }
+      session->db[h] = old_db[i];
+    }
+  }
+  if (old_db != NULL) {
+    xfree(old_db);
+  }
+}
+
+static void db_insert(struct rtp *session, source *s)
+{
+  /* The source must not already be in the database. */
+  uint32_t	 mask, h, size;
+
+  if ((session->db_used + 1) * 4 > session->db_size * 3) {
+    /* Mostly full - grow if that is with sources, otherwise */
+    /* rebuilding at the same size clears the deleted slots  */
+    size = session->db_size;
+    while ((session->db_count + 1) * 2 > size) {
+      size *= 2;
+    }
+    db_resize(session, size);
+  }
+  mask = session->db_size - 1;
+  h = ssrc_hash(s->ssrc) & mask;
+  while (session->db[h] != NULL && session->db[h] != RTP_DB_DELETED) {
+    h = (h + 1) & mask;
+  }
+  if (session->db[h] == NULL) {
+    session->db_used++;
+  }
+  session->db[h] = s;
+  session->db_count++;
+}
+
+static void db_remove(struct rtp *session, source *s)
+{
+  uint32_t	 mask = session->db_size - 1;
+  uint32_t	 h;
+
+  for (h = ssrc_hash(s->ssrc) & mask; session->db[h] != s; h = (h + 1) & mask) {
+    ASSERT(session->db[h] != NULL);	/* Else s isn't in the database... */
+  }
+  if (session->db[(h + 1) & mask] == NULL) {
+    /* The end of a run, no one needs to probe past it */
+    session->db[h] = NULL;
+    session->db_used--;
+  } else {
+    session->db[h] = RTP_DB_DELETED;
+  }
+  session->db_count--;
+}
+
+static source *db_next(struct rtp *session, uint32_t *pos)
+{
+  /* Walks the database, starting with *pos == 0. Sources may */
+  /* be deleted during the walk, but not created.             */
+  source	*s;
+
+  while (*pos < session->db_size) {
+    s = session->db[(*pos)++];
+    if (s != NULL && s != RTP_DB_DELETED) {
+      return s;
+    }
+  }
+  return NULL;
+}
+
 static uint32_t next_csrc(struct rtp *session)
 {
   /* This returns each source marked "should_advertise_sdes" in turn. */
-  int	 chain, cc;
+  int		 cc;
+  uint32_t	 pos;
   source	*s;
 
   cc = 0;
-  for (chain = 0; chain < RTP_DB_SIZE; chain++) {
-    /* Check that the linked lists making up the chains in */
-    /* the hash table are correctly linked together...     */
-    lock_mutex(session);
-    for (s = session->db[chain]; s != NULL; s = s->next) {
-      if (s->should_advertise_sdes) {
-	if (cc == session->last_advertised_csrc) {
-	  session->last_advertised_csrc++;
-	  if (session->last_advertised_csrc == session->csrc_count) {
-	    session->last_advertised_csrc = 0;
-	  }
-	  unlock_mutex(session);
-	  return s->ssrc;
-	} else {
-	  cc++;
+  pos = 0;
+  lock_mutex(session);
+  while ((s = db_next(session, &pos)) != NULL) {
+    if (s->should_advertise_sdes) {
+      if (cc == session->last_advertised_csrc) {
+	session->last_advertised_csrc++;
+	if (session->last_advertised_csrc == session->csrc_count) {
+	  session->last_advertised_csrc = 0;
 	}
+	unlock_mutex(session);
+	return s->ssrc;
+      } else {
+	cc++;
       }
     }
   }
@@ -380,108 +519,92 @@ static uint32_t next_csrc(struct rtp *session)
   abort();
 }
 
-static int ssrc_hash(uint32_t ssrc)
+static void free_rr(struct rtp *session, rtcp_rr_wrapper *cur)
 {
-  /* Hash from an ssrc to a position in the source database.   */
-  /* Assumes that ssrc values are uniformly distributed, which */
-  /* should be true but probably isn't (Rosenberg has reported */
-  /* that many implementations generate ssrc values which are  */
-  /* not uniformly distributed over the space, and the H.323   */
-  /* spec requires that they are non-uniformly distributed).   */
-  /* This routine is written as a function rather than inline  */
-  /* code to allow it to be made smart in future: probably we  */
-  /* should run MD5 on the ssrc and derive a hash value from   */
-  /* that, to ensure it's more uniformly distributed?          */
-  return ssrc % RTP_DB_SIZE;
+  /* Free an RR that has been taken off its reporter's list.   */
+  /* The caller holds the mutex.                               */
+  source	*reportee = db_find(session, cur->rr->ssrc);
+
+  if (reportee != NULL && reportee->rr_reportee_count > 0) {
+    reportee->rr_reportee_count--;
+  }
+  xfree(cur->rr);
+  xfree(cur);
 }
 
 static void insert_rr(struct rtp *session, uint32_t reporter_ssrc, rtcp_rr *rr, struct timeval *ts)
 {
   /* Insert the reception report into the receiver report      */
-  /* database. This database is a two dimensional table of     */
-  /* rr_wrappers indexed by hashes of reporter_ssrc and        */
-  /* reportee_src.  The rr_wrappers in the database are        */
-  /* sentinels to reduce conditions in list operations.        */
+  /* database. Each source has a list of the RRs it sent, one  */
+  /* for each reportee, and a count of the RRs about it on the */
+  /* lists of other sources, so deleting a source only has to  */
+  /* look at those lists when it was reported on.              */
   /* The ts is used to determine when to timeout this rr.      */
 
-  rtcp_rr_wrapper *cur, *start;
+  rtcp_rr_wrapper *cur;
+  source	  *reporter, *reportee;
 
   lock_mutex(session);
-  start = &session->rr[ssrc_hash(reporter_ssrc)][ssrc_hash(rr->ssrc)];
-  cur   = start->next;
-
-  while (cur != start) {
-    if (cur->reporter_ssrc == reporter_ssrc && cur->rr->ssrc == rr->ssrc) {
+  reporter = db_find(session, reporter_ssrc);
+  ASSERT(reporter != NULL);	/* process_rtcp_sr/rr created it... */
+  if (reporter == NULL) {
+    unlock_mutex(session);
+    return;
+  }
+  for (cur = reporter->rr_list; cur != NULL; cur = cur->next) {
+    if (cur->rr->ssrc == rr->ssrc) {
       /* Replace existing entry in the database  */
       xfree(cur->rr);
-      xfree(cur->ts);
       cur->rr = rr;
-      cur->ts = (struct timeval *) xmalloc(sizeof(struct timeval));
+      cur->ts = *ts;
       unlock_mutex(session);
-      memcpy(cur->ts, ts, sizeof(struct timeval));
       return;
     }
-    cur = cur->next;
   }
         
   /* No entry in the database so create one now. */
   cur = (rtcp_rr_wrapper*)xmalloc(sizeof(rtcp_rr_wrapper));
-  cur->reporter_ssrc = reporter_ssrc;
   cur->rr = rr;
-  cur->ts = (struct timeval *) xmalloc(sizeof(struct timeval));
-  memcpy(cur->ts, ts, sizeof(struct timeval));
-  /* Fix links */
-  cur->next       = start->next;
-  cur->next->prev = cur;
-  cur->prev       = start;
-  cur->prev->next = cur;
+  cur->ts = *ts;
+  cur->next = reporter->rr_list;
+  reporter->rr_list = cur;
+  reportee = db_find(session, rr->ssrc);
+  if (reportee != NULL) {
+    reportee->rr_reportee_count++;
+  }
   unlock_mutex(session);
 
   rtp_message(LOG_INFO, "Created new rr entry for 0x%08x from source 0x%08x", rr->ssrc, reporter_ssrc);
   return;
 }
 
-static void remove_rr(struct rtp *session, uint32_t ssrc)
+static void remove_rr(struct rtp *session, source *s)
 {
-  /* Remove any RRs from "s" which refer to "ssrc" as either   */
-  /* reporter or reportee.                                     */
-  rtcp_rr_wrapper *start, *cur, *tmp;
-  int i;
+  /* Remove any RRs which refer to "s" as either reporter or   */
+  /* reportee.                                                 */
+  rtcp_rr_wrapper *cur, **prev;
+  source	  *reporter;
+  uint32_t	   pos;
 
   lock_mutex(session);
-  /* Remove rows, i.e. ssrc == reporter_ssrc                   */
-  for(i = 0; i < RTP_DB_SIZE; i++) {
-    start = &session->rr[ssrc_hash(ssrc)][i];
-    cur   = start->next;
-    while (cur != start) {
-      if (cur->reporter_ssrc == ssrc) {
-	tmp = cur;
-	cur = cur->prev;
-	tmp->prev->next = tmp->next;
-	tmp->next->prev = tmp->prev;
-	xfree(tmp->ts);
-	xfree(tmp->rr);
-	xfree(tmp);
-      }
-      cur = cur->next;
-    }
-  }
-
-  /* Remove columns, i.e.  ssrc == reporter_ssrc */
-  for(i = 0; i < RTP_DB_SIZE; i++) {
-    start = &session->rr[i][ssrc_hash(ssrc)];
-    cur   = start->next;
-    while (cur != start) {
-      if (cur->rr->ssrc == ssrc) {
-	tmp = cur;
-	cur = cur->prev;
-	tmp->prev->next = tmp->next;
-	tmp->next->prev = tmp->prev;
-	xfree(tmp->ts);
-	xfree(tmp->rr);
-	xfree(tmp);
+  /* Remove the ones it sent...                                */
+  while ((cur = s->rr_list) != NULL) {
+    s->rr_list = cur->next;
+    free_rr(session, cur);
+  }
+
+  /* ...and the ones about it                                  */
+  pos = 0;
+  while (s->rr_reportee_count > 0 &&
+	 (reporter = db_next(session, &pos)) != NULL) {
+    prev = &reporter->rr_list;
+    while ((cur = *prev) != NULL) {
+      if (cur->rr->ssrc == s->ssrc) {
+	*prev = cur->next;
+	free_rr(session, cur);
+      } else {
+	prev = &cur->next;
       }
-      cur = cur->next;
     }
   }
   unlock_mutex(session);
@@ -491,35 +614,30 @@ static void timeout_rr(struct rtp *session, struct timeval *curr_ts)
 {
   /* Timeout any reception reports which have been in the database for more than 3 */
   /* times the RTCP reporting interval without refresh.                            */
-  rtcp_rr_wrapper *start, *cur, *tmp;
+  rtcp_rr_wrapper *cur, **prev;
   rtp_event	 event;
-  int 		 i, j;
+  source	*s;
+  uint32_t	 pos;
 
   lock_mutex(session);
-  for(i = 0; i < RTP_DB_SIZE; i++) {
-    for(j = 0; j < RTP_DB_SIZE; j++) {
-      start = &session->rr[i][j];
-      cur   = start->next;
-      while (cur != start) {
-	if (tv_diff(*curr_ts, *(cur->ts)) > (session->rtcp_interval * 3)) {
-	  /* Signal the application... */
-	  if (!filter_event(session, cur->reporter_ssrc)) {
-	    event.ssrc = cur->reporter_ssrc;
-	    event.type = RR_TIMEOUT;
-	    event.data = cur->rr;
-	    event.ts   = curr_ts;
-	    session->callback(session, &event);
-	  }
-	  /* Delete this reception report... */
-	  tmp = cur;
-	  cur = cur->prev;
-	  tmp->prev->next = tmp->next;
-	  tmp->next->prev = tmp->prev;
-	  xfree(tmp->ts);
-	  xfree(tmp->rr);
-	  xfree(tmp);
+  pos = 0;
+  while ((s = db_next(session, &pos)) != NULL) {
+    prev = &s->rr_list;
+    while ((cur = *prev) != NULL) {
+      if (tv_diff(*curr_ts, cur->ts) > (session->rtcp_interval * 3)) {
+	/* Signal the application... */
+	if (!filter_event(session, s->ssrc)) {
+	  event.ssrc = s->ssrc;
+	  event.type = RR_TIMEOUT;
+	  event.data = cur->rr;
+	  event.ts   = curr_ts;
+	  session->callback(session, &event);
 	}
-	cur = cur->next;
+	/* Delete this reception report... */
+	*prev = cur->next;
+	free_rr(session, cur);
+      } else {
+	prev = &cur->next;
       }
     }
   }
@@ -528,18 +646,18 @@ static void timeout_rr(struct rtp *session, struct timeval *curr_ts)
 
 static const rtcp_rr* get_rr(struct rtp *session, uint32_t reporter_ssrc, uint32_t reportee_ssrc)
 {
-  rtcp_rr_wrapper *cur, *start;
+  rtcp_rr_wrapper *cur;
+  source	  *s;
 
   lock_mutex(session);
-  start = &session->rr[ssrc_hash(reporter_ssrc)][ssrc_hash(reportee_ssrc)];
-  cur   = start->next;
-  while (cur != start) {
-    if (cur->reporter_ssrc == reporter_ssrc &&
-	cur->rr->ssrc      == reportee_ssrc) {
-      unlock_mutex(session);
-      return cur->rr;
+  s = db_find(session, reporter_ssrc);
+  if (s != NULL) {
+    for (cur = s->rr_list; cur != NULL; cur = cur->next) {
+      if (cur->rr->ssrc == reportee_ssrc) {
+	unlock_mutex(session);
+	return cur->rr;
+      }
     }
-    cur = cur->next;
   }
   unlock_mutex(session);
   return NULL;
@@ -560,15 +678,21 @@ static inline void
 check_database(struct rtp *session)
 {
   /* This routine performs a sanity check on the database. */
+  /* It walks all of the database, so is only done when    */
+  /* the RTP_OPT_CHECK_DATABASE option is set in a DEBUG   */
+  /* build.                                                */
   /* This should not call any of the other routines which  */
   /* manipulate the database, to avoid common failures.    */
 #ifdef DEBUG
   source 	 	*s;
-  int	 	 source_count;
-  int		 chain;
+  uint32_t	 source_count, used_count;
+  uint32_t	 pos;
 
   ASSERT(session != NULL);
   ASSERT(session->magic == 0xfeedface);
+  if (session->opt == NULL || !session->opt->check_database) {
+    return;
+  }
 
   lock_mutex(session);
   /* Check that we have a database entry for our ssrc... */
@@ -576,42 +700,38 @@ check_database(struct rtp *session)
   /* performed during initialisation whilst creating the */
   /* source entry for my_ssrc.                           */
   if (session->ssrc_count > 0) {
-    for (s = session->db[ssrc_hash(session->my_ssrc)]; s != NULL; s = s->next) {
-      if (s->ssrc == session->my_ssrc) {
-	break;
-      }
-    }
-    ASSERT(s != NULL);
+    ASSERT(db_find(session, session->my_ssrc) != NULL);
   }
 
   source_count = 0;
-  for (chain = 0; chain < RTP_DB_SIZE; chain++) {
-    /* Check that the linked lists making up the chains in */
-    /* the hash table are correctly linked together...     */
-    for (s = session->db[chain]; s != NULL; s = s->next) {
-      check_source(s);
-      source_count++;
-      if (s->prev == NULL) {
-	ASSERT(s == session->db[chain]);
-      } else {
-	ASSERT(s->prev->next == s);
-      }
-      if (s->next != NULL) {
-	ASSERT(s->next->prev == s);
-      }
-      /* Check that the SR is for this source... */
-      if (s->sr.ssrc != 0 && s->sr.ssrc != s->ssrc) {
-	rtp_message(LOG_CRIT, "database error ssrc sr->ssrc is %d should be %d",
-		    s->sr.ssrc, s->ssrc);
-	ASSERT(s->sr.ssrc == s->ssrc);
-      }
+  used_count = 0;
+  for (pos = 0; pos < session->db_size; pos++) {
+    s = session->db[pos];
+    if (s == NULL) {
+      continue;
+    }
+    used_count++;
+    if (s == RTP_DB_DELETED) {
+      continue;
+    }
+    check_source(s);
+    source_count++;
+    /* Check that probing for the source finds it... */
+    ASSERT(db_find(session, s->ssrc) == s);
+    /* Check that the SR is for this source... */
+    if (s->sr.ssrc != 0 && s->sr.ssrc != s->ssrc) {
+      rtp_message(LOG_CRIT, "database error ssrc sr->ssrc is %d should be %d",
+		  s->sr.ssrc, s->ssrc);
+      ASSERT(s->sr.ssrc == s->ssrc);
     }
   }
   unlock_mutex(session);
+  ASSERT(used_count == session->db_used);
+  ASSERT(source_count == session->db_count);
   /* Check that the number of entries in the hash table  */
   /* matches session->ssrc_count                         */
-  ASSERT(source_count == session->ssrc_count);
-  if (source_count != session->ssrc_count) {
+  ASSERT((int)source_count == session->ssrc_count);
+  if ((int)source_count != session->ssrc_count) {
     rtp_message(LOG_DEBUG, "source count %d does not equal session count %d", source_count, session->ssrc_count);
   }
 #else
@@ -626,27 +746,21 @@ get_source(struct rtp *session, uint32_t ssrc)
 
   check_database(session);
   lock_mutex(session);
-  for (s = session->db[ssrc_hash(ssrc)]; s != NULL; s = s->next) {
-    if (s->ssrc == ssrc) {
-      check_source(s);
-      unlock_mutex(session);
-      return s;
-    }
+  s = db_find(session, ssrc);
+  if (s != NULL) {
+    check_source(s);
   }
   unlock_mutex(session);
-  return NULL;
+  return s;
 }
 
 static source *
 create_source(struct rtp *session, uint32_t ssrc, int probation)
 {
   /* Create a new source entry, and add it to the database.    */
-  /* The database is a hash table, using the separate chaining */
-  /* algorithm.                                                */
   rtp_event	 event;
   struct timeval	 event_ts;
   source		*s = get_source(session, ssrc);
-  int		 h;
 
   if (s != NULL) {
     /* Source is already in the database... Mark it as */
@@ -656,7 +770,6 @@ create_source(struct rtp *session, uint32_t ssrc, int probation)
   }
   check_database(session);
   /* This is a new source, we have to create it... */
-  h = ssrc_hash(ssrc);
   s = (source *) xmalloc(sizeof(source));
   memset(s, 0, sizeof(source));
   s->magic          = 0xc001feed;
@@ -672,11 +785,7 @@ create_source(struct rtp *session, uint32_t ssrc, int probation)
   gettimeofday(&(s->last_active), NULL);
   /* Now, add it to the database... */
   lock_mutex(session);
-  s->next           = session->db[h];
-  if (session->db[h] != NULL) {
-    session->db[h]->prev = s;
-  }
-  session->db[h] = s;
+  db_insert(session, s);
   unlock_mutex(session);
   session->ssrc_count++;
   check_database(session);
@@ -702,7 +811,6 @@ static void delete_source(struct rtp *session, uint32_t ssrc)
 {
   /* Remove a source from the RTP database... */
   source		*s = get_source(session, ssrc);
-  int		 h = ssrc_hash(ssrc);
   rtp_event	 event;
   struct timeval	 event_ts;
 
@@ -713,20 +821,10 @@ static void delete_source(struct rtp *session, uint32_t ssrc)
   check_source(s);
   check_database(session);
 
+  remove_rr(session, s);
+
   lock_mutex(session);
-  if (session->db[h] == s) {
-    /* It's the first entry in this chain... */
-    session->db[h] = s->next;
-    if (s->next != NULL) {
-      s->next->prev = NULL;
-    }
-  } else {
-    ASSERT(s->prev != NULL);	/* Else it would be the first in the chain... */
-    s->prev->next = s->next;
-    if (s->next != NULL) {
-      s->next->prev = s->prev;
-    }
-  }
+  db_remove(session, s);
   unlock_mutex(session);
 
   /* Free the memory allocated to a source... */
@@ -739,8 +837,6 @@ static void delete_source(struct rtp *session, uint32_t ssrc)
   if (s->note  != NULL) xfree(s->note);
   if (s->priv  != NULL) xfree(s->priv);
 
-  remove_rr(session, ssrc); 
-
   /* Reduce our SSRC count, and perform reverse reconsideration on the RTCP */
   /* reporting interval (draft-ietf-avt-rtp-new-05.txt, section 6.3.4). To  */
   /* make the transmission rate of RTCP packets more adaptive to changes in */
@@ -994,6 +1090,8 @@ static void init_opt(struct rtp *session)
   rtp_set_option(session, RTP_OPT_PROMISC,           FALSE);
   rtp_set_option(session, RTP_OPT_WEAK_VALIDATION,   TRUE);
   rtp_set_option(session, RTP_OPT_FILTER_MY_PACKETS, FALSE);
+  rtp_set_option(session, RTP_OPT_QUEUE_SENDS,       FALSE);
+  rtp_set_option(session, RTP_OPT_CHECK_DATABASE,    FALSE);
 }
 
 static void init_rng(const char *s)
@@ -1150,7 +1248,6 @@ struct rtp *rtp_init_if(const char *addr, char *iface,
 rtp_t rtp_init_stream (rtp_stream_params_t *rsp)
 {
   struct rtp 	*session;
-  int         	 i, j;
   char		*cname;
   char *hname;
 
@@ -1244,6 +1341,7 @@ rtp_t rtp_init_stream (rtp_stream_params_t *rsp)
   session->encryption_algorithm = NULL;
   session->mutex = MutexCreate();
   session->use_mutex = 1;
+  session->recv_pool_mutex = MutexCreate();
   /* Calculate when we're supposed to send our first RTCP packet... */
   if (rsp->transmit_initial_rtcp == 0) {
     tv_add(&(session->next_rtcp_send_time), rtcp_interval(session));
@@ -1252,19 +1350,9 @@ rtp_t rtp_init_stream (rtp_stream_params_t *rsp)
   }
 
   /* Initialise the source database... */
-  for (i = 0; i < RTP_DB_SIZE; i++) {
-    session->db[i] = NULL;
-  }
+  db_resize(session, RTP_DB_INITIAL_SIZE);
   session->last_advertised_csrc = 0;
 
-  /* Initialize sentinels in rr table */
-  for (i = 0; i < RTP_DB_SIZE; i++) {
-    for (j = 0; j < RTP_DB_SIZE; j++) {
-      session->rr[i][j].next = &session->rr[i][j];
-      session->rr[i][j].prev = &session->rr[i][j];
-    }
-  }
-
   /* Create a database entry for ourselves... */
   create_source(session, session->my_ssrc, FALSE);
   cname = get_cname(session->rtp_socket);
@@ -1291,22 +1379,19 @@ rtp_t rtp_init_stream (rtp_stream_params_t *rsp)
 int rtp_set_my_ssrc(struct rtp *session, uint32_t ssrc)
 {
   source *s;
-  uint32_t h;
 
   if (session->ssrc_count != 1 && session->sender_count != 0) {
     return FALSE;
   }
   /* Remove existing source */
-  h = ssrc_hash(session->my_ssrc);
   lock_mutex(session);
-  s = session->db[h];
-  session->db[h] = NULL;
+  s = db_find(session, session->my_ssrc);
+  db_remove(session, s);
   /* Fill in new ssrc       */
   session->my_ssrc = ssrc;
   s->ssrc          = ssrc;
-  h                = ssrc_hash(ssrc);
   /* Put source back        */
-  session->db[h]   = s;
+  db_insert(session, s);
   unlock_mutex(session);
   return TRUE;
 }
@@ -1336,6 +1421,15 @@ int rtp_set_option(struct rtp *session, rtp_option optname, int optval)
   case RTP_OPT_FILTER_MY_PACKETS:
     session->opt->filter_my_packets = optval;
     break;
+  case RTP_OPT_QUEUE_SENDS:
+    if (optval == FALSE) {
+      rtp_send_flush(session);
+    }
+    session->opt->queue_sends = optval;
+    break;
+  case RTP_OPT_CHECK_DATABASE:
+    session->opt->check_database = optval;
+    break;
   default:
     rtp_message(LOG_ALERT, "Ignoring unknown option (%d) in call to rtp_set_option().", optname);
     return FALSE;
@@ -1366,6 +1460,12 @@ int rtp_get_option(struct rtp *session, rtp_option optname, int *optval)
   case RTP_OPT_FILTER_MY_PACKETS:
     *optval = session->opt->filter_my_packets;
     break;
+  case RTP_OPT_QUEUE_SENDS:
+    *optval = session->opt->queue_sends;
+    break;
+  case RTP_OPT_CHECK_DATABASE:
+    *optval = session->opt->check_database;
+    break;
   default:
     *optval = 0;
     rtp_message(LOG_ALERT, "Ignoring unknown option (%d) in call to rtp_get_option().", optname);
@@ -1589,10 +1689,57 @@ int rtp_process_recv_data (struct rtp *session,
   return -1; /* We need to free the packet */
 }
 
+/*
+ * get_recv_packet - a packet to receive into, from the pool if
+ * rtp_free_packet() has put any back
+ */
+static rtp_packet *get_recv_packet (struct rtp *session)
+{
+  rtp_packet *packet;
+
+  MutexLock(session->recv_pool_mutex);
+  packet = session->recv_pool;
+  if (packet != NULL) {
+    session->recv_pool = packet->rtp_next;
+    session->recv_pool_count--;
+  }
+  MutexUnlock(session->recv_pool_mutex);
+  if (packet == NULL) {
+    packet = (rtp_packet *) xmalloc(RTP_MAX_PACKET_LEN + RTP_PACKET_HEADER_SIZE);
+  }
+  return packet;
+}
+
+/**
+ * rtp_free_packet:
+ * @session: the session the packet was received on.
+ * @packet: a packet from an RX_RTP event.
+ *
+ * Frees a packet that the callback was given with an RX_RTP event,
+ * keeping it so the next packet received on @session can reuse it
+ * rather than allocate.  Packets may also be freed with xfree(), as
+ * before.  This may be called from any thread, but not after
+ * rtp_done().
+ **/
+void rtp_free_packet (struct rtp *session, rtp_packet *packet)
+{
+  MutexLock(session->recv_pool_mutex);
+  if (session->recv_pool_count < RTP_RECV_POOL_MAX) {
+    packet->rtp_next = session->recv_pool;
+    session->recv_pool = packet;
+    session->recv_pool_count++;
+    packet = NULL;
+  }
+  MutexUnlock(session->recv_pool_mutex);
+  if (packet != NULL) {
+    xfree(packet);
+  }
+}
+
 void rtp_recv_data(struct rtp *session, uint32_t curr_rtp_ts)
 {
   /* This routine preprocesses an incoming RTP packet, deciding whether to process it. */
-  rtp_packet	*packet = (rtp_packet *) xmalloc(RTP_MAX_PACKET_LEN + RTP_PACKET_HEADER_SIZE);
+  rtp_packet	*packet = get_recv_packet(session);
   uint8_t		*buffer = ((uint8_t *) packet) + RTP_PACKET_HEADER_SIZE;
   uint32_t		 buflen;
 
@@ -1602,7 +1749,40 @@ void rtp_recv_data(struct rtp *session, uint32_t curr_rtp_ts)
   packet->packet_length = buflen;
 
   if (rtp_process_recv_data(session, curr_rtp_ts, packet) < 0)
-    xfree(packet);
+    rtp_free_packet(session, packet);
+}
+
+/*
+ * rtp_recv_data_batch - read and process all the RTP packets that are
+ * waiting, up to UDP_RECV_BATCH_MAX, with one call to udp_recv_batch.
+ * Packets that aren't given to the callback stay in the ring for the
+ * next read.
+ */
+void rtp_recv_data_batch (struct rtp *session, uint32_t curr_rtp_ts)
+{
+  uint8_t *buffers[UDP_RECV_BATCH_MAX];
+  uint32_t lengths[UDP_RECV_BATCH_MAX];
+  uint32_t count, i;
+  rtp_packet *packet;
+
+  for (i = 0; i < UDP_RECV_BATCH_MAX; i++) {
+    if (session->recv_ring[i] == NULL) {
+      session->recv_ring[i] = get_recv_packet(session);
+    }
+    buffers[i] = ((uint8_t *)session->recv_ring[i]) + RTP_PACKET_HEADER_SIZE;
+  }
+
+  count = udp_recv_batch(session->rtp_socket, buffers, RTP_MAX_PACKET_LEN,
+			 lengths, UDP_RECV_BATCH_MAX);
+
+  for (i = 0; i < count; i++) {
+    packet = session->recv_ring[i];
+    packet->packet_start = buffers[i];
+    packet->packet_length = lengths[i];
+    if (rtp_process_recv_data(session, curr_rtp_ts, packet) == 0) {
+      session->recv_ring[i] = NULL;
+    }
+  }
 }
 
 static int validate_rtcp(uint8_t *packet, uint32_t len)
@@ -2028,6 +2208,18 @@ void rtp_process_ctrl (struct rtp *session, uint8_t *buffer, uint32_t buflen)
   }
 }
 
+/*
+ * rtp_recv_ctrl - read and process an RTCP packet
+ */
+void rtp_recv_ctrl (struct rtp *session)
+{
+  uint8_t		 buffer[RTP_MAX_PACKET_LEN];
+  int		 buflen;
+
+  buflen = udp_recv(session->rtcp_socket, buffer, RTP_MAX_PACKET_LEN);
+  rtp_process_ctrl(session, buffer, buflen);
+}
+
 /**
  * rtp_recv:
  * @session: the session pointer (returned by rtp_init())
@@ -2050,10 +2242,7 @@ int rtp_recv(struct rtp *session, struct timeval *timeout, uint32_t curr_rtp_ts)
       rtp_recv_data(session, curr_rtp_ts);
     }
     if (udp_fd_isset(session->udp_session, session->rtcp_socket)) {
-      uint8_t		 buffer[RTP_MAX_PACKET_LEN];
-      int		 buflen;
-      buflen = udp_recv(session->rtcp_socket, buffer, RTP_MAX_PACKET_LEN);
-      rtp_process_ctrl(session, buffer, buflen);
+      rtp_recv_ctrl(session);
     }
     check_database(session);
     return TRUE;
@@ -2064,6 +2253,42 @@ int rtp_recv(struct rtp *session, struct timeval *timeout, uint32_t curr_rtp_ts)
 
 
 
+/**
+ * rtp_recv_batch:
+ * @session: the session pointer (returned by rtp_init())
+ * @timeout: the amount of time that rtp_recv_batch() is allowed to block
+ * @curr_rtp_ts: the current time expressed in units of the media
+ * timestamp.
+ *
+ * Like rtp_recv(), but reads every RTP packet that is waiting when the
+ * socket becomes readable, up to %UDP_RECV_BATCH_MAX, with a single
+ * system call where recvmmsg() is available.  The callback gets an
+ * RX_RTP event for each of them.  Receivers that free their packets
+ * with rtp_free_packet() don't allocate once the pool has filled.
+ *
+ * Returns: TRUE if data received, FALSE if the timeout occurred.
+ */
+int rtp_recv_batch(struct rtp *session, struct timeval *timeout,
+		   uint32_t curr_rtp_ts)
+{
+  check_database(session);
+  udp_fd_zero(session->udp_session);
+  udp_fd_set(session->udp_session, session->rtp_socket);
+  udp_fd_set(session->udp_session, session->rtcp_socket);
+  if (udp_select(session->udp_session, timeout) > 0) {
+    if (udp_fd_isset(session->udp_session, session->rtp_socket)) {
+      rtp_recv_data_batch(session, curr_rtp_ts);
+    }
+    if (udp_fd_isset(session->udp_session, session->rtcp_socket)) {
+      rtp_recv_ctrl(session);
+    }
+    check_database(session);
+    return TRUE;
+  }
+  check_database(session);
+  return FALSE;
+}
+
 /**
  * rtp_add_csrc:
  * @session: the session pointer (returned by rtp_init()) 
@@ -2302,6 +2527,87 @@ const rtcp_rr *rtp_get_rr(struct rtp *session, uint32_t reporter, uint32_t repor
   return get_rr(session, reporter, reportee);
 }
 
+/*
+ * get_send_buffer - a buffer for an outgoing packet of len bytes,
+ * plus the rtp_packet_data header.  The pooled buffer after the queued
+ * ones is used if the packet fits, so sending doesn't malloc.
+ */
+static uint8_t *get_send_buffer(struct rtp *session, uint32_t len)
+{
+  uint8_t **buffer;
+
+  if (len > RTP_SEND_BUFFER_SIZE) {
+    return (uint8_t *)xmalloc(len + RTP_PACKET_HEADER_SIZE);
+  }
+  buffer = &session->send_buffers[session->send_queue_count];
+  if (*buffer == NULL) {
+    *buffer = (uint8_t *)xmalloc(RTP_SEND_BUFFER_SIZE + RTP_PACKET_HEADER_SIZE);
+  }
+  return *buffer;
+}
+
+static void release_send_buffer(struct rtp *session, uint8_t *buffer)
+{
+  if (buffer != session->send_buffers[session->send_queue_count]) {
+    xfree(buffer);
+  }
+}
+
+/*
+ * send_rtp_buffer - transmit a packet built in a buffer from 
+ * get_send_buffer().  With RTP_OPT_QUEUE_SENDS the packet is queued
+ * on the socket, and the buffer is kept until rtp_send_flush().
+ */
+static int send_rtp_buffer(struct rtp *session, uint8_t *buffer, 
+			   uint32_t buffer_len)
+{
+  uint8_t *start = buffer + RTP_PACKET_HEADER_SIZE;
+  int rc;
+
+  if (session->rtp_send_packet != NULL) {
+    rc = (session->rtp_send_packet)(session->send_userdata, 
+				    start, buffer_len);
+  } else if (session->opt->queue_sends &&
+	     buffer == session->send_buffers[session->send_queue_count]) {
+    udp_send_queue(session->rtp_socket, start, buffer_len);
+    session->send_queue_count++;
+    if (session->send_queue_count == UDP_SEND_QUEUE_MAX) {
+      rtp_send_flush(session);
+    }
+    return buffer_len;
+  } else {
+    /* keep the packets in order */
+    rtp_send_flush(session);
+    rc = udp_send(session->rtp_socket, start, buffer_len);
+  }
+  release_send_buffer(session, buffer);
+  return rc;
+}
+
+/**
+ * rtp_send_flush:
+ * @session: the session pointer (returned by rtp_init())
+ *
+ * Transmits the RTP packets queued while the %RTP_OPT_QUEUE_SENDS
+ * option is set, in as few system calls as the platform allows.
+ * Senders using the option should call this once they have sent
+ * everything they have for now, a frame for instance.  Errors are
+ * logged; the packets have already been counted as sent.
+ *
+ * Return value: the number of packets sent, or -1 on failure.
+ **/
+int rtp_send_flush(struct rtp *session)
+{
+  int rc;
+
+  if (session->send_queue_count == 0) {
+    return 0;
+  }
+  rc = udp_send_flush(session->rtp_socket);
+  session->send_queue_count = 0;
+  return rc;
+}
+
 /**
  * rtp_send_data:
  * @session: the session pointer (returned by rtp_init())
@@ -2374,8 +2680,8 @@ int rtp_send_data(struct rtp *session, uint32_t rtp_ts, int8_t pt, int m,
   } else
     malloc_len = buffer_len;
 
-  /* Allocate memory for the packet... */
-  buffer     = (uint8_t *) xmalloc(malloc_len + RTP_PACKET_HEADER_SIZE);
+  /* Get a buffer for the packet... */
+  buffer     = get_send_buffer(session, malloc_len);
   packet     = (rtp_packet *) buffer;
   packet->packet_start = buffer + RTP_PACKET_HEADER_SIZE;
   packet->pd.ph = (rtp_packet_header *)packet->packet_start;
@@ -2441,18 +2747,11 @@ int rtp_send_data(struct rtp *session, uint32_t rtp_ts, int8_t pt, int m,
 				    &buffer_len); 
       if (retval == FALSE) {
 	rtp_message(LOG_ERR, "encrypting failed");
-	xfree(buffer);
+	release_send_buffer(session, buffer);
 	return 0;
       }
     }
-  if (session->rtp_send_packet != NULL) {
-    rc = (session->rtp_send_packet)(session->send_userdata, 
-				    packet->packet_start,
-				    buffer_len);
-  } else 
-    rc = udp_send(session->rtp_socket, packet->packet_start, buffer_len);
-
-  xfree(buffer);
+  rc = send_rtp_buffer(session, buffer, buffer_len);
 
   /* Update the RTCP statistics... */
   session->we_sent     = TRUE;
@@ -2480,6 +2779,8 @@ int rtp_send_data_iov (struct rtp *session, uint32_t rtp_ts,
   rtp_packet	*packet;
   unsigned int my_iov_count = iov_count + 1;
   struct iovec *my_iov;
+  struct iovec local_iov[RTP_SEND_IOV_MAX];
+  int queue;
 
   /* encryption - copy to contiguous local buffer, then send that */
   if ((session->rtp_encryption_enabled)) {
@@ -2512,9 +2813,18 @@ int rtp_send_data_iov (struct rtp *session, uint32_t rtp_ts,
   if (extn != NULL) {
     buffer_len += (extn_len + 1) * 4;
   }
+  for (i = 0, payload_len = 0; i < iov_count; i++) {
+    payload_len += iov[i].iov_len;
+  }
+
+  /* When queueing, the payload is copied after the header, as the */
+  /* caller's buffers may be gone by the time the queue is flushed */
+  queue = session->opt->queue_sends && 
+    session->rtp_send_packet_iov == NULL && session->rtp_send_packet == NULL;
 
-  /* Allocate memory for the packet... */
-  buffer     = (uint8_t *) xmalloc(buffer_len + RTP_PACKET_HEADER_SIZE);
+  /* Get a buffer for the packet... */
+  buffer     = get_send_buffer(session, 
+			       queue ? buffer_len + payload_len : buffer_len);
   packet     = (rtp_packet *) buffer;
 
   packet->packet_start = buffer + RTP_PACKET_HEADER_SIZE;
@@ -2550,26 +2860,43 @@ int rtp_send_data_iov (struct rtp *session, uint32_t rtp_ts,
     memcpy(packet->rtp_extn + 4, extn, extn_len * 4);
   }
 
-  /* Add the RTP packet header to the beginning of the iov list */
-  my_iov = (struct iovec*)xmalloc(my_iov_count * sizeof(struct iovec));
+  if (queue) {
+    uint8_t *dptr = packet->rtp_data;
+    for (i = 0; i < iov_count; i++) {
+      memcpy(dptr, iov[i].iov_base, iov[i].iov_len);
+      dptr += iov[i].iov_len;
+    }
+    buffer_len += payload_len;
+    rc = send_rtp_buffer(session, buffer, buffer_len);
+  } else {
+    /* Add the RTP packet header to the beginning of the iov list */
+    if (my_iov_count <= RTP_SEND_IOV_MAX) {
+      my_iov = local_iov;
+    } else {
+      my_iov = (struct iovec*)xmalloc(my_iov_count * sizeof(struct iovec));
+    }
 
-  my_iov[0].iov_base = buffer + RTP_PACKET_HEADER_SIZE;
-  my_iov[0].iov_len = buffer_len;
+    my_iov[0].iov_base = buffer + RTP_PACKET_HEADER_SIZE;
+    my_iov[0].iov_len = buffer_len;
 
-  for (i = 1, payload_len = 0; i < my_iov_count; i++) {
-    my_iov[i].iov_base = iov[i-1].iov_base;
-    my_iov[i].iov_len = iov[i-1].iov_len;
-    payload_len += my_iov[i].iov_len;
-  }
-  buffer_len += payload_len;
+    for (i = 1; i < my_iov_count; i++) {
+      my_iov[i].iov_base = iov[i-1].iov_base;
+      my_iov[i].iov_len = iov[i-1].iov_len;
+    }
+    buffer_len += payload_len;
     /* Send the data */
-  if (session->rtp_send_packet_iov != NULL) {
-    rc = (session->rtp_send_packet_iov)(session->send_userdata, my_iov, my_iov_count);
-  } else 
-    rc = udp_send_iov(session->rtp_socket, my_iov, my_iov_count);
+    if (session->rtp_send_packet_iov != NULL) {
+      rc = (session->rtp_send_packet_iov)(session->send_userdata, my_iov, my_iov_count);
+    } else {
+      rtp_send_flush(session);
+      rc = udp_send_iov(session->rtp_socket, my_iov, my_iov_count);
+    }
   
-  xfree(buffer);
-  xfree(my_iov);
+    release_send_buffer(session, buffer);
+    if (my_iov != local_iov) {
+      xfree(my_iov);
+    }
+  }
 
   /* Update the RTCP statistics... */
   session->we_sent     = TRUE;
@@ -2585,56 +2912,55 @@ int rtp_send_data_iov (struct rtp *session, uint32_t rtp_ts,
 static int format_report_blocks(rtcp_rr *rrp, int remaining_length, struct rtp *session)
 {
   int nblocks = 0;
-  int h;
+  uint32_t pos;
   source *s;
   struct timeval now;
 
   gettimeofday(&now, NULL);
 
-  for (h = 0; h < RTP_DB_SIZE; h++) {
-    for (s = session->db[h]; s != NULL; s = s->next) {
-      check_source(s);
-      if ((nblocks == 31) || (remaining_length < 24)) {
-	break; /* Insufficient space for more report blocks... */
+  pos = 0;
+  while ((s = db_next(session, &pos)) != NULL) {
+    check_source(s);
+    if ((nblocks == 31) || (remaining_length < 24)) {
+      break; /* Insufficient space for more report blocks... */
+    }
+    if (s->sender) {
+      /* Much of this is taken from A.3 of draft-ietf-avt-rtp-new-01.txt */
+      int	extended_max      = s->cycles + s->max_seq;
+      int	expected          = extended_max - s->base_seq + 1;
+      int	lost              = expected - s->received;
+      int	expected_interval = expected - s->expected_prior;
+      int	received_interval = s->received - s->received_prior;
+      int 	lost_interval     = expected_interval - received_interval;
+      int	fraction;
+      uint32_t lsr;
+      uint32_t dlsr;
+
+      s->expected_prior = expected;
+      s->received_prior = s->received;
+      if (expected_interval == 0 || lost_interval <= 0) {
+	fraction = 0;
+      } else {
+	fraction = (lost_interval << 8) / expected_interval;
       }
-      if (s->sender) {
-	/* Much of this is taken from A.3 of draft-ietf-avt-rtp-new-01.txt */
-	int	extended_max      = s->cycles + s->max_seq;
-	int	expected          = extended_max - s->base_seq + 1;
-	int	lost              = expected - s->received;
-	int	expected_interval = expected - s->expected_prior;
-	int	received_interval = s->received - s->received_prior;
-	int 	lost_interval     = expected_interval - received_interval;
-	int	fraction;
-	uint32_t lsr;
-	uint32_t dlsr;
-
-	s->expected_prior = expected;
-	s->received_prior = s->received;
-	if (expected_interval == 0 || lost_interval <= 0) {
-	  fraction = 0;
-	} else {
-	  fraction = (lost_interval << 8) / expected_interval;
-	}
 
-	lsr = ntp64_to_ntp32(s->sr.ntp_sec, s->sr.ntp_frac);
-	dlsr = (uint32_t)(tv_diff(now, s->last_sr) * 65536);
-
-	rrp->ssrc       = htonl(s->ssrc);
-	rrp->fract_lost = fraction;
-	rrp->total_lost = lost & 0x00ffffff;
-	rrp->last_seq   = htonl(extended_max);
-	rrp->jitter     = htonl(s->jitter / 16);
-	rrp->lsr        = htonl(lsr);
-	rrp->dlsr       = htonl(dlsr);
-	rrp++;
-	remaining_length -= 24;
-	nblocks++;
-	s->sender = FALSE;
-	session->sender_count--;
-	if (session->sender_count == 0) {
-	  break; /* No point continuing, since we've reported on all senders... */
-	}
+      lsr = ntp64_to_ntp32(s->sr.ntp_sec, s->sr.ntp_frac);
+      dlsr = (uint32_t)(tv_diff(now, s->last_sr) * 65536);
+
+      rrp->ssrc       = htonl(s->ssrc);
+      rrp->fract_lost = fraction;
+      rrp->total_lost = lost & 0x00ffffff;
+      rrp->last_seq   = htonl(extended_max);
+      rrp->jitter     = htonl(s->jitter / 16);
+      rrp->lsr        = htonl(lsr);
+      rrp->dlsr       = htonl(dlsr);
+      rrp++;
+      remaining_length -= 24;
+      nblocks++;
+      s->sender = FALSE;
+      session->sender_count--;
+      if (session->sender_count == 0) {
+	break; /* No point continuing, since we've reported on all senders... */
       }
     }
   }
@@ -2852,6 +3178,8 @@ static void send_rtcp(struct rtp *session,
   unsigned int length, new_length;
 
   check_database(session);
+  /* the sender report counts the queued packets, send them first */
+  rtp_send_flush(session);
 
   /* The first RTCP packet in the compound packet MUST always be a report packet...  */
   if (session->we_sent) {
@@ -2971,7 +3299,7 @@ void rtp_send_ctrl_2(struct rtp *session,
   if (tv_gt(curr_time, session->next_rtcp_send_time)) {
     /* The RTCP transmission timer has expired. The following */
     /* implements draft-ietf-avt-rtp-new-02.txt section 6.3.6 */
-    int		 h;
+    uint32_t	 pos;
     source		*s;
     struct timeval	 new_send_time;
     double		 new_interval;
@@ -2988,11 +3316,10 @@ void rtp_send_ctrl_2(struct rtp *session,
       /* We're starting a new RTCP reporting interval, zero out */
       /* the per-interval statistics.                           */
       session->sender_count = 0;
-      for (h = 0; h < RTP_DB_SIZE; h++) {
-	for (s = session->db[h]; s != NULL; s = s->next) {
-	  check_source(s);
-	  s->sender = FALSE;
-	}
+      pos = 0;
+      while ((s = db_next(session, &pos)) != NULL) {
+	check_source(s);
+	s->sender = FALSE;
       }
     } else {
       session->next_rtcp_send_time = new_send_time;
@@ -3015,8 +3342,8 @@ void rtp_send_ctrl_2(struct rtp *session,
 void rtp_update(struct rtp *session)
 {
   /* Perform housekeeping on the source database... */
-  int	 	 h;
-  source	 	*s, *n;
+  uint32_t	 pos;
+  source	 	*s;
   struct timeval	 curr_time;
   double		 delay;
 
@@ -3035,41 +3362,40 @@ void rtp_update(struct rtp *session)
 
   check_database(session);
 
-  for (h = 0; h < RTP_DB_SIZE; h++) {
-    for (s = session->db[h]; s != NULL; s = n) {
-      check_source(s);
-      n = s->next;
-      /* Expire sources which haven't been heard from for a long time.   */
-      /* Section 6.2.1 of the RTP specification details the timers used. */
+  pos = 0;
+  while ((s = db_next(session, &pos)) != NULL) {
+    check_source(s);
+    /* Expire sources which haven't been heard from for a long time.   */
+    /* Section 6.2.1 of the RTP specification details the timers used. */
 
-      /* How long since we last heard from this source?  */
-      delay = tv_diff(curr_time, s->last_active);
+    /* How long since we last heard from this source?  */
+    delay = tv_diff(curr_time, s->last_active);
 				
-      /* Check if we've received a BYE packet from this source.    */
-      /* If we have, and it was received more than 2 seconds ago   */
-      /* then the source is deleted. The arbitrary 2 second delay  */
-      /* is to ensure that all delayed packets are received before */
-      /* the source is timed out.                                  */
-      if (s->got_bye && (delay > 2.0)) {
-	rtp_message(LOG_INFO, "Deleting source 0x%08x due to reception of BYE %f seconds ago...", s->ssrc, delay);
-	delete_source(session, s->ssrc);
-      }
-
-      /* Sources are marked as inactive if they haven't been heard */
-      /* from for more than 2 intervals (RTP section 6.3.5)        */
-      if ((s->ssrc != rtp_my_ssrc(session)) && (delay > (session->rtcp_interval * 2))) {
-	if (s->sender) {
-	  s->sender = FALSE;
-	  session->sender_count--;
-	}
+    /* Check if we've received a BYE packet from this source.    */
+    /* If we have, and it was received more than 2 seconds ago   */
+    /* then the source is deleted. The arbitrary 2 second delay  */
+    /* is to ensure that all delayed packets are received before */
+    /* the source is timed out.                                  */
+    if (s->got_bye && (delay > 2.0)) {
+      rtp_message(LOG_INFO, "Deleting source 0x%08x due to reception of BYE %f seconds ago...", s->ssrc, delay);
+      delete_source(session, s->ssrc);
+      continue;
+    }
+
+    /* Sources are marked as inactive if they haven't been heard */
+    /* from for more than 2 intervals (RTP section 6.3.5)        */
+    if ((s->ssrc != rtp_my_ssrc(session)) && (delay > (session->rtcp_interval * 2))) {
+      if (s->sender) {
+	s->sender = FALSE;
+	session->sender_count--;
       }
+    }
 
-      /* If a source hasn't been heard from for more than 5 RTCP   */
-      /* reporting intervals, we delete it from our database...    */
-      if ((s->ssrc != rtp_my_ssrc(session)) && (delay > (session->rtcp_interval * 5))) {
-	rtp_message(LOG_INFO, "Deleting source 0x%08x due to timeout...", s->ssrc);
-	delete_source(session, s->ssrc);
-      }
+    /* If a source hasn't been heard from for more than 5 RTCP   */
+    /* reporting intervals, we delete it from our database...    */
+    if ((s->ssrc != rtp_my_ssrc(session)) && (delay > (session->rtcp_interval * 5))) {
+      rtp_message(LOG_INFO, "Deleting source 0x%08x due to timeout...", s->ssrc);
+      delete_source(session, s->ssrc);
     }
   }
 
@@ -3160,6 +3486,7 @@ void rtp_send_bye(struct rtp *session)
   double		new_interval;
 
   check_database(session);
+  rtp_send_flush(session);
 
   /* "...a participant which never sent an RTP or RTCP packet MUST NOT send  */
   /* a BYE packet when they leave the group." (section 6.3.7 of RTP spec)    */
@@ -3230,23 +3557,23 @@ void rtp_send_bye(struct rtp *session)
 void rtp_done(struct rtp *session)
 {
   int i;
-  source *s, *n;
+  uint32_t pos;
+  source *s;
 
   check_database(session);
+  rtp_send_flush(session);
   /* In delete_source, check database gets called and this assumes */
   /* first added and last removed is us.                           */
-  for (i = 0; i < RTP_DB_SIZE; i++) {
-    s = session->db[i];
-    while (s != NULL) {
-      n = s->next;
-      if (s->ssrc != session->my_ssrc) {
-	delete_source(session,session->db[i]->ssrc);
-      }
-      s = n;
+  pos = 0;
+  while ((s = db_next(session, &pos)) != NULL) {
+    if (s->ssrc != session->my_ssrc) {
+      delete_source(session, s->ssrc);
     }
   }
 
   delete_source(session, session->my_ssrc);
+  xfree(session->db);
+  session->db = NULL;
 
   /*
    * Introduce a memory leak until we add algorithm-specific
@@ -3276,6 +3603,27 @@ void rtp_done(struct rtp *session)
     xfree(session->m_output_buffer);
     session->m_output_buffer = NULL;
   }
+  for (i = 0; i < UDP_SEND_QUEUE_MAX; i++) {
+    if (session->send_buffers[i] != NULL) {
+      xfree(session->send_buffers[i]);
+      session->send_buffers[i] = NULL;
+    }
+  }
+  for (i = 0; i < UDP_RECV_BATCH_MAX; i++) {
+    if (session->recv_ring[i] != NULL) {
+      xfree(session->recv_ring[i]);
+      session->recv_ring[i] = NULL;
+    }
+  }
+  while (session->recv_pool != NULL) {
+    rtp_packet *packet = session->recv_pool;
+    session->recv_pool = packet->rtp_next;
+    xfree(packet);
+  }
+  if (session->recv_pool_mutex != NULL) {
+    MutexDestroy(session->recv_pool_mutex);
+    session->recv_pool_mutex = NULL;
+  }
   if (session->mutex != NULL) {
     MutexDestroy(session->mutex);
     session->mutex = NULL;
@@ -3326,6 +3674,30 @@ uint16_t rtp_get_tx_port(struct rtp *session)
   return session->tx_port;
 }
 
+/**
+ * rtp_get_next_timeout:
+ * @session: The RTP Session.
+ * @next: filled in with the time.
+ *
+ * Gets the time at which rtp_send_ctrl() or rtp_update() next have
+ * work to do, so a caller handling many sessions doesn't have to
+ * call them every second for each one.  Receiving RTCP can make the
+ * time earlier, so get it again after rtp_recv_ctrl().
+ */
+void rtp_get_next_timeout(struct rtp *session, struct timeval *next)
+{
+  struct timeval update_time;
+
+  check_database(session);
+  update_time = session->last_update;
+  tv_add(&update_time, 1.0);
+  if (tv_gt(update_time, session->next_rtcp_send_time)) {
+    *next = session->next_rtcp_send_time;
+  } else {
+    *next = update_time;
+  }
+}
+
 /**
  * rtp_get_ttl:
  * @session: The RTP Session.
@@ -229,7 +229,9 @@ typedef struct {
 typedef enum {
         RTP_OPT_PROMISC =	    1,
         RTP_OPT_WEAK_VALIDATION	=   2,
-        RTP_OPT_FILTER_MY_PACKETS = 3
+        RTP_OPT_FILTER_MY_PACKETS = 3,
+        RTP_OPT_QUEUE_SENDS = 4,		/* hold RTP packets until rtp_send_flush */
+        RTP_OPT_CHECK_DATABASE = 5	/* DEBUG builds: verify the source database on every call */
 } rtp_option;
 
 typedef struct socket_udp_ socket_udp; 
@@ -299,6 +301,11 @@ int 		 rtp_get_option(struct rtp *session, rtp_option optname, int *optval);
 int 		 rtp_recv(struct rtp *session, 
 			  struct timeval *timeout, uint32_t curr_rtp_ts);
   void rtp_recv_data(struct rtp *session, uint32_t curr_rtp_ts);
+int		 rtp_recv_batch(struct rtp *session,
+				struct timeval *timeout, uint32_t curr_rtp_ts);
+void		 rtp_free_packet(struct rtp *session, rtp_packet *packet);
+void		 rtp_recv_data_batch(struct rtp *session, uint32_t curr_rtp_ts);
+void		 rtp_recv_ctrl(struct rtp *session);
 int 		 rtp_send_data(struct rtp *session, 
 			       uint32_t rtp_ts, int8_t pt, int m, 
 			       unsigned int cc, uint32_t csrc[], 
@@ -316,6 +323,7 @@ void 		 rtp_send_ctrl_2(struct rtp *session, uint32_t rtp_ts,
 				 uint64_t ntp_ts, 
 				 rtcp_app_callback_f appcallback);
 void 		 rtp_update(struct rtp *session);
+int		 rtp_send_flush(struct rtp *session);
 
 uint32_t	 rtp_my_ssrc(struct rtp *session);
 int		 rtp_add_csrc(struct rtp *session, uint32_t csrc);
@@ -335,6 +343,7 @@ char 		*rtp_get_addr(struct rtp *session);
 uint16_t	 rtp_get_rx_port(struct rtp *session);
 uint16_t	 rtp_get_tx_port(struct rtp *session);
 int		 rtp_get_ttl(struct rtp *session);
+void		 rtp_get_next_timeout(struct rtp *session, struct timeval *next);
 void		*rtp_get_recv_userdata(struct rtp *session);
 
   
@@ -357,6 +366,17 @@ socket_udp *get_rtp_rtcp_socket(struct rtp *session);
 
   void rtp_set_rtp_callback(struct rtp *session, rtp_callback_f rtp,
 			    void *userdata);
+  /* one thread receiving for many sessions, see rtp_loop.c */
+typedef struct rtp_loop rtp_loop_t;
+typedef uint32_t (*rtp_loop_ts_f)(struct rtp *session, void *userdata);
+
+rtp_loop_t	*rtp_loop_create(void);
+void		 rtp_loop_destroy(rtp_loop_t *loop);
+int		 rtp_loop_add_session(rtp_loop_t *loop, struct rtp *session,
+				      rtp_loop_ts_f get_rtp_ts, void *userdata);
+void		 rtp_loop_remove_session(rtp_loop_t *loop, struct rtp *session);
+int		 rtp_loop_run(rtp_loop_t *loop, struct timeval *timeout);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,465 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ *
+ * The Original Code is MPEG4IP.
+ *
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2005.  All Rights Reserved.
+ *
+ * Contributor(s):
+ *		Bill May		wmay@cisco.com
+ */
+/*
+ * rtp_loop.c - one thread receiving for many RTP sessions
+ *
+ * The loop waits on the RTP and RTCP sockets of all its sessions at
+ * once, with epoll where there is one and select otherwise.  The
+ * sessions are kept in a heap ordered by the time rtp_send_ctrl()
+ * and rtp_update() next have work to do, so the loop only wakes up
+ * for the sessions that need it.
+ */
+#include "config_unix.h"
+#include "config_win32.h"
+#include "memory.h"
+#include "debug.h"
+#include "net_udp.h"
+#include "rtp.h"
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+#define RTP_LOOP_EVENTS_MAX 64
+
+struct rtp_loop_session_;
+
+typedef struct rtp_loop_socket_ {
+  struct rtp_loop_session_ *ls;
+  int fd;
+  int is_rtcp;
+} rtp_loop_socket;
+
+typedef struct rtp_loop_session_ {
+  struct rtp *session;
+  rtp_loop_ts_f get_rtp_ts;
+  void *userdata;
+  rtp_loop_socket sockets[2];		/* RTP, then RTCP */
+  uint64_t next_time;			/* usec, the heap key */
+  uint32_t heap_index;
+  int removed;
+  struct rtp_loop_session_ *next_dead;
+} rtp_loop_session;
+
+struct rtp_loop {
+#ifdef HAVE_SYS_EPOLL_H
+  int epoll_fd;
+#endif
+  /* every session, by next_time */
+  rtp_loop_session **heap;
+  uint32_t heap_count, heap_max;
+  /* sockets that are readable, filled in by loop_wait */
+  rtp_loop_socket **ready;
+  /* sessions removed by a callback, freed when rtp_loop_run ends */
+  rtp_loop_session *dead;
+  int dispatching;
+};
+
+static uint64_t loop_now (void)
+{
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+  return ((uint64_t)now.tv_sec * 1000000) + now.tv_usec;
+}
+
+static uint32_t loop_rtp_ts (rtp_loop_session *ls)
+{
+  if (ls->get_rtp_ts == NULL) {
+    return 0;
+  }
+  return (ls->get_rtp_ts)(ls->session, ls->userdata);
+}
+
+/*
+ * The heap of sessions - heap[0] is the one whose timers are due first
+ */
+static void heap_set (rtp_loop_t *loop, uint32_t index, rtp_loop_session *ls)
+{
+  loop->heap[index] = ls;
+  ls->heap_index = index;
+}
+
+static void heap_up (rtp_loop_t *loop, uint32_t index)
+{
+  rtp_loop_session *ls = loop->heap[index];
+
+  while (index > 0) {
+    uint32_t parent = (index - 1) / 2;
+    if (loop->heap[parent]->next_time <= ls->next_time) {
+      break;
+    }
+    heap_set(loop, index, loop->heap[parent]);
+    index = parent;
+  }
+  heap_set(loop, index, ls);
+}
+
+static void heap_down (rtp_loop_t *loop, uint32_t index)
+{
+  rtp_loop_session *ls = loop->heap[index];
+  uint32_t child;
+
+  while ((child = (index * 2) + 1) < loop->heap_count) {
+    if (child + 1 < loop->heap_count &&
+	loop->heap[child + 1]->next_time < loop->heap[child]->next_time) {
+      child++;
+    }
+    if (ls->next_time <= loop->heap[child]->next_time) {
+      break;
+    }
+    heap_set(loop, index, loop->heap[child]);
+    index = child;
+  }
+  heap_set(loop, index, ls);
+}
+
+static void heap_remove (rtp_loop_t *loop, rtp_loop_session *ls)
+{
+  rtp_loop_session *moved;
+
+  loop->heap_count--;
+  if (ls->heap_index != loop->heap_count) {
+    /* the last one takes its place, and goes up or down from there */
+    moved = loop->heap[loop->heap_count];
+    heap_set(loop, ls->heap_index, moved);
+    heap_up(loop, moved->heap_index);
+    heap_down(loop, moved->heap_index);
+  }
+}
+
+/*
+ * loop_schedule - move the session to where its timers now put it
+ * in the heap.  The time is at least a msec after now, so a session
+ * whose timers don't move can't keep the loop busy
+ */
+static void loop_schedule (rtp_loop_t *loop, rtp_loop_session *ls,
+			   uint64_t now)
+{
+  struct timeval next;
+  uint64_t next_time;
+
+  rtp_get_next_timeout(ls->session, &next);
+  next_time = ((uint64_t)next.tv_sec * 1000000) + next.tv_usec;
+  if (next_time <= now) {
+    next_time = now + 1000;
+  }
+  ls->next_time = next_time;
+  heap_up(loop, ls->heap_index);
+  heap_down(loop, ls->heap_index);
+}
+
+/*
+ * loop_wait - wait for up to wait_usec, or forever if wait_forever is
+ * set, for sockets to be readable.  Returns how many are in loop->ready
+ */
+static uint32_t loop_wait (rtp_loop_t *loop, uint64_t wait_usec,
+			   int wait_forever)
+{
+  uint32_t count = 0;
+#ifdef HAVE_SYS_EPOLL_H
+  struct epoll_event events[RTP_LOOP_EVENTS_MAX];
+  int ret, ms;
+
+  /* round up, so we don't wake up just before a timer */
+  ms = wait_forever ? -1 : (int)((wait_usec + 999) / 1000);
+  ret = epoll_wait(loop->epoll_fd, events, RTP_LOOP_EVENTS_MAX, ms);
+  if (ret < 0) {
+    if (errno != EINTR) {
+      rtp_message(LOG_ERR, "rtp_loop: epoll_wait error %d", errno);
+    }
+    return 0;
+  }
+  for (count = 0; count < (uint32_t)ret; count++) {
+    loop->ready[count] = (rtp_loop_socket *)events[count].data.ptr;
+  }
+#else
+  fd_set rfds;
+  struct timeval tv;
+  int max_fd = -1;
+  uint32_t ix, jx;
+  int ret;
+
+  FD_ZERO(&rfds);
+  for (ix = 0; ix < loop->heap_count; ix++) {
+    for (jx = 0; jx < 2; jx++) {
+      FD_SET(loop->heap[ix]->sockets[jx].fd, &rfds);
+      max_fd = MAX(max_fd, loop->heap[ix]->sockets[jx].fd);
+    }
+  }
+  tv.tv_sec = wait_usec / 1000000;
+  tv.tv_usec = wait_usec % 1000000;
+  ret = select(max_fd + 1, &rfds, NULL, NULL, wait_forever ? NULL : &tv);
+  if (ret <= 0) {
+    return 0;
+  }
+  for (ix = 0; ix < loop->heap_count; ix++) {
+    for (jx = 0; jx < 2; jx++) {
+      if (FD_ISSET(loop->heap[ix]->sockets[jx].fd, &rfds)) {
+	loop->ready[count++] = &loop->heap[ix]->sockets[jx];
+      }
+    }
+  }
+#endif
+  return count;
+}
+
+/**
+ * rtp_loop_create:
+ *
+ * Creates a loop that can receive for many RTP sessions from one
+ * thread.  Add the sessions with rtp_loop_add_session(), then call
+ * rtp_loop_run() repeatedly.  A loop and its sessions should only be
+ * used from one thread.
+ *
+ * Returns: the loop, or NULL on error.
+ **/
+rtp_loop_t *rtp_loop_create (void)
+{
+  rtp_loop_t *loop = (rtp_loop_t *)xmalloc(sizeof(rtp_loop_t));
+
+  memset(loop, 0, sizeof(*loop));
+#ifdef HAVE_SYS_EPOLL_H
+  loop->epoll_fd = epoll_create(64);
+  if (loop->epoll_fd < 0) {
+    rtp_message(LOG_ERR, "rtp_loop: can't create epoll descriptor %d", errno);
+    xfree(loop);
+    return NULL;
+  }
+#endif
+  return loop;
+}
+
+/**
+ * rtp_loop_destroy:
+ * @loop: the loop.
+ *
+ * Frees the loop.  The sessions that were still added are not closed.
+ **/
+void rtp_loop_destroy (rtp_loop_t *loop)
+{
+  uint32_t ix;
+
+  for (ix = 0; ix < loop->heap_count; ix++) {
+    xfree(loop->heap[ix]);
+  }
+#ifdef HAVE_SYS_EPOLL_H
+  close(loop->epoll_fd);
+#endif
+  if (loop->heap != NULL) {
+    xfree(loop->heap);
+  }
+  if (loop->ready != NULL) {
+    xfree(loop->ready);
+  }
+  xfree(loop);
+}
+
+/**
+ * rtp_loop_add_session:
+ * @loop: the loop.
+ * @session: an RTP session with sockets of its own.
+ * @get_rtp_ts: returns the current time in units of the media timestamp,
+ * as passed to rtp_recv() and rtp_send_ctrl().  May be NULL, for 0.
+ * @userdata: passed to @get_rtp_ts.
+ *
+ * Adds the session to the loop.  From then on the loop receives the
+ * session's RTP and RTCP, which are given to the session's callback
+ * as usual, and calls rtp_send_ctrl() and rtp_update() for it.
+ *
+ * Returns: TRUE on success, FALSE otherwise.
+ **/
+int rtp_loop_add_session (rtp_loop_t *loop, struct rtp *session,
+			  rtp_loop_ts_f get_rtp_ts, void *userdata)
+{
+  rtp_loop_session *ls;
+  socket_udp *socks[2];
+  uint32_t ix;
+
+  socks[0] = get_rtp_data_socket(session);
+  socks[1] = get_rtp_rtcp_socket(session);
+  if (socks[0] == NULL || socks[1] == NULL) {
+    rtp_message(LOG_ERR, "rtp_loop: session has no sockets");
+    return FALSE;
+  }
+
+  ls = (rtp_loop_session *)xmalloc(sizeof(rtp_loop_session));
+  memset(ls, 0, sizeof(*ls));
+  ls->session = session;
+  ls->get_rtp_ts = get_rtp_ts;
+  ls->userdata = userdata;
+  for (ix = 0; ix < 2; ix++) {
+    ls->sockets[ix].ls = ls;
+    ls->sockets[ix].fd = udp_fd(socks[ix]);
+    ls->sockets[ix].is_rtcp = ix;
+#ifdef HAVE_SYS_EPOLL_H
+    {
+      struct epoll_event event;
+      memset(&event, 0, sizeof(event));
+      event.events = EPOLLIN;
+      event.data.ptr = &ls->sockets[ix];
+      if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, ls->sockets[ix].fd,
+		    &event) < 0) {
+	rtp_message(LOG_ERR, "rtp_loop: can't add socket %d", errno);
+	if (ix == 1) {
+	  epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, ls->sockets[0].fd, &event);
+	}
+	xfree(ls);
+	return FALSE;
+      }
+    }
+#elif !defined(_WIN32)
+    if (ls->sockets[ix].fd >= FD_SETSIZE) {
+      rtp_message(LOG_ERR, "rtp_loop: socket %d is too large for select",
+		  ls->sockets[ix].fd);
+      xfree(ls);
+      return FALSE;
+    }
+#endif
+  }
+
+  if (loop->heap_count == loop->heap_max) {
+    loop->heap_max = loop->heap_max == 0 ? 16 : loop->heap_max * 2;
+    loop->heap = (rtp_loop_session **)
+      xrealloc(loop->heap, loop->heap_max * sizeof(rtp_loop_session *));
+    /* a batch of ready sockets always fits, when all are ready */
+    loop->ready = (rtp_loop_socket **)
+      xrealloc(loop->ready,
+	       MAX(loop->heap_max * 2, RTP_LOOP_EVENTS_MAX) * sizeof(rtp_loop_socket *));
+  }
+  heap_set(loop, loop->heap_count, ls);
+  loop->heap_count++;
+  loop_schedule(loop, ls, loop_now());
+  return TRUE;
+}
+
+/**
+ * rtp_loop_remove_session:
+ * @loop: the loop.
+ * @session: a session added with rtp_loop_add_session().
+ *
+ * Takes the session out of the loop; call this before rtp_done().  It
+ * can be called from the session's callback.
+ **/
+void rtp_loop_remove_session (rtp_loop_t *loop, struct rtp *session)
+{
+  rtp_loop_session *ls = NULL;
+  uint32_t ix;
+
+  for (ix = 0; ix < loop->heap_count; ix++) {
+    if (loop->heap[ix]->session == session) {
+      ls = loop->heap[ix];
+      break;
+    }
+  }
+  if (ls == NULL) {
+    return;
+  }
+  heap_remove(loop, ls);
+#ifdef HAVE_SYS_EPOLL_H
+  {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    for (ix = 0; ix < 2; ix++) {
+      epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, ls->sockets[ix].fd, &event);
+    }
+  }
+#endif
+  if (loop->dispatching) {
+    /* it may be on the ready list */
+    ls->removed = TRUE;
+    ls->next_dead = loop->dead;
+    loop->dead = ls;
+  } else {
+    xfree(ls);
+  }
+}
+
+/**
+ * rtp_loop_run:
+ * @loop: the loop.
+ * @timeout: the longest to wait for packets, or NULL to wait until
+ * there are some.
+ *
+ * Waits for packets on any of the sessions and passes all the ones
+ * that are waiting to the sessions, then calls rtp_send_ctrl() and
+ * rtp_update() for the sessions whose timers are due.
+ *
+ * Returns: TRUE if data was received, FALSE otherwise.
+ **/
+int rtp_loop_run (rtp_loop_t *loop, struct timeval *timeout)
+{
+  rtp_loop_session *ls;
+  rtp_loop_socket *sock;
+  uint64_t now, wait_until;
+  uint32_t ready_count, ix;
+  int wait_forever, received;
+
+  now = loop_now();
+  wait_forever = timeout == NULL;
+  wait_until = wait_forever ? 0 :
+    now + ((uint64_t)timeout->tv_sec * 1000000) + timeout->tv_usec;
+  if (loop->heap_count > 0 &&
+      (wait_forever || loop->heap[0]->next_time < wait_until)) {
+    wait_until = loop->heap[0]->next_time;
+    wait_forever = FALSE;
+  }
+
+  ready_count = loop_wait(loop, wait_until > now ? wait_until - now : 0,
+			  wait_forever);
+
+  loop->dispatching = TRUE;
+  received = FALSE;
+  for (ix = 0; ix < ready_count; ix++) {
+    sock = loop->ready[ix];
+    ls = sock->ls;
+    if (ls->removed) {
+      continue;
+    }
+    if (sock->is_rtcp) {
+      rtp_recv_ctrl(ls->session);
+      /* new members or byes move the next RTCP */
+      if (ls->removed == FALSE) {
+	loop_schedule(loop, ls, loop_now());
+      }
+    } else {
+      rtp_recv_data_batch(ls->session, loop_rtp_ts(ls));
+    }
+    received = TRUE;
+  }
+
+  now = loop_now();
+  while (loop->heap_count > 0 && loop->heap[0]->next_time <= now) {
+    ls = loop->heap[0];
+    rtp_send_ctrl(ls->session, loop_rtp_ts(ls), NULL);
+    rtp_update(ls->session);
+    if (ls->removed == FALSE) {
+      loop_schedule(loop, ls, now);
+    }
+  }
+
+  loop->dispatching = FALSE;
+  while (loop->dead != NULL) {
+    ls = loop->dead;
+    loop->dead = ls->next_dead;
+    xfree(ls);
+  }
+  return received;
+}
@@ -0,0 +1,165 @@
+/*
+ * test_rtp_loop - many RTP sessions handled by one thread.
+ *
+ * Opens pairs of sessions on the loopback, a sender and a receiver,
+ * and puts all of them in one rtp_loop.  The senders send a packet
+ * every 20 msec between calls to rtp_loop_run(); the loop receives
+ * them and sends the RTCP for every session, and at the end every
+ * receiver should have had the packets and a sender report, and
+ * every sender a receiver report.
+ *
+ * usage: test_rtp_loop [<pairs> [<seconds> [<port>]]]
+ */
+#include "mpeg4ip.h"
+#include <rtp.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "memory.h"
+#include "debug.h"
+
+#define TTL 1
+#define RTCP_BW 1500*0.05
+#define SEND_INTERVAL_USEC 20000
+
+typedef struct pair_stats_t {
+  uint32_t rtp_packets;		// at the receiver
+  uint32_t sender_reports;	// at the receiver
+  uint32_t receiver_reports;	// at the sender
+} pair_stats_t;
+
+static uint32_t pairs = 100;
+static uint32_t run_seconds = 8;
+static uint16_t port = 16000;
+
+static void recv_callback (struct rtp *session, rtp_event *e)
+{
+  pair_stats_t *stats = (pair_stats_t *)rtp_get_recv_userdata(session);
+
+  switch (e->type) {
+  case RX_RTP:
+    stats->rtp_packets++;
+    rtp_free_packet(session, (rtp_packet *)e->data);
+    break;
+  case RX_SR:
+    stats->sender_reports++;
+    break;
+  default:
+    break;
+  }
+}
+
+static void send_callback (struct rtp *session, rtp_event *e)
+{
+  pair_stats_t *stats = (pair_stats_t *)rtp_get_recv_userdata(session);
+
+  switch (e->type) {
+  case RX_RTP:
+    xfree(e->data);
+    break;
+  case RX_RR:
+    stats->receiver_reports++;
+    break;
+  default:
+    break;
+  }
+}
+
+static uint64_t now_usec (void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return ((uint64_t)tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+int main (int argc, char *argv[])
+{
+  struct rtp **receivers, **senders;
+  pair_stats_t *stats;
+  rtp_loop_t *loop;
+  struct timeval timeout;
+  uint8_t payload[200];
+  uint64_t start, end, next_send, now;
+  uint32_t ix, sent, loops;
+  uint32_t no_rtp, no_sr, no_rr;
+  uint32_t total_rtp;
+
+  if (argc > 1) pairs = strtoul(argv[1], NULL, 10);
+  if (argc > 2) run_seconds = strtoul(argv[2], NULL, 10);
+  if (argc > 3) port = strtoul(argv[3], NULL, 10);
+  if (pairs == 0 || run_seconds == 0) {
+    fprintf(stderr, "usage: %s [<pairs> [<seconds> [<port>]]]\n", argv[0]);
+    exit(1);
+  }
+  rtp_set_loglevel(LOG_ERR);
+
+  loop = rtp_loop_create();
+  if (loop == NULL) {
+    exit(1);
+  }
+  receivers = (struct rtp **)malloc(pairs * sizeof(struct rtp *));
+  senders = (struct rtp **)malloc(pairs * sizeof(struct rtp *));
+  stats = (pair_stats_t *)calloc(pairs, sizeof(pair_stats_t));
+  for (ix = 0; ix < pairs; ix++) {
+    uint16_t recv_port = port + (ix * 4);
+    receivers[ix] = rtp_init("127.0.0.1", recv_port, recv_port + 2, TTL,
+			     RTCP_BW, recv_callback, &stats[ix]);
+    senders[ix] = rtp_init("127.0.0.1", recv_port + 2, recv_port, TTL,
+			   RTCP_BW, send_callback, &stats[ix]);
+    if (receivers[ix] == NULL || senders[ix] == NULL ||
+	rtp_loop_add_session(loop, receivers[ix], NULL, NULL) == FALSE ||
+	rtp_loop_add_session(loop, senders[ix], NULL, NULL) == FALSE) {
+      fprintf(stderr, "can't open rtp sessions on port %u\n", recv_port);
+      exit(1);
+    }
+  }
+
+  memset(payload, 0, sizeof(payload));
+  start = now_usec();
+  end = start + (run_seconds * 1000000);
+  next_send = start;
+  sent = 0;
+  loops = 0;
+  while ((now = now_usec()) < end) {
+    if (now >= next_send) {
+      for (ix = 0; ix < pairs; ix++) {
+	rtp_send_data(senders[ix], sent * 90 * 20, 96, 0, 0, NULL,
+		      payload, sizeof(payload), NULL, 0, 0);
+      }
+      sent++;
+      next_send += SEND_INTERVAL_USEC;
+    }
+    now = now_usec();
+    timeout.tv_sec = 0;
+    timeout.tv_usec = next_send > now ? next_send - now : 0;
+    rtp_loop_run(loop, &timeout);
+    loops++;
+  }
+  // the last packets
+  timeout.tv_sec = 0;
+  timeout.tv_usec = 100000;
+  while (rtp_loop_run(loop, &timeout));
+
+  no_rtp = no_sr = no_rr = 0;
+  total_rtp = 0;
+  for (ix = 0; ix < pairs; ix++) {
+    total_rtp += stats[ix].rtp_packets;
+    if (stats[ix].rtp_packets == 0) no_rtp++;
+    if (stats[ix].sender_reports == 0) no_sr++;
+    if (stats[ix].receiver_reports == 0) no_rr++;
+    rtp_loop_remove_session(loop, receivers[ix]);
+    rtp_loop_remove_session(loop, senders[ix]);
+    rtp_done(receivers[ix]);
+    rtp_done(senders[ix]);
+  }
+  rtp_loop_destroy(loop);
+
+  printf("%u sessions in one loop, %u loop runs in %u seconds\n",
+	 pairs * 2, loops, run_seconds);
+  printf("received %u of %u rtp packets\n", total_rtp, sent * pairs);
+  printf("%u receivers without rtp, %u without a sender report, "
+	 "%u senders without a receiver report\n", no_rtp, no_sr, no_rr);
+  free(receivers);
+  free(senders);
+  free(stats);
+  return (no_rtp != 0 || no_sr != 0 || no_rr != 0) ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * test_rtp_recv_rate - loopback receive rate of rtp_recv() against
+ * rtp_recv_batch().
+ *
+ * A thread sends packets to a receiving session on the loopback as
+ * fast as it can, and the receiver counts what it gets, once reading
+ * a packet per rtp_recv() and once reading all that are waiting with
+ * rtp_recv_batch().
+ *
+ * usage: test_rtp_recv_rate [<packets> [<payload bytes> [<port>]]]
+ */
+#include "mpeg4ip.h"
+#include <rtp.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "memory.h"
+#include "mutex.h"
+
+#define TTL 1
+#define RTCP_BW 1500*0.05
+#define SEND_BURST 32
+
+static uint32_t packets = 200000;
+static uint32_t payload_len = 200;
+static uint16_t port = 15000;
+
+static uint32_t received;
+static uint64_t received_bytes;
+static volatile int send_done;
+
+static void recv_callback (struct rtp *session, rtp_event *e)
+{
+  rtp_packet *pak;
+
+  if (e->type == RX_RTP) {
+    pak = (rtp_packet *)e->data;
+    received++;
+    received_bytes += pak->rtp_data_len;
+    rtp_free_packet(session, pak);
+  }
+}
+
+static void send_callback (struct rtp *session, rtp_event *e)
+{
+  if (e->type == RX_RTP) {
+    xfree(e->data);
+  }
+}
+
+static int send_thread (void *data)
+{
+  struct rtp *session = (struct rtp *)data;
+  uint8_t *payload = (uint8_t *)malloc(payload_len);
+  uint32_t ix;
+
+  memset(payload, 0x5a, payload_len);
+  rtp_set_option(session, RTP_OPT_QUEUE_SENDS, TRUE);
+  for (ix = 0; ix < packets; ix++) {
+    rtp_send_data(session, ix, 96, 0, 0, NULL, payload, payload_len,
+		  NULL, 0, 0);
+    if ((ix % SEND_BURST) == SEND_BURST - 1) {
+      rtp_send_flush(session);
+      // give the receiver a chance on a single cpu
+      if ((ix % (SEND_BURST * 8)) == (SEND_BURST * 8) - 1) {
+	ThreadSleep(0);
+      }
+    }
+  }
+  rtp_send_flush(session);
+  free(payload);
+  send_done = 1;
+  return 0;
+}
+
+static double now (void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+static void run (const char *name, int batch)
+{
+  struct rtp *recv_session, *send_session;
+  struct timeval timeout;
+  thread_t thread;
+  double start, end;
+  int ret;
+
+  recv_session = rtp_init("127.0.0.1", port, port + 2, TTL, RTCP_BW,
+			  recv_callback, NULL);
+  send_session = rtp_init("127.0.0.1", port + 2, port, TTL, RTCP_BW,
+			  send_callback, NULL);
+  if (recv_session == NULL || send_session == NULL) {
+    fprintf(stderr, "can't open rtp sessions on port %u\n", port);
+    exit(1);
+  }
+  rtp_set_option(recv_session, RTP_OPT_PROMISC, TRUE);
+
+  received = 0;
+  received_bytes = 0;
+  send_done = 0;
+  start = now();
+  thread = ThreadCreate(send_thread, send_session);
+  while (1) {
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 100000;
+    if (batch) {
+      ret = rtp_recv_batch(recv_session, &timeout, 0);
+    } else {
+      ret = rtp_recv(recv_session, &timeout, 0);
+    }
+    if (ret == FALSE && send_done) {
+      break;
+    }
+  }
+  // the last 100 msec were waiting for packets that didn't come
+  end = now() - 0.1;
+  ThreadWait(thread);
+
+  printf("%-15s %u of %u packets (%u lost), %.0f packets/sec, %.1f Mbits/sec\n",
+	 name, received, packets, packets - received,
+	 received / (end - start),
+	 (received_bytes * 8) / ((end - start) * 1000000.0));
+
+  rtp_done(send_session);
+  rtp_done(recv_session);
+}
+
+int main (int argc, char *argv[])
+{
+  if (argc > 1) packets = strtoul(argv[1], NULL, 10);
+  if (argc > 2) payload_len = strtoul(argv[2], NULL, 10);
+  if (argc > 3) port = strtoul(argv[3], NULL, 10);
+  if (packets == 0 || payload_len == 0 || payload_len > RTP_MAX_PACKET_LEN - 12) {
+    fprintf(stderr, "usage: %s [<packets> [<payload bytes> [<port>]]]\n",
+	    argv[0]);
+    exit(1);
+  }
+
+  run("rtp_recv", 0);
+  run("rtp_recv_batch", 1);
+  return 0;
+}
@@ -0,0 +1,177 @@
+/*
+ * test_rtp_rtcp_reporters - cost of the source database with many
+ * receivers sending RTCP, as in a large multicast session.
+ *
+ * Each reporter sends a compound RR + SDES, with a report block about
+ * our SSRC; they are passed straight to rtp_process_ctrl(), so no
+ * network is needed.  Then the reports are read back with
+ * rtp_get_rr(), RTP packets are sent with all the sources in the
+ * database, and the session is closed.
+ *
+ * usage: test_rtp_rtcp_reporters [<reporters> [<rounds> [<port>]]]
+ */
+#include "mpeg4ip.h"
+#include <rtp.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "memory.h"
+#include "debug.h"
+
+#define TTL 1
+#define RTCP_BW 1500*0.05
+#define SEND_PACKETS 20000
+
+static uint32_t reporters = 5000;
+static uint32_t rounds = 20;
+static uint16_t port = 15100;
+
+static void callback (struct rtp *session, rtp_event *e)
+{
+  if (e->type == RX_RTP) {
+    xfree(e->data);
+  }
+}
+
+static double now (void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+static uint8_t *put32 (uint8_t *ptr, uint32_t value)
+{
+  value = htonl(value);
+  memcpy(ptr, &value, sizeof(value));
+  return ptr + sizeof(value);
+}
+
+/*
+ * build_rtcp - an RR from ssrc with one report block about reportee,
+ * followed by an SDES with its CNAME.  Returns the length.
+ */
+static uint32_t build_rtcp (uint8_t *buffer, uint32_t ssrc, uint32_t reportee,
+			    uint32_t seq)
+{
+  uint8_t *ptr = buffer;
+  uint8_t *sdes;
+  char cname[64];
+  uint32_t cname_len, sdes_len;
+
+  // RR, 1 report block: 8 words
+  ptr = put32(ptr, (2u << 30) | (1 << 24) | (201 << 16) | 7);
+  ptr = put32(ptr, ssrc);
+  ptr = put32(ptr, reportee);
+  ptr = put32(ptr, 0);		// fraction lost, cumulative lost
+  ptr = put32(ptr, seq);	// extended highest sequence
+  ptr = put32(ptr, 10);		// jitter
+  ptr = put32(ptr, 0);		// lsr
+  ptr = put32(ptr, 0);		// dlsr
+
+  // SDES, 1 chunk with a CNAME, padded to a word
+  sdes = ptr;
+  cname_len = sprintf(cname, "user%u@10.%u.%u.%u", ssrc, (ssrc >> 16) & 0xff,
+		      (ssrc >> 8) & 0xff, ssrc & 0xff);
+  ptr += 4;
+  ptr = put32(ptr, ssrc);
+  *ptr++ = 1;			// RTCP_SDES_CNAME
+  *ptr++ = cname_len;
+  memcpy(ptr, cname, cname_len);
+  ptr += cname_len;
+  do {
+    *ptr++ = 0;
+  } while (((ptr - sdes) & 3) != 0);
+  sdes_len = ptr - sdes;
+  put32(sdes, (2u << 30) | (1 << 24) | (202 << 16) | ((sdes_len / 4) - 1));
+
+  return ptr - buffer;
+}
+
+static void process_all (struct rtp *session, uint32_t *ssrcs, uint32_t seq)
+{
+  uint8_t buffer[RTP_MAX_PACKET_LEN];
+  uint32_t ix, len;
+
+  for (ix = 0; ix < reporters; ix++) {
+    len = build_rtcp(buffer, ssrcs[ix], rtp_my_ssrc(session), seq);
+    rtp_process_ctrl(session, buffer, len);
+  }
+}
+
+int main (int argc, char *argv[])
+{
+  struct rtp *session;
+  uint32_t *ssrcs;
+  uint8_t payload[200];
+  uint32_t ix, missing;
+  double start, join_time, steady_time, get_time, send_time, done_time;
+
+  if (argc > 1) reporters = strtoul(argv[1], NULL, 10);
+  if (argc > 2) rounds = strtoul(argv[2], NULL, 10);
+  if (argc > 3) port = strtoul(argv[3], NULL, 10);
+  if (reporters == 0 || rounds == 0) {
+    fprintf(stderr, "usage: %s [<reporters> [<rounds> [<port>]]]\n", argv[0]);
+    exit(1);
+  }
+  rtp_set_loglevel(LOG_ERR);
+
+  session = rtp_init("127.0.0.1", port, port, TTL, RTCP_BW, callback, NULL);
+  if (session == NULL) {
+    fprintf(stderr, "can't open rtp session on port %u\n", port);
+    exit(1);
+  }
+
+  // ssrcs from a real session aren't in any order
+  ssrcs = (uint32_t *)malloc(reporters * sizeof(uint32_t));
+  srand48(1);
+  for (ix = 0; ix < reporters; ix++) {
+    do {
+      ssrcs[ix] = (uint32_t)lrand48();
+    } while (ssrcs[ix] == rtp_my_ssrc(session));
+  }
+
+  start = now();
+  process_all(session, ssrcs, 1);
+  join_time = now() - start;
+
+  start = now();
+  for (ix = 0; ix < rounds; ix++) {
+    process_all(session, ssrcs, ix + 2);
+  }
+  steady_time = now() - start;
+
+  start = now();
+  missing = 0;
+  for (ix = 0; ix < reporters; ix++) {
+    if (rtp_get_rr(session, ssrcs[ix], rtp_my_ssrc(session)) == NULL) {
+      missing++;
+    }
+  }
+  get_time = now() - start;
+
+  memset(payload, 0, sizeof(payload));
+  start = now();
+  for (ix = 0; ix < SEND_PACKETS; ix++) {
+    rtp_send_data(session, ix, 96, 0, 0, NULL, payload, sizeof(payload),
+		  NULL, 0, 0);
+  }
+  send_time = now() - start;
+
+  start = now();
+  rtp_done(session);
+  done_time = now() - start;
+  free(ssrcs);
+
+  printf("%u reporters\n", reporters);
+  printf("  first reports   %.0f rtcp packets/sec\n", reporters / join_time);
+  printf("  %u more rounds  %.0f rtcp packets/sec\n", rounds,
+	 (reporters * rounds) / steady_time);
+  printf("  rtp_get_rr      %.0f lookups/sec\n", reporters / get_time);
+  printf("  rtp_send_data   %.0f packets/sec\n", SEND_PACKETS / send_time);
+  printf("  rtp_done        %.3f sec\n", done_time);
+  if (missing != 0) {
+    printf("error - %u reception reports missing\n", missing);
+    return 1;
+  }
+  return 0;
+}
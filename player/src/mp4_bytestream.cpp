@@ -60,6 +60,7 @@ CMp4ByteStream::CMp4ByteStream (CMp4File *parent,
   m_buffer = (u_int8_t *) malloc(m_max_frame_size * sizeof(u_int8_t));
   m_has_video = has_video;
   m_frame_in_buffer = 0xffffffff;
+  m_reader = MP4CreateReader(fh);
   MP4Duration trackDuration;
   trackDuration = MP4GetTrackDuration(fh, m_track);
   uint64_t max_ts;
@@ -76,6 +77,8 @@ CMp4ByteStream::CMp4ByteStream (CMp4File *parent,
 
 CMp4ByteStream::~CMp4ByteStream()
 {
+  MP4CloseReader(m_reader);
+  m_reader = MP4_INVALID_READER_HANDLE;
   if (m_buffer != NULL) {
     free(m_buffer);
     m_buffer = NULL;
@@ -209,7 +212,9 @@ void CMp4ByteStream::read_frame (uint32_t frame_to_read,
   }
   // Haven't already read the next frame,  so - get the size, see if
   // it fits, then read it into the appropriate buffer
-  m_parent->lock_file_mutex();
+  // our own reader can read while other streams do
+  bool use_lock = !MP4_IS_VALID_READER_HANDLE(m_reader);
+  if (use_lock) m_parent->lock_file_mutex();
 
   m_frame_in_buffer = frame_to_read;
 
@@ -220,20 +225,32 @@ void CMp4ByteStream::read_frame (uint32_t frame_to_read,
   u_int8_t *temp;
   m_this_frame_size = m_max_frame_size;
   temp = m_buffer;
-  ret = MP4ReadSample(m_parent->get_file(),
-		      m_track,
-		      frame_to_read,
-		      &temp,
-		      &m_this_frame_size,
-		      &sampleTime,
-		      &sampleDuration,
-		      &sampleRenderingOffset,
-		      &isSyncSample);
+  if (use_lock) {
+    ret = MP4ReadSample(m_parent->get_file(),
+			m_track,
+			frame_to_read,
+			&temp,
+			&m_this_frame_size,
+			&sampleTime,
+			&sampleDuration,
+			&sampleRenderingOffset,
+			&isSyncSample);
+  } else {
+    ret = MP4ReaderReadSample(m_reader,
+			      m_track,
+			      frame_to_read,
+			      &temp,
+			      &m_this_frame_size,
+			      &sampleTime,
+			      &sampleDuration,
+			      &sampleRenderingOffset,
+			      &isSyncSample);
+  }
   if (ret == FALSE) {
     mp4f_message(LOG_ALERT, "Couldn't read frame from mp4 file - frame %d %d", 
 		 frame_to_read, m_track);
     m_eof = true;
-    m_parent->unlock_file_mutex();
+    if (use_lock) m_parent->unlock_file_mutex();
     return;
   }
   memset(m_buffer + m_this_frame_size, 0, sizeof(uint32_t));
@@ -263,7 +280,7 @@ void CMp4ByteStream::read_frame (uint32_t frame_to_read,
   m_frame_on_ts = ts;
   m_frame_in_buffer_has_sync = m_frame_on_has_sync = isSyncSample;
 		
-  m_parent->unlock_file_mutex();
+  if (use_lock) m_parent->unlock_file_mutex();
   m_byte_on = 0;
 }
 
@@ -82,6 +82,7 @@ class CMp4ByteStream : public COurInByteStream
 #endif
   void read_frame(uint32_t frame, frame_timestamp_t *ts);
   CMp4File *m_parent;
+  MP4ReaderHandle m_reader; // own reader, so no file lock is needed
   bool m_eof;
   MP4TrackId m_track;
   MP4SampleId m_frames_max;
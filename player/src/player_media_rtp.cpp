@@ -245,7 +245,7 @@ int CPlayerMedia::recv_thread (void)
       } else {
 	timeout.tv_sec = 0;
 	timeout.tv_usec = 500000;
-	retcode = rtp_recv(m_rtp_session, &timeout, 0);
+	retcode = rtp_recv_batch(m_rtp_session, &timeout, 0);
       }
       //      player_debug_message("rtp_recv return %d", retcode);
       // Run rtp periodic after each packet received or idle time.
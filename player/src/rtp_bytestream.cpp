@@ -37,6 +37,19 @@ DEFINE_MESSAGE_MACRO(rtp_message, "rtpbyst")
 #else
 #define rtp_message(loglevel, fmt...) message(loglevel, "rtpbyst", fmt)
 #endif
+
+// size of the sequence number ring - it doubles when 2 packets on the
+// queue need the same slot.
+#define RTP_SEQ_RING_MIN_SIZE 1024
+#define RTP_SEQ_RING_MAX_SIZE 32768
+// packets up to this far behind the one last played are late, not
+// a change in the sequence numbers
+#define RTP_SEQ_LATE_WINDOW 512
+// buffer at least this many times the interarrival jitter
+#define RTP_JITTER_DELAY_MULT 4
+// the extra buffer time for late packets halves every this many msec
+// without one, so it goes away again once the network settles
+#define RTP_LATE_DELAY_HALF_LIFE_MSEC 10000
 /*
  * add_rtp_packet_to_queue() - adds rtp packet to doubly linked lists - 
  * this is used both by the bytestream, and by the player_media when trying
@@ -206,6 +219,25 @@ CRtpByteStreamBase::CRtpByteStreamBase(const char *name,
     m_rtp_base_seq_set = false;
   }
 
+  m_seq_ring = NULL;
+  m_pak_count = 0;
+  m_mbit_count = 0;
+  if (m_head != NULL) {
+    rtp_packet *pak = m_head;
+    do {
+      m_pak_count++;
+      if (pak->rtp_pak_m) m_mbit_count++;
+      pak = pak->rtp_next;
+    } while (pak != m_head);
+  }
+  seq_ring_resize(RTP_SEQ_RING_MIN_SIZE);
+  m_lost_paks = 0;
+  m_late_paks = 0;
+  m_duplicate_paks = 0;
+  m_jitter = 0;
+  m_late_delay = 0;
+  m_late_delay_time = 0;
+
   m_have_first_pak_ts = false;
   m_rtp_pt = rtp_pt;
   uint64_t temp;
@@ -242,6 +274,201 @@ CRtpByteStreamBase::~CRtpByteStreamBase (void)
     SDL_DestroyMutex(m_rtp_packet_mutex);
     m_rtp_packet_mutex = NULL;
   }
+  rtp_message(LOG_INFO, "%s - %u paks lost, %u late, %u duplicate, jitter %u",
+	      m_name, m_lost_paks, m_late_paks, m_duplicate_paks, 
+	      m_jitter >> 4);
+  free(m_seq_ring);
+  m_seq_ring = NULL;
+}
+
+/*
+ * seq_ring_resize - reallocate the sequence number ring and put
+ * the packets on the queue back in it.
+ */
+void CRtpByteStreamBase::seq_ring_resize (uint32_t size)
+{
+  rtp_packet *pak;
+
+  free(m_seq_ring);
+  m_seq_ring = (rtp_packet **)calloc(size, sizeof(rtp_packet *));
+  m_seq_ring_mask = size - 1;
+  m_seq_ring_valid = true;
+  if (m_head == NULL) return;
+  pak = m_head;
+  do {
+    seq_ring_add(pak);
+    pak = pak->rtp_next;
+  } while (pak != m_head);
+}
+
+void CRtpByteStreamBase::seq_ring_add (rtp_packet *pak)
+{
+  rtp_packet **slot = &m_seq_ring[pak->rtp_pak_seq & m_seq_ring_mask];
+
+  if (*slot == NULL) {
+    *slot = pak;
+  } else {
+    // 2 packets need this slot, so the ring can't be used to find
+    // where packets go until the queue has emptied.
+    m_seq_ring_valid = false;
+  }
+}
+
+/*
+ * add_rtp_packet - put a received packet on the queue in sequence
+ * number order.  Packets that arrive in order go on the tail;
+ * reordered packets are put in front of the next sequence number
+ * on the ring.  Duplicates and packets that are too late to be
+ * played are freed, and 0 is returned.
+ * m_rtp_packet_mutex must be held.
+ */
+int CRtpByteStreamBase::add_rtp_packet (rtp_packet *pak)
+{
+  uint16_t seq = pak->rtp_pak_seq;
+  uint16_t next;
+  int16_t head_diff, tail_diff, played_diff;
+  rtp_packet *q;
+
+#ifdef DEBUG_RTP_PAKS
+  rtp_message(LOG_DEBUG, "%s - m %u pt %u seq %u ts %x len %d", 
+	      m_name,
+	      pak->rtp_pak_m, pak->rtp_pak_pt, pak->rtp_pak_seq, 
+	      pak->rtp_pak_ts, pak->rtp_data_len);
+#endif
+  if (m_have_played_seq) {
+    played_diff = seq - m_next_seq;
+    if (played_diff < 0 && played_diff >= -RTP_SEQ_LATE_WINDOW) {
+      // we've already played past this one - remember how late it
+      // was, so the next time we buffer, we can buffer for it.
+      int32_t late = m_last_rtp_ts - pak->rtp_pak_ts;
+      if (late > 0) {
+	uint64_t late_msec = (uint64_t)late;
+	late_msec *= TO_U64(1000);
+	late_msec /= m_timescale;
+	late_msec = MIN(late_msec, m_rtp_buffer_time);
+	decay_late_delay();
+	m_late_delay = MAX(m_late_delay, late_msec);
+	m_late_delay_time = get_time_of_day();
+      }
+      m_late_paks++;
+      rtp_message(LOG_DEBUG, "%s - late pak %u, next is %u", 
+		  m_name, seq, m_next_seq);
+      xfree(pak);
+      return 0;
+    }
+  }
+
+  if (m_head == NULL) {
+    // no packets on queue
+    m_head = m_tail = pak;
+    pak->rtp_next = pak;
+    pak->rtp_prev = pak;
+  } else {
+    q = m_seq_ring[seq & m_seq_ring_mask];
+    if (q != NULL && q->rtp_pak_seq == seq) {
+      rtp_message(LOG_ERR, "%s - Duplicate of pak sequence #%u", 
+		  m_name, seq);
+      m_duplicate_paks++;
+      xfree(pak);
+      return 0;
+    }
+    head_diff = seq - m_head->rtp_pak_seq;
+    tail_diff = seq - m_tail->rtp_pak_seq;
+    if (head_diff > 0 && tail_diff > 0) {
+      // in order - add to the tail
+      pak->rtp_prev = m_tail;
+      pak->rtp_next = m_head;
+      m_tail->rtp_next = pak;
+      m_head->rtp_prev = pak;
+      m_tail = pak;
+    } else if (head_diff > 0 && tail_diff < 0 && m_seq_ring_valid) {
+      // reordered - insert before the next sequence number we have
+      for (next = seq + 1; next != m_tail->rtp_pak_seq; next++) {
+	q = m_seq_ring[next & m_seq_ring_mask];
+	if (q != NULL && q->rtp_pak_seq == next) break;
+      }
+      if (next == m_tail->rtp_pak_seq) q = m_tail;
+#ifdef DEBUG_RTP_PAKS
+      rtp_message(LOG_DEBUG, "%s - insert %u before %u",
+		  m_name, seq, q->rtp_pak_seq);
+#endif
+      q->rtp_prev->rtp_next = pak;
+      pak->rtp_prev = q->rtp_prev;
+      q->rtp_prev = pak;
+      pak->rtp_next = q;
+    } else {
+      // before the head, or we can't use the ring - walk the list
+      if (add_rtp_packet_to_queue(pak, &m_head, &m_tail, m_name) == 0) {
+	m_duplicate_paks++;
+	return 0;
+      }
+    }
+  }
+
+  m_pak_count++;
+  if (pak->rtp_pak_m) m_mbit_count++;
+  seq_ring_add(pak);
+  if (m_seq_ring_valid == false && 
+      m_seq_ring_mask + 1 < RTP_SEQ_RING_MAX_SIZE) {
+    seq_ring_resize((m_seq_ring_mask + 1) * 2);
+  }
+  return 1;
+}
+
+/*
+ * update_jitter - rfc 3550 interarrival jitter, using the arrival
+ * time converted to rtp timestamp ticks.
+ */
+void CRtpByteStreamBase::update_jitter (rtp_packet *pak)
+{
+  uint64_t arrival;
+  int32_t transit, d;
+
+  arrival = get_time_of_day();
+  arrival *= m_timescale;
+  arrival /= TO_U64(1000);
+  transit = (uint32_t)arrival - pak->rtp_pak_ts;
+  if (m_have_transit) {
+    d = transit - m_last_transit;
+    if (d < 0) d = -d;
+    m_jitter += d - ((m_jitter + 8) >> 4);
+  }
+  m_last_transit = transit;
+  m_have_transit = true;
+}
+
+/*
+ * decay_late_delay - halve the time added for late packets for each
+ * half life since the last late packet.
+ */
+void CRtpByteStreamBase::decay_late_delay (void)
+{
+  uint64_t now = get_time_of_day();
+
+  while (m_late_delay != 0 && 
+	 now - m_late_delay_time >= RTP_LATE_DELAY_HALF_LIFE_MSEC) {
+    m_late_delay /= 2;
+    m_late_delay_time += RTP_LATE_DELAY_HALF_LIFE_MSEC;
+  }
+}
+
+/*
+ * get_target_delay - how much to buffer before we start to play.  This
+ * is the configured buffer time, made longer if the jitter says it isn't
+ * enough, and by how late recent packets that missed being played were.
+ */
+uint64_t CRtpByteStreamBase::get_target_delay (void)
+{
+  uint64_t jitter_msec;
+
+  if (m_rtp_buffer_time == 0) return 0;
+
+  decay_late_delay();
+  jitter_msec = m_jitter >> 4;
+  jitter_msec *= TO_U64(1000);
+  jitter_msec /= m_timescale;
+  return MAX(m_rtp_buffer_time, jitter_msec * RTP_JITTER_DELAY_MULT) + 
+    m_late_delay;
 }
 
 // set_sync - this is for audio only - it will send messages to any
@@ -393,7 +620,7 @@ int CRtpByteStreamBase::check_buffering (void)
 	calc -= head_ts;
 	calc *= TO_U64(1000);
 	calc /= m_timescale;
-	if (calc >= m_rtp_buffer_time) {
+	if (calc >= get_target_delay()) {
 	  if (m_base_ts_set == false) {
 	    rtp_message(LOG_NOTICE, 
 			"%s - Setting rtp seq and time from 1st pak",
@@ -449,6 +676,7 @@ int CRtpByteStreamBase::recv_callback (struct rtp *session, rtp_event *e)
       }
       m_have_recv_last_ts = true;
       m_recv_last_ts = rpak->rtp_pak_ts;
+      update_jitter(rpak);
       if (m_buffering == 0) {
 	rpak->pd.rtp_pd_timestamp = get_time_of_day();
 	rpak->pd.rtp_pd_have_timestamp = 1;
@@ -457,7 +685,7 @@ int CRtpByteStreamBase::recv_callback (struct rtp *session, rtp_event *e)
 	rtp_message(LOG_CRIT, "SDL Lock mutex failure in rtp bytestream recv");
 	break;
       }
-      add_rtp_packet_to_queue(rpak, &m_head, &m_tail, m_name);
+      add_rtp_packet(rpak);
       if (SDL_mutexV(m_rtp_packet_mutex) == -1) {
 	rtp_message(LOG_CRIT, "SDL Lock mutex failure in rtp bytestream recv");
 	break;
@@ -596,6 +824,15 @@ void CRtpByteStreamBase::remove_packet_rtp_queue (rtp_packet *pak,
       m_tail = pak->rtp_prev;
     }
   }
+  if (m_seq_ring[pak->rtp_pak_seq & m_seq_ring_mask] == pak) {
+    m_seq_ring[pak->rtp_pak_seq & m_seq_ring_mask] = NULL;
+  }
+  m_pak_count--;
+  if (pak->rtp_pak_m) m_mbit_count--;
+  if (m_head == NULL) {
+    // every slot is empty again
+    m_seq_ring_valid = true;
+  }
   if (pak->rtp_data_len < 0) {
     // restore the packet data length
     pak->rtp_data_len = 0 - pak->rtp_data_len;
@@ -615,6 +852,7 @@ void CRtpByteStreamBase::flush_rtp_packets (void)
   m_buffering = 0;
   m_recvd_pak = false;
   m_recvd_pak_timeout = false;
+  m_have_played_seq = false;
 }
 
 void CRtpByteStreamBase::pause(void)
@@ -689,6 +927,11 @@ bool CRtpByteStreamBase::check_seq (uint16_t seq)
 
 void CRtpByteStreamBase::set_last_seq (uint16_t seq)
 {
+  if (m_have_played_seq) {
+    int16_t diff = seq - m_next_seq;
+    if (diff > 0) m_lost_paks += diff;
+  }
+  m_have_played_seq = true;
   m_next_seq = seq + 1;
 }
 
@@ -801,25 +1044,11 @@ uint64_t CRtpByteStreamBase::rtp_ts_to_msec (uint32_t rtp_ts,
 
 bool CRtpByteStreamBase::find_mbit (void)
 {
-  rtp_packet *temp, *first;
-  if (m_head == NULL) return false;
-  SDL_LockMutex(m_rtp_packet_mutex);
-  first = temp = m_head;
-  do {
-    if (temp->rtp_pak_m == 1) {
-      SDL_UnlockMutex(m_rtp_packet_mutex);
-      return true;
-    }
-    temp = temp->rtp_next;
-  } while (temp != NULL && temp != first);
-  SDL_UnlockMutex(m_rtp_packet_mutex);
-  return false;
+  return m_mbit_count != 0;
 }
 void CRtpByteStreamBase::display_status(void)
 {
   SDL_LockMutex(m_rtp_packet_mutex);
-  rtp_packet *pak;
-  uint32_t count;
   int32_t diff;
   if (m_head == NULL) {
     rtp_message(LOG_DEBUG, "%s - no packets", m_name);
@@ -828,15 +1057,15 @@ void CRtpByteStreamBase::display_status(void)
     SDL_UnlockMutex(m_rtp_packet_mutex);
     return;
   }
-  pak = m_head;
-  count = 1;
-  for (pak = m_head; pak->rtp_next != m_head; pak = pak->rtp_next) count++;
   diff = m_tail->rtp_pak_ts - m_head->rtp_pak_ts;
   rtp_message(LOG_DEBUG, "%s - %u paks head seq %u ts %u tail seq %u ts %u "D64, 
-	      m_name, count, m_head->rtp_pak_seq, m_head->rtp_pak_ts, 
+	      m_name, m_pak_count, m_head->rtp_pak_seq, m_head->rtp_pak_ts, 
 	      m_tail->rtp_pak_seq, m_tail->rtp_pak_ts, diff * 1000 / m_timescale);
   rtp_message(LOG_DEBUG, "%s - last rtp %u last realtime "U64 " wrap "U64,
 	      m_name, m_last_rtp_ts, m_last_realtime, m_wrap_offset);
+  rtp_message(LOG_DEBUG, "%s - %u lost %u late %u duplicate jitter %u target delay "U64,
+	      m_name, m_lost_paks, m_late_paks, m_duplicate_paks, 
+	      m_jitter >> 4, get_target_delay());
   uint32_t last_rtp_ts = m_last_rtp_ts;
   uint64_t last_realtime = m_last_realtime;
   uint64_t wrap_offset = m_wrap_offset;
@@ -66,6 +66,8 @@ class CRtpByteStreamBase : public COurInByteStream
     m_have_first_pak_ts = false;
     m_recvd_pak = false;
     m_recvd_pak_timeout = false;
+    m_have_played_seq = false;
+    m_have_transit = false;
   };
   void set_skip_on_advance (uint32_t bytes_to_skip) {
     m_skip_on_advance_bytes = bytes_to_skip;
@@ -107,8 +109,14 @@ class CRtpByteStreamBase : public COurInByteStream
   void set_rtp_buffer_time (uint64_t ts) { m_rtp_buffer_time = ts; };
   virtual bool check_rtp_frame_complete_for_payload_type(void);
   int check_buffering(void);
+  uint64_t get_target_delay(void);
  protected:
   void init(void);
+  int add_rtp_packet(rtp_packet *pak);
+  void seq_ring_add(rtp_packet *pak);
+  void seq_ring_resize(uint32_t size);
+  void update_jitter(rtp_packet *pak);
+  void decay_late_delay(void);
   // Make sure all classes call this to calculate real time.
   uint64_t rtp_ts_to_msec(uint32_t rtp_ts, uint64_t uts, uint64_t &wrap_offset);
   rtp_packet *m_head, *m_tail;
@@ -151,6 +159,24 @@ class CRtpByteStreamBase : public COurInByteStream
   rtcp_sync_t m_sync_info;
   bool m_have_recv_last_ts;
   uint32_t m_recv_last_ts;
+  // The queue is ordered by the list, but every packet on it is also
+  // in a ring indexed by sequence number, so a packet can be put in
+  // place, or found to be a duplicate, without walking the list.
+  rtp_packet **m_seq_ring;
+  uint32_t m_seq_ring_mask;
+  bool m_seq_ring_valid;
+  uint32_t m_pak_count;
+  uint32_t m_mbit_count;
+  bool m_have_played_seq;
+  // jitter buffer statistics
+  uint32_t m_lost_paks;
+  uint32_t m_late_paks;
+  uint32_t m_duplicate_paks;
+  bool m_have_transit;
+  int32_t m_last_transit;
+  uint32_t m_jitter;		// rfc 3550 interarrival jitter, in ticks * 16
+  uint64_t m_late_delay;	// msec added to the buffer time for late paks
+  uint64_t m_late_delay_time;	// when m_late_delay last changed
 };
 
 class CRtpByteStream : public CRtpByteStreamBase
@@ -103,6 +103,7 @@ int main(int argc, char** argv)
     "  -encrypt[=<track-id>]   Encrypt a track, also -E\n"
     "  -extract=<track-id>     Extract a track\n"
     "  -delete=<track-id>      Delete a track\n"
+    "  -faststart              Move the mp4 file control information to the front\n"
     "  -force3GPCompliance     Force making the file 3GP compliant. This disables ISMA compliance.\n"
     "  -forceH263Profile=<profile> Force using H.263 Profile <profile> (default is 0)\n"
     "  -forceH263Level=<level>     Force using H.263 level <level> (default is 10)\n"
@@ -132,6 +133,7 @@ int main(int argc, char** argv)
   bool doHint = false;
   bool doList = false;
   bool doOptimize = false;
+  bool doFastStart = false;
   bool doInterleave = false;
   bool doIsma = false;
   uint64_t createFlags = 0;
@@ -171,6 +173,7 @@ int main(int argc, char** argv)
       { "delete", 1, 0, 'd' },
       { "extract", 2, 0, 'e' },
       { "encrypt", 2, 0, 'E' },
+      { "faststart", 0, 0, 'F' },
       { "force3GPCompliance", 0, 0, 'G'},
       { "forceH263Profile", 1, 0, 'P'},
       { "forceH263Level", 1, 0, 'L'},
@@ -194,7 +197,7 @@ int main(int argc, char** argv)
       { NULL, 0, 0, 0 }
     };
 
-    c = getopt_long_only(argc, argv, "aBc:Cd:e:E::GH::iIlL:m:Op:P:r:t:T:uUv::VZ",
+    c = getopt_long_only(argc, argv, "aBc:Cd:e:E::FGH::iIlL:m:Op:P:r:t:T:uUv::VZ",
 			 long_options, &option_index);
 
     if (c == -1)
@@ -334,6 +337,9 @@ int main(int argc, char** argv)
     case 'O':
       doOptimize = true;
       break;
+    case 'F':
+      doFastStart = true;
+      break;
     case 'p':
       payloadName = optarg;
       break;
@@ -455,7 +461,7 @@ int main(int argc, char** argv)
   // operations consistency checks
   
   if (!doList && !doCreate && !doHint && !doEncrypt  
-      && !doOptimize && !doExtract && !doDelete && !doIsma) {
+      && !doOptimize && !doFastStart && !doExtract && !doDelete && !doIsma) {
     fprintf(stderr, 
 	    "%s: no operation specified\n",
 	    ProgName);
@@ -846,6 +852,12 @@ int main(int argc, char** argv)
       // mp4 library should have printed a message
       exit(EXIT_OPTIMIZE_FILE);
     }
+  } else if (doFastStart) {
+    // optimize already puts the moov first, this only moves it
+    if (!MP4MakeStreamable(mp4FileName, NULL, Verbosity)) {
+      // mp4 library should have printed a message
+      exit(EXIT_OPTIMIZE_FILE);
+    }
   }
 
  return(EXIT_SUCCESS);
@@ -89,6 +89,7 @@ void CAudioEncoder::Initialize (void)
 int CAudioEncoder::ThreadMain(void) 
 {
   CMsg* pMsg;
+  CMediaFrame *mf;
   bool stop = false;
 
   debug_message("audio encoder thread %s %s %s start", Profile()->GetName(),
@@ -96,7 +97,7 @@ int CAudioEncoder::ThreadMain(void)
 		Profile()->GetStringValue(CFG_AUDIO_ENCODING));
 
   while (stop == false && SDL_SemWait(m_myMsgQueueSemaphore) == 0) {
-    pMsg = m_myMsgQueue.get_message();
+    pMsg = GetSinkMessage(&mf);
     if (pMsg != NULL) {
       switch (pMsg->get_value()) {
       case MSG_NODE_STOP_THREAD:
@@ -109,31 +110,21 @@ int CAudioEncoder::ThreadMain(void)
       case MSG_NODE_STOP:
 	DoStopAudio();
 	break;
-      case MSG_SINK_FRAME: {
-	uint32_t dontcare;
-	CMediaFrame *mf = (CMediaFrame*)pMsg->get_message(dontcare);
-	if (m_stop_thread == false)
-	  ProcessAudioFrame(mf);
-	if (mf->RemoveReference()) {
-	  delete mf;
-	}
-	break;
-      }
       }
       
       delete pMsg;
-    }
-  }
-  while ((pMsg = m_myMsgQueue.get_message()) != NULL) {
-    if (pMsg->get_value() == MSG_SINK_FRAME) {
-      uint32_t dontcare;
-      CMediaFrame *mf = (CMediaFrame*)pMsg->get_message(dontcare);
+    } else if (mf != NULL) {
+      if (m_stop_thread == false)
+	ProcessAudioFrame(mf);
       if (mf->RemoveReference()) {
 	delete mf;
       }
     }
+  }
+  while ((pMsg = m_myMsgQueue.get_message()) != NULL) {
     delete pMsg;
   }
+  FlushFrames();
 
   if (m_audioResample != NULL) {
     for (uint ix = 0; ix < m_audioDstChannels; ix++) {
@@ -33,10 +33,11 @@
 int CMp4Recorder::ThreadMain(void) 
 {
   CMsg *pMsg;
+  CMediaFrame *mf;
   bool stop = false;
 
   while (stop == false && SDL_SemWait(m_myMsgQueueSemaphore) == 0) {
-    pMsg = m_myMsgQueue.get_message();
+    pMsg = GetSinkMessage(&mf);
 		
     if (pMsg != NULL) {
       switch (pMsg->get_value()) {
@@ -50,27 +51,19 @@ int CMp4Recorder::ThreadMain(void)
       case MSG_NODE_STOP:
         DoStopRecord();
         break;
-      case MSG_SINK_FRAME:
-        uint32_t dontcare;
-        DoWriteFrame((CMediaFrame*)pMsg->get_message(dontcare));
-        break;
       }
 
       delete pMsg;
+    } else if (mf != NULL) {
+      DoWriteFrame(mf);
     }
   }
 
   while ((pMsg = m_myMsgQueue.get_message()) != NULL) {
     error_message("recorder - had msg after stop");
-    if (pMsg->get_value() == MSG_SINK_FRAME) {
-      uint32_t dontcare;
-      CMediaFrame *mf = (CMediaFrame*)pMsg->get_message(dontcare);
-      if (mf->RemoveReference()) {
-	delete mf;
-      }
-    }
     delete pMsg;
   }
+  FlushFrames();
   CHECK_AND_FREE(m_videoTempBuffer);
   m_videoTempBufferSize = 0;
   return 0;
@@ -86,6 +79,7 @@ void CMp4Recorder::DoStartRecord()
 
   m_makeIod = true;
   m_makeIsmaCompliant = true;
+  m_fragmented = false;
 
   m_audioFrameType = UNDEFINEDFRAME;
   m_videoFrameType = UNDEFINEDFRAME;
@@ -214,6 +208,14 @@ void CMp4Recorder::DoStartRecord()
 			      0x0001,
 			      p3gppSupportedBrands,
 			      NUM_ELEMENTS_IN_ARRAY(p3gppSupportedBrands));
+    } else if (m_pConfig->GetIntegerValue(CONFIG_RECORD_MP4_FRAGMENT_DURATION) > 0) {
+      // fragments are flushed as we go, so memory use doesn't 
+      // grow with the length of the recording
+      m_fragmented = true;
+      m_mp4File = 
+	MP4CreateFragmented(m_mp4FileName,
+			    verbosity, createFlags,
+			    m_pConfig->GetIntegerValue(CONFIG_RECORD_MP4_FRAGMENT_DURATION));
     } else {
       m_mp4File = MP4Create(m_mp4FileName,
 			    verbosity, createFlags);
@@ -1225,6 +1227,12 @@ void CMp4Recorder::DoStopRecord()
   debug_message("done with writing last frame");
   bool optimize = false;
 
+  // fragmented files can't be modified after the fact
+  if (m_fragmented) {
+    m_sink = false;
+    return;
+  }
+
   // create hint tracks
   if (m_pConfig->GetBoolValue(CONFIG_RECORD_MP4_HINT_TRACKS)) {
 
@@ -127,6 +127,7 @@ protected:
 
   bool                  m_makeIod;
   bool                  m_makeIsmaCompliant;
+  bool                  m_fragmented;
 
   uint16_t m_amrMode;
   void ProcessEncodedAudioFrame(CMediaFrame *pFrame);
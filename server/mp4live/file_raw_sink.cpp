@@ -26,9 +26,10 @@
 int CRawFileSink::ThreadMain(void) 
 {
   CMsg *pMsg;
+  CMediaFrame *mf;
   bool stop = false;
 	while (stop == false && SDL_SemWait(m_myMsgQueueSemaphore) == 0) {
-		pMsg = m_myMsgQueue.get_message();
+		pMsg = GetSinkMessage(&mf);
 		
 		if (pMsg != NULL) {
 			switch (pMsg->get_value()) {
@@ -42,26 +43,18 @@ int CRawFileSink::ThreadMain(void)
 			case MSG_NODE_STOP:
 				DoStopSink();
 				break;
-			case MSG_SINK_FRAME:
-				uint32_t dontcare;
-				DoWriteFrame((CMediaFrame*)pMsg->get_message(dontcare));
-				break;
 			}
 
 			delete pMsg;
+		} else if (mf != NULL) {
+			DoWriteFrame(mf);
 		}
 	}
   while ((pMsg = m_myMsgQueue.get_message()) != NULL) {
     error_message("recorder - had msg after stop");
-    if (pMsg->get_value() == MSG_SINK_FRAME) {
-      uint32_t dontcare;
-      CMediaFrame *mf = (CMediaFrame*)pMsg->get_message(dontcare);
-      if (mf->RemoveReference()) {
-	delete mf;
-      }
-    }
     delete pMsg;
   }
+  FlushFrames();
   return 0;
 
 }
@@ -8,6 +8,7 @@ CMediaFeeder::CMediaFeeder (void)
   }
   for (int i = 0; i < MAX_SINKS; i++) {
     m_sinks[i] = NULL;
+    m_queues[i] = NULL;
   }
 }
 
@@ -34,8 +35,11 @@ bool CMediaFeeder::AddSink(CMediaSink* pSink)
   }
   for (i = 0; i < MAX_SINKS; i++) {
     if (m_sinks[i] == NULL) {
-      m_sinks[i] = pSink;
-      rc = true;
+      m_queues[i] = pSink->AttachFeeder();
+      if (m_queues[i] != NULL) {
+	m_sinks[i] = pSink;
+	rc = true;
+      }
       break;
     }
   }
@@ -85,10 +89,13 @@ void CMediaFeeder::RemoveSink(CMediaSink* pSink)
   for (int i = 0; i < MAX_SINKS; i++) {
     if (m_sinks[i] == pSink) {
       int j;
+      pSink->DetachFeeder(m_queues[i]);
       for (j = i; j < MAX_SINKS - 1; j++) {
 	m_sinks[j] = m_sinks[j+1];
+	m_queues[j] = m_queues[j+1];
       }
       m_sinks[j] = NULL;
+      m_queues[j] = NULL;
       break;
     }
   }
@@ -107,7 +114,9 @@ void CMediaFeeder::RemoveAllSinks(void)
     if (m_sinks[i] == NULL) {
       break;
     }
+    m_sinks[i]->DetachFeeder(m_queues[i]);
     m_sinks[i] = NULL;
+    m_queues[i] = NULL;
   }
   if (SDL_UnlockMutex(m_pSinksMutex) == -1) {
     debug_message("UnlockMutex error");
@@ -125,7 +134,7 @@ void CMediaFeeder::ForwardFrame(CMediaFrame* pFrame)
     if (m_sinks[i] == NULL) {
       break;
     }
-    m_sinks[i]->EnqueueFrame(pFrame);
+    m_sinks[i]->EnqueueFrame(m_queues[i], pFrame);
     //debug_message("forward frame type %d", pFrame->GetType());
   }
 
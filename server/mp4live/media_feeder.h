@@ -17,6 +17,8 @@ class CMediaFeeder {
   void ForwardFrame(CMediaFrame* pFrame);
   static const u_int16_t MAX_SINKS = 8;
   CMediaSink* m_sinks[MAX_SINKS];
+  // our queue to each sink
+  CMediaFrameQueue* m_queues[MAX_SINKS];
   SDL_mutex*	m_pSinksMutex;
 };
 
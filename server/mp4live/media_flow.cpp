@@ -30,6 +30,7 @@
 #include "file_raw_sink.h"
 #include "mp4live_common.h"
 #include "video_encoder.h"
+#include "video_preprocess.h"
 #include "audio_encoder.h"
 #include "text_encoder.h"
 #include "text_encoder.h"
@@ -38,6 +39,7 @@
 #include "profile_audio.h"
 #include "profile_text.h"
 #include "text_source.h"
+#include "media_frame_pool.h"
 
 
 CAVMediaFlow::CAVMediaFlow(CLiveConfig* pConfig)
@@ -55,6 +57,7 @@ CAVMediaFlow::CAVMediaFlow(CLiveConfig* pConfig)
   m_text_profile_list = NULL;
   m_stream_list = NULL;
   m_video_encoder_list = NULL;
+  m_video_preprocess_list = NULL;
   m_audio_encoder_list = NULL;
   m_text_encoder_list = NULL;
   ReadStreams();
@@ -122,15 +125,13 @@ void CAVMediaFlow::Stop(void)
 	  debug_message("Text stopped");
 	}
 
-	// stop the encoders - remove the sinks from the source
+	// stop the encoders - remove the preprocessors that feed them
+	// from the source
 	// This will stop the sinks, and deletes the rtp destinations
+	DeleteVideoPreprocessors();
 	CMediaCodec *mc = m_video_encoder_list, *p;
 	while (mc != NULL) {
 	  //debug_message("stopping video profile %s", mc->GetProfileName());
-	  if (m_videoSource != NULL) {
-	    m_videoSource->RemoveSink(mc);
-	  }
-	  //	  debug_message("sinks removed");
 	  mc->StopThread();
 	  //debug_message("thread_stopped");
 	  mc->StopSinks();
@@ -196,6 +197,15 @@ void CAVMediaFlow::Stop(void)
 	  delete m_mp4RawRecorder;
 	  m_mp4RawRecorder = NULL;
 	}
+
+	// give back the frame buffers the encoders were using - a
+	// video source still running for the preview will get more
+	frame_pool_status_t pool_status;
+	frame_pool_get_status(&pool_status);
+	debug_message("frame pool: "U64" allocs, "U64" from the heap, %u buffers "
+		      U64" bytes", pool_status.allocs, pool_status.heap_allocs,
+		      pool_status.buffers, pool_status.bytes);
+	frame_pool_trim();
 	
 	m_started = false;
 	
@@ -273,6 +283,9 @@ bool CAVMediaFlow::GetStatus(u_int32_t valueName, void* pValue)
 			*(float*)pValue = 0.0;
 		}
 		break;
+	case FLOW_STATUS_FRAME_POOL:
+		frame_pool_get_status((frame_pool_status_t *)pValue);
+		break;
 	default:
 	  return false;
 	}
@@ -829,6 +842,7 @@ CVideoEncoder *CAVMediaFlow::FindOrCreateVideoEncoder (CVideoProfile *vp,
 						       bool create)
 {
   const char *vp_name = vp->GetName();
+  uint32_t encoders = 0;
 
   CVideoEncoder *ve_ptr = m_video_encoder_list;
 
@@ -836,6 +850,7 @@ CVideoEncoder *CAVMediaFlow::FindOrCreateVideoEncoder (CVideoProfile *vp,
     if (strcmp(vp_name, ve_ptr->GetProfileName()) == 0) {
       return ve_ptr;
     }
+    encoders++;
     ve_ptr = ve_ptr->GetNext();
   }
  
@@ -846,11 +861,53 @@ CVideoEncoder *CAVMediaFlow::FindOrCreateVideoEncoder (CVideoProfile *vp,
 		       m_pConfig->GetIntegerValue(CONFIG_RTP_PAYLOAD_SIZE), 
 		       m_video_encoder_list /* TODO realTime */);
   m_video_encoder_list = ve_ptr;
+  if (m_pConfig->GetBoolValue(CONFIG_VIDEO_ENCODER_PIN_CPUS)) {
+    ve_ptr->SetThreadCpu(GetThreadCpu(encoders));
+  }
   ve_ptr->StartThread();
-  m_videoSource->AddSink(ve_ptr);
+  FindOrCreateVideoPreprocessor(vp)->AddEncoder(ve_ptr, vp);
   debug_message("Added video encoder %s", vp_name);
   return ve_ptr;
 }
+
+// FindOrCreateVideoPreprocessor - the encoders for profiles with the
+// same size and filter share the preprocessor that feeds them
+CVideoPreprocessor *CAVMediaFlow::FindOrCreateVideoPreprocessor (CVideoProfile *vp)
+{
+  CVideoPreprocessor *vpp = m_video_preprocess_list;
+
+  while (vpp != NULL) {
+    if (vpp->Matches(vp)) {
+      return vpp;
+    }
+    vpp = vpp->GetNext();
+  }
+
+  vpp = new CVideoPreprocessor(vp, m_video_preprocess_list);
+  m_video_preprocess_list = vpp;
+  vpp->StartThread();
+  m_videoSource->AddSink(vpp);
+  debug_message("Added %ux%u video preprocessor", 
+		vp->m_videoWidth, vp->m_videoHeight);
+  return vpp;
+}
+
+void CAVMediaFlow::DeleteVideoPreprocessors (void)
+{
+  CVideoPreprocessor *vpp = m_video_preprocess_list, *p;
+
+  while (vpp != NULL) {
+    if (m_videoSource != NULL) {
+      m_videoSource->RemoveSink(vpp);
+    }
+    vpp->StopThread();
+    vpp->RemoveAllSinks();
+    p = vpp;
+    vpp = vpp->GetNext();
+    delete p;
+  }
+  m_video_preprocess_list = NULL;
+}
   
 CAudioEncoder *CAVMediaFlow::FindOrCreateAudioEncoder (CAudioProfile *ap)
 {
@@ -33,6 +33,7 @@ class CMp4Recorder;
 class CVideoProfileList;
 class CAudioProfileList;
 class CVideoEncoder;
+class CVideoPreprocessor;
 class CAudioEncoder;
 class CTextSource;
 
@@ -42,6 +43,7 @@ enum {
 	FLOW_STATUS_PROGRESS,
 	FLOW_STATUS_VIDEO_ENCODED_FRAMES,
 	FLOW_STATUS_FILENAME, 
+	FLOW_STATUS_FRAME_POOL,		// frame_pool_status_t
 	FLOW_STATUS_MAX
 };
 
@@ -104,6 +106,9 @@ protected:
  protected:
 	CVideoEncoder *FindOrCreateVideoEncoder(CVideoProfile *vp, 
 						bool create = true);
+	CVideoPreprocessor *FindOrCreateVideoPreprocessor(CVideoProfile *vp);
+	void DeleteVideoPreprocessors(void);
+	CVideoPreprocessor *m_video_preprocess_list;
 	CAudioEncoder *FindOrCreateAudioEncoder(CAudioProfile *ap);
 	CTextEncoder  *FindOrCreateTextEncoder(CTextProfile *tp);
 	CMp4Recorder*		m_mp4RawRecorder;
@@ -92,10 +92,12 @@ public:
 		u_int32_t durationScale = TimestampTicks,
 		Timestamp pts = 0) {
 
+#ifndef HAVE_SYNC_BUILTINS
 		m_pMutex = SDL_CreateMutex();
 		if (m_pMutex == NULL) {
 			debug_message("CMediaFrame CreateMutex error");
 		}
+#endif
 		m_refcnt = 1;
 		m_type = type;
 		m_pData = pData;
@@ -105,6 +107,7 @@ public:
 		m_duration = duration;
 		m_durationScale = durationScale;
 		m_media_free = NULL;
+		m_keyFrame = false;
 	}
 
 	~CMediaFrame() {
@@ -114,14 +117,28 @@ public:
 	  } else {
 	    free(m_pData);
 	  }
+#ifndef HAVE_SYNC_BUILTINS
 	  SDL_DestroyMutex(m_pMutex);
+#endif
 	}
 
 	void SetMediaFreeFunction(media_free_f m) {
 	  m_media_free = m;
 	};
+	// a frame is passed to several sinks, each with its own thread -
+	// with the atomic builtins, the count doesn't need a mutex for
+	// every frame
+#ifdef HAVE_SYNC_BUILTINS
 	void AddReference(void) {
-	  uint16_t ref;
+	  __sync_add_and_fetch(&m_refcnt, 1);
+	}
+
+	bool RemoveReference(void) {
+	  return __sync_sub_and_fetch(&m_refcnt, 1) == 0;
+	}
+#else
+	void AddReference(void) {
+	  uint32_t ref;
 		if (SDL_LockMutex(m_pMutex) == -1) {
 			debug_message("AddReference LockMutex error");
 		}
@@ -134,7 +151,7 @@ public:
 	}
 
 	bool RemoveReference(void) {
-	  u_int16_t ref;
+	  uint32_t ref;
 		if (SDL_LockMutex(m_pMutex) == -1) {
 			debug_message("RemoveReference LockMutex error");
 		}
@@ -146,6 +163,7 @@ public:
 		//debug_message("%p rm %u", this, ref);
 		return ref == 0;
 	}
+#endif
 
 
 	// predefined types of frames
@@ -178,6 +196,13 @@ public:
 	void SetDuration(Duration d) {
 		m_duration = d;
 	}
+	// a frame that a sink that is behind shouldn't skip
+	bool IsKeyFrame(void) {
+		return m_keyFrame;
+	}
+	void SetKeyFrame(bool key) {
+		m_keyFrame = key;
+	}
 	u_int32_t GetDurationScale(void) {
 		return m_durationScale;
 	}
@@ -191,8 +216,10 @@ public:
 	}
 
 protected:
+#ifndef HAVE_SYNC_BUILTINS
 	SDL_mutex*	m_pMutex;
-	u_int16_t	m_refcnt;
+#endif
+	uint32_t	m_refcnt;
 	MediaType	m_type;
 	void* 		m_pData;
 	u_int32_t 	m_dataLength;
@@ -201,6 +228,7 @@ protected:
 	Duration 	m_duration;
 	u_int32_t	m_durationScale;
 	media_free_f    m_media_free;
+	bool		m_keyFrame;
 };
 
 #endif /* __MEDIA_FRAME_H__ */
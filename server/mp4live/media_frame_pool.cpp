@@ -0,0 +1,241 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ *
+ * The Original Code is MPEG4IP.
+ *
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2000-2005.  All Rights Reserved.
+ *
+ * Contributor(s):
+ *		Bill May 		wmay@cisco.com
+ */
+#include "mp4live.h"
+#include "media_frame.h"
+#include "media_frame_pool.h"
+
+// sizes are rounded up to these, so frames of nearly the same size
+// (a resized image and a converted one, say) can share a class
+#define FRAME_POOL_SMALL_ROUND 64
+#define FRAME_POOL_LARGE_ROUND 4096
+#define FRAME_POOL_MAX_CLASSES 32
+// the header in front of each buffer - keeps the images aligned for
+// the SIMD code
+#define FRAME_POOL_HEADER_SIZE 32
+#define FRAME_POOL_ALIGN 32
+
+typedef struct frame_pool_buffer_t frame_pool_buffer_t;
+
+typedef struct frame_pool_class_t {
+  uint32_t size;		// 0 if the class isn't used
+  uint32_t buffers;
+  uint32_t in_use;
+  frame_pool_buffer_t *free_list;
+} frame_pool_class_t;
+
+struct frame_pool_buffer_t {
+  frame_pool_class_t *pool_class; // NULL if not from a class
+  frame_pool_buffer_t *next_free;
+  uint32_t refs;
+};
+
+class CFramePool {
+public:
+  CFramePool(void) {
+    m_mutex = SDL_CreateMutex();
+    memset(m_classes, 0, sizeof(m_classes));
+    m_allocs = 0;
+    m_heap_allocs = 0;
+  };
+  ~CFramePool(void) {
+    SDL_DestroyMutex(m_mutex);
+  };
+  SDL_mutex *m_mutex;
+  frame_pool_class_t m_classes[FRAME_POOL_MAX_CLASSES];
+  uint64_t m_allocs;
+  uint64_t m_heap_allocs;
+};
+
+// created before main(), so before there are any threads
+static CFramePool pool;
+
+static inline frame_pool_buffer_t *buffer_from_data (void *data)
+{
+  return (frame_pool_buffer_t *)((uint8_t *)data - FRAME_POOL_HEADER_SIZE);
+}
+
+static inline void *data_from_buffer (frame_pool_buffer_t *buf)
+{
+  return (uint8_t *)buf + FRAME_POOL_HEADER_SIZE;
+}
+
+static uint32_t round_size (uint32_t size)
+{
+  if (size <= FRAME_POOL_LARGE_ROUND) {
+    return (size + FRAME_POOL_SMALL_ROUND - 1) & ~(FRAME_POOL_SMALL_ROUND - 1);
+  }
+  return (size + FRAME_POOL_LARGE_ROUND - 1) & ~(FRAME_POOL_LARGE_ROUND - 1);
+}
+
+// find_class - with the mutex held.  Returns NULL if all the classes
+// are in use by other sizes.
+static frame_pool_class_t *find_class (uint32_t size)
+{
+  frame_pool_class_t *unused = NULL;
+
+  for (uint32_t ix = 0; ix < FRAME_POOL_MAX_CLASSES; ix++) {
+    if (pool.m_classes[ix].size == size) {
+      return &pool.m_classes[ix];
+    }
+    if (unused == NULL && pool.m_classes[ix].size == 0) {
+      unused = &pool.m_classes[ix];
+    }
+  }
+  if (unused != NULL) {
+    unused->size = size;
+  }
+  return unused;
+}
+
+static frame_pool_buffer_t *malloc_buffer (uint32_t size)
+{
+  void *mem;
+
+  if (posix_memalign(&mem, FRAME_POOL_ALIGN,
+		     FRAME_POOL_HEADER_SIZE + size) != 0) {
+    throw;
+  }
+  return (frame_pool_buffer_t *)mem;
+}
+
+void *frame_pool_alloc (uint32_t size)
+{
+  frame_pool_class_t *fclass;
+  frame_pool_buffer_t *buf;
+
+  size = round_size(size == 0 ? 1 : size);
+
+  SDL_LockMutex(pool.m_mutex);
+  pool.m_allocs++;
+  fclass = find_class(size);
+  if (fclass != NULL && fclass->free_list != NULL) {
+    buf = fclass->free_list;
+    fclass->free_list = buf->next_free;
+    fclass->in_use++;
+    SDL_UnlockMutex(pool.m_mutex);
+  } else {
+    pool.m_heap_allocs++;
+    if (fclass != NULL) {
+      fclass->buffers++;
+      fclass->in_use++;
+    }
+    SDL_UnlockMutex(pool.m_mutex);
+    if (fclass == NULL) {
+      debug_message("frame pool: no class for %u bytes", size);
+    }
+    buf = malloc_buffer(size);
+    buf->pool_class = fclass;
+  }
+  buf->next_free = NULL;
+  buf->refs = 1;
+  return data_from_buffer(buf);
+}
+
+void frame_pool_add_reference (void *data)
+{
+  frame_pool_buffer_t *buf = buffer_from_data(data);
+
+  SDL_LockMutex(pool.m_mutex);
+  buf->refs++;
+  SDL_UnlockMutex(pool.m_mutex);
+}
+
+void frame_pool_free (void *data)
+{
+  frame_pool_buffer_t *buf;
+  frame_pool_class_t *fclass;
+
+  if (data == NULL) return;
+
+  buf = buffer_from_data(data);
+  SDL_LockMutex(pool.m_mutex);
+  if (--buf->refs != 0) {
+    SDL_UnlockMutex(pool.m_mutex);
+    return;
+  }
+  fclass = buf->pool_class;
+  if (fclass != NULL) {
+    buf->next_free = fclass->free_list;
+    fclass->free_list = buf;
+    fclass->in_use--;
+    buf = NULL;
+  }
+  SDL_UnlockMutex(pool.m_mutex);
+  // not from a class - give it back to the heap
+  CHECK_AND_FREE(buf);
+}
+
+void frame_pool_trim (void)
+{
+  frame_pool_buffer_t *free_lists = NULL;
+  frame_pool_buffer_t *buf;
+
+  SDL_LockMutex(pool.m_mutex);
+  for (uint32_t ix = 0; ix < FRAME_POOL_MAX_CLASSES; ix++) {
+    frame_pool_class_t *fclass = &pool.m_classes[ix];
+    while (fclass->free_list != NULL) {
+      buf = fclass->free_list;
+      fclass->free_list = buf->next_free;
+      fclass->buffers--;
+      buf->next_free = free_lists;
+      free_lists = buf;
+    }
+    if (fclass->buffers == 0) {
+      // the size can be used by another class
+      fclass->size = 0;
+    }
+  }
+  SDL_UnlockMutex(pool.m_mutex);
+
+  while (free_lists != NULL) {
+    buf = free_lists;
+    free_lists = buf->next_free;
+    free(buf);
+  }
+}
+
+void frame_pool_get_status (frame_pool_status_t *status)
+{
+  memset(status, 0, sizeof(*status));
+  SDL_LockMutex(pool.m_mutex);
+  for (uint32_t ix = 0; ix < FRAME_POOL_MAX_CLASSES; ix++) {
+    frame_pool_class_t *fclass = &pool.m_classes[ix];
+    if (fclass->size == 0) continue;
+    status->classes++;
+    status->buffers += fclass->buffers;
+    status->in_use += fclass->in_use;
+    status->idle += fclass->buffers - fclass->in_use;
+    status->bytes +=
+      (uint64_t)fclass->buffers * (fclass->size + FRAME_POOL_HEADER_SIZE);
+  }
+  status->allocs = pool.m_allocs;
+  status->heap_allocs = pool.m_heap_allocs;
+  SDL_UnlockMutex(pool.m_mutex);
+}
+
+void frame_pool_free_yuv (void *f)
+{
+  yuv_media_frame_t *yuv = (yuv_media_frame_t *)f;
+  if (yuv->free_y) {
+    frame_pool_free((void *)yuv->y);
+  }
+  frame_pool_free(yuv);
+}
@@ -0,0 +1,61 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ *
+ * The Original Code is MPEG4IP.
+ *
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2000-2005.  All Rights Reserved.
+ *
+ * Contributor(s):
+ *		Bill May 		wmay@cisco.com
+ */
+/*
+ * media_frame_pool - buffers for the raw frames that go from the video
+ * sources to the encoders and the previews.
+ *
+ * Buffers are kept in size classes; a buffer given back goes on the
+ * free list of its class and is handed out again for the next frame of
+ * that size, so once capture and encoding are going no frame memory is
+ * malloced or freed.  Buffers are reference counted, so the same image
+ * can be held by more than one frame.  Free buffers are kept until
+ * frame_pool_trim() is called, when the flow stops.
+ */
+#ifndef __MEDIA_FRAME_POOL_H__
+#define __MEDIA_FRAME_POOL_H__
+
+typedef struct frame_pool_status_t {
+  uint32_t classes;		// buffer sizes in the pool
+  uint32_t buffers;		// buffers malloced by the pool
+  uint32_t in_use;		// buffers held by frames
+  uint32_t idle;		// buffers on the free lists
+  uint64_t bytes;		// memory held by the pool
+  uint64_t allocs;		// calls to frame_pool_alloc()
+  uint64_t heap_allocs;		// of those, the ones that needed a malloc
+} frame_pool_status_t;
+
+// returns a buffer with 1 reference
+void *frame_pool_alloc(uint32_t size);
+void frame_pool_add_reference(void *buffer);
+// removes a reference - the buffer goes back to the pool on the last
+void frame_pool_free(void *buffer);
+// frees the buffers on the free lists
+void frame_pool_trim(void);
+void frame_pool_get_status(frame_pool_status_t *status);
+
+// like MALLOC_STRUCTURE, from the pool
+#define FRAME_POOL_STRUCTURE(type) (type *)frame_pool_alloc(sizeof(type))
+
+// media_free_f for a yuv_media_frame_t from the pool, with, if free_y
+// is set, an image from the pool
+void frame_pool_free_yuv(void *yuv);
+
+#endif
@@ -0,0 +1,291 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ *
+ * The Original Code is MPEG4IP.
+ *
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2000-2005.  All Rights Reserved.
+ *
+ * Contributor(s):
+ *		Bill May 		wmay@cisco.com
+ */
+#include "mp4live.h"
+#include "media_frame_queue.h"
+
+#ifdef HAVE_SYNC_BUILTINS
+#define frame_queue_barrier() __sync_synchronize()
+#define frame_queue_cas(ptr, oldval, newval) \
+  __sync_bool_compare_and_swap(ptr, oldval, newval)
+#else
+// locking and unlocking a mutex is a full barrier
+static SDL_mutex *barrier_mutex = SDL_CreateMutex();
+#define frame_queue_barrier() \
+  { SDL_LockMutex(barrier_mutex); SDL_UnlockMutex(barrier_mutex); }
+
+static bool frame_queue_cas (volatile uint32_t *ptr, uint32_t oldval,
+			     uint32_t newval)
+{
+  bool ret;
+
+  SDL_LockMutex(barrier_mutex);
+  ret = *ptr == oldval;
+  if (ret) *ptr = newval;
+  SDL_UnlockMutex(barrier_mutex);
+  return ret;
+}
+#endif
+
+CMediaFrameQueue::CMediaFrameQueue (frame_queue_policy_t policy,
+				    uint32_t depth)
+{
+  m_policy = policy;
+  m_depth = depth == 0 ? 1 : depth;
+  // for drop oldest, the frames past the depth are kept until the sink
+  // runs again and skips them
+  m_size = 2;
+  while (m_size < m_depth * 2) m_size <<= 1;
+  m_mask = m_size - 1;
+  m_slots = (frame_queue_slot_t *)Malloc(m_size * sizeof(frame_queue_slot_t));
+  m_head = 0;
+  m_tail = 0;
+  m_detached = false;
+  m_waiting = false;
+  m_space = SDL_CreateSemaphore(0);
+  m_stalled = false;
+
+  m_enqueued = 0;
+  m_dropped_newest = 0;
+  m_blocked = 0;
+  m_stalls = 0;
+  m_evicted = 0;
+  m_max_depth = 0;
+  m_dequeued = 0;
+  m_dropped_oldest = 0;
+  m_total_latency = 0;
+  m_max_latency = 0;
+}
+
+CMediaFrameQueue::~CMediaFrameQueue (void)
+{
+  Flush();
+  free(m_slots);
+  SDL_DestroySemaphore(m_space);
+}
+
+bool CMediaFrameQueue::Enqueue (CMediaFrame *pFrame)
+{
+  uint32_t tail = m_tail;
+  uint32_t depth;
+
+  if (m_policy == FRAME_QUEUE_DROP_OLDEST && tail - m_head >= m_size) {
+    EvictOldest(tail);
+  }
+  depth = tail - m_head;
+  // a stalled sink has caught up
+  if (depth == 0) m_stalled = false;
+  if (depth >= m_size ||
+      (m_policy != FRAME_QUEUE_DROP_OLDEST && depth >= m_depth)) {
+    return false;
+  }
+  // the sink is done with the slot before we write it
+  frame_queue_barrier();
+  pFrame->AddReference();
+  m_slots[tail & m_mask].frame = pFrame;
+  m_slots[tail & m_mask].enqueued = GetTimestamp();
+  m_slots[tail & m_mask].keyFrame = pFrame->IsKeyFrame();
+  // and it is written before the sink sees it
+  frame_queue_barrier();
+  m_tail = tail + 1;
+
+  m_enqueued++;
+  depth++;
+  if (depth > m_max_depth) m_max_depth = depth;
+  return true;
+}
+
+void CMediaFrameQueue::EvictOldest (uint32_t tail)
+{
+  frame_queue_slot_t oldest, next;
+  uint32_t head;
+
+  for (;;) {
+    head = m_head;
+    if (tail - head < m_size) {
+      // the sink took a frame
+      return;
+    }
+    // only we write the slots, so we can read them before we own them
+    oldest = m_slots[head & m_mask];
+    next = m_slots[(head + 1) & m_mask];
+    if (oldest.keyFrame == false || next.keyFrame) {
+      if (frame_queue_cas(&m_head, head, head + 1)) {
+	if (oldest.frame->RemoveReference()) {
+	  delete oldest.frame;
+	}
+	m_evicted++;
+	return;
+      }
+    } else if (frame_queue_cas(&m_head, head, head + 2)) {
+      // drop the frame after the key frame, and move the key frame
+      // into its slot.  m_head never went to head + 1, so the sink
+      // can't have read that slot yet.
+      if (next.frame->RemoveReference()) {
+	delete next.frame;
+      }
+      m_evicted++;
+      m_slots[(head + 1) & m_mask] = oldest;
+      if (frame_queue_cas(&m_head, head + 2, head + 1) == false) {
+	// the sink took a newer frame meanwhile - too late for this one
+	if (oldest.frame->RemoveReference()) {
+	  delete oldest.frame;
+	}
+	m_evicted++;
+      }
+      return;
+    }
+    // the sink took the oldest frame first - look again
+  }
+}
+
+void CMediaFrameQueue::WaitForSpace (uint32_t msec)
+{
+  m_blocked++;
+  m_waiting = true;
+  frame_queue_barrier();
+  // the sink may have taken a frame before it saw m_waiting
+  if (m_tail - m_head < m_depth) {
+    m_waiting = false;
+    return;
+  }
+  SDL_SemWaitTimeout(m_space, msec);
+}
+
+void CMediaFrameQueue::Detach (void)
+{
+  frame_queue_barrier();
+  m_detached = true;
+}
+
+bool CMediaFrameQueue::GetHeadTime (Timestamp *enqueued)
+{
+  uint32_t head;
+  Timestamp headTime;
+
+  do {
+    head = m_head;
+    if (head == m_tail) {
+      return false;
+    }
+    frame_queue_barrier();
+    headTime = m_slots[head & m_mask].enqueued;
+    frame_queue_barrier();
+    // unless a feeder dropping frames has reused the slot
+  } while (m_head != head);
+  *enqueued = headTime;
+  return true;
+}
+
+CMediaFrame *CMediaFrameQueue::Dequeue (void)
+{
+  frame_queue_slot_t slot;
+  uint32_t head, tail;
+  Duration latency;
+
+  for (;;) {
+    head = m_head;
+    tail = m_tail;
+    if (head == tail) {
+      return NULL;
+    }
+    // the slot is read after the tail, and before we take it - once
+    // m_head has moved on, the feeder can write the slot again
+    frame_queue_barrier();
+    slot = m_slots[head & m_mask];
+    if (frame_queue_cas(&m_head, head, head + 1) == false) {
+      // a feeder dropping frames got there first
+      continue;
+    }
+    if (m_policy == FRAME_QUEUE_DROP_OLDEST &&
+	tail - head > m_depth && slot.keyFrame == false) {
+      if (slot.frame->RemoveReference()) {
+	delete slot.frame;
+      }
+      m_dropped_oldest++;
+      continue;
+    }
+    break;
+  }
+
+  latency = GetTimestamp() - slot.enqueued;
+  m_total_latency += latency;
+  if (latency > m_max_latency) m_max_latency = latency;
+  m_dequeued++;
+
+  // the compare and swap stored m_head before m_waiting is read -
+  // WaitForSpace does the opposite, so one of us sees the other
+  if (m_waiting) {
+    m_waiting = false;
+    SDL_SemPost(m_space);
+  }
+  return slot.frame;
+}
+
+void CMediaFrameQueue::Flush (void)
+{
+  CMediaFrame *pFrame;
+  uint32_t head;
+
+  for (;;) {
+    head = m_head;
+    if (head == m_tail) {
+      break;
+    }
+    frame_queue_barrier();
+    pFrame = m_slots[head & m_mask].frame;
+    if (frame_queue_cas(&m_head, head, head + 1)) {
+      if (pFrame->RemoveReference()) {
+	delete pFrame;
+      }
+    }
+  }
+}
+
+void CMediaFrameQueue::GetStats (frame_queue_stats_t *stats)
+{
+  stats->enqueued = m_enqueued;
+  stats->dequeued = m_dequeued;
+  stats->dropped_oldest = m_dropped_oldest + m_evicted;
+  stats->dropped_newest = m_dropped_newest;
+  stats->blocked = m_blocked;
+  stats->stalls = m_stalls;
+  stats->depth = m_tail - m_head;
+  stats->max_depth = m_max_depth;
+  stats->total_latency = m_total_latency;
+  stats->max_latency = m_max_latency;
+}
+
+void CMediaFrameQueue::AddStats (frame_queue_stats_t *total,
+				 const frame_queue_stats_t *stats)
+{
+  total->enqueued += stats->enqueued;
+  total->dequeued += stats->dequeued;
+  total->dropped_oldest += stats->dropped_oldest;
+  total->dropped_newest += stats->dropped_newest;
+  total->blocked += stats->blocked;
+  total->stalls += stats->stalls;
+  total->depth += stats->depth;
+  if (stats->max_depth > total->max_depth)
+    total->max_depth = stats->max_depth;
+  total->total_latency += stats->total_latency;
+  if (stats->max_latency > total->max_latency)
+    total->max_latency = stats->max_latency;
+}
@@ -0,0 +1,134 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ *
+ * The Original Code is MPEG4IP.
+ *
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2000-2005.  All Rights Reserved.
+ *
+ * Contributor(s):
+ *		Bill May 		wmay@cisco.com
+ */
+/*
+ * media_frame_queue - the frames from one feeder to one sink.
+ *
+ * A ring of a fixed size, written only by the feeder's thread and read
+ * only by the sink's thread, so it needs no lock.  When the sink falls
+ * behind, the policy decides what happens to the frames.  For
+ * FRAME_QUEUE_DROP_OLDEST the feeder also takes frames out of a full
+ * ring, so the sink and the feeder both take the first frame by moving
+ * m_head on with a compare and swap.
+ */
+#ifndef __MEDIA_FRAME_QUEUE_H__
+#define __MEDIA_FRAME_QUEUE_H__
+
+#include "media_frame.h"
+
+typedef enum frame_queue_policy_t {
+  // the sink skips to the newest frames when more than the depth
+  // are waiting, and a full ring loses its oldest frames - but key
+  // frames are not skipped, and an incoming frame is never dropped.
+  // A full ring keeps a key frame in place of the frame after it, and
+  // only loses it for a newer key frame, or when the sink has just
+  // taken a newer frame.
+  FRAME_QUEUE_DROP_OLDEST,
+  // the feeder waits for room
+  FRAME_QUEUE_BLOCK,
+  // frames that don't fit are dropped
+  FRAME_QUEUE_DROP_NEWEST
+} frame_queue_policy_t;
+
+typedef struct frame_queue_stats_t {
+  uint64_t enqueued;
+  uint64_t dequeued;
+  uint64_t dropped_oldest;	// skipped, or pushed out of a full ring
+  uint64_t dropped_newest;	// didn't fit
+  uint64_t blocked;		// times the feeder had to wait
+  uint64_t stalls;		// times it gave up waiting
+  uint32_t depth;		// waiting now
+  uint32_t max_depth;
+  Duration total_latency;	// from enqueue to dequeue
+  Duration max_latency;
+} frame_queue_stats_t;
+
+class CMediaFrameQueue {
+ public:
+  CMediaFrameQueue(frame_queue_policy_t policy, uint32_t depth);
+  ~CMediaFrameQueue(void);
+
+  frame_queue_policy_t GetPolicy(void) { return m_policy; };
+
+  // feeder side - Enqueue adds a reference to the frame if it fits,
+  // which it always does for FRAME_QUEUE_DROP_OLDEST
+  bool Enqueue(CMediaFrame *pFrame);
+  // wait for the sink to take a frame, for FRAME_QUEUE_BLOCK
+  void WaitForSpace(uint32_t msec);
+  // a FRAME_QUEUE_BLOCK sink that stopped taking frames - the feeder
+  // drops frames instead of waiting until the sink has emptied the queue
+  bool IsStalled(void) { return m_stalled; };
+  void SetStalled(void) { m_stalled = true; m_stalls++; };
+  void DropNewest(void) { m_dropped_newest++; };
+  // the feeder won't enqueue anything more; the sink frees the queue
+  void Detach(void);
+
+  // sink side
+  bool IsDetached(void) { return m_detached; };
+  // when the first waiting frame was enqueued
+  bool GetHeadTime(Timestamp *enqueued);
+  CMediaFrame *Dequeue(void);
+  void Flush(void);
+
+  void GetStats(frame_queue_stats_t *stats);
+  static void AddStats(frame_queue_stats_t *total,
+		       const frame_queue_stats_t *stats);
+
+ protected:
+  // feeder - make room in a full ring by dropping a waiting frame
+  void EvictOldest(uint32_t tail);
+
+  typedef struct frame_queue_slot_t {
+    CMediaFrame *frame;
+    Timestamp enqueued;
+    // the feeder can't look at a frame the sink may have freed
+    bool keyFrame;
+  } frame_queue_slot_t;
+
+  frame_queue_policy_t m_policy;
+  uint32_t m_depth;
+  uint32_t m_size;		// power of 2, at least twice m_depth
+  uint32_t m_mask;
+  frame_queue_slot_t *m_slots;
+  // m_tail and the slots are only written by the feeder.  m_head is
+  // moved on by the sink, and by a FRAME_QUEUE_DROP_OLDEST feeder with
+  // a full ring - the one whose compare and swap moves it owns the frame
+  volatile uint32_t m_head;
+  volatile uint32_t m_tail;
+  volatile bool m_detached;
+  volatile bool m_waiting;
+  SDL_sem *m_space;
+  bool m_stalled;		// feeder only
+
+  // feeder counters
+  uint64_t m_enqueued;
+  uint64_t m_dropped_newest;
+  uint64_t m_blocked;
+  uint64_t m_stalls;
+  uint64_t m_evicted;		// dropped from a full ring
+  uint32_t m_max_depth;
+  // sink counters
+  uint64_t m_dequeued;
+  uint64_t m_dropped_oldest;
+  Duration m_total_latency;
+  Duration m_max_latency;
+};
+
+#endif
@@ -37,10 +37,20 @@ public:
 		m_myMsgQueueSemaphore = NULL;
 		m_pConfig = NULL;
 		m_stop_thread = false;
+		m_threadCpu = -1;
 	}
 
 	static int StartThreadCallback(void* data) {
-		return ((CMediaNode*)data)->ThreadMain();
+		CMediaNode *node = (CMediaNode*)data;
+		if (node->m_threadCpu >= 0) {
+			PinThreadToCpu(node->m_threadCpu);
+		}
+		return node->ThreadMain();
+	}
+
+	// run the thread only on this cpu - call before StartThread
+	void SetThreadCpu(int cpu) {
+		m_threadCpu = cpu;
 	}
 
 	void StartThread() {
@@ -115,6 +125,7 @@ protected:
 
 	CLiveConfig*		m_pConfig;
 	volatile bool m_stop_thread;
+	int			m_threadCpu;
 };
 
 #endif /* __MEDIA_NODE_H__ */
@@ -0,0 +1,209 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ *
+ * The Original Code is MPEG4IP.
+ *
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2000-2005.  All Rights Reserved.
+ *
+ * Contributor(s):
+ *		Bill May 		wmay@cisco.com
+ */
+#include "mp4live.h"
+#include "media_sink.h"
+
+CMediaSink::CMediaSink (void) : CMediaNode()
+{
+  m_sink = false;
+  for (int i = 0; i < MAX_FEEDERS; i++) {
+    m_frameQueues[i] = NULL;
+  }
+  m_pAttachMutex = SDL_CreateMutex();
+  if (m_pAttachMutex == NULL) {
+    debug_message("CMediaSink CreateMutex error");
+  }
+  m_frameQueuePolicy = FRAME_QUEUE_BLOCK;
+  m_frameQueueDepth = 32;
+  memset(&m_detachedStats, 0, sizeof(m_detachedStats));
+  m_pendingMsg = NULL;
+  m_pendingMsgTime = 0;
+}
+
+CMediaSink::~CMediaSink (void)
+{
+  // the thread reads the queues
+  StopThread();
+  for (int i = 0; i < MAX_FEEDERS; i++) {
+    if (m_frameQueues[i] != NULL) {
+      delete m_frameQueues[i];
+      m_frameQueues[i] = NULL;
+    }
+  }
+  if (m_pendingMsg != NULL) {
+    delete m_pendingMsg;
+    m_pendingMsg = NULL;
+  }
+  SDL_DestroyMutex(m_pAttachMutex);
+}
+
+CMediaFrameQueue *CMediaSink::AttachFeeder (void)
+{
+  CMediaFrameQueue *queue = NULL;
+
+  SDL_LockMutex(m_pAttachMutex);
+  for (int i = 0; i < MAX_FEEDERS; i++) {
+    if (m_frameQueues[i] == NULL) {
+      queue = new CMediaFrameQueue(m_frameQueuePolicy, m_frameQueueDepth);
+      m_frameQueues[i] = queue;
+      break;
+    }
+  }
+  SDL_UnlockMutex(m_pAttachMutex);
+  if (queue == NULL) {
+    error_message("%s: too many feeders", name());
+  }
+  return queue;
+}
+
+void CMediaSink::DetachFeeder (CMediaFrameQueue *queue)
+{
+  // the sink thread frees it once it is empty, or the destructor will
+  queue->Detach();
+}
+
+void CMediaSink::EnqueueFrame (CMediaFrameQueue *queue, CMediaFrame* pFrame)
+{
+  if (pFrame == NULL) {
+    debug_message("EnqueueFrame: got NULL frame!?");
+    return;
+  }
+  // nothing will read the frame if the thread isn't running
+  if (m_myMsgQueueSemaphore == NULL || m_stop_thread) {
+    queue->DropNewest();
+    return;
+  }
+
+  uint32_t waited = 0;
+  // a FRAME_QUEUE_DROP_OLDEST queue always makes room
+  while (queue->Enqueue(pFrame) == false) {
+    if (queue->GetPolicy() != FRAME_QUEUE_BLOCK ||
+	queue->IsStalled() ||
+	m_stop_thread) {
+      queue->DropNewest();
+      return;
+    }
+    if (waited >= FRAME_QUEUE_BLOCK_MSEC) {
+      // the feeder's other sinks wait with us - don't wait again
+      // until this one has caught up
+      debug_message("%s: stalled, dropping frames", name());
+      queue->SetStalled();
+      queue->DropNewest();
+      return;
+    }
+    queue->WaitForSpace(FRAME_QUEUE_WAIT_MSEC);
+    waited += FRAME_QUEUE_WAIT_MSEC;
+  }
+  SDL_SemPost(m_myMsgQueueSemaphore);
+}
+
+CMsg *CMediaSink::GetSinkMessage (CMediaFrame **ppFrame)
+{
+  CMsg *pMsg;
+
+  *ppFrame = NULL;
+  if (m_pendingMsg == NULL) {
+    m_pendingMsg = m_myMsgQueue.get_message();
+    if (m_pendingMsg == NULL) {
+      *ppFrame = DequeueFrame();
+      return NULL;
+    }
+    m_pendingMsgTime = GetTimestamp();
+  }
+  // each message and frame posts the semaphore once, so we can hand
+  // out a frame for the message's post, and the message for the frame's
+  *ppFrame = DequeueFrame(m_pendingMsgTime);
+  if (*ppFrame != NULL) {
+    return NULL;
+  }
+  pMsg = m_pendingMsg;
+  m_pendingMsg = NULL;
+  return pMsg;
+}
+
+CMediaFrame *CMediaSink::DequeueFrame (Timestamp before)
+{
+  CMediaFrameQueue *oldest = NULL;
+  Timestamp oldestTime = 0, headTime;
+
+  for (int i = 0; i < MAX_FEEDERS; i++) {
+    CMediaFrameQueue *queue = m_frameQueues[i];
+    if (queue == NULL) continue;
+    if (queue->GetHeadTime(&headTime)) {
+      // frames from all the feeders come out in the order they came in
+      if (oldest == NULL || headTime < oldestTime) {
+	oldest = queue;
+	oldestTime = headTime;
+      }
+    } else if (queue->IsDetached() && queue->GetHeadTime(&headTime) == false) {
+      // the feeder is gone - GetFrameQueueStats may be reading it
+      frame_queue_stats_t stats;
+      SDL_LockMutex(m_pAttachMutex);
+      queue->GetStats(&stats);
+      CMediaFrameQueue::AddStats(&m_detachedStats, &stats);
+      m_frameQueues[i] = NULL;
+      SDL_UnlockMutex(m_pAttachMutex);
+      delete queue;
+    }
+  }
+  if (oldest == NULL || (before != 0 && oldestTime > before)) {
+    return NULL;
+  }
+  return oldest->Dequeue();
+}
+
+void CMediaSink::FlushFrames (void)
+{
+  frame_queue_stats_t stats;
+
+  for (int i = 0; i < MAX_FEEDERS; i++) {
+    CMediaFrameQueue *queue = m_frameQueues[i];
+    if (queue != NULL) {
+      queue->Flush();
+    }
+  }
+  GetFrameQueueStats(&stats);
+  if (stats.enqueued != 0) {
+    debug_message("%s: "U64" frames, "U64" skipped, "U64" dropped, "
+		  U64" stalls, max depth %u, latency avg "U64" max "U64" usec",
+		  name(), stats.enqueued,
+		  stats.dropped_oldest, stats.dropped_newest, stats.stalls,
+		  stats.max_depth,
+		  stats.dequeued == 0 ? 0 : stats.total_latency / stats.dequeued,
+		  stats.max_latency);
+  }
+}
+
+void CMediaSink::GetFrameQueueStats (frame_queue_stats_t *stats)
+{
+  frame_queue_stats_t queueStats;
+
+  SDL_LockMutex(m_pAttachMutex);
+  *stats = m_detachedStats;
+  for (int i = 0; i < MAX_FEEDERS; i++) {
+    CMediaFrameQueue *queue = m_frameQueues[i];
+    if (queue != NULL) {
+      queue->GetStats(&queueStats);
+      CMediaFrameQueue::AddStats(stats, &queueStats);
+    }
+  }
+  SDL_UnlockMutex(m_pAttachMutex);
+}
@@ -24,51 +24,58 @@
 #define __MEDIA_SINK_H__
 
 #include "media_node.h"
+#include "media_frame_queue.h"
 
 class CMediaSink : public CMediaNode {
 public:
-	CMediaSink() : CMediaNode() {
-		m_sink = false;
-		m_pEnqueueMutex = SDL_CreateMutex();
-		if (m_pEnqueueMutex == NULL) {
-			debug_message("EnqueueFrame CreateMutex error");
-		}
-	}
-
-	~CMediaSink() {
-		SDL_DestroyMutex(m_pEnqueueMutex);
-	}
+	CMediaSink();
+	virtual ~CMediaSink();
 
-	void EnqueueFrame(CMediaFrame* pFrame) {
-		if (pFrame == NULL) {
-			debug_message("EnqueueFrame: got NULL frame!?");
-			return;
-		}
-		if (SDL_LockMutex(m_pEnqueueMutex) == -1) {
-			debug_message("EnqueueFrame LockMutex error");
-			return;
-		}
+	// feeder side - each feeder gets its own queue to the sink
+	CMediaFrameQueue *AttachFeeder(void);
+	void DetachFeeder(CMediaFrameQueue *queue);
+	void EnqueueFrame(CMediaFrameQueue *queue, CMediaFrame* pFrame);
 
-		pFrame->AddReference();
-		m_myMsgQueue.send_message(MSG_SINK_FRAME, 
-			pFrame, 0,
-			m_myMsgQueueSemaphore);
-
-		if (SDL_UnlockMutex(m_pEnqueueMutex) == -1) {
-			debug_message("EnqueueFrame UnlockMutex error");
-		}
+	// for the feeders that are attached after this
+	void SetFrameQueue(frame_queue_policy_t policy, uint32_t depth) {
+		m_frameQueuePolicy = policy;
+		m_frameQueueDepth = depth;
 	}
+	void GetFrameQueueStats(frame_queue_stats_t *stats);
 
 	virtual const char* name() {
 	  return "CMediaSink";
 	}
 protected:
+	// sink thread, after each wake up on m_myMsgQueueSemaphore -
+	// returns the next control message, or NULL and the next frame
+	// in *ppFrame.  Frames that came in before a message come first.
+	CMsg *GetSinkMessage(CMediaFrame **ppFrame);
+	// the frame that has waited longest, or NULL - if before is not
+	// 0, only one that came in before it
+	CMediaFrame *DequeueFrame(Timestamp before = 0);
+	// sink thread - releases the waiting frames when stopping
+	void FlushFrames(void);
+
 	static const uint32_t MSG_SINK = 4096;
-	static const uint32_t MSG_SINK_FRAME = MSG_SINK + 1;
+	static const uint16_t MAX_FEEDERS = 8;
+	// the longest a FRAME_QUEUE_BLOCK feeder waits before it gives
+	// up on the sink, and drops frames until the sink catches up
+	static const uint32_t FRAME_QUEUE_BLOCK_MSEC = 1000;
+	static const uint32_t FRAME_QUEUE_WAIT_MSEC = 10;
 
 	bool 		m_sink;
-	SDL_mutex*	m_pEnqueueMutex;
+	// written under m_pAttachMutex, or by the sink thread when it
+	// frees a detached queue - the sink thread reads them without it
+	CMediaFrameQueue * volatile m_frameQueues[MAX_FEEDERS];
+	SDL_mutex*	m_pAttachMutex;
+	frame_queue_policy_t m_frameQueuePolicy;
+	uint32_t	m_frameQueueDepth;
+	// from the queues of feeders that have gone
+	frame_queue_stats_t m_detachedStats;
+	// a message that is waiting for the frames before it
+	CMsg*		m_pendingMsg;
+	Timestamp	m_pendingMsgTime;
 };
 
 #endif /* __MEDIA_SINK_H__ */
-
@@ -162,6 +162,7 @@ DECLARE_CONFIG(CONFIG_VIDEO_CONTRAST);
 DECLARE_CONFIG(CONFIG_V4L_CACHE_TIMESTAMP);
 DECLARE_CONFIG(CONFIG_VIDEO_CAP_BUFF_COUNT);
 DECLARE_CONFIG(CONFIG_VIDEO_FILTER);
+DECLARE_CONFIG(CONFIG_VIDEO_ENCODER_PIN_CPUS);
 
 DECLARE_CONFIG(CONFIG_TEXT_ENABLE);
 DECLARE_CONFIG(CONFIG_TEXT_SOURCE_TYPE);
@@ -178,6 +179,7 @@ DECLARE_CONFIG(CONFIG_RECORD_MP4_OPTIMIZE);
 DECLARE_CONFIG(CONFIG_RECORD_MP4_FILE_STATUS);
 DECLARE_CONFIG(CONFIG_RECORD_MP4_VIDEO_TIMESCALE_USES_AUDIO);
 DECLARE_CONFIG(CONFIG_RECORD_MP4_ISMA_COMPLIANT);
+DECLARE_CONFIG(CONFIG_RECORD_MP4_FRAGMENT_DURATION);
 
 DECLARE_CONFIG(CONFIG_RTP_PAYLOAD_SIZE);
 DECLARE_CONFIG(CONFIG_RTP_MCAST_TTL);
@@ -266,6 +268,8 @@ static SConfigVariable MyConfigVariables[] = {
 
   CONFIG_INT(CONFIG_VIDEO_CAP_BUFF_COUNT, "videoCaptureBuffersCount", 16),
   CONFIG_STRING(CONFIG_VIDEO_FILTER, "videoFilter", "none"),
+  CONFIG_BOOL_HELP(CONFIG_VIDEO_ENCODER_PIN_CPUS, "videoEncoderPinCpus",
+		   false, "Run each video encoder on its own cpu"),
   // text
   CONFIG_BOOL(CONFIG_TEXT_ENABLE, "textEnable", false),
   CONFIG_STRING(CONFIG_TEXT_SOURCE_TYPE, "textSource", TEXT_SOURCE_DIALOG),
@@ -287,6 +291,9 @@ static SConfigVariable MyConfigVariables[] = {
   CONFIG_BOOL_HELP(CONFIG_RECORD_MP4_ISMA_COMPLIANT,
 		   "recordMp4IsmaCompliant", false, 
 		   "Make ISMA compliant mp4 files - default is false"),
+  CONFIG_INT_HELP(CONFIG_RECORD_MP4_FRAGMENT_DURATION,
+		  "recordMp4FragmentDuration", 0,
+		  "Write the mp4 file as movie fragments of this many msec - 0 disables"),
 
   // RTP
   CONFIG_INT(CONFIG_RTP_PAYLOAD_SIZE, "rtpPayloadSize", 1460),
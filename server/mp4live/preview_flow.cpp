@@ -12,7 +12,7 @@ void CPreviewAVMediaFlow::Start (bool startvideo,
   // If we're getting an encoded preview, we're going to delete the
   // encoder, then recreate the preview below
   if (m_PreviewEncoder != NULL) {
-    m_videoSource->RemoveSink(m_PreviewEncoder);
+    DeleteVideoPreprocessors();
     m_PreviewEncoder->StopThread();
     m_PreviewEncoder->RemoveSink(m_videoPreview);
     delete m_PreviewEncoder;
@@ -142,8 +142,7 @@ void CPreviewAVMediaFlow::StopVideoPreview (bool delete_it)
 	debug_message("done disconnect");
 	if (m_PreviewEncoder != NULL) {
 	  if (m_started == false) {
-	    if (m_videoSource != NULL)
-	      m_videoSource->RemoveSink(m_PreviewEncoder);
+	    DeleteVideoPreprocessors();
 	    m_PreviewEncoder->StopThread();
 	    delete m_PreviewEncoder;
 	    m_video_encoder_list = NULL;
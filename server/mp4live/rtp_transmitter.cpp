@@ -136,10 +136,11 @@ void CRtpTransmitter::AddRtpDestination (mp4live_rtp_params_t *rtp_params)
 int CRtpTransmitter::ThreadMain(void) 
 {
   CMsg* pMsg;
+  CMediaFrame *mf;
   bool stop = false;
   uint32_t len;
   while (stop == false && SDL_SemWait(m_myMsgQueueSemaphore) == 0) {
-    pMsg = m_myMsgQueue.get_message();
+    pMsg = GetSinkMessage(&mf);
     if (pMsg != NULL) {
       switch (pMsg->get_value()) {
       case MSG_NODE_STOP_THREAD:
@@ -152,10 +153,6 @@ int CRtpTransmitter::ThreadMain(void)
       case MSG_NODE_STOP:
 	DoStopTransmit();
 	break;
-      case MSG_SINK_FRAME:
-	uint32_t dontcare;
-	DoSendFrame((CMediaFrame*)pMsg->get_message(dontcare));
-	break;
       case MSG_RTP_DEST_START:
 	DoStartRtpDestination((const char *)pMsg->get_message(len), 
 			      pMsg->get_param());
@@ -167,18 +164,14 @@ int CRtpTransmitter::ThreadMain(void)
       }
       
       delete pMsg;
+    } else if (mf != NULL) {
+      DoSendFrame(mf);
     }
   }
   while ((pMsg = m_myMsgQueue.get_message()) != NULL) {
-    if (pMsg->get_value() == MSG_SINK_FRAME) {
-      uint32_t dontcare;
-      CMediaFrame *mf = (CMediaFrame*)pMsg->get_message(dontcare);
-      if (mf->RemoveReference()) {
-	delete mf;
-      }
-    }
     delete pMsg;
   }
+  FlushFrames();
   
   return 0;
 }
@@ -197,6 +190,16 @@ void CRtpTransmitter::DoStartTransmit()
   }
 }
 
+// called once a frame has been handed to every destination
+void CRtpTransmitter::FlushRtpDestinations (void)
+{
+  CRtpDestination *rdptr = m_rtpDestination;
+  while (rdptr != NULL) {
+    rdptr->flush();
+    rdptr = rdptr->get_next();
+  }
+}
+
 void CRtpTransmitter::DoStopTransmit()
 {
 	if (!m_sink) {
@@ -215,6 +218,7 @@ void CAudioRtpTransmitter::DoStopTransmit(void)
 {
 	// send any pending frames
 	SendQueuedAudioFrames();
+	FlushRtpDestinations();
 	CRtpTransmitter::DoStopTransmit();
 
 }
@@ -232,6 +236,7 @@ void CAudioRtpTransmitter::DoSendFrame(CMediaFrame* pFrame)
 
   if (pFrame->GetType() == m_frameType) {
     SendAudioFrame(pFrame);
+    FlushRtpDestinations();
   } else {
     if (pFrame->RemoveReference())
       delete pFrame;
@@ -276,6 +281,7 @@ void CVideoRtpTransmitter::DoSendFrame (CMediaFrame *pFrame)
     }
     (m_videoSendFunc)(pFrame, m_rtpDestination, rtpTimestamp, 
 		      m_mtu);
+    FlushRtpDestinations();
   } else {
     // not the fame we want - okay for previews...
     if (pFrame->RemoveReference())
@@ -313,6 +319,7 @@ void CTextRtpTransmitter::DoSendFrame (CMediaFrame *pFrame)
     }
     (m_textSendFunc)(pFrame, m_rtpDestination, rtpTimestamp, 
 		      m_mtu);
+    FlushRtpDestinations();
   } else {
     // not the fame we want - okay for previews...
     if (pFrame->RemoveReference())
@@ -821,7 +828,8 @@ void CRtpDestination::start (void)
       if (m_rtp_params->use_srtp) {
 	m_srtpSession = srtp_setup(m_rtpSession, &m_rtp_params->srtp_params);
       }
-      
+      // the packets of a frame are sent together, see flush()
+      rtp_set_option(m_rtpSession, RTP_OPT_QUEUE_SENDS, TRUE);
     }
   }
 }
@@ -861,3 +869,10 @@ int CRtpDestination::send_iov (struct iovec *piov,
   }
   return -1;
 }
+
+void CRtpDestination::flush (void)
+{
+  if (m_rtpSession != NULL) {
+    rtp_send_flush(m_rtpSession);
+  }
+}
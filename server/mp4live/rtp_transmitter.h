@@ -68,6 +68,8 @@ class CRtpDestination
 	       uint iovCount,
 	       u_int32_t rtpTimestamp,
 	       int mbit);
+  // send the packets queued by send_iov
+  void flush(void);
   CRtpDestination *get_next(void) { return m_next;};
   void set_next (CRtpDestination *p) { m_next = p; };
   void add_reference (void) {
@@ -211,6 +213,7 @@ protected:
 	virtual void DoSendFrame(CMediaFrame* pFrame) = 0;
 
 	void DoAddRtpDestinationToQueue(CRtpDestination *dest);
+	void FlushRtpDestinations(void);
 	void DoStartRtpDestination(const char *destAddr, in_port_t port);
 	void DoStopRtpDestination(const char *destAddr, in_port_t port);
 
@@ -0,0 +1,98 @@
+/*
+ * test_frame_pool - a source thread passes frames from the pool to
+ * an encoder thread, which frees them, the way the video capture and
+ * encoders do; after the first frames no buffer should come from the
+ * heap.  Then a buffer is shared, and the pool is trimmed.
+ *
+ * usage: test_frame_pool [<frames>]
+ */
+#include "mp4live.h"
+#include "media_frame.h"
+#include "media_frame_pool.h"
+
+#define QUEUE_SIZE 8
+#define SRC_SIZE ((720 * 576 * 3) / 2)
+#define DST_SIZE ((352 * 288 * 3) / 2)
+
+static uint32_t frames = 10000;
+static yuv_media_frame_t *queue[QUEUE_SIZE];
+static uint32_t queue_head, queue_tail;
+static SDL_sem *queue_full, *queue_empty;
+
+static int encoder_thread (void *data)
+{
+  for (uint32_t ix = 0; ix < frames; ix++) {
+    SDL_SemWait(queue_full);
+    yuv_media_frame_t *yuv = queue[queue_tail];
+    queue_tail = (queue_tail + 1) % QUEUE_SIZE;
+    SDL_SemPost(queue_empty);
+
+    // resize, then encode
+    uint8_t *resized = (uint8_t *)frame_pool_alloc(DST_SIZE);
+    memset(resized, yuv->y[0], DST_SIZE);
+    frame_pool_free_yuv(yuv);
+    frame_pool_free(resized);
+  }
+  return 0;
+}
+
+int main (int argc, char *argv[])
+{
+  frame_pool_status_t status;
+  uint32_t errors = 0;
+
+  if (argc > 1) frames = strtoul(argv[1], NULL, 10);
+
+  queue_full = SDL_CreateSemaphore(0);
+  queue_empty = SDL_CreateSemaphore(QUEUE_SIZE);
+  SDL_Thread *thread = SDL_CreateThread(encoder_thread, NULL);
+  for (uint32_t ix = 0; ix < frames; ix++) {
+    yuv_media_frame_t *yuv = FRAME_POOL_STRUCTURE(yuv_media_frame_t);
+    uint8_t *image = (uint8_t *)frame_pool_alloc(SRC_SIZE);
+    memset(image, ix & 0xff, SRC_SIZE);
+    yuv->y = image;
+    yuv->free_y = true;
+    SDL_SemWait(queue_empty);
+    queue[queue_head] = yuv;
+    queue_head = (queue_head + 1) % QUEUE_SIZE;
+    SDL_SemPost(queue_full);
+  }
+  SDL_WaitThread(thread, NULL);
+
+  frame_pool_get_status(&status);
+  printf("%u frames: "U64" allocs, "U64" from the heap, %u buffers in %u "
+	 "classes, "U64" bytes\n", frames, status.allocs, status.heap_allocs,
+	 status.buffers, status.classes, status.bytes);
+  // at most a queue full of frames, and the ones being filled and freed
+  if (status.heap_allocs > 3 * (QUEUE_SIZE + 2)) {
+    printf("error - too many buffers from the heap\n");
+    errors++;
+  }
+  if (status.in_use != 0 || status.classes != 3) {
+    printf("error - %u buffers in use, %u classes\n", status.in_use,
+	   status.classes);
+    errors++;
+  }
+
+  // a shared buffer goes back on the last reference
+  uint8_t *shared = (uint8_t *)frame_pool_alloc(SRC_SIZE);
+  frame_pool_add_reference(shared);
+  frame_pool_free(shared);
+  frame_pool_get_status(&status);
+  if (status.in_use != 1) {
+    printf("error - shared buffer freed with a reference left\n");
+    errors++;
+  }
+  frame_pool_free(shared);
+
+  frame_pool_trim();
+  frame_pool_get_status(&status);
+  if (status.buffers != 0 || status.classes != 0 || status.bytes != 0) {
+    printf("error - %u buffers left after trim\n", status.buffers);
+    errors++;
+  }
+
+  SDL_DestroySemaphore(queue_full);
+  SDL_DestroySemaphore(queue_empty);
+  return errors == 0 ? 0 : 1;
+}
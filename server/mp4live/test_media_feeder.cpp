@@ -0,0 +1,361 @@
+/*
+ * test_media_feeder - cost of CMediaFeeder::ForwardFrame() fanning
+ * frames out to 1 to MAX_SINKS sinks, each with its own thread, the
+ * way a source feeds its encoders and an encoder its transmitters and
+ * recorders.  The sinks just drop their reference; every frame has to
+ * be freed exactly once, after the last sink is done with it.
+ *
+ * Then the frame queue policies are checked with a sink that doesn't
+ * read its frames until the feeder has sent them all, and a stalled
+ * FRAME_QUEUE_BLOCK sink must hold up the feeder and its other sink
+ * only once.  Last, a slow FRAME_QUEUE_DROP_OLDEST sink races a feeder
+ * that is dropping frames from the same ring.
+ *
+ * usage: test_media_feeder [<frames>]
+ */
+#include "mp4live.h"
+#include "media_feeder.h"
+
+#define POLICY_FRAMES 20
+#define POLICY_DEPTH 4
+#define POLICY_KEY_FRAME 1
+
+static uint32_t frames = 200000;
+static uint8_t frame_data[160];
+static SDL_mutex *freed_mutex;
+static uint32_t freed;
+
+static void count_free (void *data)
+{
+  SDL_LockMutex(freed_mutex);
+  freed++;
+  SDL_UnlockMutex(freed_mutex);
+}
+
+class CCountSink : public CMediaSink {
+public:
+  CCountSink(SDL_sem *gate = NULL) : CMediaSink() {
+    m_gate = gate;
+    m_frames = 0;
+    m_keyFrames = 0;
+    m_outOfOrder = 0;
+    m_spin = 0;
+  };
+  uint32_t m_frames, m_keyFrames, m_outOfOrder;
+  uint32_t m_spin;		// work for each frame
+  Timestamp m_received[POLICY_FRAMES];
+protected:
+  int ThreadMain(void) {
+    CMsg *pMsg;
+    CMediaFrame *mf;
+    bool stop = false;
+    if (m_gate != NULL) {
+      SDL_SemWait(m_gate);
+    }
+    while (stop == false && SDL_SemWait(m_myMsgQueueSemaphore) == 0) {
+      pMsg = GetSinkMessage(&mf);
+      if (pMsg != NULL) {
+	if (pMsg->get_value() == MSG_NODE_STOP_THREAD) {
+	  stop = true;
+	}
+	delete pMsg;
+      } else if (mf != NULL) {
+	if (m_frames < POLICY_FRAMES) {
+	  m_received[m_frames] = mf->GetTimestamp();
+	}
+	if (m_frames > 0 && mf->GetTimestamp() <= m_last) {
+	  m_outOfOrder++;
+	}
+	m_last = mf->GetTimestamp();
+	if (mf->IsKeyFrame()) m_keyFrames++;
+	m_frames++;
+	for (volatile uint32_t spin = 0; spin < m_spin; spin++);
+	if (mf->RemoveReference()) {
+	  delete mf;
+	}
+      }
+    }
+    FlushFrames();
+    return 0;
+  };
+  SDL_sem *m_gate;
+  Timestamp m_last;
+};
+
+class CTestFeeder : public CMediaFeeder {
+public:
+  using CMediaFeeder::MAX_SINKS;
+  void Forward(CMediaFrame *pFrame) {
+    ForwardFrame(pFrame);
+  };
+};
+
+static double now (void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+static CMediaFrame *new_frame (uint32_t ix)
+{
+  CMediaFrame *frame = new CMediaFrame(PCMAUDIOFRAME,
+				       frame_data,
+				       sizeof(frame_data),
+				       ix);
+  frame->SetMediaFreeFunction(count_free);
+  return frame;
+}
+
+static uint32_t run (uint32_t sinks)
+{
+  CTestFeeder feeder;
+  CCountSink *sink[CTestFeeder::MAX_SINKS];
+  uint32_t errors = 0;
+  double start, forwarded, done;
+
+  for (uint32_t ix = 0; ix < sinks; ix++) {
+    sink[ix] = new CCountSink();
+    sink[ix]->StartThread();
+    feeder.AddSink(sink[ix]);
+  }
+  freed = 0;
+
+  start = now();
+  for (uint32_t ix = 0; ix < frames; ix++) {
+    feeder.Forward(new_frame(ix));
+  }
+  forwarded = now() - start;
+  // the sinks read the frames sent before the stop
+  for (uint32_t ix = 0; ix < sinks; ix++) {
+    sink[ix]->StopThread();
+  }
+  done = now() - start;
+
+  printf("%u sinks: forward %.0f frames/sec, all received %.0f frames/sec\n",
+	 sinks, frames / forwarded, frames / done);
+  for (uint32_t ix = 0; ix < sinks; ix++) {
+    if (sink[ix]->m_frames != frames) {
+      printf("error - sink %u received %u frames\n", ix, sink[ix]->m_frames);
+      errors++;
+    }
+    feeder.RemoveSink(sink[ix]);
+    delete sink[ix];
+  }
+  if (freed != frames) {
+    printf("error - %u of %u frames freed\n", freed, frames);
+    errors++;
+  }
+  return errors;
+}
+
+static int open_gate (void *data)
+{
+  SDL_Delay(100);
+  SDL_SemPost((SDL_sem *)data);
+  return 0;
+}
+
+static uint32_t check_policy (const char *name, frame_queue_policy_t policy,
+			      const Timestamp *expected, uint32_t expected_len,
+			      uint64_t skipped, uint64_t dropped)
+{
+  CTestFeeder feeder;
+  SDL_sem *gate = SDL_CreateSemaphore(0);
+  CCountSink *sink = new CCountSink(gate);
+  SDL_Thread *thread = NULL;
+  frame_queue_stats_t stats;
+  uint32_t errors = 0;
+
+  sink->SetFrameQueue(policy, POLICY_DEPTH);
+  sink->StartThread();
+  feeder.AddSink(sink);
+  freed = 0;
+  // a blocked feeder needs the sink to read
+  if (policy == FRAME_QUEUE_BLOCK) {
+    thread = SDL_CreateThread(open_gate, gate);
+  }
+  for (uint32_t ix = 0; ix < POLICY_FRAMES; ix++) {
+    CMediaFrame *frame = new_frame(ix);
+    frame->SetKeyFrame(ix == POLICY_KEY_FRAME);
+    feeder.Forward(frame);
+  }
+  if (thread != NULL) {
+    SDL_WaitThread(thread, NULL);
+  } else {
+    SDL_SemPost(gate);
+  }
+  sink->StopThread();
+  sink->GetFrameQueueStats(&stats);
+
+  printf("%s: received %u, skipped "U64", dropped "U64", blocked "U64
+	 ", max depth %u\n", name, sink->m_frames, stats.dropped_oldest,
+	 stats.dropped_newest, stats.blocked, stats.max_depth);
+  if (sink->m_frames != expected_len) {
+    printf("error - %s received %u frames, should be %u\n", name,
+	   sink->m_frames, expected_len);
+    errors++;
+  } else {
+    for (uint32_t ix = 0; ix < expected_len; ix++) {
+      if (sink->m_received[ix] != expected[ix]) {
+	printf("error - %s frame %u is "U64", should be "U64"\n", name, ix,
+	       sink->m_received[ix], expected[ix]);
+	errors++;
+	break;
+      }
+    }
+  }
+  if (stats.dropped_oldest != skipped || stats.dropped_newest != dropped) {
+    printf("error - %s should skip "U64" and drop "U64"\n", name, skipped,
+	   dropped);
+    errors++;
+  }
+  if (policy == FRAME_QUEUE_BLOCK && stats.blocked == 0) {
+    printf("error - %s didn't block\n", name);
+    errors++;
+  }
+  feeder.RemoveSink(sink);
+  delete sink;
+  SDL_DestroySemaphore(gate);
+  if (freed != POLICY_FRAMES) {
+    printf("error - %s freed %u of %u frames\n", name, freed, POLICY_FRAMES);
+    errors++;
+  }
+  return errors;
+}
+
+static uint32_t check_stall (void)
+{
+  CTestFeeder feeder;
+  SDL_sem *gate = SDL_CreateSemaphore(0);
+  CCountSink *stalled = new CCountSink(gate);
+  CCountSink *sibling = new CCountSink();
+  frame_queue_stats_t stats;
+  uint32_t errors = 0;
+  double start, forwarded;
+
+  stalled->SetFrameQueue(FRAME_QUEUE_BLOCK, POLICY_DEPTH);
+  sibling->SetFrameQueue(FRAME_QUEUE_BLOCK, POLICY_FRAMES);
+  stalled->StartThread();
+  sibling->StartThread();
+  feeder.AddSink(stalled);
+  feeder.AddSink(sibling);
+  freed = 0;
+
+  start = now();
+  for (uint32_t ix = 0; ix < POLICY_FRAMES; ix++) {
+    feeder.Forward(new_frame(ix));
+  }
+  forwarded = now() - start;
+  SDL_SemPost(gate);
+  stalled->StopThread();
+  sibling->StopThread();
+  stalled->GetFrameQueueStats(&stats);
+
+  printf("stall: forward %.1f sec, received %u and %u, dropped "U64
+	 ", stalls "U64"\n", forwarded, stalled->m_frames, sibling->m_frames,
+	 stats.dropped_newest, stats.stalls);
+  // one wait of a second, not one for each frame
+  if (forwarded > 1.9) {
+    printf("error - stall held up the feeder for %.1f sec\n", forwarded);
+    errors++;
+  }
+  if (stalled->m_frames != POLICY_DEPTH || sibling->m_frames != POLICY_FRAMES ||
+      stats.dropped_newest != POLICY_FRAMES - POLICY_DEPTH ||
+      stats.stalls != 1) {
+    printf("error - stall should drop "U64" frames once stalled\n",
+	   (uint64_t)(POLICY_FRAMES - POLICY_DEPTH));
+    errors++;
+  }
+  feeder.RemoveSink(stalled);
+  feeder.RemoveSink(sibling);
+  delete stalled;
+  delete sibling;
+  SDL_DestroySemaphore(gate);
+  if (freed != POLICY_FRAMES) {
+    printf("error - stall freed %u of %u frames\n", freed, POLICY_FRAMES);
+    errors++;
+  }
+  return errors;
+}
+
+static uint32_t check_drop_race (void)
+{
+  CTestFeeder feeder;
+  CCountSink *sink = new CCountSink();
+  frame_queue_stats_t stats;
+  uint32_t errors = 0;
+  uint32_t keyFrames = 0;
+
+  sink->SetFrameQueue(FRAME_QUEUE_DROP_OLDEST, 2);
+  sink->m_spin = 20000;
+  sink->StartThread();
+  feeder.AddSink(sink);
+  freed = 0;
+
+  for (uint32_t ix = 0; ix < frames; ix++) {
+    CMediaFrame *frame = new_frame(ix);
+    frame->SetKeyFrame((ix % 10) == 0);
+    if (frame->IsKeyFrame()) keyFrames++;
+    feeder.Forward(frame);
+  }
+  sink->StopThread();
+  sink->GetFrameQueueStats(&stats);
+
+  printf("drop oldest race: received %u, %u of %u key frames, skipped "U64
+	 "\n", sink->m_frames, sink->m_keyFrames, keyFrames,
+	 stats.dropped_oldest);
+  if (sink->m_outOfOrder != 0) {
+    printf("error - drop oldest race received %u frames out of order\n",
+	   sink->m_outOfOrder);
+    errors++;
+  }
+  if (sink->m_frames + stats.dropped_oldest != frames ||
+      stats.dropped_newest != 0) {
+    printf("error - drop oldest race lost frames\n");
+    errors++;
+  }
+  feeder.RemoveSink(sink);
+  delete sink;
+  if (freed != frames) {
+    printf("error - drop oldest race freed %u of %u frames\n", freed, frames);
+    errors++;
+  }
+  return errors;
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t errors = 0;
+
+  if (argc > 1) frames = strtoul(argv[1], NULL, 10);
+
+  freed_mutex = SDL_CreateMutex();
+  for (uint32_t sinks = 1; sinks <= CTestFeeder::MAX_SINKS; sinks *= 2) {
+    errors += run(sinks);
+  }
+
+  // everything, in order
+  Timestamp all[POLICY_FRAMES];
+  for (uint32_t ix = 0; ix < POLICY_FRAMES; ix++) all[ix] = ix;
+  errors += check_policy("block", FRAME_QUEUE_BLOCK, all, POLICY_FRAMES,
+			 0, 0);
+  // the first frames that fit
+  errors += check_policy("drop newest", FRAME_QUEUE_DROP_NEWEST,
+			 all, POLICY_DEPTH, 0, POLICY_FRAMES - POLICY_DEPTH);
+  // the full ring of twice the depth loses its oldest frames, but
+  // keeps the key frame, then the sink skips to the newest frames that
+  // fit in the depth - nothing new is dropped
+  static const Timestamp newest[] = {
+    POLICY_KEY_FRAME,
+    POLICY_FRAMES - 4, POLICY_FRAMES - 3, POLICY_FRAMES - 2, POLICY_FRAMES - 1
+  };
+  errors += check_policy("drop oldest", FRAME_QUEUE_DROP_OLDEST, newest,
+			 sizeof(newest) / sizeof(newest[0]),
+			 POLICY_FRAMES - sizeof(newest) / sizeof(newest[0]), 0);
+  errors += check_stall();
+  errors += check_drop_race();
+
+  SDL_DestroyMutex(freed_mutex);
+  return errors == 0 ? 0 : 1;
+}
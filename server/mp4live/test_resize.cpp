@@ -0,0 +1,219 @@
+/*
+ * test_resize - checks that scale_image_process() gives the same
+ * pixels as the column programs it replaced, for every filter and a
+ * range of sizes, with and without the SIMD kernels; then measures
+ * frames/sec for the resizes the encoder does, Y and both UV planes
+ * of a frame.
+ *
+ * usage: test_resize [<seconds per benchmark>]
+ */
+#include "mp4live.h"
+#include "video_util_resize.h"
+
+typedef struct filter_t {
+  const char *name;
+  double (*filter)(double);
+  double support;
+} filter_t;
+
+static const filter_t filters[] = {
+  { "box", Box_filter, Box_support },
+  { "triangle", Triangle_filter, Triangle_support },
+  { "hermite", Hermite_filter, Hermite_support },
+  { "bell", Bell_filter, Bell_support },
+  { "b-spline", B_spline_filter, B_spline_support },
+  { "mitchell", Mitchell_filter, Mitchell_support },
+  { "lanczos3", Lanczos3_filter, Lanczos3_support },
+};
+#define NUM_FILTERS (sizeof(filters) / sizeof(filters[0]))
+
+static const int sizes[][4] = {
+  // src w, h -> dst w, h
+  { 720, 576, 352, 288 },
+  { 720, 576, 320, 240 },
+  { 720, 576, 176, 144 },
+  { 720, 480, 640, 480 },
+  { 352, 288, 720, 576 },
+  { 176, 144, 352, 288 },
+  { 101, 77, 37, 53 },
+  { 37, 53, 101, 77 },
+  { 33, 17, 31, 19 },
+};
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static double now (void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+/*
+ * fill_image - noise, with flat blocks and gradients, so both the
+ * filtered pixels and the ones copied from constant areas are tested.
+ */
+static void fill_image (uint8_t *data, int w, int h, int stride)
+{
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      uint8_t pel;
+      switch (((x / 24) + (y / 16)) % 4) {
+      case 0:
+	pel = lrand48() & 0xff;
+	break;
+      case 1:
+	pel = (((x / 24) * 37) + ((y / 16) * 11)) & 0xff;
+	break;
+      case 2:
+	pel = (x + y) & 0xff;
+	break;
+      default:
+	pel = (lrand48() & 1) ? 255 : 0;
+	break;
+      }
+      data[(y * stride) + x] = pel;
+    }
+  }
+}
+
+/*
+ * check_size - resize one plane with each filter, and compare the
+ * row scaler, with and without SIMD, with the column programs.
+ */
+static uint32_t check_size (int sw, int sh, int dw, int dh)
+{
+  int stride = sw + 13;	// the source is cropped or padded in the encoder
+  uint8_t *src = (uint8_t *)malloc(stride * sh);
+  uint8_t *ref = (uint8_t *)malloc(dw * dh);
+  uint8_t *out = (uint8_t *)malloc(dw * dh);
+  uint32_t errors = 0;
+
+  fill_image(src, sw, sh, stride);
+  for (uint32_t ix = 0; ix < NUM_FILTERS; ix++) {
+    image_t *src_image = scale_new_image(sw, sh, 1);
+    image_t *dst_image = scale_new_image(dw, dh, 1);
+    src_image->span = stride;
+    src_image->data = src;
+    scaler_t *scaler = scale_image_init(dst_image, src_image,
+					filters[ix].filter,
+					filters[ix].support);
+    if (scaler == NULL) {
+      printf("%dx%d -> %dx%d %s: can't init scaler\n", sw, sh, dw, dh,
+	     filters[ix].name);
+      errors++;
+      continue;
+    }
+
+    dst_image->data = ref;
+    scale_image_process_columns(scaler);
+
+    for (int simd = 1; simd >= 0; simd--) {
+      memset(out, 0x5a, dw * dh);
+      scaler->simd = simd;
+      dst_image->data = out;
+      scale_image_process(scaler);
+      for (int pix = 0; pix < dw * dh; pix++) {
+	if (out[pix] != ref[pix]) {
+	  printf("%dx%d -> %dx%d %s%s: pixel %d,%d is %u should be %u\n",
+		 sw, sh, dw, dh, filters[ix].name, simd ? " simd" : "",
+		 pix % dw, pix / dw, out[pix], ref[pix]);
+	  errors++;
+	  break;
+	}
+      }
+    }
+    scale_image_done(scaler);
+    scale_free_image(src_image);
+    scale_free_image(dst_image);
+  }
+  free(src);
+  free(ref);
+  free(out);
+  return errors;
+}
+
+typedef enum { BENCH_COLUMNS, BENCH_ROWS, BENCH_ROWS_SIMD } bench_t;
+
+/*
+ * bench - frames/sec for the Y and 2 UV resizes of a 4:2:0 frame,
+ * set up the way CVideoEncoder does it.
+ */
+static double bench (int sw, int sh, int dw, int dh, bench_t type,
+		     double seconds)
+{
+  uint8_t *src = (uint8_t *)malloc((sw * sh * 3) / 2);
+  uint8_t *dst = (uint8_t *)malloc((dw * dh * 3) / 2);
+  image_t *src_y = scale_new_image(sw, sh, 1);
+  image_t *dst_y = scale_new_image(dw, dh, 1);
+  image_t *src_uv = scale_new_image(sw / 2, sh / 2, 1);
+  image_t *dst_uv = scale_new_image(dw / 2, dh / 2, 1);
+  scaler_t *y_scaler = scale_image_init(dst_y, src_y, Bell_filter,
+					Bell_support);
+  scaler_t *uv_scaler = scale_image_init(dst_uv, src_uv, Bell_filter,
+					 Bell_support);
+  uint32_t frames = 0;
+  double start, elapsed;
+
+  fill_image(src, sw, (sh * 3) / 2, sw);
+  y_scaler->simd = uv_scaler->simd = (type == BENCH_ROWS_SIMD);
+  start = now();
+  do {
+    for (int plane = 0; plane < 3; plane++) {
+      scaler_t *scaler = plane == 0 ? y_scaler : uv_scaler;
+      if (plane == 0) {
+	src_y->data = src;
+	dst_y->data = dst;
+      } else {
+	src_uv->data = src + (sw * sh) + ((plane - 1) * (sw * sh) / 4);
+	dst_uv->data = dst + (dw * dh) + ((plane - 1) * (dw * dh) / 4);
+      }
+      if (type == BENCH_COLUMNS) {
+	scale_image_process_columns(scaler);
+      } else {
+	scale_image_process(scaler);
+      }
+    }
+    frames++;
+    elapsed = now() - start;
+  } while (elapsed < seconds);
+
+  scale_image_done(y_scaler);
+  scale_image_done(uv_scaler);
+  scale_free_image(src_y);
+  scale_free_image(dst_y);
+  scale_free_image(src_uv);
+  scale_free_image(dst_uv);
+  free(src);
+  free(dst);
+  return frames / elapsed;
+}
+
+int main (int argc, char *argv[])
+{
+  double seconds = 1.0;
+  uint32_t errors = 0;
+
+  if (argc > 1) seconds = strtod(argv[1], NULL);
+  srand48(1);
+
+  for (uint32_t ix = 0; ix < NUM_SIZES; ix++) {
+    errors += check_size(sizes[ix][0], sizes[ix][1],
+			 sizes[ix][2], sizes[ix][3]);
+  }
+  printf("%u sizes, %u filters: %u mismatches\n", (uint32_t)NUM_SIZES,
+	 (uint32_t)NUM_FILTERS, errors);
+
+  if (seconds > 0.0) {
+    printf("bell filter, frames/sec    columns       rows  rows+simd\n");
+    for (uint32_t ix = 0; ix < 5; ix++) {
+      int sw = sizes[ix][0], sh = sizes[ix][1];
+      int dw = sizes[ix][2], dh = sizes[ix][3];
+      printf("%4dx%-4d -> %4dx%-4d  %10.1f %10.1f %10.1f\n",
+	     sw, sh, dw, dh,
+	     bench(sw, sh, dw, dh, BENCH_COLUMNS, seconds),
+	     bench(sw, sh, dw, dh, BENCH_ROWS, seconds),
+	     bench(sw, sh, dw, dh, BENCH_ROWS_SIMD, seconds));
+    }
+  }
+  return errors == 0 ? 0 : 1;
+}
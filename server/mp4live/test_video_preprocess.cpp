@@ -0,0 +1,266 @@
+/*
+ * test_video_preprocess - a CVideoPreprocessor feeding two encoders
+ * at different frame rates from a 30 fps source.  The faster encoder
+ * has to get every frame it would have used, a key frame request in
+ * a skipped frame has to reach the next forwarded frame, and a frame
+ * that needs no resize or filter has to reach the encoders unchanged.
+ *
+ * The encoders are sinks that count what they get.  The source sends
+ * faster than real time, so the preprocessor blocks instead of skipping
+ * to the newest frames.
+ *
+ * usage: test_video_preprocess
+ */
+#include "mp4live.h"
+#include "video_preprocess.h"
+#include "media_frame_pool.h"
+
+#define SRC_RATE 30
+#define SRC_FRAMES 300
+#define KEY_FRAME 3
+#define QUEUE_DEPTH 8
+
+static uint8_t src_image[(640 * 480 * 3) / 2];
+
+// profile_video.cpp wants the encoders for these - the preprocessor
+// only needs the size, filter and frame rate
+void AddVideoProfileEncoderVariables (CVideoProfile *vp)
+{
+}
+
+void VideoProfileCheck (CVideoProfile *vp)
+{
+}
+
+void GenerateMpeg4VideoConfig (CVideoProfile *vp)
+{
+}
+
+static Timestamp frame_time (uint32_t ix)
+{
+  return (ix * TimestampTicks) / SRC_RATE;
+}
+
+class CTestEncoder : public CMediaSink {
+public:
+  CTestEncoder(Timestamp end) : CMediaSink() {
+    SetFrameQueue(FRAME_QUEUE_BLOCK, QUEUE_DEPTH);
+    m_end = end;
+    m_done = false;
+    m_frames = 0;
+    m_unchanged = 0;
+    m_keyFrames = 0;
+    m_keyTimestamp = 0;
+    m_lastTimestamp = 0;
+    m_maxGap = 0;
+    m_width = 0;
+    m_height = 0;
+  };
+  volatile bool m_done;
+  uint32_t m_frames, m_unchanged, m_keyFrames;
+  Timestamp m_keyTimestamp, m_lastTimestamp;
+  Duration m_maxGap;
+  uint32_t m_width, m_height;
+protected:
+  int ThreadMain(void) {
+    CMsg *pMsg;
+    CMediaFrame *mf;
+    bool stop = false;
+    while (stop == false && SDL_SemWait(m_myMsgQueueSemaphore) == 0) {
+      pMsg = GetSinkMessage(&mf);
+      if (pMsg != NULL) {
+	if (pMsg->get_value() == MSG_NODE_STOP_THREAD) {
+	  stop = true;
+	}
+	delete pMsg;
+      } else if (mf != NULL) {
+	ReceiveFrame(mf);
+	if (mf->RemoveReference()) {
+	  delete mf;
+	}
+      }
+    }
+    FlushFrames();
+    return 0;
+  };
+  void ReceiveFrame(CMediaFrame *mf) {
+    yuv_media_frame_t *yuv = (yuv_media_frame_t *)mf->GetData();
+    Timestamp ts = mf->GetTimestamp();
+
+    // everything before the last frame has been through the preprocessor
+    if (ts >= m_end) {
+      m_done = true;
+      return;
+    }
+    if (m_frames > 0 && (Duration)(ts - m_lastTimestamp) > m_maxGap) {
+      m_maxGap = ts - m_lastTimestamp;
+    }
+    m_lastTimestamp = ts;
+    m_frames++;
+    if (yuv->y == src_image) m_unchanged++;
+    if (yuv->force_iframe && mf->IsKeyFrame()) {
+      if (m_keyFrames == 0) m_keyTimestamp = ts;
+      m_keyFrames++;
+    }
+    m_width = yuv->w;
+    m_height = yuv->h;
+  };
+  Timestamp m_end;
+};
+
+class CTestPreprocessor : public CVideoPreprocessor {
+public:
+  CTestPreprocessor(CVideoProfile *vp) : CVideoPreprocessor(vp) {
+    SetFrameQueue(FRAME_QUEUE_BLOCK, QUEUE_DEPTH);
+  };
+  using CVideoPreprocessor::AddSinkAtRate;
+};
+
+class CTestFeeder : public CMediaFeeder {
+public:
+  void Forward(CMediaFrame *pFrame) {
+    ForwardFrame(pFrame);
+  };
+};
+
+static CVideoProfile *new_profile (uint32_t width, uint32_t height)
+{
+  CVideoProfile *vp = new CVideoProfile(NULL, NULL);
+  vp->LoadConfigVariables();
+  vp->Initialize(false);
+  vp->SetIntegerValue(CFG_VIDEO_WIDTH, width);
+  vp->SetIntegerValue(CFG_VIDEO_HEIGHT, height);
+  vp->Update();
+  return vp;
+}
+
+static CMediaFrame *new_frame (uint32_t ix, uint16_t width, uint16_t height,
+			       bool keyFrame)
+{
+  yuv_media_frame_t *yuv = FRAME_POOL_STRUCTURE(yuv_media_frame_t);
+  memset(yuv, 0, sizeof(*yuv));
+  yuv->y = src_image;
+  yuv->u = src_image + (width * height);
+  yuv->v = yuv->u + ((width * height) / 4);
+  yuv->w = width;
+  yuv->h = height;
+  yuv->y_stride = width;
+  yuv->uv_stride = width / 2;
+  yuv->force_iframe = keyFrame;
+
+  CMediaFrame *frame = new CMediaFrame(YUVVIDEOFRAME, yuv, 0,
+				       frame_time(ix),
+				       TimestampTicks / SRC_RATE);
+  frame->SetMediaFreeFunction(frame_pool_free_yuv);
+  frame->SetKeyFrame(keyFrame);
+  return frame;
+}
+
+// keyIndex is the source frame that should carry the key frame
+// request of source frame KEY_FRAME; if not resized, only that frame
+// may be a copy
+static uint32_t check_preprocess (const char *name,
+				  uint16_t srcWidth, uint16_t srcHeight,
+				  uint16_t dstWidth, uint16_t dstHeight,
+				  float fastRate, float slowRate,
+				  uint32_t keyIndex, bool resized)
+{
+  CVideoProfile *vp = new_profile(dstWidth, dstHeight);
+  CTestPreprocessor *pp = new CTestPreprocessor(vp);
+  // the last frame is far enough ahead to always be forwarded
+  Timestamp end = frame_time(SRC_FRAMES + SRC_RATE);
+  CTestEncoder *fast = new CTestEncoder(end);
+  CTestEncoder *slow = new CTestEncoder(end);
+  CTestFeeder feeder;
+  uint32_t errors = 0;
+
+  fast->StartThread();
+  slow->StartThread();
+  pp->StartThread();
+  pp->AddSinkAtRate(slow, slowRate);
+  pp->AddSinkAtRate(fast, fastRate);
+  feeder.AddSink(pp);
+
+  for (uint32_t ix = 0; ix < SRC_FRAMES; ix++) {
+    feeder.Forward(new_frame(ix, srcWidth, srcHeight, ix == KEY_FRAME));
+  }
+  feeder.Forward(new_frame(SRC_FRAMES + SRC_RATE, srcWidth, srcHeight, false));
+  for (uint32_t wait = 0; wait < 500 && fast->m_done == false; wait++) {
+    SDL_Delay(10);
+  }
+
+  feeder.RemoveSink(pp);
+  pp->StopThread();
+  pp->RemoveAllSinks();
+  fast->StopThread();
+  slow->StopThread();
+
+  uint32_t used = (uint32_t)((SRC_FRAMES * fastRate) / SRC_RATE);
+  Duration frameDuration = (Duration)(TimestampTicks / fastRate) + 1;
+  uint32_t copies = resized ? fast->m_frames : (keyIndex != KEY_FRAME);
+
+  printf("%s: %.0f/%.0f fps, %u frames, %u unchanged, %u key frames at "
+	 U64", %ux%u\n", name, fastRate, slowRate, fast->m_frames,
+	 fast->m_unchanged, fast->m_keyFrames, fast->m_keyTimestamp,
+	 fast->m_width, fast->m_height);
+  if (fast->m_done == false) {
+    printf("error - %s didn't forward the last frame\n", name);
+    errors++;
+  }
+  if (fast->m_frames < used || fast->m_frames > used + 1 ||
+      fast->m_maxGap > frameDuration) {
+    printf("error - %s %u frames, up to "U64" apart, should be %u, "U64
+	   " apart\n", name, fast->m_frames, fast->m_maxGap, used,
+	   frameDuration);
+    errors++;
+  }
+  if (slow->m_frames != fast->m_frames) {
+    printf("error - %s slow encoder got %u frames, fast %u\n", name,
+	   slow->m_frames, fast->m_frames);
+    errors++;
+  }
+  if (fast->m_keyFrames != 1 || fast->m_keyTimestamp != frame_time(keyIndex)) {
+    printf("error - %s key frame should be source frame %u\n", name,
+	   keyIndex);
+    errors++;
+  }
+  if (fast->m_frames - fast->m_unchanged != copies) {
+    printf("error - %s %u frames copied, should be %u\n", name,
+	   fast->m_frames - fast->m_unchanged, copies);
+    errors++;
+  }
+  if (fast->m_width != dstWidth || fast->m_height != dstHeight) {
+    printf("error - %s frames are %ux%u\n", name, fast->m_width,
+	   fast->m_height);
+    errors++;
+  }
+
+  delete pp;
+  delete fast;
+  delete slow;
+  delete vp;
+  return errors;
+}
+
+int main (int argc, char *argv[])
+{
+  frame_pool_status_t status;
+  uint32_t errors = 0;
+
+  // every frame is used, and needs nothing done to it
+  errors += check_preprocess("same size", 320, 240, 320, 240,
+			     30.0, 15.0, KEY_FRAME, false);
+  // every other frame, the key frame request moves to the next one,
+  // which has to be copied to carry it
+  errors += check_preprocess("skipped key", 320, 240, 320, 240,
+			     15.0, 10.0, KEY_FRAME + 1, false);
+  errors += check_preprocess("resize", 640, 480, 320, 240,
+			     15.0, 10.0, KEY_FRAME + 1, true);
+
+  frame_pool_get_status(&status);
+  if (status.in_use != 0) {
+    printf("error - %u frame pool buffers still in use\n", status.in_use);
+    errors++;
+  }
+  return errors == 0 ? 0 : 1;
+}
@@ -365,6 +365,7 @@ CTextEncoder::CTextEncoder (CTextProfile *tp,
 int CTextEncoder::ThreadMain (void)
 {
   CMsg* pMsg;
+  CMediaFrame *mf;
   bool stop = false;
   
   Init();
@@ -377,7 +378,7 @@ int CTextEncoder::ThreadMain (void)
   while (stop == false) {
     int rc = SDL_SemWaitTimeout(m_myMsgQueueSemaphore, wait_time);
     if (rc == 0) {
-      pMsg = m_myMsgQueue.get_message();
+      pMsg = GetSinkMessage(&mf);
       if (pMsg != NULL) {
 	switch (pMsg->get_value()) {
 	case MSG_NODE_STOP_THREAD:
@@ -392,34 +393,24 @@ int CTextEncoder::ThreadMain (void)
 	case MSG_NODE_STOP:
 	  DoStopText();
 	  break;
-	case MSG_SINK_FRAME: {
-	  uint32_t dontcare;
-	  CMediaFrame *mf = (CMediaFrame*)pMsg->get_message(dontcare);
-	  if (m_stop_thread == false)
-	    ProcessTextFrame(mf);
-	  if (mf->RemoveReference()) {
-	    delete mf;
-	  }
-	  break;
-	}
 	}
       
 	delete pMsg;
-      } 
+      } else if (mf != NULL) {
+	if (m_stop_thread == false)
+	  ProcessTextFrame(mf);
+	if (mf->RemoveReference()) {
+	  delete mf;
+	}
+      }
     } else if (rc == SDL_MUTEX_TIMEDOUT) {
       SendFrame(GetTimestamp());
     }
   }
   while ((pMsg = m_myMsgQueue.get_message()) != NULL) {
-    if (pMsg->get_value() == MSG_SINK_FRAME) {
-      uint32_t dontcare;
-      CMediaFrame *mf = (CMediaFrame*)pMsg->get_message(dontcare);
-      if (mf->RemoveReference()) {
-	delete mf;
-      }
-    }
     delete pMsg;
   }
+  FlushFrames();
   debug_message("text encoder %s exit", Profile()->GetName());
   return 0;
 }
@@ -24,6 +24,9 @@
 #include <sys/time.h>
 #include <unistd.h>
 #include <stdarg.h>
+#ifdef HAVE_SCHED_SETAFFINITY
+#include <sched.h>
+#endif
 
 #include "util.h"
 
@@ -123,6 +126,53 @@ in_port_t GetRandomPort(void)
   return (in_port_t)(20000 + ((random() >> 18) << 2));
 }
 
+// GetThreadCpu - the nth of the cpus we may run on, round robin -
+// under taskset or a cpuset they aren't 0 to the number of cpus.
+// -1 if they can't be found
+int GetThreadCpu (uint32_t n)
+{
+#ifdef HAVE_SCHED_SETAFFINITY
+  cpu_set_t cpus;
+  uint32_t count = 0;
+  int cpu;
+
+  CPU_ZERO(&cpus);
+  if (sched_getaffinity(0, sizeof(cpus), &cpus) < 0) {
+    error_message("Can't get the cpus to run on: %s", strerror(errno));
+    return -1;
+  }
+  for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &cpus)) count++;
+  }
+  if (count == 0) return -1;
+  n %= count;
+  for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &cpus)) {
+      if (n == 0) return cpu;
+      n--;
+    }
+  }
+#endif
+  return -1;
+}
+
+// PinThreadToCpu - keep the calling thread on one cpu
+bool PinThreadToCpu (uint32_t cpu)
+{
+#ifdef HAVE_SCHED_SETAFFINITY
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  if (sched_setaffinity(0, sizeof(cpus), &cpus) < 0) {
+    error_message("Can't run thread on cpu %u: %s", cpu, strerror(errno));
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
 char *create_payload_number_string (uint8_t payload)
 {
   char *ret = (char *)malloc(4);
@@ -68,6 +68,8 @@ bool ValidateIpAddress (const char *address);
 bool ValidateIpPort (in_port_t port);
 in_addr_t GetRandomMcastAddress(void);
 in_port_t GetRandomPort(void);
+int GetThreadCpu(uint32_t n);
+bool PinThreadToCpu(uint32_t cpu);
 
 extern bool PrintDebugMessages;
 #endif
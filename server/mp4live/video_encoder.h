@@ -74,12 +74,6 @@ class CTimestampPush {
   uint m_in, m_out, m_max;
 };
 
-typedef enum VIDEO_FILTERS {
-  VF_NONE,
-  VF_DEINTERLACE,
-  VF_FFMPEG_DEINTERLACE_INPLACE,
-} VIDEO_FILTERS;
-
 class CVideoEncoder : public CMediaCodec {
 public:
   CVideoEncoder(CVideoProfile *vp,
@@ -133,15 +127,9 @@ public:
 				     u_int8_t* pY, u_int8_t* pU, u_int8_t* pV) = 0;
   virtual media_free_f GetMediaFreeFunction(void) { return NULL; };
 
-  // processing routines
+  // processing routines - the frames come from a CVideoPreprocessor,
+  // already cropped, resized and filtered for this profile
   void ProcessVideoYUVFrame(CMediaFrame *frame);
-  void SetVideoSrcSize(
-		       u_int16_t srcWidth,
-		       u_int16_t srcHeight,
-		       u_int16_t srcStride,
-		       bool matchAspectRatios);
-  
-  void DestroyVideoResizer();
   
   void DoStopVideo();
   inline Duration VideoDstFramesToDuration(void) {
@@ -153,40 +141,18 @@ public:
   };
   
   u_int32_t		m_videoSrcFrameNumber;
-  u_int16_t		m_videoSrcWidth;
-  u_int16_t		m_videoSrcHeight;
-  u_int16_t		m_videoSrcAdjustedHeight;
-  float			m_videoSrcAspectRatio;
-  u_int32_t		m_videoSrcYUVSize;
-  u_int32_t		m_videoSrcYSize;
-  u_int16_t		m_videoSrcYStride;
-  u_int32_t		m_videoSrcUVSize;
-  u_int16_t		m_videoSrcUVStride;
-  u_int32_t		m_videoSrcYCrop;
-  u_int32_t		m_videoSrcUVCrop;
 
   // video destination info
-  VIDEO_FILTERS         m_videoFilter;
   MediaType		m_videoDstType;
   float			m_videoDstFrameRate;
   Duration		m_videoDstFrameDuration;
   u_int32_t		m_videoDstFrameNumber;
   u_int16_t		m_videoDstWidth;
   u_int16_t		m_videoDstHeight;
-  float			m_videoDstAspectRatio;
   u_int32_t		m_videoDstYUVSize;
   u_int32_t		m_videoDstYSize;
   u_int32_t		m_videoDstUVSize;
 
-  // video resizing info
-  bool			m_videoMatchAspectRatios;
-  image_t*		m_videoSrcYImage;
-  image_t*		m_videoDstYImage;
-  scaler_t*		m_videoYResizer;
-  image_t*		m_videoSrcUVImage;
-  image_t*		m_videoDstUVImage;
-  scaler_t*		m_videoUVResizer;
-
   // video encoding info
   bool			m_videoWantKeyFrame;
 
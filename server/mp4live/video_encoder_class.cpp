@@ -23,16 +23,7 @@
 #include "mp4live.h"
 #include "video_encoder.h"
 #include "video_encoder_base.h"
-#include "video_util_filter.h"
-#ifdef HAVE_FFMPEG
-extern "C" {
-#ifdef HAVE_FFMPEG_INSTALLED
-#include <ffmpeg/avcodec.h>
-#else
-#include <avcodec.h>
-#endif
-}
-#endif
+#include "media_frame_pool.h"
 
 // Video encoder initialization
 
@@ -42,23 +33,18 @@ CVideoEncoder::CVideoEncoder(CVideoProfile *vp,
 			     bool realTime) : 
   CMediaCodec(vp, mtu, next, realTime)
 {
-  m_videoSrcYImage = NULL;
-  m_videoDstYImage = NULL;
-  m_videoYResizer = NULL;
-  m_videoSrcUVImage = NULL;
-  m_videoDstUVImage = NULL;
-  m_videoUVResizer = NULL;
   m_videoDstPrevImage = NULL;
   m_videoDstPrevReconstructImage = NULL;
-  m_videoSrcWidth = 0;
-  m_videoSrcHeight = 0;
-  m_videoSrcYStride = 0;
   m_preview = false;
+  // if we fall behind, skip to the newest source frames - the frame
+  // rate logic copes with the gap
+  SetFrameQueue(FRAME_QUEUE_DROP_OLDEST, 4);
 };
 
 int CVideoEncoder::ThreadMain(void) 
 {
   CMsg* pMsg;
+  CMediaFrame *mf;
   bool stop = false;
 
   debug_message("video encoder %s start", Profile()->GetName());
@@ -66,16 +52,6 @@ int CVideoEncoder::ThreadMain(void)
   //  debug_message("audio source frame is %d", m_audioSrcFrameNumber);
   //  m_audioSrcFrameNumber = 0;	// ensure audio is also at zero
 
-  const char *videoFilter;
-  videoFilter = Profile()->GetStringValue(CFG_VIDEO_FILTER);
-  m_videoFilter = VF_NONE;
-  if (strcasecmp(videoFilter, VIDEO_FILTER_DEINTERLACE) == 0) {
-    m_videoFilter = VF_DEINTERLACE;
-#ifdef HAVE_FFMPEG
-  } else if (strcasecmp(videoFilter, VIDEO_FILTER_FFMPEG_DEINTERLACE_INPLACE) == 0) {
-    m_videoFilter = VF_FFMPEG_DEINTERLACE_INPLACE;
-#endif
-  }
   m_videoDstFrameRate = Profile()->GetFloatValue(CFG_VIDEO_FRAME_RATE);
   m_videoDstFrameDuration = 
     (Duration)(((float)TimestampTicks / m_videoDstFrameRate) + 0.5);
@@ -84,8 +60,6 @@ int CVideoEncoder::ThreadMain(void)
     Profile()->m_videoWidth;
   m_videoDstHeight =
     Profile()->m_videoHeight;
-  m_videoDstAspectRatio = 
-    (float)Profile()->m_videoWidth / (float)Profile()->m_videoHeight;
   m_videoDstYSize = m_videoDstWidth * m_videoDstHeight;
   m_videoDstUVSize = m_videoDstYSize / 4;
   m_videoDstYUVSize = (m_videoDstYSize * 3) / 2;
@@ -103,7 +77,7 @@ int CVideoEncoder::ThreadMain(void)
   m_videoDstPrevReconstructImage = NULL;
 
   while (stop == false && SDL_SemWait(m_myMsgQueueSemaphore) == 0) {
-    pMsg = m_myMsgQueue.get_message();
+    pMsg = GetSinkMessage(&mf);
     if (pMsg != NULL) {
       switch (pMsg->get_value()) {
       case MSG_NODE_STOP_THREAD:
@@ -118,123 +92,25 @@ int CVideoEncoder::ThreadMain(void)
       case MSG_NODE_STOP:
 	DoStopVideo();
 	break;
-      case MSG_SINK_FRAME: {
-	uint32_t dontcare;
-	CMediaFrame *mf = (CMediaFrame*)pMsg->get_message(dontcare);
-	if (m_stop_thread == false)
-	  ProcessVideoYUVFrame(mf);
-	if (mf->RemoveReference()) {
-	  delete mf;
-	}
-	break;
-      }
       }
       
       delete pMsg;
-    } 
-  }
-  while ((pMsg = m_myMsgQueue.get_message()) != NULL) {
-    if (pMsg->get_value() == MSG_SINK_FRAME) {
-      uint32_t dontcare;
-      CMediaFrame *mf = (CMediaFrame*)pMsg->get_message(dontcare);
+    } else if (mf != NULL) {
+      if (m_stop_thread == false)
+	ProcessVideoYUVFrame(mf);
       if (mf->RemoveReference()) {
 	delete mf;
       }
     }
+  }
+  while ((pMsg = m_myMsgQueue.get_message()) != NULL) {
     delete pMsg;
   }
+  FlushFrames();
   debug_message("video encoder %s exit", Profile()->GetName());
   return 0;
 }
 
-static void c_ReleaseReconstruct(void *f)
-{
-  yuv_media_frame_t *yuv = (yuv_media_frame_t *)f;
-  if (yuv->free_y) {
-    CHECK_AND_FREE(yuv->y);
-  } 
-  free(yuv);
-}
-
-// Called from ProcessYUVVideoFrame when we get the first frame - 
-// it will have the source information.  
-void CVideoEncoder::SetVideoSrcSize(
-				    u_int16_t srcWidth,
-				    u_int16_t srcHeight,
-				    u_int16_t srcStride,
-				    bool matchAspectRatios)
-{
-  // N.B. InitVideo() must be called first
-
-  m_videoSrcWidth = srcWidth;
-  m_videoSrcHeight = srcHeight;
-  m_videoSrcAspectRatio = (float)srcWidth / (float)srcHeight;
-  m_videoMatchAspectRatios = matchAspectRatios;
-
-  // N.B. SetVideoSrcSize() should be called once before 
-
-  m_videoSrcYStride = srcStride;
-  m_videoSrcUVStride = srcStride / 2;
-
-  // these next three may change below
-  m_videoSrcAdjustedHeight = m_videoSrcHeight;
-  m_videoSrcYCrop = 0;
-  m_videoSrcUVCrop = 0;
-
-  // match aspect ratios
-  if (m_videoMatchAspectRatios 
-      && fabs(m_videoSrcAspectRatio - m_videoDstAspectRatio) > 0.01) {
-
-    m_videoSrcAdjustedHeight =
-      (u_int16_t)(m_videoSrcWidth / m_videoDstAspectRatio);
-    if ((m_videoSrcAdjustedHeight % 16) != 0) {
-      m_videoSrcAdjustedHeight += 16 - (m_videoSrcAdjustedHeight % 16);
-    }
-
-    if (m_videoSrcAspectRatio < m_videoDstAspectRatio) {
-      // crop src
-      m_videoSrcYCrop = m_videoSrcYStride * 
-	((m_videoSrcHeight - m_videoSrcAdjustedHeight) / 2);
-      m_videoSrcUVCrop = m_videoSrcYCrop / 4;
-    }
-  }
-
-  m_videoSrcYSize = m_videoSrcYStride 
-    * MAX(m_videoSrcHeight, m_videoSrcAdjustedHeight);
-  m_videoSrcUVSize = m_videoSrcYSize / 4;
-  m_videoSrcYUVSize = (m_videoSrcYSize * 3) / 2;
-
-  // resizing
-
-  DestroyVideoResizer();
-
-  if (m_videoSrcWidth != m_videoDstWidth 
-      || m_videoSrcAdjustedHeight != m_videoDstHeight) {
-
-    m_videoSrcYImage = 
-      scale_new_image(m_videoSrcWidth, 
-		      m_videoSrcAdjustedHeight, 1);
-    m_videoSrcYImage->span = m_videoSrcYStride;
-    m_videoDstYImage = 
-      scale_new_image(m_videoDstWidth, 
-		      m_videoDstHeight, 1);
-    m_videoYResizer = 
-      scale_image_init(m_videoDstYImage, m_videoSrcYImage, 
-		       Bell_filter, Bell_support);
-
-    m_videoSrcUVImage = 
-      scale_new_image(m_videoSrcWidth / 2, 
-		      m_videoSrcAdjustedHeight / 2, 1);
-    m_videoSrcUVImage->span = m_videoSrcUVStride;
-    m_videoDstUVImage = 
-      scale_new_image(m_videoDstWidth / 2, 
-		      m_videoDstHeight / 2, 1);
-    m_videoUVResizer = 
-      scale_image_init(m_videoDstUVImage, m_videoSrcUVImage, 
-		       Bell_filter, Bell_support);
-  }
-}
-
 void CVideoEncoder::ProcessVideoYUVFrame(CMediaFrame *pFrame)
 {
   yuv_media_frame_t *pYUV = (yuv_media_frame_t *)pFrame->GetData();
@@ -245,13 +121,16 @@ void CVideoEncoder::ProcessVideoYUVFrame(CMediaFrame *pFrame)
   u_int16_t uvStride = pYUV->uv_stride;
   Timestamp srcFrameTimestamp = pFrame->GetTimestamp();
 
+  if (pYUV->w != m_videoDstWidth || pYUV->h != m_videoDstHeight) {
+    error_message("video encoder %s: %ux%u frame, should be %ux%u",
+		  Profile()->GetName(), pYUV->w, pYUV->h,
+		  m_videoDstWidth, m_videoDstHeight);
+    return;
+  }
   if (m_videoSrcFrameNumber == 0) {
     m_videoStartTimestamp = srcFrameTimestamp;
-    SetVideoSrcSize(pYUV->w, pYUV->h, yStride, false);
   }
 
-  // if we want to be able to handle different input sizes, we
-  // can check pYUV->w, pYUV->h, ystride against the stored values
   m_videoSrcFrameNumber++;
   m_videoSrcElapsedDuration = srcFrameTimestamp - m_videoStartTimestamp;
 
@@ -315,90 +194,10 @@ void CVideoEncoder::ProcessVideoYUVFrame(CMediaFrame *pFrame)
   //Timestamp encodingStartTimestamp = GetTimestamp();
 
 
-  u_int8_t* mallocedYuvImage = NULL;
-
-  // crop to desired aspect ratio (may be a no-op)
-  const u_int8_t* yImage = pY + m_videoSrcYCrop;
-  const u_int8_t* uImage = pU + m_videoSrcUVCrop;
-  const u_int8_t* vImage = pV + m_videoSrcUVCrop;
-
-  // resize image if necessary
-  if (m_videoYResizer) {
-    u_int8_t* resizedYUV = (u_int8_t*)Malloc(m_videoDstYUVSize);
-		
-    u_int8_t* resizedY = resizedYUV;
-    u_int8_t* resizedU = resizedYUV + m_videoDstYSize;
-    u_int8_t* resizedV = resizedYUV + m_videoDstYSize + m_videoDstUVSize;
-
-    m_videoSrcYImage->data = (pixel_t *)yImage;
-    m_videoDstYImage->data = resizedY;
-    scale_image_process(m_videoYResizer);
-
-    m_videoSrcUVImage->data = (pixel_t *)uImage;
-    m_videoDstUVImage->data = resizedU;
-    scale_image_process(m_videoUVResizer);
-
-    m_videoSrcUVImage->data = (pixel_t *)vImage;
-    m_videoDstUVImage->data = resizedV;
-    scale_image_process(m_videoUVResizer);
-
-    // done with the original source image
-    if (mallocedYuvImage) free(mallocedYuvImage);
-
-    // switch over to resized version
-    mallocedYuvImage = resizedYUV;
-    yImage = resizedY;
-    uImage = resizedU;
-    vImage = resizedV;
-    yStride = m_videoDstWidth;
-    uvStride = yStride / 2;
-  }
-  // this has to be rewritten to not mess with the original YUV, 
-  // since it has to be done after the resizer.
-  if (m_videoFilter != VF_NONE) {
-    if (mallocedYuvImage == NULL) {
-      u_int8_t* YUV = (u_int8_t*)Malloc(m_videoDstYUVSize);
-		
-      u_int8_t* pY = YUV;
-      u_int8_t* pU = YUV + m_videoDstYSize;
-      u_int8_t* pV = YUV + m_videoDstYSize + m_videoDstUVSize;
-      CopyYuv(yImage, uImage, vImage, yStride, uvStride, uvStride,
-	      pY, pU, pV, m_videoDstWidth, m_videoDstWidth/2, m_videoDstWidth / 2,
-	      m_videoDstWidth, m_videoDstHeight);
-      mallocedYuvImage = YUV;
-      yImage = pY;
-      uImage = pU;
-      vImage = pV;
-      yStride = m_videoDstWidth;
-      uvStride = yStride / 2;
-      // need to copy
-    }
-    switch (m_videoFilter) {
-    case VF_DEINTERLACE:
-      video_filter_interlace((uint8_t *)yImage, 
-			     (uint8_t *)yImage + m_videoDstYSize, yStride);
-      break;
-#ifdef HAVE_FFMPEG
-    case VF_FFMPEG_DEINTERLACE_INPLACE: {
-      AVPicture src;
-      avpicture_fill(&src, (uint8_t *)yImage, PIX_FMT_YUV420P, m_videoDstWidth, m_videoDstHeight);
-      avpicture_deinterlace(&src, &src, PIX_FMT_YUV420P, 
-			    m_videoDstWidth, m_videoDstHeight);
-      break;
-    }
-#else
-    case VF_FFMPEG_DEINTERLACE_INPLACE:
-#endif
-    case VF_NONE:
-    default:
-      break;
-    //debug_message("ffmpeg_deinterlace");
-    }
-  }
   // if we want encoded video frames
   // this checkr really doesnt need to be here
   bool rc = EncodeImage(
-			yImage, uImage, vImage, 
+			pY, pU, pV, 
 			yStride, uvStride,
 			m_videoWantKeyFrame |
 			pYUV->force_iframe,
@@ -407,7 +206,6 @@ void CVideoEncoder::ProcessVideoYUVFrame(CMediaFrame *pFrame)
 
   if (!rc) {
     debug_message("Can't encode image!");
-    if (mallocedYuvImage) free(mallocedYuvImage);
     return;
   }
 
@@ -437,11 +235,11 @@ void CVideoEncoder::ProcessVideoYUVFrame(CMediaFrame *pFrame)
 
   // forward reconstructed video to sinks
   if (m_preview) {
-    yuv_media_frame_t *mf = MALLOC_STRUCTURE(yuv_media_frame_t);
+    yuv_media_frame_t *mf = FRAME_POOL_STRUCTURE(yuv_media_frame_t);
     uint8_t *alloced;
     mf->y_stride = m_videoDstWidth;
     mf->uv_stride = m_videoDstWidth / 2;
-    mf->y =  alloced = (u_int8_t*)Malloc(m_videoDstYUVSize);
+    mf->y =  alloced = (u_int8_t*)frame_pool_alloc(m_videoDstYUVSize);
     mf->u = mf->y + m_videoDstYSize;
     mf->v = mf->u + m_videoDstUVSize;
     mf->w = m_videoDstWidth;
@@ -457,55 +255,22 @@ void CVideoEncoder::ProcessVideoYUVFrame(CMediaFrame *pFrame)
 					    0,
 					    srcFrameTimestamp,
 					    m_videoDstFrameDuration);
-      pFrame->SetMediaFreeFunction(c_ReleaseReconstruct);
+      pFrame->SetMediaFreeFunction(frame_pool_free_yuv);
       ForwardFrame(pFrame);
     } else {
-      CHECK_AND_FREE(mf->y);
-      free(mf);
+      frame_pool_free_yuv(mf);
     }
   }
-
-  if (mallocedYuvImage) free(mallocedYuvImage);
 }
 
 void CVideoEncoder::DoStopVideo()
 {
-  DestroyVideoResizer();
-
   StopEncoder();
   debug_message("Video encoding profile %s stats", GetProfileName());
   debug_message("Encoded frames: %u", m_videoDstFrameNumber);
 		
 }
 
-void CVideoEncoder::DestroyVideoResizer()
-{
-  if (m_videoSrcYImage) {
-    scale_free_image(m_videoSrcYImage);
-    m_videoSrcYImage = NULL;
-  }
-  if (m_videoDstYImage) {
-    scale_free_image(m_videoDstYImage);
-    m_videoDstYImage = NULL;
-  }
-  if (m_videoYResizer) {
-    scale_image_done(m_videoYResizer);
-    m_videoYResizer = NULL;
-  }
-  if (m_videoSrcUVImage) {
-    scale_free_image(m_videoSrcUVImage);
-    m_videoSrcUVImage = NULL;
-  }
-  if (m_videoDstUVImage) {
-    scale_free_image(m_videoDstUVImage);
-    m_videoDstUVImage = NULL;
-  }
-  if (m_videoUVResizer) {
-    scale_image_done(m_videoUVResizer);
-    m_videoUVResizer = NULL;
-  }
-}
-
 void CVideoEncoder::AddRtpDestination (CMediaStream *stream,
 				       bool disable_ts_offset, 
 				       uint16_t max_ttl,
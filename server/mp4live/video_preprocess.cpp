@@ -0,0 +1,399 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ *
+ * The Original Code is MPEG4IP.
+ *
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2005.  All Rights Reserved.
+ *
+ * Contributor(s):
+ *		Dave Mackie		dmackie@cisco.com
+ *		Bill May 		wmay@cisco.com
+ */
+
+#include "mp4live.h"
+#include "video_preprocess.h"
+#include "video_util_filter.h"
+#include "media_frame_pool.h"
+#ifdef HAVE_FFMPEG
+extern "C" {
+#ifdef HAVE_FFMPEG_INSTALLED
+#include <ffmpeg/avcodec.h>
+#else
+#include <avcodec.h>
+#endif
+}
+#endif
+
+VIDEO_FILTERS GetVideoFilter (CVideoProfile *vp)
+{
+  const char *videoFilter = vp->GetStringValue(CFG_VIDEO_FILTER);
+
+  if (strcasecmp(videoFilter, VIDEO_FILTER_DEINTERLACE) == 0) {
+    return VF_DEINTERLACE;
+#ifdef HAVE_FFMPEG
+  } else if (strcasecmp(videoFilter, VIDEO_FILTER_FFMPEG_DEINTERLACE_INPLACE) == 0) {
+    return VF_FFMPEG_DEINTERLACE_INPLACE;
+#endif
+  }
+  return VF_NONE;
+}
+
+CVideoPreprocessor::CVideoPreprocessor (CVideoProfile *vp,
+					CVideoPreprocessor *next)
+{
+  m_next = next;
+  m_frameRate = 0.0;
+  m_videoFilter = GetVideoFilter(vp);
+  m_videoDstWidth = vp->m_videoWidth;
+  m_videoDstHeight = vp->m_videoHeight;
+  m_videoDstAspectRatio =
+    (float)vp->m_videoWidth / (float)vp->m_videoHeight;
+  m_videoDstYSize = m_videoDstWidth * m_videoDstHeight;
+  m_videoDstUVSize = m_videoDstYSize / 4;
+  m_videoDstYUVSize = (m_videoDstYSize * 3) / 2;
+
+  m_videoSrcYImage = NULL;
+  m_videoDstYImage = NULL;
+  m_videoYResizer = NULL;
+  m_videoSrcUVImage = NULL;
+  m_videoDstUVImage = NULL;
+  m_videoUVResizer = NULL;
+  m_videoSrcWidth = 0;
+  m_videoSrcHeight = 0;
+  m_videoSrcYStride = 0;
+  // like the encoders, skip to the newest source frames if we fall
+  // behind
+  SetFrameQueue(FRAME_QUEUE_DROP_OLDEST, 4);
+}
+
+CVideoPreprocessor::~CVideoPreprocessor (void)
+{
+  StopThread();
+  DestroyVideoResizer();
+}
+
+bool CVideoPreprocessor::Matches (CVideoProfile *vp)
+{
+  return vp->m_videoWidth == m_videoDstWidth &&
+    vp->m_videoHeight == m_videoDstHeight &&
+    GetVideoFilter(vp) == m_videoFilter;
+}
+
+bool CVideoPreprocessor::AddEncoder (CVideoEncoder *ve, CVideoProfile *vp)
+{
+  return AddSinkAtRate(ve, vp->GetFloatValue(CFG_VIDEO_FRAME_RATE));
+}
+
+bool CVideoPreprocessor::AddSinkAtRate (CMediaSink *sink, float frameRate)
+{
+  if (AddSink(sink) == false) {
+    error_message("%ux%u video preprocessor: too many encoders",
+		  m_videoDstWidth, m_videoDstHeight);
+    return false;
+  }
+  if (frameRate > m_frameRate) {
+    m_frameRate = frameRate;
+  }
+  return true;
+}
+
+int CVideoPreprocessor::ThreadMain (void)
+{
+  CMsg* pMsg;
+  CMediaFrame *mf;
+  bool stop = false;
+
+  debug_message("%ux%u video preprocessor start",
+		m_videoDstWidth, m_videoDstHeight);
+  m_videoSrcFrameNumber = 0;
+  m_videoSrcSkipped = 0;
+  m_videoWantKeyFrame = false;
+  m_videoDstFrameRate = 0.0;
+
+  while (stop == false && SDL_SemWait(m_myMsgQueueSemaphore) == 0) {
+    pMsg = GetSinkMessage(&mf);
+    if (pMsg != NULL) {
+      switch (pMsg->get_value()) {
+      case MSG_NODE_STOP_THREAD:
+	stop = true;
+	break;
+      case MSG_NODE_STOP:
+	// start over with the next frame
+	DestroyVideoResizer();
+	m_videoSrcFrameNumber = 0;
+	m_videoDstFrameRate = 0.0;
+	break;
+      }
+      delete pMsg;
+    } else if (mf != NULL) {
+      if (m_stop_thread == false)
+	ProcessVideoYUVFrame(mf);
+      if (mf->RemoveReference()) {
+	delete mf;
+      }
+    }
+  }
+  while ((pMsg = m_myMsgQueue.get_message()) != NULL) {
+    delete pMsg;
+  }
+  FlushFrames();
+  DestroyVideoResizer();
+  debug_message("%ux%u video preprocessor exit - %u frames, %u skipped",
+		m_videoDstWidth, m_videoDstHeight,
+		m_videoSrcFrameNumber, m_videoSrcSkipped);
+  return 0;
+}
+
+// The same test the encoders use to drop source frames, at the
+// highest of their frame rates - an encoder at that rate drops none
+// of the frames we send it, the slower ones still get enough.
+bool CVideoPreprocessor::SkipFrame (Timestamp srcFrameTimestamp)
+{
+  float frameRate = m_frameRate;
+
+  if (frameRate <= 0.0) return false;
+  // first frame, or a faster encoder was added
+  if (m_videoDstFrameRate != frameRate) {
+    m_videoDstFrameRate = frameRate;
+    m_videoDstFrameDuration =
+      (Duration)(((float)TimestampTicks / m_videoDstFrameRate) + 0.5);
+    m_videoDstFrameNumber = 0;
+    m_videoStartTimestamp = srcFrameTimestamp;
+  }
+
+  Duration srcElapsedDuration = srcFrameTimestamp - m_videoStartTimestamp;
+  Duration dstElapsedDuration = VideoDstFramesToDuration();
+
+  // destination gets ahead of source
+  if (srcElapsedDuration + m_videoDstFrameDuration < dstElapsedDuration) {
+    return true;
+  }
+
+  // source gets ahead of destination
+  Duration lag = srcElapsedDuration - dstElapsedDuration;
+  if (lag > 3 * m_videoDstFrameDuration) {
+    m_videoDstFrameNumber +=
+      (lag - (2 * m_videoDstFrameDuration)) / m_videoDstFrameDuration;
+  }
+  m_videoDstFrameNumber++;
+  return false;
+}
+
+// Called from ProcessVideoYUVFrame when we get the first frame, or
+// one of a different size
+void CVideoPreprocessor::SetVideoSrcSize (u_int16_t srcWidth,
+					  u_int16_t srcHeight,
+					  u_int16_t srcStride,
+					  bool matchAspectRatios)
+{
+  m_videoSrcWidth = srcWidth;
+  m_videoSrcHeight = srcHeight;
+  m_videoSrcAspectRatio = (float)srcWidth / (float)srcHeight;
+  m_videoMatchAspectRatios = matchAspectRatios;
+
+  m_videoSrcYStride = srcStride;
+  m_videoSrcUVStride = srcStride / 2;
+
+  // these next three may change below
+  m_videoSrcAdjustedHeight = m_videoSrcHeight;
+  m_videoSrcYCrop = 0;
+  m_videoSrcUVCrop = 0;
+
+  // match aspect ratios
+  if (m_videoMatchAspectRatios
+      && fabs(m_videoSrcAspectRatio - m_videoDstAspectRatio) > 0.01) {
+
+    m_videoSrcAdjustedHeight =
+      (u_int16_t)(m_videoSrcWidth / m_videoDstAspectRatio);
+    if ((m_videoSrcAdjustedHeight % 16) != 0) {
+      m_videoSrcAdjustedHeight += 16 - (m_videoSrcAdjustedHeight % 16);
+    }
+
+    if (m_videoSrcAspectRatio < m_videoDstAspectRatio) {
+      // crop src
+      m_videoSrcYCrop = m_videoSrcYStride *
+	((m_videoSrcHeight - m_videoSrcAdjustedHeight) / 2);
+      m_videoSrcUVCrop = m_videoSrcYCrop / 4;
+    }
+  }
+
+  m_videoSrcYSize = m_videoSrcYStride
+    * MAX(m_videoSrcHeight, m_videoSrcAdjustedHeight);
+  m_videoSrcUVSize = m_videoSrcYSize / 4;
+
+  // resizing
+
+  DestroyVideoResizer();
+
+  if (m_videoSrcWidth != m_videoDstWidth
+      || m_videoSrcAdjustedHeight != m_videoDstHeight) {
+
+    m_videoSrcYImage =
+      scale_new_image(m_videoSrcWidth,
+		      m_videoSrcAdjustedHeight, 1);
+    m_videoSrcYImage->span = m_videoSrcYStride;
+    m_videoDstYImage =
+      scale_new_image(m_videoDstWidth,
+		      m_videoDstHeight, 1);
+    m_videoYResizer =
+      scale_image_init(m_videoDstYImage, m_videoSrcYImage,
+		       Bell_filter, Bell_support);
+
+    m_videoSrcUVImage =
+      scale_new_image(m_videoSrcWidth / 2,
+		      m_videoSrcAdjustedHeight / 2, 1);
+    m_videoSrcUVImage->span = m_videoSrcUVStride;
+    m_videoDstUVImage =
+      scale_new_image(m_videoDstWidth / 2,
+		      m_videoDstHeight / 2, 1);
+    m_videoUVResizer =
+      scale_image_init(m_videoDstUVImage, m_videoSrcUVImage,
+		       Bell_filter, Bell_support);
+  }
+}
+
+void CVideoPreprocessor::ProcessVideoYUVFrame (CMediaFrame *pFrame)
+{
+  yuv_media_frame_t *pYUV = (yuv_media_frame_t *)pFrame->GetData();
+  Timestamp srcFrameTimestamp = pFrame->GetTimestamp();
+
+  // a key frame request mustn't be lost with a skipped frame
+  if (pYUV->force_iframe) {
+    m_videoWantKeyFrame = true;
+  }
+  if (SkipFrame(srcFrameTimestamp)) {
+    m_videoSrcSkipped++;
+    return;
+  }
+
+  if (m_videoSrcFrameNumber == 0 ||
+      pYUV->w != m_videoSrcWidth ||
+      pYUV->h != m_videoSrcHeight ||
+      pYUV->y_stride != m_videoSrcYStride) {
+    SetVideoSrcSize(pYUV->w, pYUV->h, pYUV->y_stride, false);
+  }
+  m_videoSrcFrameNumber++;
+
+  bool keyFrame = m_videoWantKeyFrame;
+  m_videoWantKeyFrame = false;
+
+  // nothing to do - the encoders get the source frame, unless it
+  // has to carry the key frame request of a skipped one
+  if (m_videoYResizer == NULL && m_videoFilter == VF_NONE &&
+      keyFrame == pYUV->force_iframe) {
+    pFrame->AddReference();
+    ForwardFrame(pFrame);
+    return;
+  }
+
+  // crop to desired aspect ratio (may be a no-op)
+  const u_int8_t* yImage = pYUV->y + m_videoSrcYCrop;
+  const u_int8_t* uImage = pYUV->u + m_videoSrcUVCrop;
+  const u_int8_t* vImage = pYUV->v + m_videoSrcUVCrop;
+
+  u_int8_t* dstYUV = (u_int8_t*)frame_pool_alloc(m_videoDstYUVSize);
+  u_int8_t* dstY = dstYUV;
+  u_int8_t* dstU = dstYUV + m_videoDstYSize;
+  u_int8_t* dstV = dstYUV + m_videoDstYSize + m_videoDstUVSize;
+
+  // resize image if necessary
+  if (m_videoYResizer) {
+    m_videoSrcYImage->data = (pixel_t *)yImage;
+    m_videoDstYImage->data = dstY;
+    scale_image_process(m_videoYResizer);
+
+    m_videoSrcUVImage->data = (pixel_t *)uImage;
+    m_videoDstUVImage->data = dstU;
+    scale_image_process(m_videoUVResizer);
+
+    m_videoSrcUVImage->data = (pixel_t *)vImage;
+    m_videoDstUVImage->data = dstV;
+    scale_image_process(m_videoUVResizer);
+  } else {
+    // the source frame is shared, so the filter works on a copy
+    CopyYuv(yImage, uImage, vImage,
+	    pYUV->y_stride, pYUV->uv_stride, pYUV->uv_stride,
+	    dstY, dstU, dstV,
+	    m_videoDstWidth, m_videoDstWidth / 2, m_videoDstWidth / 2,
+	    m_videoDstWidth, m_videoDstHeight);
+  }
+
+  switch (m_videoFilter) {
+  case VF_DEINTERLACE:
+    video_filter_interlace(dstY, dstY + m_videoDstYSize, m_videoDstWidth);
+    break;
+#ifdef HAVE_FFMPEG
+  case VF_FFMPEG_DEINTERLACE_INPLACE: {
+    AVPicture src;
+    avpicture_fill(&src, dstY, PIX_FMT_YUV420P, m_videoDstWidth, m_videoDstHeight);
+    avpicture_deinterlace(&src, &src, PIX_FMT_YUV420P,
+			  m_videoDstWidth, m_videoDstHeight);
+    break;
+  }
+#else
+  case VF_FFMPEG_DEINTERLACE_INPLACE:
+#endif
+  case VF_NONE:
+  default:
+    break;
+  }
+
+  yuv_media_frame_t *yuv = FRAME_POOL_STRUCTURE(yuv_media_frame_t);
+  memset(yuv, 0, sizeof(*yuv));
+  yuv->y = dstY;
+  yuv->u = dstU;
+  yuv->v = dstV;
+  yuv->w = m_videoDstWidth;
+  yuv->h = m_videoDstHeight;
+  yuv->y_stride = m_videoDstWidth;
+  yuv->uv_stride = m_videoDstWidth / 2;
+  yuv->free_y = true;
+  yuv->force_iframe = keyFrame;
+
+  CMediaFrame *frame = new CMediaFrame(YUVVIDEOFRAME,
+				       yuv,
+				       0,
+				       srcFrameTimestamp,
+				       pFrame->GetDuration());
+  frame->SetMediaFreeFunction(frame_pool_free_yuv);
+  frame->SetKeyFrame(keyFrame);
+  ForwardFrame(frame);
+}
+
+void CVideoPreprocessor::DestroyVideoResizer (void)
+{
+  if (m_videoSrcYImage) {
+    scale_free_image(m_videoSrcYImage);
+    m_videoSrcYImage = NULL;
+  }
+  if (m_videoDstYImage) {
+    scale_free_image(m_videoDstYImage);
+    m_videoDstYImage = NULL;
+  }
+  if (m_videoYResizer) {
+    scale_image_done(m_videoYResizer);
+    m_videoYResizer = NULL;
+  }
+  if (m_videoSrcUVImage) {
+    scale_free_image(m_videoSrcUVImage);
+    m_videoSrcUVImage = NULL;
+  }
+  if (m_videoDstUVImage) {
+    scale_free_image(m_videoDstUVImage);
+    m_videoDstUVImage = NULL;
+  }
+  if (m_videoUVResizer) {
+    scale_image_done(m_videoUVResizer);
+    m_videoUVResizer = NULL;
+  }
+}
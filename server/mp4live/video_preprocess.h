@@ -0,0 +1,118 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ *
+ * The Original Code is MPEG4IP.
+ *
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2005.  All Rights Reserved.
+ *
+ * Contributor(s):
+ *		Bill May 		wmay@cisco.com
+ */
+/*
+ * video_preprocess - crops, resizes and filters the source video for
+ * the video encoders.  The encoders for profiles with the same size
+ * and filter share one, so each source frame is resized and filtered
+ * once for all of them.
+ */
+#ifndef __VIDEO_PREPROCESS_H__
+#define __VIDEO_PREPROCESS_H__
+
+#include "media_feeder.h"
+#include "video_encoder.h"
+#include "video_util_resize.h"
+
+typedef enum VIDEO_FILTERS {
+  VF_NONE,
+  VF_DEINTERLACE,
+  VF_FFMPEG_DEINTERLACE_INPLACE,
+} VIDEO_FILTERS;
+
+VIDEO_FILTERS GetVideoFilter(CVideoProfile *vp);
+
+class CVideoPreprocessor : public CMediaFeeder, public CMediaSink {
+ public:
+  CVideoPreprocessor(CVideoProfile *vp, CVideoPreprocessor *next = NULL);
+  ~CVideoPreprocessor(void);
+
+  // if the profile wants the same picture
+  bool Matches(CVideoProfile *vp);
+  // feeds the encoder, at the highest frame rate of its encoders
+  bool AddEncoder(CVideoEncoder *ve, CVideoProfile *vp);
+  CVideoPreprocessor *GetNext(void) { return m_next; };
+
+  virtual const char* name() {
+    return "CVideoPreprocessor";
+  }
+ protected:
+  bool AddSinkAtRate(CMediaSink *sink, float frameRate);
+  int ThreadMain(void);
+  // true if no encoder needs the frame
+  bool SkipFrame(Timestamp srcFrameTimestamp);
+  void ProcessVideoYUVFrame(CMediaFrame *pFrame);
+  void SetVideoSrcSize(u_int16_t srcWidth,
+		       u_int16_t srcHeight,
+		       u_int16_t srcStride,
+		       bool matchAspectRatios);
+  void DestroyVideoResizer(void);
+  inline Duration VideoDstFramesToDuration(void) {
+    double tempd;
+    tempd = m_videoDstFrameNumber;
+    tempd *= TimestampTicks;
+    tempd /= m_videoDstFrameRate;
+    return (Duration) tempd;
+  };
+
+  CVideoPreprocessor *m_next;
+  // the highest frame rate of the encoders - written by AddEncoder
+  volatile float	m_frameRate;
+
+  // video source info
+  u_int32_t		m_videoSrcFrameNumber;
+  u_int16_t		m_videoSrcWidth;
+  u_int16_t		m_videoSrcHeight;
+  u_int16_t		m_videoSrcAdjustedHeight;
+  float			m_videoSrcAspectRatio;
+  u_int32_t		m_videoSrcYSize;
+  u_int16_t		m_videoSrcYStride;
+  u_int32_t		m_videoSrcUVSize;
+  u_int16_t		m_videoSrcUVStride;
+  u_int32_t		m_videoSrcYCrop;
+  u_int32_t		m_videoSrcUVCrop;
+  uint32_t		m_videoSrcSkipped;
+  // a key frame was asked for in a skipped frame
+  bool			m_videoWantKeyFrame;
+
+  // video destination info
+  VIDEO_FILTERS		m_videoFilter;
+  float			m_videoDstFrameRate;
+  Duration		m_videoDstFrameDuration;
+  u_int32_t		m_videoDstFrameNumber;
+  Timestamp		m_videoStartTimestamp;
+  u_int16_t		m_videoDstWidth;
+  u_int16_t		m_videoDstHeight;
+  float			m_videoDstAspectRatio;
+  u_int32_t		m_videoDstYUVSize;
+  u_int32_t		m_videoDstYSize;
+  u_int32_t		m_videoDstUVSize;
+
+  // video resizing info
+  bool			m_videoMatchAspectRatios;
+  image_t*		m_videoSrcYImage;
+  image_t*		m_videoDstYImage;
+  scaler_t*		m_videoYResizer;
+  image_t*		m_videoSrcUVImage;
+  image_t*		m_videoDstUVImage;
+  scaler_t*		m_videoUVResizer;
+};
+
+#endif /* __VIDEO_PREPROCESS_H__ */
@@ -26,14 +26,16 @@
 int CSDLVideoPreview::ThreadMain(void) 
 {
   CMsg *pMsg;
+  CMediaFrame *pFrame;
 	while (SDL_SemWait(m_myMsgQueueSemaphore) == 0) {
-		pMsg = m_myMsgQueue.get_message();
+		pMsg = GetSinkMessage(&pFrame);
 		
 		if (pMsg != NULL) {
 			switch (pMsg->get_value()) {
 			case MSG_NODE_STOP_THREAD:
 				DoStopPreview();
 				delete pMsg;
+				FlushFrames();
 				return 0;
 			case MSG_NODE_START:
 				DoStartPreview();
@@ -41,19 +43,13 @@ int CSDLVideoPreview::ThreadMain(void)
 			case MSG_NODE_STOP:
 				DoStopPreview();
 				break;
-			case MSG_SINK_FRAME:
-				uint32_t dontcare;
-				CMediaFrame *pFrame = 
-				  (CMediaFrame*)pMsg->get_message(dontcare);
-				if (pFrame != NULL) {
-				  DoPreviewFrame(pFrame);
-				  if (pFrame->RemoveReference())
-				    delete pFrame;
-				}
-				break;
 			}
 
 			delete pMsg;
+		} else if (pFrame != NULL) {
+			DoPreviewFrame(pFrame);
+			if (pFrame->RemoveReference())
+				delete pFrame;
 		}
 	}
 
@@ -30,6 +30,8 @@ public:
 		m_sdlScreen = NULL;
 		m_sdlImage = NULL;
 		m_w = m_h = 0;
+		// only show the newest frames
+		SetFrameQueue(FRAME_QUEUE_DROP_OLDEST, 2);
 	}
 
 	virtual const char* name() {
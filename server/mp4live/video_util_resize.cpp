@@ -41,6 +41,16 @@
 #include "mp4live.h"
 #include "video_util_resize.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCALE_HAVE_SIMD 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SCALE_HAVE_SIMD 1
+#else
+#define SCALE_HAVE_SIMD 0
+#endif
+
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
@@ -282,6 +292,96 @@ static int calc_x_contrib(CLIST* contribX, double xscale, double fwidth, int dst
 } /* calc_x_contrib */
 
 
+static void scale_free_taps(scale_taps_t *taps)
+{
+    free(taps->pixel);
+    free(taps->weight);
+    free(taps->weight16);
+    free(taps->weight8);
+    memset(taps, 0, sizeof(*taps));
+}
+
+/*
+  scale_build_taps - put the contributions for each destination pixel
+  in one direction into taps for the row scaler.  The contributions
+  are the same ones the column programs use, so the output is too.
+
+  Returns -1 if error, 0 otherwise.
+*/
+static int scale_build_taps(scale_taps_t *taps, double scale, double fwidth,
+                            int dstsize, int srcsize,
+                            double (*filterf)(double))
+{
+    CLIST *contrib;
+    int i, j, k, n;
+    int maxn = 0;
+    bool wide = false;
+    int ret = -1;
+
+    contrib = (CLIST *)calloc(dstsize, sizeof(CLIST));
+    if(contrib == NULL)
+        return -1;
+    for(i = 0; i < dstsize; ++i)
+    {
+        if(calc_x_contrib(&contrib[i], scale, fwidth, dstsize, srcsize,
+                          filterf, i) < 0)
+            goto done;
+        if(contrib[i].n > maxn)
+            maxn = contrib[i].n;
+    }
+
+    /* the SIMD kernels do the taps in pairs */
+    taps->taps = (maxn + 1) & ~1;
+    n = dstsize * taps->taps;
+    taps->pixel = (int *)malloc(n * sizeof(int));
+    taps->weight = (fixdouble *)malloc(n * sizeof(fixdouble));
+    taps->weight16 = (int16_t *)malloc(n * sizeof(int16_t));
+    if(taps->pixel == NULL || taps->weight == NULL || taps->weight16 == NULL)
+        goto done;
+
+    for(i = 0, k = 0; i < dstsize; ++i)
+    {
+        for(j = 0; j < taps->taps; ++j, ++k)
+        {
+            if(j < contrib[i].n)
+            {
+                taps->pixel[k] = contrib[i].p[j].pixel;
+                taps->weight[k] = contrib[i].p[j].weight;
+            } else {
+                taps->pixel[k] = contrib[i].p[0].pixel;
+                taps->weight[k] = 0;
+            }
+            if(taps->weight[k] < -32768 || taps->weight[k] > 32767)
+                wide = true;
+        }
+    }
+
+    if(wide)
+    {
+        taps->weight8 = (int16_t *)malloc(n * sizeof(int16_t));
+        if(taps->weight8 == NULL)
+            goto done;
+        for(k = 0; k < n; ++k)
+        {
+            taps->weight16[k] = taps->weight[k] >> 8;
+            taps->weight8[k] = taps->weight[k] & 0xff;
+        }
+    } else {
+        for(k = 0; k < n; ++k)
+            taps->weight16[k] = taps->weight[k];
+    }
+    ret = 0;
+
+ done:
+    for(i = 0; i < dstsize; ++i)
+        free(contrib[i].p);
+    free(contrib);
+    if(ret < 0)
+        scale_free_taps(taps);
+    return ret;
+}
+
+
 scaler_t *
 scale_image_init(image_t *dst, image_t *src, double (*filterf)(double), double fwidth)
 {
@@ -443,11 +543,30 @@ scale_image_init(image_t *dst, image_t *src, double (*filterf)(double), double f
         free(contribY[i].p);
     free(contribY);
 
+    /* and the same contributions as taps for the row scaler */
+    memset(&scaler->vert, 0, sizeof(scaler->vert));
+    memset(&scaler->horz, 0, sizeof(scaler->horz));
+    scaler->rows = NULL;
+    scaler->block = NULL;
+    scaler->simd = SCALE_HAVE_SIMD;
+    if(scale_build_taps(&scaler->vert, xscale, fwidth,
+                        dst->xsize, src->xsize, filterf) < 0 ||
+       scale_build_taps(&scaler->horz, yscale, fwidth,
+                        dst->ysize, src->ysize, filterf) < 0 ||
+       (scaler->rows = (pixel_t **)malloc(scaler->vert.taps * 
+                                          sizeof(pixel_t *))) == NULL ||
+       (scaler->block = (pixel_t *)malloc(16 * (2 * src->ysize + 
+                                                dst->ysize))) == NULL)
+    {
+        scale_image_done(scaler);
+        return 0;
+    }
+
     return scaler;
 }
 
 
-void scale_image_process(scaler_t *scaler)
+void scale_image_process_columns(scaler_t *scaler)
 {
     int x;
     int i = 0, j, k;            /* loop variables */
@@ -507,11 +626,302 @@ void scale_image_process(scaler_t *scaler)
     } /* next dst column */
 }
 
+/* point scaler->rows at the source rows for destination row y */
+static void scale_rows_setup(scaler_t *scaler, int y)
+{
+    const int *pixel = scaler->vert.pixel + y * scaler->vert.taps;
+    int j;
+
+    for(j = 0; j < scaler->vert.taps; j++)
+        scaler->rows[j] = scaler->src->data + pixel[j] * scaler->src->span;
+}
+
+/*
+ * scale_rows - the vertical taps for pixels x to width of a row.  If
+ * all the source pixels are the same, that pixel is used, as in the
+ * column programs.
+ */
+static void scale_rows(pixel_t **rows, const fixdouble *weight, int taps,
+                       pixel_t *out, int x, int width)
+{
+    int j;
+    int bPelDelta;
+    fixdouble sum;
+    pixel_t pel, pel2;
+
+    for(; x < width; x++) {
+        pel = rows[0][x];
+        bPelDelta = false;
+        sum = 0;
+        for(j = 0; j < taps; j++) {
+            pel2 = rows[j][x];
+            if(pel2 != pel) {
+                bPelDelta = true;
+            }
+            sum += pel2 * weight[j];
+        }
+        out[x] = bPelDelta ? (pixel_t)CLAMP(fixdouble2int(sum)) : pel;
+    }
+}
+
+#if SCALE_HAVE_SIMD
+/*
+ * scale_taps_simd - 16 pixels that use the same taps; tap j of pixel
+ * k is base[pixel[j] * stride + k].  The pixels for 2 taps are
+ * interleaved so that pmaddwd does both at once.  With wide weights,
+ * the high and low parts are summed apart and put back together, so
+ * the result is the same as the C version.
+ */
+static inline __m128i scale_taps_simd(const pixel_t *base, const int *pixel,
+                                      int stride, const int16_t *weight16,
+                                      const int16_t *weight8, int taps)
+{
+    int j, k;
+#ifdef __AVX2__
+    const __m256i round = _mm256_set1_epi32(32768);
+    __m256i acc[2], acc8[2], p[2], w;
+    __m256i a, b, res;
+#else
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(32768);
+    __m128i acc[4], acc8[4], p[4], w;
+    __m128i alo, ahi, blo, bhi;
+#endif
+    __m128i first, same, a8, b8, out8;
+
+    first = _mm_loadu_si128((const __m128i *)(base + pixel[0] * stride));
+    same = _mm_cmpeq_epi8(first, first);
+#ifdef __AVX2__
+    acc[0] = acc[1] = acc8[0] = acc8[1] = _mm256_setzero_si256();
+#else
+    for(k = 0; k < 4; k++)
+        acc[k] = acc8[k] = zero;
+#endif
+    for(j = 0; j < taps; j += 2) {
+        a8 = _mm_loadu_si128((const __m128i *)(base + pixel[j] * stride));
+        b8 = _mm_loadu_si128((const __m128i *)(base + pixel[j + 1] * stride));
+        same = _mm_and_si128(same, _mm_and_si128(_mm_cmpeq_epi8(a8, first),
+                                                 _mm_cmpeq_epi8(b8, first)));
+#ifdef __AVX2__
+        a = _mm256_cvtepu8_epi16(a8);
+        b = _mm256_cvtepu8_epi16(b8);
+        p[0] = _mm256_unpacklo_epi16(a, b);     /* 0-3, 8-11 */
+        p[1] = _mm256_unpackhi_epi16(a, b);     /* 4-7, 12-15 */
+        w = _mm256_set1_epi32((uint16_t)weight16[j] |
+                              ((uint32_t)(uint16_t)weight16[j + 1] << 16));
+        for(k = 0; k < 2; k++)
+            acc[k] = _mm256_add_epi32(acc[k], _mm256_madd_epi16(p[k], w));
+        if(weight8 != NULL) {
+            w = _mm256_set1_epi32((uint16_t)weight8[j] |
+                                  ((uint32_t)(uint16_t)weight8[j + 1] << 16));
+            for(k = 0; k < 2; k++)
+                acc8[k] = _mm256_add_epi32(acc8[k], _mm256_madd_epi16(p[k], w));
+        }
+#else
+        alo = _mm_unpacklo_epi8(a8, zero);
+        ahi = _mm_unpackhi_epi8(a8, zero);
+        blo = _mm_unpacklo_epi8(b8, zero);
+        bhi = _mm_unpackhi_epi8(b8, zero);
+        p[0] = _mm_unpacklo_epi16(alo, blo);
+        p[1] = _mm_unpackhi_epi16(alo, blo);
+        p[2] = _mm_unpacklo_epi16(ahi, bhi);
+        p[3] = _mm_unpackhi_epi16(ahi, bhi);
+        w = _mm_set1_epi32((uint16_t)weight16[j] |
+                           ((uint32_t)(uint16_t)weight16[j + 1] << 16));
+        for(k = 0; k < 4; k++)
+            acc[k] = _mm_add_epi32(acc[k], _mm_madd_epi16(p[k], w));
+        if(weight8 != NULL) {
+            w = _mm_set1_epi32((uint16_t)weight8[j] |
+                               ((uint32_t)(uint16_t)weight8[j + 1] << 16));
+            for(k = 0; k < 4; k++)
+                acc8[k] = _mm_add_epi32(acc8[k], _mm_madd_epi16(p[k], w));
+        }
+#endif
+    }
+#ifdef __AVX2__
+    for(k = 0; k < 2; k++) {
+        if(weight8 != NULL)
+            acc[k] = _mm256_add_epi32(_mm256_slli_epi32(acc[k], 8), acc8[k]);
+        acc[k] = _mm256_srai_epi32(_mm256_add_epi32(acc[k], round), 16);
+    }
+    /* the packs undo the lane order of the unpacks */
+    res = _mm256_packs_epi32(acc[0], acc[1]);
+    res = _mm256_packus_epi16(res, res);
+    res = _mm256_permute4x64_epi64(res, 0x08);
+    out8 = _mm256_castsi256_si128(res);
+#else
+    for(k = 0; k < 4; k++) {
+        if(weight8 != NULL)
+            acc[k] = _mm_add_epi32(_mm_slli_epi32(acc[k], 8), acc8[k]);
+        acc[k] = _mm_srai_epi32(_mm_add_epi32(acc[k], round), 16);
+    }
+    out8 = _mm_packus_epi16(_mm_packs_epi32(acc[0], acc[1]),
+                            _mm_packs_epi32(acc[2], acc[3]));
+#endif
+    /* where all the source pixels were the same, use that pixel */
+    return _mm_or_si128(_mm_and_si128(same, first),
+                        _mm_andnot_si128(same, out8));
+}
+
+/*
+ * scale_rows_simd - the vertical taps for a row, 16 pixels at a time.
+ * Returns how many pixels were done.
+ */
+static int scale_rows_simd(const scaler_t *scaler, int y, pixel_t *out)
+{
+    const scale_taps_t *vert = &scaler->vert;
+    int offset = y * vert->taps;
+    int x;
+
+    for(x = 0; x + 16 <= scaler->src->ysize; x += 16) {
+        _mm_storeu_si128((__m128i *)(out + x),
+                         scale_taps_simd(scaler->src->data + x,
+                                         vert->pixel + offset,
+                                         scaler->src->span,
+                                         vert->weight16 + offset,
+                                         vert->weight8 ? 
+                                         vert->weight8 + offset : NULL,
+                                         vert->taps));
+    }
+    return x;
+}
+
+/* 16 rows of 16 pixels to 16 columns, by interleaving 4 times */
+static inline void scale_transpose_16x16(const pixel_t *in, int in_stride,
+                                         pixel_t *out, int out_stride)
+{
+    __m128i a[16], b[16];
+    int i, k;
+
+    for(k = 0; k < 16; k++)
+        a[k] = _mm_loadu_si128((const __m128i *)(in + k * in_stride));
+    for(i = 0; i < 4; i++) {
+        for(k = 0; k < 8; k++) {
+            b[2 * k] = _mm_unpacklo_epi8(a[k], a[k + 8]);
+            b[2 * k + 1] = _mm_unpackhi_epi8(a[k], a[k + 8]);
+        }
+        for(k = 0; k < 16; k++)
+            a[k] = b[k];
+    }
+    for(k = 0; k < 16; k++)
+        _mm_storeu_si128((__m128i *)(out + k * out_stride), a[k]);
+}
+
+/*
+ * scale_block - 16 destination rows at once.  The rows are scaled
+ * vertically, then turned into columns of 16 pixels, so that each
+ * horizontal tap is one load for all 16 rows and the same SIMD taps
+ * can be used along the rows; then the result is turned back.
+ */
+static void scale_block(scaler_t *scaler, int y, pixel_t *out)
+{
+    const scale_taps_t *horz = &scaler->horz;
+    int srcw = scaler->src->ysize;
+    int dstw = scaler->dst->ysize;
+    pixel_t *rows = scaler->block;
+    pixel_t *columns = rows + 16 * srcw;
+    pixel_t *result = columns + 16 * srcw;
+    int i, r, x, offset;
+
+    for(r = 0; r < 16; r++) {
+        x = scale_rows_simd(scaler, y + r, rows + r * srcw);
+        if(x < srcw) {
+            scale_rows_setup(scaler, y + r);
+            scale_rows(scaler->rows, scaler->vert.weight + 
+                       (y + r) * scaler->vert.taps,
+                       scaler->vert.taps, rows + r * srcw, x, srcw);
+        }
+    }
+
+    for(x = 0; x + 16 <= srcw; x += 16)
+        scale_transpose_16x16(rows + x, srcw, columns + x * 16, 16);
+    for(; x < srcw; x++)
+        for(r = 0; r < 16; r++)
+            columns[x * 16 + r] = rows[r * srcw + x];
+
+    for(i = 0, offset = 0; i < dstw; i++, offset += horz->taps) {
+        _mm_storeu_si128((__m128i *)(result + i * 16),
+                         scale_taps_simd(columns, horz->pixel + offset, 16,
+                                         horz->weight16 + offset,
+                                         horz->weight8 ? 
+                                         horz->weight8 + offset : NULL,
+                                         horz->taps));
+    }
+
+    for(i = 0; i + 16 <= dstw; i += 16)
+        scale_transpose_16x16(result + i * 16, 16, out + i, dstw);
+    for(; i < dstw; i++)
+        for(r = 0; r < 16; r++)
+            out[r * dstw + i] = result[i * 16 + r];
+}
+#endif
+
+/*
+ * scale_line - the horizontal taps for a row.
+ */
+static void scale_line(const pixel_t *in, const scale_taps_t *taps,
+                       pixel_t *out, int width)
+{
+    const int *pixel = taps->pixel;
+    const fixdouble *weight = taps->weight;
+    int i, j;
+    int bPelDelta;
+    fixdouble sum;
+    pixel_t pel, pel2;
+
+    for(i = 0; i < width; i++) {
+        pel = in[pixel[0]];
+        bPelDelta = false;
+        sum = 0;
+        for(j = 0; j < taps->taps; j++) {
+            pel2 = in[pixel[j]];
+            if(pel2 != pel) {
+                bPelDelta = true;
+            }
+            sum += pel2 * weight[j];
+        }
+        out[i] = bPelDelta ? (pixel_t)CLAMP(fixdouble2int(sum)) : pel;
+        pixel += taps->taps;
+        weight += taps->taps;
+    }
+}
+
+void scale_image_process(scaler_t *scaler)
+{
+    pixel_t *out = scaler->dst->data;
+    int y = 0, x;
+
+#if SCALE_HAVE_SIMD
+    if(scaler->simd) {
+        for(; y + 16 <= scaler->dst->xsize; y += 16) {
+            scale_block(scaler, y, out);
+            out += 16 * scaler->dst->ysize;
+        }
+    }
+#endif
+    for(; y < scaler->dst->xsize; y++) {
+        x = 0;
+#if SCALE_HAVE_SIMD
+        if(scaler->simd)
+            x = scale_rows_simd(scaler, y, scaler->tmp);
+#endif
+        scale_rows_setup(scaler, y);
+        scale_rows(scaler->rows, scaler->vert.weight + y * scaler->vert.taps,
+                   scaler->vert.taps, scaler->tmp, x, scaler->src->ysize);
+        scale_line(scaler->tmp, &scaler->horz, out, scaler->dst->ysize);
+        out += scaler->dst->ysize;
+    }
+}
+
 void scale_image_done(scaler_t *scaler)
 {
     free(scaler->tmp);
     free(scaler->programY);
     free(scaler->programX);
+    scale_free_taps(&scaler->vert);
+    scale_free_taps(&scaler->horz);
+    free(scaler->rows);
+    free(scaler->block);
     free(scaler);
 }
 
@@ -39,6 +39,21 @@ typedef union
    int           count;
 } instruction_t;
 
+/* Filter taps for one direction of the row scaler.  Every destination
+   pixel has the same (even) number of taps; the padding taps repeat
+   the first source pixel with a weight of 0.  The weights are also
+   kept as 16 bit taps for the SIMD kernels: weight16 holds the whole
+   weight if every weight fits, otherwise weight16 holds the weight
+   >> 8 and weight8 the low 8 bits.  */
+typedef struct
+{
+    int           taps;
+    int          *pixel;      /* [size * taps] source pixel of each tap */
+    fixdouble    *weight;     /* [size * taps] */
+    int16_t      *weight16;   /* [size * taps] */
+    int16_t      *weight8;    /* [size * taps], NULL if not needed */
+} scale_taps_t;
+
 /* This structure holds the state of scaling function just after
    initialization and before image processing. The advantage of
    this approach is that you can do as much of (CPU intensive)
@@ -49,6 +64,10 @@ typedef struct
     image_t       *src, *dst;
     pixel_t       *tmp;
     instruction_t *programY, *programX;
+    scale_taps_t   vert, horz;  /* taps down the rows and along a row */
+    pixel_t      **rows;        /* source rows for the vertical taps */
+    pixel_t       *block;       /* 16 rows at a time, for the SIMD kernels */
+    int            simd;        /* use the SSE2/AVX2 kernels, if built */
 }  scaler_t;
 
 extern image_t *scale_new_image(int xsize, int ysize, int depth);
@@ -58,9 +77,15 @@ extern image_t *scale_new_image(int xsize, int ysize, int depth);
 extern scaler_t *scale_image_init(image_t *dst, image_t *src,
                                  double (*filterf)(double), double fwidth);
 
-/* Processes frame.  */
+/* Processes frame.  Each destination row is filtered from the source
+   rows into a temporary row, which is then filtered along the row. */
 extern void scale_image_process(scaler_t *scaler);
 
+/* Processes frame with the original column by column programs.  The
+   output is the same as scale_image_process(); it is kept to test
+   that it stays that way. */
+extern void scale_image_process_columns(scaler_t *scaler);
+
 /* Shuts down scaler, deallocates memory. */
 extern void scale_image_done(scaler_t *scaler);
 
@@ -90,7 +115,7 @@ extern double Lanczos3_filter(double t);
 
 void CopyYuv(const uint8_t *fY, const uint8_t *fU, const uint8_t *fV,
 	     uint32_t fyStride, uint32_t fuStride, uint32_t fvStride,
-	     uint8_t *tY, uint8_t *tU, uint8_t *fV,
-	     uint32_t tyStride, uint32_t tvStride, uint32_t tvStride,
+	     uint8_t *tY, uint8_t *tU, uint8_t *tV,
+	     uint32_t tyStride, uint32_t tuStride, uint32_t tvStride,
 	     uint32_t w, uint32_t h);
 #endif
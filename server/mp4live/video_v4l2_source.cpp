@@ -28,6 +28,7 @@
 #include "video_util_rgb.h"
 #include "video_util_filter.h"
 #include "video_util_convert.h"
+#include "media_frame_pool.h"
 
 const char *get_linux_video_type (void)
 {
@@ -713,7 +714,7 @@ void c_ReleaseFrame (void *f)
 {
   yuv_media_frame_t *yuv = (yuv_media_frame_t *)f;
   if (yuv->free_y) {
-    CHECK_AND_FREE(yuv->y);
+    frame_pool_free((void *)yuv->y);
   } else {
     CV4LVideoSource *s = (CV4LVideoSource *)yuv->hardware;
     if (s->IsHardwareVersion(yuv->hardware_version)) {
@@ -725,7 +726,7 @@ void c_ReleaseFrame (void *f)
       s->ReleaseOldFrame(yuv->hardware_version, yuv->hardware_index);
     }
   }
-  free(yuv);
+  frame_pool_free(yuv);
 }
 
 void CV4LVideoSource::ReleaseOldFrame (uint hardware_version, 
@@ -853,7 +854,7 @@ void CV4LVideoSource::ProcessVideo(void)
     switch (m_format) {
     case V4L2_PIX_FMT_RGB24:
     case V4L2_PIX_FMT_BGR24:
-      mallocedYuvImage = (u_int8_t*)Malloc(m_videoSrcYUVSize);
+      mallocedYuvImage = (u_int8_t*)frame_pool_alloc(m_videoSrcYUVSize);
       debug_message("converting to YUV420P from RGB");
       pY = mallocedYuvImage;
       pV = pY + m_videoSrcYSize;
@@ -870,7 +871,7 @@ void CV4LVideoSource::ProcessVideo(void)
 		m_format == V4L2_PIX_FMT_RGB24);
       break;
     case V4L2_PIX_FMT_YUYV: 
-      mallocedYuvImage = (u_int8_t*)Malloc(m_videoSrcYUVSize);
+      mallocedYuvImage = (u_int8_t*)frame_pool_alloc(m_videoSrcYUVSize);
       //debug_message("converting to YUV420P from YUYV");
       pY = mallocedYuvImage;
       pU = pY + m_videoSrcYSize;
@@ -881,7 +882,7 @@ void CV4LVideoSource::ProcessVideo(void)
 			      m_videoSrcHeight);
       break;
     case V4L2_PIX_FMT_UYVY:
-      mallocedYuvImage = (u_int8_t*)Malloc(m_videoSrcYUVSize);
+      mallocedYuvImage = (u_int8_t*)frame_pool_alloc(m_videoSrcYUVSize);
       //debug_message("converting to YUV420P from YUYV");
       pY = mallocedYuvImage;
       pU = pY + m_videoSrcYSize;
@@ -892,7 +893,7 @@ void CV4LVideoSource::ProcessVideo(void)
 			      m_videoSrcHeight);
       break;
     case V4L2_PIX_FMT_YYUV:
-      mallocedYuvImage = (u_int8_t*)Malloc(m_videoSrcYUVSize);
+      mallocedYuvImage = (u_int8_t*)frame_pool_alloc(m_videoSrcYUVSize);
       //debug_message("converting to YUV420P from YUYV");
       pY = mallocedYuvImage;
       pU = pY + m_videoSrcYSize;
@@ -903,7 +904,7 @@ void CV4LVideoSource::ProcessVideo(void)
 			      m_videoSrcHeight);
       break;
     case V4L2_PIX_FMT_NV12:
-      mallocedYuvImage = (u_int8_t*)Malloc(m_videoSrcYUVSize);
+      mallocedYuvImage = (u_int8_t*)frame_pool_alloc(m_videoSrcYUVSize);
       //debug_message("converting to YUV420P from YUYV");
       pY = mallocedYuvImage;
       pU = pY + m_videoSrcYSize;
@@ -918,7 +919,7 @@ void CV4LVideoSource::ProcessVideo(void)
 #if 0
       // we would need the below if we were going to switch 
       // video - this is a problem with the 
-      mallocedYuvImage = (u_int8_t*)Malloc(m_videoSrcYUVSize);
+      mallocedYuvImage = (u_int8_t*)frame_pool_alloc(m_videoSrcYUVSize);
       pY = (u_int8_t*)mallocedYuvImage;
       memcpy(pY, m_buffers[index].start, m_videoSrcYUVSize);
 #else
@@ -934,7 +935,7 @@ void CV4LVideoSource::ProcessVideo(void)
 			    m_videoSrcHeight);
     }
 
-    yuv_media_frame_t *yuv = MALLOC_STRUCTURE(yuv_media_frame_t);
+    yuv_media_frame_t *yuv = FRAME_POOL_STRUCTURE(yuv_media_frame_t);
     yuv->y = pY;
     yuv->u = pU;
     yuv->v = pV;
@@ -958,6 +959,8 @@ void CV4LVideoSource::ProcessVideo(void)
 					 0,
 					 frameTimestamp);
     frame->SetMediaFreeFunction(c_ReleaseFrame);
+    // an encoder that is behind mustn't skip the key frame request
+    frame->SetKeyFrame(yuv->force_iframe);
     ForwardFrame(frame);
     //debug_message("video source forward");
     // enqueue the frame to video capture buffer
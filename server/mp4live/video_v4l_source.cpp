@@ -27,6 +27,7 @@
 #include "video_v4l_source.h"
 #include "video_util_rgb.h"
 #include "video_util_filter.h"
+#include "media_frame_pool.h"
 
 const char *get_linux_video_type (void)
 {
@@ -454,12 +455,12 @@ void c_ReleaseFrame (void *f)
 {
   yuv_media_frame_t *yuv = (yuv_media_frame_t *)f;
   if (yuv->free_y) {
-    CHECK_AND_FREE(yuv->y);
+    frame_pool_free((void *)yuv->y);
   } else {
     CV4LVideoSource *s = (CV4LVideoSource *)yuv->hardware;
     s->IndicateReleaseFrame(yuv->hardware_index);
   }
-  free(yuv);
+  frame_pool_free(yuv);
 }
 
 void CV4LVideoSource::ReleaseFrames (void)
@@ -533,7 +534,7 @@ void CV4LVideoSource::ProcessVideo(void)
 	  
 	  // perform colorspace conversion if necessary
 	  if (m_videoNeedRgbToYuv) {
-	    mallocedYuvImage = (u_int8_t*)Malloc(m_videoSrcYUVSize);
+	    mallocedYuvImage = (u_int8_t*)frame_pool_alloc(m_videoSrcYUVSize);
 	    
 	    pY = mallocedYuvImage;
 	    pU = pY + m_videoSrcYSize;
@@ -558,7 +559,7 @@ void CV4LVideoSource::ProcessVideo(void)
 				  m_videoSrcWidth,
 				  m_videoSrcHeight);
 	  }
-	  yuv_media_frame_t *yuv = MALLOC_STRUCTURE(yuv_media_frame_t);
+	  yuv_media_frame_t *yuv = FRAME_POOL_STRUCTURE(yuv_media_frame_t);
 	  yuv->y = pY;
 	  yuv->u = pU;
 	  yuv->v = pV;
@@ -581,6 +582,8 @@ void CV4LVideoSource::ProcessVideo(void)
 					       0,
 					       frameTimestamp);
 	  frame->SetMediaFreeFunction(c_ReleaseFrame);
+	  // an encoder that is behind mustn't skip the key frame request
+	  frame->SetKeyFrame(yuv->force_iframe);
 	  ForwardFrame(frame);
     //debug_message("video source forward");
     // enqueue the frame to video capture buffer
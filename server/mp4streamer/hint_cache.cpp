@@ -0,0 +1,280 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ *
+ * The Original Code is MPEG4IP.
+ *
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2005.  All Rights Reserved.
+ *
+ * Contributor(s):
+ *		Bill May		wmay@cisco.com
+ */
+/*
+ * hint_cache.cpp - hinted mp4 file shared between streaming sessions
+ *
+ * An MP4FileHandle can only be used by one thread at a time, so all
+ * reads of the file happen with m_mutex held.  Each hint is read and
+ * assembled into packets once, and the result is shared by all the
+ * sessions that get to it while it is in the cache.
+ */
+#include "hint_cache.h"
+
+#define HINT_PACKET_IOV_MAX 64
+
+CHintSample::CHintSample (uint32_t track_index, MP4SampleId hint_id)
+{
+  m_track_index = track_index;
+  m_hint_id = hint_id;
+  m_send_time = 0;
+  m_packet_count = 0;
+  m_packets = NULL;
+  m_data = NULL;
+  m_data_len = 0;
+  m_reference = 0;
+  m_lru_prev = m_lru_next = NULL;
+}
+
+CHintSample::~CHintSample (void)
+{
+  CHECK_AND_FREE(m_packets);
+  CHECK_AND_FREE(m_data);
+}
+
+CHintFile::CHintFile (const char *file_name, uint32_t cache_bytes)
+{
+  m_file_name = strdup(file_name);
+  m_mp4File = MP4_INVALID_FILE_HANDLE;
+  m_mutex = SDL_CreateMutex();
+  m_track_count = 0;
+  m_tracks = NULL;
+  m_lru_head = m_lru_tail = NULL;
+  m_cache_bytes = 0;
+  m_cache_max_bytes = cache_bytes;
+  m_cache_hits = m_cache_misses = 0;
+  m_packet_buffer_size = 0x10000;
+  m_packet_buffer = (uint8_t *)malloc(m_packet_buffer_size);
+  m_next = NULL;
+  m_reference = 0;
+}
+
+CHintFile::~CHintFile (void)
+{
+  for (uint32_t ix = 0; ix < m_track_count; ix++) {
+    for (uint32_t jx = 0; jx < m_tracks[ix].hint_count; jx++) {
+      if (m_tracks[ix].hints[jx] != NULL) {
+	delete m_tracks[ix].hints[jx];
+      }
+    }
+    free(m_tracks[ix].hints);
+  }
+  CHECK_AND_FREE(m_tracks);
+  if (m_mp4File != MP4_INVALID_FILE_HANDLE) {
+    MP4Close(m_mp4File);
+  }
+  SDL_DestroyMutex(m_mutex);
+  CHECK_AND_FREE(m_packet_buffer);
+  CHECK_AND_FREE(m_file_name);
+}
+
+bool CHintFile::Open (void)
+{
+  // mapped, so the packet data is copied straight from the mapping
+  m_mp4File = MP4ReadMapped(m_file_name);
+  if (m_mp4File == MP4_INVALID_FILE_HANDLE) {
+    return false;
+  }
+
+  uint32_t hint_tracks = MP4GetNumberOfTracks(m_mp4File, MP4_HINT_TRACK_TYPE);
+  if (hint_tracks == 0) {
+    return false;
+  }
+
+  m_tracks = (hint_track_t *)malloc(hint_tracks * sizeof(hint_track_t));
+  for (uint32_t ix = 0; ix < hint_tracks; ix++) {
+    MP4TrackId trackId = MP4FindTrackId(m_mp4File, ix, MP4_HINT_TRACK_TYPE);
+    if (trackId == MP4_INVALID_TRACK_ID) {
+      continue;
+    }
+    hint_track_t *track = &m_tracks[m_track_count];
+    track->track_id = trackId;
+    track->media_track_id = MP4GetHintTrackReferenceTrackId(m_mp4File,
+							   trackId);
+    track->hint_count = MP4GetTrackNumberOfSamples(m_mp4File, trackId);
+    track->time_scale = MP4GetTrackTimeScale(m_mp4File, trackId);
+    track->duration = MP4GetTrackDuration(m_mp4File, trackId);
+    track->hints =
+      (CHintSample **)calloc(MAX(track->hint_count, 1), sizeof(CHintSample *));
+    m_track_count++;
+  }
+  return m_track_count > 0;
+}
+
+CHintSample *CHintFile::GetHint (uint32_t track_index, MP4SampleId hint_id)
+{
+  if (track_index >= m_track_count ||
+      hint_id == MP4_INVALID_SAMPLE_ID ||
+      hint_id > m_tracks[track_index].hint_count) {
+    return NULL;
+  }
+
+  SDL_LockMutex(m_mutex);
+  CHintSample *hint = m_tracks[track_index].hints[hint_id - 1];
+  if (hint != NULL) {
+    m_cache_hits++;
+    if (hint->m_reference == 0) {
+      LruRemove(hint);
+    }
+  } else {
+    m_cache_misses++;
+    hint = ReadHint(track_index, hint_id);
+    if (hint != NULL) {
+      m_tracks[track_index].hints[hint_id - 1] = hint;
+      m_cache_bytes += hint->m_data_len +
+	(hint->m_packet_count * sizeof(hint_packet_t));
+    }
+  }
+  if (hint != NULL) {
+    hint->m_reference++;
+  }
+  SDL_UnlockMutex(m_mutex);
+  return hint;
+}
+
+void CHintFile::ReleaseHint (CHintSample *hint)
+{
+  SDL_LockMutex(m_mutex);
+  hint->m_reference--;
+  if (hint->m_reference == 0) {
+    LruAddHead(hint);
+    TrimCache();
+  }
+  SDL_UnlockMutex(m_mutex);
+}
+
+/*
+ * ReadHint - read a hint and assemble its packets.  The packets
+ * are gathered with MP4ReadRtpPacketIov, so the payload is copied
+ * once, from the file mapping into the cached sample
+ */
+CHintSample *CHintFile::ReadHint (uint32_t track_index, MP4SampleId hint_id)
+{
+  hint_track_t *track = &m_tracks[track_index];
+  uint16_t packet_count;
+
+  if (MP4ReadRtpHint(m_mp4File, track->track_id, hint_id,
+		     &packet_count) == false) {
+    return NULL;
+  }
+
+  CHintSample *hint = new CHintSample(track_index, hint_id);
+  hint->m_send_time =
+    MP4ConvertFromTrackTimestamp(m_mp4File, track->track_id,
+				 MP4GetSampleTime(m_mp4File, track->track_id,
+						  hint_id),
+				 MP4_USECS_TIME_SCALE);
+  hint->m_packets =
+    (hint_packet_t *)malloc(MAX(packet_count, 1) * sizeof(hint_packet_t));
+
+  uint32_t data_max = 0;
+  for (uint16_t ix = 0; ix < packet_count; ix++) {
+    struct iovec iov[HINT_PACKET_IOV_MAX];
+    uint32_t iov_count = HINT_PACKET_IOV_MAX;
+
+    if (MP4ReadRtpPacketIov(m_mp4File, track->track_id, ix,
+			    m_packet_buffer, m_packet_buffer_size,
+			    iov, &iov_count, 0) == false) {
+      continue;
+    }
+
+    // the header is always the start of the first entry
+    const uint8_t *header = (const uint8_t *)iov[0].iov_base;
+    hint_packet_t *pak = &hint->m_packets[hint->m_packet_count];
+    pak->mbit = (header[1] & 0x80) != 0;
+    pak->payload_type = header[1] & 0x7f;
+    pak->rtp_ts = ntohl(*(uint32_t *)&header[4]);
+    pak->payload_len = 0;
+    for (uint32_t jx = 0; jx < iov_count; jx++) {
+      pak->payload_len += iov[jx].iov_len;
+    }
+    pak->payload_len -= 12;
+
+    if (hint->m_data_len + pak->payload_len > data_max) {
+      data_max = MAX(data_max * 2, hint->m_data_len + pak->payload_len);
+      hint->m_data = (uint8_t *)realloc(hint->m_data, data_max);
+    }
+    iov[0].iov_base = (uint8_t *)iov[0].iov_base + 12;
+    iov[0].iov_len -= 12;
+    for (uint32_t jx = 0; jx < iov_count; jx++) {
+      memcpy(hint->m_data + hint->m_data_len, iov[jx].iov_base,
+	     iov[jx].iov_len);
+      hint->m_data_len += iov[jx].iov_len;
+    }
+    hint->m_packet_count++;
+  }
+
+  // the payloads are back to back, now that m_data won't move
+  uint32_t offset = 0;
+  for (uint16_t ix = 0; ix < hint->m_packet_count; ix++) {
+    hint->m_packets[ix].payload = hint->m_data + offset;
+    offset += hint->m_packets[ix].payload_len;
+  }
+  return hint;
+}
+
+void CHintFile::LruRemove (CHintSample *hint)
+{
+  if (hint->m_lru_prev != NULL) {
+    hint->m_lru_prev->m_lru_next = hint->m_lru_next;
+  } else {
+    m_lru_head = hint->m_lru_next;
+  }
+  if (hint->m_lru_next != NULL) {
+    hint->m_lru_next->m_lru_prev = hint->m_lru_prev;
+  } else {
+    m_lru_tail = hint->m_lru_prev;
+  }
+  hint->m_lru_prev = hint->m_lru_next = NULL;
+}
+
+void CHintFile::LruAddHead (CHintSample *hint)
+{
+  hint->m_lru_prev = NULL;
+  hint->m_lru_next = m_lru_head;
+  if (m_lru_head != NULL) {
+    m_lru_head->m_lru_prev = hint;
+  } else {
+    m_lru_tail = hint;
+  }
+  m_lru_head = hint;
+}
+
+/*
+ * TrimCache - drop the least recently used samples until the cache
+ * fits in its budget.  Samples that a session holds aren't in the
+ * list, so the cache can go over budget while they are in use
+ */
+void CHintFile::TrimCache (void)
+{
+  while (m_cache_bytes > m_cache_max_bytes && m_lru_tail != NULL) {
+    CHintSample *hint = m_lru_tail;
+    LruRemove(hint);
+    FreeHint(hint);
+  }
+}
+
+void CHintFile::FreeHint (CHintSample *hint)
+{
+  m_tracks[hint->m_track_index].hints[hint->m_hint_id - 1] = NULL;
+  m_cache_bytes -= hint->m_data_len +
+    (hint->m_packet_count * sizeof(hint_packet_t));
+  delete hint;
+}
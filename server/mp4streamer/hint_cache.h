@@ -0,0 +1,130 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ *
+ * The Original Code is MPEG4IP.
+ *
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2005.  All Rights Reserved.
+ *
+ * Contributor(s):
+ *		Bill May		wmay@cisco.com
+ */
+/*
+ * hint_cache.h - a hinted mp4 file shared by all the sessions that
+ * stream it, with the assembled packets of recently used hints cached
+ */
+#ifndef __HINT_CACHE_H__
+#define __HINT_CACHE_H__
+
+#include "mpeg4ip.h"
+#include "mpeg4ip_sdl_includes.h"
+#include "mp4.h"
+
+// one packet of a hint, the payload is what follows the 12 byte rtp header
+typedef struct hint_packet_t {
+  uint8_t *payload;
+  uint32_t payload_len;
+  uint32_t rtp_ts;		// from the hint, before the session's offset
+  uint8_t payload_type;
+  bool mbit;
+} hint_packet_t;
+
+class CHintSample {
+ public:
+  CHintSample(uint32_t track_index, MP4SampleId hint_id);
+  ~CHintSample(void);
+
+  uint32_t m_track_index;
+  MP4SampleId m_hint_id;
+  uint64_t m_send_time;		// usec from the start of the track
+  uint16_t m_packet_count;
+  hint_packet_t *m_packets;
+  uint8_t *m_data;
+  uint32_t m_data_len;
+
+  // the rest is managed by CHintFile, under its mutex
+  uint32_t m_reference;
+  CHintSample *m_lru_prev, *m_lru_next;
+};
+
+typedef struct hint_track_t {
+  MP4TrackId track_id;
+  MP4TrackId media_track_id;
+  uint32_t hint_count;
+  uint32_t time_scale;
+  MP4Duration duration;		// in time_scale units
+  CHintSample **hints;		// by hint id - 1, NULL when not cached
+} hint_track_t;
+
+class CHintFile {
+ public:
+  CHintFile(const char *file_name, uint32_t cache_bytes);
+  ~CHintFile(void);
+
+  // false if the file couldn't be read or has no hint tracks
+  bool Open(void);
+
+  const char *get_file_name (void) { return m_file_name; };
+  uint32_t get_track_count (void) { return m_track_count; };
+  uint32_t get_hint_count (uint32_t track_index) {
+    return m_tracks[track_index].hint_count;
+  };
+  MP4TrackId get_hint_track_id (uint32_t track_index) {
+    return m_tracks[track_index].track_id;
+  };
+  uint32_t get_time_scale (uint32_t track_index) {
+    return m_tracks[track_index].time_scale;
+  };
+  MP4Duration get_duration (uint32_t track_index) {
+    return m_tracks[track_index].duration;
+  };
+  // the packets of a hint, assembled on first use.  The sample stays
+  // valid until it is handed back with ReleaseHint
+  CHintSample *GetHint(uint32_t track_index, MP4SampleId hint_id);
+  void ReleaseHint(CHintSample *hint);
+
+  // sessions using the file, see CStreamServer
+  CHintFile *get_next (void) { return m_next; };
+  void set_next (CHintFile *next) { m_next = next; };
+  void add_reference (void) { m_reference++; };
+  bool remove_reference (void) { return --m_reference == 0; };
+
+  uint64_t get_cache_hits (void) { return m_cache_hits; };
+  uint64_t get_cache_misses (void) { return m_cache_misses; };
+
+ protected:
+  CHintSample *ReadHint(uint32_t track_index, MP4SampleId hint_id);
+  void LruRemove(CHintSample *hint);
+  void LruAddHead(CHintSample *hint);
+  void TrimCache(void);
+  void FreeHint(CHintSample *hint);
+
+  char *m_file_name;
+  MP4FileHandle m_mp4File;
+  SDL_mutex *m_mutex;
+  uint32_t m_track_count;
+  hint_track_t *m_tracks;
+
+  // unreferenced samples, most recently used first
+  CHintSample *m_lru_head, *m_lru_tail;
+  uint32_t m_cache_bytes, m_cache_max_bytes;
+  uint64_t m_cache_hits, m_cache_misses;
+
+  // packet assembly, only used with m_mutex held
+  uint8_t *m_packet_buffer;
+  uint32_t m_packet_buffer_size;
+
+  CHintFile *m_next;
+  uint32_t m_reference;
+};
+
+#endif
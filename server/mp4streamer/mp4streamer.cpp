@@ -0,0 +1,280 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ *
+ * The Original Code is MPEG4IP.
+ *
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2005.  All Rights Reserved.
+ *
+ * Contributor(s):
+ *		Bill May		wmay@cisco.com
+ */
+/*
+ * mp4streamer - streams hinted mp4 files to many destinations at once
+ *
+ * With --receive, the destinations are sockets on the loopback that
+ * this program opens itself, and it reports what arrived, which makes
+ * it possible to try a few hundred sessions on one machine.
+ */
+#include "stream_server.h"
+#include <mpeg4ip_getopt.h>
+#include <sys/resource.h>
+#include <sys/poll.h>
+
+char *progName;
+
+static const char *usage =
+  " [--sessions <n>] [--workers <n>] [--address <addr>] [--port <port>]\n"
+  "\t[--loop] [--time <secs>] [--cache <kbytes>] [--receive] <file> ...\n";
+
+// the receiving side of --receive
+typedef struct receiver_t {
+  uint32_t socket_count;
+  struct pollfd *fds;
+  volatile bool stop;
+  uint64_t rtp_packets;
+  uint64_t rtp_bytes;
+  uint64_t rtcp_packets;
+  uint64_t rtcp_sender_reports;
+} receiver_t;
+
+static int receiver_open (in_port_t port)
+{
+  struct sockaddr_in sin;
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_port = htons(port);
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
+    close(fd);
+    return -1;
+  }
+  int bufsize = 256 * 1024;
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+  return fd;
+}
+
+static int receiver_thread (void *data)
+{
+  receiver_t *receiver = (receiver_t *)data;
+  uint8_t buffer[2048];
+
+  while (receiver->stop == false) {
+    int ret = poll(receiver->fds, receiver->socket_count, 100);
+    if (ret <= 0) {
+      continue;
+    }
+    for (uint32_t ix = 0; ix < receiver->socket_count; ix++) {
+      if ((receiver->fds[ix].revents & POLLIN) == 0) {
+	continue;
+      }
+      ssize_t len = recv(receiver->fds[ix].fd, buffer, sizeof(buffer), 0);
+      if (len < 2) {
+	continue;
+      }
+      // even sockets get rtp, odd ones rtcp
+      if ((ix & 1) == 0) {
+	receiver->rtp_packets++;
+	receiver->rtp_bytes += len;
+      } else {
+	receiver->rtcp_packets++;
+	if (buffer[1] == 200) {
+	  receiver->rtcp_sender_reports++;
+	}
+      }
+    }
+  }
+  return 0;
+}
+
+static void raise_file_limit (void)
+{
+  struct rlimit rl;
+
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+}
+
+int main (int argc, char **argv)
+{
+  uint32_t sessions = 1;
+  uint32_t workers = 4;
+  const char *address = "127.0.0.1";
+  in_port_t base_port = 20000;
+  bool loop = false;
+  uint32_t run_time = 0;
+  uint32_t cache_kbytes = 8192;
+  bool receive = false;
+
+  progName = argv[0];
+  while (true) {
+    int c = -1;
+    int option_index = 0;
+    static struct option long_options[] = {
+      { "sessions", 1, 0, 's' },
+      { "workers", 1, 0, 'w' },
+      { "address", 1, 0, 'a' },
+      { "port", 1, 0, 'p' },
+      { "loop", 0, 0, 'l' },
+      { "time", 1, 0, 't' },
+      { "cache", 1, 0, 'c' },
+      { "receive", 0, 0, 'r' },
+      { "version", 0, 0, 'V' },
+      { "help", 0, 0, '?' },
+      { NULL, 0, 0, 0 }
+    };
+
+    c = getopt_long_only(argc, argv, "s:w:a:p:lt:c:rV?",
+			 long_options, &option_index);
+
+    if (c == -1)
+      break;
+
+    switch (c) {
+    case 's':
+      sessions = strtoul(optarg, NULL, 10);
+      break;
+    case 'w':
+      workers = strtoul(optarg, NULL, 10);
+      break;
+    case 'a':
+      address = optarg;
+      break;
+    case 'p':
+      base_port = strtoul(optarg, NULL, 10);
+      break;
+    case 'l':
+      loop = true;
+      break;
+    case 't':
+      run_time = strtoul(optarg, NULL, 10);
+      break;
+    case 'c':
+      cache_kbytes = strtoul(optarg, NULL, 10);
+      break;
+    case 'r':
+      receive = true;
+      break;
+    case 'V':
+      fprintf(stderr, "%s - %s version %s\n", progName,
+	      MPEG4IP_PACKAGE, MPEG4IP_VERSION);
+      return 0;
+    case '?':
+    default:
+      fprintf(stderr, "usage: %s%s", progName, usage);
+      return 0;
+    }
+  }
+
+  if (optind >= argc || sessions == 0) {
+    fprintf(stderr, "usage: %s%s", progName, usage);
+    exit(1);
+  }
+  if (loop && run_time == 0) {
+    fprintf(stderr, "%s: --loop needs --time\n", progName);
+    exit(1);
+  }
+  if (receive) {
+    address = "127.0.0.1";
+  }
+  raise_file_limit();
+
+  // every session gets a block of ports big enough for the file
+  // with the most hint tracks
+  uint32_t ports_per_session = 0;
+  for (int ix = optind; ix < argc; ix++) {
+    MP4FileHandle mp4File = MP4Read(argv[ix]);
+    if (mp4File == MP4_INVALID_FILE_HANDLE) {
+      fprintf(stderr, "%s: can't open %s\n", progName, argv[ix]);
+      exit(1);
+    }
+    uint32_t tracks = MP4GetNumberOfTracks(mp4File, MP4_HINT_TRACK_TYPE);
+    MP4Close(mp4File);
+    ports_per_session = MAX(ports_per_session, tracks * 2);
+  }
+  if (ports_per_session == 0) {
+    fprintf(stderr, "%s: no hint tracks, use mp4creator -hint\n", progName);
+    exit(1);
+  }
+
+  receiver_t receiver;
+  SDL_Thread *recv_thread = NULL;
+  memset(&receiver, 0, sizeof(receiver));
+  if (receive) {
+    receiver.socket_count = sessions * ports_per_session;
+    receiver.fds = (struct pollfd *)calloc(receiver.socket_count,
+				       sizeof(struct pollfd));
+    for (uint32_t ix = 0; ix < receiver.socket_count; ix++) {
+      receiver.fds[ix].fd = receiver_open(base_port + ix);
+      if (receiver.fds[ix].fd < 0) {
+	fprintf(stderr, "%s: can't open receive port %u\n", progName,
+		base_port + ix);
+	exit(1);
+      }
+      receiver.fds[ix].events = POLLIN;
+    }
+    recv_thread = SDL_CreateThread(receiver_thread, &receiver);
+  }
+
+  CStreamServer *server = new CStreamServer(workers, cache_kbytes * 1024);
+  if (server->Start() == false) {
+    fprintf(stderr, "%s: can't start worker threads\n", progName);
+    exit(1);
+  }
+
+  uint32_t files = argc - optind;
+  uint32_t started = 0;
+  for (uint32_t ix = 0; ix < sessions; ix++) {
+    if (server->AddSession(argv[optind + (ix % files)], address,
+			   base_port + (ix * ports_per_session), loop)) {
+      started++;
+    }
+  }
+  fprintf(stderr, "%s: %u sessions, %u workers\n", progName, started,
+	  workers);
+
+  if (run_time != 0) {
+    SDL_Delay(run_time * 1000);
+  } else {
+    server->WaitUntilIdle();
+  }
+  server->Stop();
+
+  fprintf(stdout, "sent "U64" packets, "U64" bytes, "U64" late, "
+	  "hint cache "U64" hits "U64" misses\n",
+	  server->get_packets_sent(), server->get_bytes_sent(),
+	  server->get_late_sends(), server->get_cache_hits(),
+	  server->get_cache_misses());
+  delete server;
+
+  if (receive) {
+    // let the last packets and byes arrive
+    SDL_Delay(500);
+    receiver.stop = true;
+    SDL_WaitThread(recv_thread, NULL);
+    fprintf(stdout, "received "U64" rtp packets, "U64" bytes, "
+	    U64" rtcp packets, "U64" sender reports\n",
+	    receiver.rtp_packets, receiver.rtp_bytes, receiver.rtcp_packets,
+	    receiver.rtcp_sender_reports);
+    for (uint32_t ix = 0; ix < receiver.socket_count; ix++) {
+      close(receiver.fds[ix].fd);
+    }
+    free(receiver.fds);
+  }
+  return 0;
+}
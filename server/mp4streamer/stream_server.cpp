@@ -0,0 +1,422 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ *
+ * The Original Code is MPEG4IP.
+ *
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2005.  All Rights Reserved.
+ *
+ * Contributor(s):
+ *		Bill May		wmay@cisco.com
+ */
+/*
+ * stream_server.cpp - paces the hint tracks of all sessions
+ *
+ * Every track that is streaming sits in a heap ordered by the time
+ * its next hint is due.  A worker takes the earliest track off the
+ * heap when it is due, sends the packets of the hint, reads ahead
+ * the hint after it and puts the track back.  A track is only ever
+ * handled by one worker at a time, so its rtp session needs no lock.
+ */
+#include "stream_server.h"
+
+// a send this late (usec) counts as late in the statistics
+#define LATE_SEND_USEC 10000
+
+static uint64_t get_time_usec (void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return ((uint64_t)tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+CStreamServer::CStreamServer (uint32_t worker_count,
+			      uint32_t cache_bytes_per_file)
+{
+  m_worker_count = worker_count == 0 ? 1 : worker_count;
+  m_workers = NULL;
+  m_cache_bytes_per_file = cache_bytes_per_file;
+  m_mutex = SDL_CreateMutex();
+  m_cond = SDL_CreateCond();
+  m_idle_cond = SDL_CreateCond();
+  m_stop = false;
+  m_heap_max = 64;
+  m_heap_count = 0;
+  m_heap = (CStreamTrack **)malloc(m_heap_max * sizeof(CStreamTrack *));
+  m_files = NULL;
+  m_session_count = 0;
+  m_packets_sent = m_bytes_sent = m_late_sends = 0;
+  m_cache_hits = m_cache_misses = 0;
+}
+
+CStreamServer::~CStreamServer (void)
+{
+  Stop();
+  CHECK_AND_FREE(m_heap);
+  SDL_DestroyCond(m_idle_cond);
+  SDL_DestroyCond(m_cond);
+  SDL_DestroyMutex(m_mutex);
+}
+
+bool CStreamServer::Start (void)
+{
+  m_workers = (SDL_Thread **)malloc(m_worker_count * sizeof(SDL_Thread *));
+  for (uint32_t ix = 0; ix < m_worker_count; ix++) {
+    m_workers[ix] = SDL_CreateThread(CStreamServer::WorkerThread, this);
+    if (m_workers[ix] == NULL) {
+      m_worker_count = ix;
+      Stop();
+      return false;
+    }
+  }
+  return true;
+}
+
+void CStreamServer::Stop (void)
+{
+  if (m_workers != NULL) {
+    SDL_LockMutex(m_mutex);
+    m_stop = true;
+    SDL_CondBroadcast(m_cond);
+    SDL_UnlockMutex(m_mutex);
+    for (uint32_t ix = 0; ix < m_worker_count; ix++) {
+      SDL_WaitThread(m_workers[ix], NULL);
+    }
+    free(m_workers);
+    m_workers = NULL;
+  }
+
+  // end the sessions that were still streaming, so the statistics
+  // are complete
+  SDL_LockMutex(m_mutex);
+  while (m_heap_count > 0) {
+    CStreamTrack *track = HeapPop();
+    EndTrack(track);
+    TrackDone(track);
+  }
+  SDL_UnlockMutex(m_mutex);
+}
+
+bool CStreamServer::AddSession (const char *file_name,
+				const char *dest_addr,
+				in_port_t base_port,
+				bool loop)
+{
+  SDL_LockMutex(m_mutex);
+  CHintFile *file = GetFile(file_name);
+  if (file == NULL) {
+    SDL_UnlockMutex(m_mutex);
+    return false;
+  }
+
+  CStreamSession *session = new CStreamSession;
+  session->m_file = file;
+  session->m_loop = loop;
+  session->m_track_count = file->get_track_count();
+  session->m_active_tracks = 0;
+  session->m_tracks = new CStreamTrack[session->m_track_count];
+  session->m_start_time = get_time_usec();
+
+  for (uint32_t ix = 0; ix < session->m_track_count; ix++) {
+    CStreamTrack *track = &session->m_tracks[ix];
+    rtp_stream_params_t rsp;
+
+    track->m_session = session;
+    track->m_track_index = ix;
+    track->m_loop_usec = 0;
+    track->m_next_hint = 1;
+    track->m_hint = NULL;
+    track->m_packets_sent = track->m_bytes_sent = 0;
+    // lrand48 isn't thread safe, which is one reason this is done
+    // with m_mutex held
+    track->m_rtp_ts_offset = (uint32_t)lrand48();
+
+    rtp_default_params(&rsp);
+    rsp.rtp_addr = dest_addr;
+    rsp.rtp_rx_port = 0;
+    rsp.rtp_tx_port = base_port + (2 * ix);
+    rsp.rtp_ttl = 1;
+    rsp.rtcp_bandwidth = 5000.0;
+    track->m_rtp = rtp_init_stream(&rsp);
+    if (track->m_rtp == NULL) {
+      fprintf(stderr, "%s: couldn't create rtp session to %s:%u\n",
+	      file_name, dest_addr, rsp.rtp_tx_port);
+      continue;
+    }
+    if (NextHint(track) == false) {
+      rtp_done(track->m_rtp);
+      track->m_rtp = NULL;
+      continue;
+    }
+    session->m_active_tracks++;
+  }
+
+  if (session->m_active_tracks == 0) {
+    EndSession(session);
+    SDL_UnlockMutex(m_mutex);
+    return false;
+  }
+  for (uint32_t ix = 0; ix < session->m_track_count; ix++) {
+    if (session->m_tracks[ix].m_rtp != NULL) {
+      HeapPush(&session->m_tracks[ix]);
+    }
+  }
+  m_session_count++;
+  SDL_CondSignal(m_cond);
+  SDL_UnlockMutex(m_mutex);
+  return true;
+}
+
+void CStreamServer::WaitUntilIdle (void)
+{
+  SDL_LockMutex(m_mutex);
+  while (m_session_count > 0) {
+    SDL_CondWait(m_idle_cond, m_mutex);
+  }
+  SDL_UnlockMutex(m_mutex);
+}
+
+int CStreamServer::WorkerThread (void *data)
+{
+  ((CStreamServer *)data)->WorkerLoop();
+  return 0;
+}
+
+void CStreamServer::WorkerLoop (void)
+{
+  SDL_LockMutex(m_mutex);
+  while (m_stop == false) {
+    if (m_heap_count == 0) {
+      SDL_CondWait(m_cond, m_mutex);
+      continue;
+    }
+    uint64_t now = get_time_usec();
+    if (m_heap[0]->m_send_time > now) {
+      uint64_t wait = (m_heap[0]->m_send_time - now + 999) / 1000;
+      SDL_CondWaitTimeout(m_cond, m_mutex, (Uint32)wait);
+      continue;
+    }
+    CStreamTrack *track = HeapPop();
+    if (now - track->m_send_time > LATE_SEND_USEC) {
+      m_late_sends++;
+    }
+    // let another worker have the next track while this one sends
+    if (m_heap_count > 0) {
+      SDL_CondSignal(m_cond);
+    }
+    SDL_UnlockMutex(m_mutex);
+
+    SendHint(track);
+    bool more = NextHint(track);
+    if (more == false) {
+      EndTrack(track);
+    }
+
+    SDL_LockMutex(m_mutex);
+    if (more) {
+      HeapPush(track);
+      if (m_heap[0] == track) {
+	SDL_CondSignal(m_cond);
+      }
+    } else {
+      TrackDone(track);
+    }
+  }
+  SDL_UnlockMutex(m_mutex);
+}
+
+/*
+ * SendHint - send the packets of the current hint, then an RTCP
+ * sender report if one is due
+ */
+void CStreamServer::SendHint (CStreamTrack *track)
+{
+  CHintSample *hint = track->m_hint;
+  uint32_t rtp_ts = 0;
+
+  for (uint16_t ix = 0; ix < hint->m_packet_count; ix++) {
+    hint_packet_t *pak = &hint->m_packets[ix];
+    struct iovec iov;
+
+    iov.iov_base = pak->payload;
+    iov.iov_len = pak->payload_len;
+    rtp_ts = pak->rtp_ts + track->m_rtp_ts_offset;
+    if (rtp_send_data_iov(track->m_rtp, rtp_ts, pak->payload_type,
+			  pak->mbit ? 1 : 0, 0, NULL, &iov, 1,
+			  NULL, 0, 0, 0) < 0) {
+      break;
+    }
+    track->m_packets_sent++;
+    track->m_bytes_sent += pak->payload_len;
+  }
+  track->m_session->m_file->ReleaseHint(hint);
+  track->m_hint = NULL;
+
+  rtp_send_ctrl(track->m_rtp, rtp_ts, NULL);
+  rtp_update(track->m_rtp);
+}
+
+/*
+ * NextHint - get the hint after the one just sent, and the time it is
+ * due.  Looping starts the file over, with the times and rtp
+ * timestamps carrying on from the end of the track
+ */
+bool CStreamServer::NextHint (CStreamTrack *track)
+{
+  CStreamSession *session = track->m_session;
+  CHintFile *file = session->m_file;
+  uint32_t ix = track->m_track_index;
+
+  if (track->m_next_hint > file->get_hint_count(ix)) {
+    MP4Duration duration = file->get_duration(ix);
+    if (session->m_loop == false || duration == 0) {
+      return false;
+    }
+    track->m_next_hint = 1;
+    track->m_rtp_ts_offset += (uint32_t)duration;
+    track->m_loop_usec +=
+      (duration * TO_U64(1000000)) / file->get_time_scale(ix);
+  }
+
+  track->m_hint = file->GetHint(ix, track->m_next_hint);
+  if (track->m_hint == NULL) {
+    return false;
+  }
+  track->m_next_hint++;
+  track->m_send_time = session->m_start_time + track->m_loop_usec +
+    track->m_hint->m_send_time;
+  return true;
+}
+
+void CStreamServer::EndTrack (CStreamTrack *track)
+{
+  if (track->m_hint != NULL) {
+    track->m_session->m_file->ReleaseHint(track->m_hint);
+    track->m_hint = NULL;
+  }
+  rtp_send_bye(track->m_rtp);
+  rtp_done(track->m_rtp);
+  track->m_rtp = NULL;
+}
+
+// called with m_mutex held, after EndTrack
+void CStreamServer::TrackDone (CStreamTrack *track)
+{
+  CStreamSession *session = track->m_session;
+
+  m_packets_sent += track->m_packets_sent;
+  m_bytes_sent += track->m_bytes_sent;
+  session->m_active_tracks--;
+  if (session->m_active_tracks == 0) {
+    EndSession(session);
+    m_session_count--;
+    SDL_CondBroadcast(m_idle_cond);
+  }
+}
+
+// called with m_mutex held
+void CStreamServer::EndSession (CStreamSession *session)
+{
+  ReleaseFile(session->m_file);
+  delete [] session->m_tracks;
+  delete session;
+}
+
+// called with m_mutex held
+CHintFile *CStreamServer::GetFile (const char *file_name)
+{
+  CHintFile *file;
+
+  for (file = m_files; file != NULL; file = file->get_next()) {
+    if (strcmp(file->get_file_name(), file_name) == 0) {
+      file->add_reference();
+      return file;
+    }
+  }
+
+  file = new CHintFile(file_name, m_cache_bytes_per_file);
+  if (file->Open() == false) {
+    fprintf(stderr, "%s: not a hinted mp4 file\n", file_name);
+    delete file;
+    return NULL;
+  }
+  file->add_reference();
+  file->set_next(m_files);
+  m_files = file;
+  return file;
+}
+
+// called with m_mutex held
+void CStreamServer::ReleaseFile (CHintFile *file)
+{
+  if (file->remove_reference() == false) {
+    return;
+  }
+  if (m_files == file) {
+    m_files = file->get_next();
+  } else {
+    CHintFile *prev = m_files;
+    while (prev->get_next() != file) {
+      prev = prev->get_next();
+    }
+    prev->set_next(file->get_next());
+  }
+  m_cache_hits += file->get_cache_hits();
+  m_cache_misses += file->get_cache_misses();
+  delete file;
+}
+
+void CStreamServer::HeapPush (CStreamTrack *track)
+{
+  if (m_heap_count == m_heap_max) {
+    m_heap_max *= 2;
+    m_heap = (CStreamTrack **)realloc(m_heap,
+				      m_heap_max * sizeof(CStreamTrack *));
+  }
+  uint32_t ix = m_heap_count++;
+  while (ix > 0) {
+    uint32_t parent = (ix - 1) / 2;
+    if (m_heap[parent]->m_send_time <= track->m_send_time) {
+      break;
+    }
+    m_heap[ix] = m_heap[parent];
+    ix = parent;
+  }
+  m_heap[ix] = track;
+}
+
+CStreamTrack *CStreamServer::HeapPop (void)
+{
+  CStreamTrack *ret = m_heap[0];
+  CStreamTrack *last = m_heap[--m_heap_count];
+  uint32_t ix = 0;
+
+  while (true) {
+    uint32_t child = (2 * ix) + 1;
+    if (child >= m_heap_count) {
+      break;
+    }
+    if (child + 1 < m_heap_count &&
+	m_heap[child + 1]->m_send_time < m_heap[child]->m_send_time) {
+      child++;
+    }
+    if (last->m_send_time <= m_heap[child]->m_send_time) {
+      break;
+    }
+    m_heap[ix] = m_heap[child];
+    ix = child;
+  }
+  if (m_heap_count > 0) {
+    m_heap[ix] = last;
+  }
+  return ret;
+}
@@ -0,0 +1,118 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ *
+ * The Original Code is MPEG4IP.
+ *
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2005.  All Rights Reserved.
+ *
+ * Contributor(s):
+ *		Bill May		wmay@cisco.com
+ */
+/*
+ * stream_server.h - streams the hint tracks of many sessions from a
+ * small pool of worker threads
+ */
+#ifndef __STREAM_SERVER_H__
+#define __STREAM_SERVER_H__
+
+#include "hint_cache.h"
+#include <rtp/rtp.h>
+
+class CStreamSession;
+
+// one hint track of a session, and its rtp session
+class CStreamTrack {
+ public:
+  CStreamSession *m_session;
+  uint32_t m_track_index;
+  struct rtp *m_rtp;
+  uint32_t m_rtp_ts_offset;	// random start, plus the loops so far
+  uint64_t m_loop_usec;		// usec added to the hint times by loops
+  MP4SampleId m_next_hint;
+  CHintSample *m_hint;		// the hint to send at m_send_time
+  uint64_t m_send_time;		// absolute, usec
+  uint64_t m_packets_sent;
+  uint64_t m_bytes_sent;
+};
+
+class CStreamSession {
+ public:
+  CHintFile *m_file;
+  uint64_t m_start_time;
+  bool m_loop;
+  uint32_t m_track_count;
+  uint32_t m_active_tracks;
+  CStreamTrack *m_tracks;
+};
+
+class CStreamServer {
+ public:
+  CStreamServer(uint32_t worker_count, uint32_t cache_bytes_per_file);
+  ~CStreamServer(void);
+
+  bool Start(void);
+  void Stop(void);
+
+  // streams each hint track of the file to dest_addr, the first
+  // to base_port, the next to base_port + 2, and so on
+  bool AddSession(const char *file_name,
+		  const char *dest_addr,
+		  in_port_t base_port,
+		  bool loop = false);
+
+  // waits until every session has finished, only useful without loop
+  void WaitUntilIdle(void);
+
+  uint32_t get_session_count(void) { return m_session_count; };
+  uint64_t get_packets_sent(void) { return m_packets_sent; };
+  uint64_t get_bytes_sent(void) { return m_bytes_sent; };
+  uint64_t get_late_sends(void) { return m_late_sends; };
+  uint64_t get_cache_hits(void) { return m_cache_hits; };
+  uint64_t get_cache_misses(void) { return m_cache_misses; };
+
+ protected:
+  static int WorkerThread(void *data);
+  void WorkerLoop(void);
+  void SendHint(CStreamTrack *track);
+  bool NextHint(CStreamTrack *track);
+  void EndTrack(CStreamTrack *track);
+  void TrackDone(CStreamTrack *track);
+  void EndSession(CStreamSession *session);
+
+  CHintFile *GetFile(const char *file_name);
+  void ReleaseFile(CHintFile *file);
+
+  // tracks that are waiting to send, ordered by m_send_time
+  void HeapPush(CStreamTrack *track);
+  CStreamTrack *HeapPop(void);
+
+  uint32_t m_worker_count;
+  SDL_Thread **m_workers;
+  uint32_t m_cache_bytes_per_file;
+
+  // everything below is protected by m_mutex
+  SDL_mutex *m_mutex;
+  SDL_cond *m_cond;		// the head of the heap changed, or stop
+  SDL_cond *m_idle_cond;	// a session ended
+  bool m_stop;
+
+  CStreamTrack **m_heap;
+  uint32_t m_heap_count, m_heap_max;
+
+  CHintFile *m_files;
+  uint32_t m_session_count;
+  uint64_t m_packets_sent, m_bytes_sent, m_late_sends;
+  uint64_t m_cache_hits, m_cache_misses;
+};
+
+#endif